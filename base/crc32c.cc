@@ -3,11 +3,14 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 //
 // A portable implementation of crc32c, optimized to handle
-// four bytes at a time.
+// four bytes at a time, and a hardware accelerated one based on SSE4.2 crc32 instruction
+// that is chosen at runtime.
 
 #include "base/crc32c.h"
 
 #include <stdint.h>
+#include <x86intrin.h>
+
 #include "base/endian.h"
 
 namespace crc32c {
@@ -282,7 +285,7 @@ static inline uint32_t LE_LOAD32(const uint8_t *buf) {
   return LittleEndian::Load32(buf);
 }
 
-uint32_t Extend(uint32_t crc, const uint8_t* buf, size_t size) {
+uint32_t ExtendPortable(uint32_t crc, const uint8_t* buf, size_t size) {
   //const uint8_t *p = reinterpret_cast<const uint8_t *>(buf);
   const uint8_t *e = buf + size;
   uint32_t l = crc ^ 0xffffffffu;
@@ -327,4 +330,154 @@ uint32_t Extend(uint32_t crc, const uint8_t* buf, size_t size) {
   return l ^ 0xffffffffu;
 }
 
+namespace {
+
+// Polynomials below are represented in bit-reflected order, i.e. bit 31 is x^0 and bit 0
+// is x^31, to match the reflected crc32c register.
+constexpr uint32_t kReflectedPoly = 0x82f63b78;
+constexpr uint32_t kXPow0 = 1u << 31;
+
+// Returns a(x) * b(x) modulo P(x).
+uint32_t MultModP(uint32_t a, uint32_t b) {
+  uint32_t m = kXPow0, p = 0;
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0)
+        break;
+    }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ kReflectedPoly : b >> 1;
+  }
+  return p;
+}
+
+// x2n_table[i] = x^(2^i) modulo P(x).
+struct PowTable {
+  uint32_t x2n[64];
+
+  PowTable() {
+    x2n[0] = kXPow0 >> 1;   // x^1
+    for (unsigned i = 1; i < 64; ++i)
+      x2n[i] = MultModP(x2n[i - 1], x2n[i - 1]);
+  }
+};
+
+const PowTable& GetPowTable() {
+  static const PowTable table;
+  return table;
+}
+
+// Returns x^n modulo P(x).
+uint32_t XPowNModP(uint64_t n) {
+  const PowTable& table = GetPowTable();
+  uint32_t p = kXPow0;
+  for (unsigned k = 0; n; n >>= 1, ++k) {
+    if (n & 1)
+      p = MultModP(table.x2n[k], p);
+  }
+  return p;
+}
+
+#define TARGET_SSE42 __attribute__((target("sse4.2,pclmul")))
+
+// Stream lengths for 3-way interleaved computation. crc32 instruction has latency of 3 cycles
+// and throughput of 1 cycle, therefore running 3 independent streams saturates the unit.
+// The partial crcs are merged with carry-less multiplication.
+constexpr size_t kLongStream = 8192;
+constexpr size_t kShortStream = 256;
+
+// x^(8 * len - 33) modulo P(x) for each of the stream lengths. See ShiftCrc below.
+uint32_t long_shift_k = 0, short_shift_k = 0;
+
+// Returns crc * x^(8 * len) modulo P(x), where k = x^(8 * len - 33) modulo P(x).
+// The 64-bit carry-less product of reflected operands equals crc * k * x and
+// crc32 instruction multiplies its 64-bit argument by x^32 before the reduction.
+TARGET_SSE42 inline uint32_t ShiftCrc(uint32_t crc, uint32_t k) {
+  __m128i prod = _mm_clmulepi64_si128(_mm_cvtsi32_si128(crc), _mm_cvtsi32_si128(k), 0);
+  return _mm_crc32_u64(0, _mm_cvtsi128_si64(prod));
+}
+
+TARGET_SSE42 inline uint64_t CrcStreams3(uint64_t crc, const uint8_t* buf, size_t len,
+                                         uint32_t k) {
+  uint64_t crc1 = 0, crc2 = 0;
+  const uint8_t* end = buf + len;
+  for (; buf < end; buf += 8) {
+    crc = _mm_crc32_u64(crc, LittleEndian::Load64(buf));
+    crc1 = _mm_crc32_u64(crc1, LittleEndian::Load64(buf + len));
+    crc2 = _mm_crc32_u64(crc2, LittleEndian::Load64(buf + 2 * len));
+  }
+  crc = ShiftCrc(crc, k) ^ crc1;
+  return ShiftCrc(crc, k) ^ crc2;
+}
+
+TARGET_SSE42 uint32_t ExtendSse42(uint32_t crc, const uint8_t* buf, size_t size) {
+  const uint8_t* e = buf + size;
+  uint64_t l = crc ^ 0xffffffffu;
+
+  // Align to 8 bytes.
+  while (buf != e && (reinterpret_cast<uintptr_t>(buf) & 7)) {
+    l = _mm_crc32_u8(l, *buf++);
+  }
+
+  while (size_t(e - buf) >= 3 * kLongStream) {
+    l = CrcStreams3(l, buf, kLongStream, long_shift_k);
+    buf += 3 * kLongStream;
+  }
+
+  while (size_t(e - buf) >= 3 * kShortStream) {
+    l = CrcStreams3(l, buf, kShortStream, short_shift_k);
+    buf += 3 * kShortStream;
+  }
+
+  while (e - buf >= 8) {
+    l = _mm_crc32_u64(l, LittleEndian::Load64(buf));
+    buf += 8;
+  }
+
+  while (buf != e) {
+    l = _mm_crc32_u8(l, *buf++);
+  }
+  return l ^ 0xffffffffu;
+}
+
+#undef TARGET_SSE42
+
+typedef uint32_t (*ExtendFunction)(uint32_t, const uint8_t*, size_t);
+
+bool HasSse42() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+}
+
+ExtendFunction ChooseExtend() {
+  if (HasSse42()) {
+    long_shift_k = XPowNModP(8 * kLongStream - 33);
+    short_shift_k = XPowNModP(8 * kShortStream - 33);
+    return &ExtendSse42;
+  }
+  return &ExtendPortable;
+}
+
+// Resolved once, on first use. Function-local static makes it safe to call Extend from
+// static initializers of other translation units.
+ExtendFunction GetExtend() {
+  static const ExtendFunction extend_fn = ChooseExtend();
+  return extend_fn;
+}
+
+}  // namespace
+
+uint32_t Extend(uint32_t crc, const uint8_t* buf, size_t size) {
+  return GetExtend()(crc, buf, size);
+}
+
+bool IsHardwareAccelerated() {
+  return GetExtend() != &ExtendPortable;
+}
+
+uint32_t Combine(uint32_t crc_a, uint32_t crc_b, size_t len_b) {
+  return MultModP(XPowNModP(uint64_t(len_b) * 8), crc_a) ^ crc_b;
+}
+
 }  // namespace crc32c
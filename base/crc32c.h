@@ -12,8 +12,21 @@ namespace crc32c {
 // Return the crc32c of concat(A, data[0,n-1]) where init_crc is the
 // crc32c of some string A.  Extend() is often used to maintain the
 // crc32c of a stream of data.
+// Uses SSE4.2 crc32 instruction when the cpu supports it and falls back to the portable
+// table-driven implementation otherwise.
 extern uint32_t Extend(uint32_t init_crc, const uint8_t* data, size_t n);
 
+// Table-driven implementation of Extend(). Exposed for tests and benchmarks.
+extern uint32_t ExtendPortable(uint32_t init_crc, const uint8_t* data, size_t n);
+
+// Returns true if Extend() runs on the hardware accelerated path.
+bool IsHardwareAccelerated();
+
+// Given crc_a = Value(A) and crc_b = Value(B), returns Value(concat(A, B)),
+// where len_b is the length of B. Runs in O(log(len_b)).
+// Allows checksumming large buffers in parallel chunks.
+uint32_t Combine(uint32_t crc_a, uint32_t crc_b, size_t len_b);
+
 // Return the crc32c of data[0,n-1]
 inline uint32_t Value(const uint8_t* data, size_t n) {
   return Extend(0, data, n);
@@ -4,9 +4,11 @@
 
 #include "base/crc32c.h"
 
+#include <random>
+
+#include "base/gtest.h"
 #include "base/integral_types.h"
 #include "strings/stringpiece.h"
-#include <gtest/gtest.h>
 
 namespace crc32c {
 
@@ -62,6 +64,34 @@ TEST(CRC, Extend) {
             Extend(Value("hello "), reinterpret_cast<const uint8*>("world"), 5));
 }
 
+TEST(CRC, Portable) {
+  std::mt19937 rand(10);
+  std::string buf(100000, '\0');
+  for (auto& c : buf)
+    c = rand();
+  const uint8* ptr = reinterpret_cast<const uint8*>(buf.data());
+
+  // Cover unaligned starts and all the tails of the interleaved streams.
+  for (size_t offs = 0; offs < 9; ++offs) {
+    for (size_t len : {0, 1, 7, 8, 15, 100, 767, 768, 769, 24575, 24576, 24577, 99000}) {
+      ASSERT_EQ(ExtendPortable(0, ptr + offs, len), Extend(0, ptr + offs, len))
+          << offs << " " << len;
+      ASSERT_EQ(ExtendPortable(17, ptr + offs, len), Extend(17, ptr + offs, len));
+    }
+  }
+}
+
+TEST(CRC, Combine) {
+  std::string str(70000, 'a');
+  for (size_t i = 0; i < str.size(); ++i)
+    str[i] = 'a' + i % 26;
+
+  for (size_t split : {0, 1, 5, 1000, 30000, 70000}) {
+    StringPiece a(str.data(), split), b(str.data() + split, str.size() - split);
+    ASSERT_EQ(Value(str), Combine(Value(a), Value(b), b.size())) << split;
+  }
+}
+
 TEST(CRC, Mask) {
   uint32_t crc = Value("foo");
   ASSERT_NE(crc, Mask(crc));
@@ -70,4 +100,16 @@ TEST(CRC, Mask) {
   ASSERT_EQ(crc, Unmask(Unmask(Mask(Mask(crc)))));
 }
 
+static void BM_Extend(benchmark::State& state, bool portable) {
+  std::string buf(state.range(0), 'x');
+  const uint8* ptr = reinterpret_cast<const uint8*>(buf.data());
+  while (state.KeepRunning()) {
+    base::sink_result(portable ? ExtendPortable(0, ptr, buf.size()) : Extend(0, ptr, buf.size()));
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * buf.size());
+}
+BENCHMARK_CAPTURE(BM_Extend, portable, true)->Arg(64)->Arg(1 << 10)->Arg(64 << 10)->Arg(1 << 20);
+BENCHMARK_CAPTURE(BM_Extend, dispatched, false)->Arg(64)->Arg(1 << 10)->Arg(64 << 10)
+    ->Arg(1 << 20);
+
 }  // namespace crc32c
\ No newline at end of file
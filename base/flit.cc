@@ -0,0 +1,132 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "base/flit.h"
+
+#include "base/simd.h"
+
+#if defined(__AVX2__) && defined(__BMI2__)
+#include <x86intrin.h>
+#endif
+
+namespace base {
+namespace flit {
+
+#if defined(__AVX2__) && defined(__BMI2__)
+
+const uint8_t* DecodeN(const uint8_t* src, size_t n, uint32_t* dest) {
+  uint32_t* const end = dest + n;
+
+  // 1 + number of trailing zeros of a nibble. 16 for zero low nibble and
+  // 9 for zero byte, so that min(low, high) is the length of a value starting with this byte.
+  const __m128i low_len = _mm_setr_epi8(16, 1, 2, 1, 3, 1, 2, 1, 4, 1, 2, 1, 3, 1, 2, 1);
+  const __m128i high_len = _mm_setr_epi8(9, 5, 6, 5, 7, 5, 6, 5, 8, 5, 6, 5, 7, 5, 6, 5);
+  const __m128i nibble = _mm_set1_epi8(0xF);
+  const __m128i four = _mm_set1_epi8(4);
+  const __m128i zero = _mm_setzero_si128();
+
+  // Every value takes at least one byte, so 16 pending values guarantee that
+  // the 16 byte load stays inside the input and the 4 lane store inside dest.
+  while (end - dest >= 16) {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+
+    // Single byte values have their LSB set. Moves LSB of each byte into its MSB.
+    unsigned ones = _mm_movemask_epi8(_mm_slli_epi16(in, 7));
+    if (ones == 0xFFFF) {
+      __m256i lo = _mm256_cvtepu8_epi32(in);
+      __m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(in, 8));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), _mm256_srli_epi32(lo, 1));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest) + 1, _mm256_srli_epi32(hi, 1));
+      src += 16;
+      dest += 16;
+      continue;
+    }
+
+    // Length of a value that would start at each byte.
+    __m128i len = _mm_min_epu8(_mm_shuffle_epi8(low_len, _mm_and_si128(in, nibble)),
+                               _mm_shuffle_epi8(high_len,
+                                                _mm_and_si128(_mm_srli_epi16(in, 4), nibble)));
+
+    // Walks the value boundaries in vector registers, each position is broadcasted to all
+    // the bytes. Lengths are clamped to 4 to keep the positions of the first group inside
+    // the loaded bytes.
+    __m128i clamped = _mm_min_epu8(len, four);
+    __m128i p1 = _mm_shuffle_epi8(clamped, zero);
+    __m128i p2 = _mm_add_epi8(p1, _mm_shuffle_epi8(clamped, p1));
+    __m128i p3 = _mm_add_epi8(p2, _mm_shuffle_epi8(clamped, p2));
+    __m128i p4 = _mm_add_epi8(p3, _mm_shuffle_epi8(clamped, p3));
+
+    // The second group is valid only if it ends inside the loaded bytes.
+    __m128i p5 = _mm_add_epi8(p4, _mm_shuffle_epi8(clamped, p4));
+    __m128i p6 = _mm_add_epi8(p5, _mm_shuffle_epi8(clamped, p5));
+    __m128i p7 = _mm_add_epi8(p6, _mm_shuffle_epi8(clamped, p6));
+    __m128i p8 = _mm_add_epi8(p7, _mm_shuffle_epi8(clamped, p7));
+
+    // Bytes 0-7: offsets of the first 8 values and then their lengths.
+    __m128i pos = _mm_unpacklo_epi32(
+        _mm_unpacklo_epi16(_mm_unpacklo_epi8(zero, p1), _mm_unpacklo_epi8(p2, p3)),
+        _mm_unpacklo_epi16(_mm_unpacklo_epi8(p4, p5), _mm_unpacklo_epi8(p6, p7)));
+    __m128i group_len = _mm_shuffle_epi8(len, pos);
+
+    unsigned longer = _mm_movemask_epi8(_mm_cmpgt_epi8(group_len, four)) & 0xFF;
+    unsigned count = 4, skip = _mm_cvtsi128_si32(p4) & 0xFF;
+
+    // The first group is cut at the first value that is longer than 4 bytes.
+    if (longer & 0xF) {
+      count = Bits::FindLSBSetNonZero(longer);
+      if (count == 0) {
+        src += ParseT(src, dest);
+        ++dest;
+        continue;
+      }
+      skip = (_mm_cvtsi128_si32(pos) >> (count * 8)) & 0xFF;
+    } else {
+      unsigned end8 = _mm_cvtsi128_si32(p8) & 0xFF;
+      bool full = longer == 0 && end8 <= 16;
+      count = full ? 8 : 4;
+      skip = full ? end8 : skip;
+    }
+
+    // Lengths codes of kShuffle4x32 are formed from 2 low bits of (length - 1).
+    __m128i lens = _mm_min_epu8(group_len, four);
+    uint64_t codes = _pext_u64(_mm_cvtsi128_si64(lens) - 0x0101010101010101ULL,
+                               0x0303030303030303ULL);
+
+    __m128i shuf = _mm_load_si128(reinterpret_cast<const __m128i*>(kShuffle4x32[codes & 0xFF]));
+    __m128i x = _mm_shuffle_epi8(in, shuf);
+
+    // Shifts out the length markers.
+    x = _mm_srlv_epi32(x, _mm_cvtepu8_epi32(lens));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), x);
+
+    // The second group is decoded unconditionally, the shuffle is offset by its position.
+    // Bytes with MSB set remain zeroing after the addition.
+    shuf = _mm_load_si128(reinterpret_cast<const __m128i*>(kShuffle4x32[codes >> 8]));
+    x = _mm_shuffle_epi8(in, _mm_add_epi8(shuf, p4));
+    x = _mm_srlv_epi32(x, _mm_cvtepu8_epi32(_mm_srli_si128(lens, 4)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest) + 1, x);
+
+    // Lanes past count hold garbage that is overwritten by the next iteration.
+    src += skip;
+    dest += count;
+  }
+
+  for (; dest < end; ++dest) {
+    src += ParseT(src, dest);
+  }
+  return src;
+}
+
+#else
+
+const uint8_t* DecodeN(const uint8_t* src, size_t n, uint32_t* dest) {
+  for (uint32_t* end = dest + n; dest < end; ++dest) {
+    src += ParseT(src, dest);
+  }
+  return src;
+}
+
+#endif
+
+}  // namespace flit
+}  // namespace base
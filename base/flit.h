@@ -212,6 +212,14 @@ template<typename T> unsigned ParseT(const uint8_t* src, T* dest) {
   return index;
 }
 
+// Decodes n consecutive flit-encoded uint32 values from src into dest.
+// Value boundaries inside a 16 byte window are found with vector shuffles and up to 8
+// values are extracted with shuffles and variable shifts. Runs of single byte values are
+// decoded 16 at a time. Several times faster than calling ParseT in a loop.
+// Assumes that the input is valid. Like ParseT, may read up to 4 bytes past the last value.
+// Returns pointer just past the last decoded value.
+const uint8_t* DecodeN(const uint8_t* src, size_t n, uint32_t* dest);
+
 template<typename T> uint32_t Length(T v) {
   return 1 + base::FindMsbNotZero(v | 1) / 7;
 }
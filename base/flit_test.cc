@@ -170,6 +170,82 @@ static void FillEncoded(uint8_t* buf, unsigned num) {
 
 constexpr unsigned kBatchLen = 1000;
 
+// Random values with up to max_bits bits, with runs of small values to exercise the fast paths.
+static std::vector<uint32_t> RandUint32Vec(unsigned num, unsigned max_bits) {
+  std::vector<uint32_t> res(num);
+  for (unsigned i = 0; i < num; ++i) {
+    unsigned bit_len = (i / 64) % 3 == 0 ? 7 : (rnd_engine() % max_bits) + 1;
+    res[i] = rnd_engine() & ((1ULL << bit_len) - 1);
+  }
+  return res;
+}
+
+TEST_F(FlitTest, DecodeN) {
+  for (unsigned max_bits : {7, 14, 21, 28, 32}) {
+    std::vector<uint32_t> input = RandUint32Vec(kBatchLen + 3, max_bits);
+    std::vector<uint8_t> buf(input.size() * 5 + 8);
+    uint8_t* next = buf.data();
+    for (uint32_t val : input)
+      next += flit::Encode32(val, next);
+
+    std::vector<uint32_t> output(input.size());
+    const uint8_t* end = flit::DecodeN(buf.data(), input.size(), output.data());
+    EXPECT_EQ(next, end);
+    ASSERT_EQ(input, output) << max_bits;
+  }
+}
+
+TEST_F(FlitTest, VarintDecodeN) {
+  for (unsigned max_bits : {7, 14, 21, 28, 32}) {
+    std::vector<uint32_t> input = RandUint32Vec(kBatchLen + 3, max_bits);
+    std::vector<uint8_t> buf(input.size() * Varint::kMax64);
+    uint8_t* next = buf.data();
+    for (uint32_t val : input)
+      next = Varint::Encode32(next, val);
+
+    std::vector<uint32_t> output(input.size());
+    const uint8_t* end = Varint::DecodeN(buf.data(), input.size(), output.data());
+    EXPECT_EQ(next, end);
+    ASSERT_EQ(input, output) << max_bits;
+
+    std::vector<uint64_t> output64(input.size());
+    end = Varint::DecodeN(buf.data(), input.size(), output64.data());
+    EXPECT_EQ(next, end);
+    ASSERT_TRUE(std::equal(input.begin(), input.end(), output64.begin())) << max_bits;
+  }
+
+  std::vector<uint64_t> input64(kBatchLen);
+  std::generate(input64.begin(), input64.end(), RandUint64);
+  std::vector<uint8_t> buf(input64.size() * Varint::kMax64);
+  uint8_t* next = buf.data();
+  for (uint64_t val : input64)
+    next = Varint::Encode64(next, val);
+
+  std::vector<uint64_t> output64(input64.size());
+  EXPECT_EQ(next, Varint::DecodeN(buf.data(), input64.size(), output64.data()));
+  EXPECT_EQ(input64, output64);
+}
+
+TEST_F(FlitTest, VarintDecodeDeltasN) {
+  std::vector<uint32_t> input(kBatchLen + 5);
+  uint32_t val = 1000;
+  for (auto& v : input) {
+    val += rnd_engine() % 300;
+    v = val;
+  }
+  std::vector<uint8_t> buf(input.size() * Varint::kMax32);
+  uint8_t* next = buf.data();
+  uint32_t prev = 1000;
+  for (uint32_t v : input) {
+    next = Varint::Encode32(next, v - prev);
+    prev = v;
+  }
+
+  std::vector<uint32_t> output(input.size());
+  EXPECT_EQ(next, Varint::DecodeDeltasN(buf.data(), input.size(), 1000, output.data()));
+  EXPECT_EQ(input, output);
+}
+
 template <typename T> void BM_FlitEncode(benchmark::State& state) {
   T input[kBatchLen];
   std::generate(input, input + arraysize(input), RandUint64);
@@ -262,4 +338,71 @@ static void BM_VarintEncode(benchmark::State& state) {
 }
 BENCHMARK(BM_VarintEncode);
 
+// Large enough to prevent branch predictors from memorizing the input.
+constexpr unsigned kDecodeLen = 1 << 16;
+
+static void BM_FlitDecodeLoop(benchmark::State& state) {
+  std::vector<uint32_t> input = RandUint32Vec(kDecodeLen, state.range(0));
+  std::vector<uint8_t> buf(kDecodeLen * 5 + 8);
+  uint8_t* next = buf.data();
+  for (uint32_t val : input)
+    next += flit::Encode32(val, next);
+  std::vector<uint32_t> output(kDecodeLen);
+
+  while (state.KeepRunning()) {
+    const uint8_t* rn = buf.data();
+    for (unsigned i = 0; i < kDecodeLen; ++i) {
+      rn += flit::ParseT(rn, &output[i]);
+    }
+    sink_result(output[kDecodeLen - 1]);
+  }
+}
+BENCHMARK(BM_FlitDecodeLoop)->Arg(7)->Arg(14)->Arg(32);
+
+static void BM_FlitDecodeN(benchmark::State& state) {
+  std::vector<uint32_t> input = RandUint32Vec(kDecodeLen, state.range(0));
+  std::vector<uint8_t> buf(kDecodeLen * 5 + 8);
+  uint8_t* next = buf.data();
+  for (uint32_t val : input)
+    next += flit::Encode32(val, next);
+  std::vector<uint32_t> output(kDecodeLen);
+
+  while (state.KeepRunning()) {
+    sink_result(flit::DecodeN(buf.data(), kDecodeLen, output.data()));
+  }
+}
+BENCHMARK(BM_FlitDecodeN)->Arg(7)->Arg(14)->Arg(32);
+
+static void BM_VarintDecodeLoop(benchmark::State& state) {
+  std::vector<uint32_t> input = RandUint32Vec(kDecodeLen, state.range(0));
+  std::vector<uint8_t> buf(kDecodeLen * Varint::kMax32);
+  uint8_t* next = buf.data();
+  for (uint32_t val : input)
+    next = Varint::Encode32(next, val);
+  std::vector<uint32_t> output(kDecodeLen);
+
+  while (state.KeepRunning()) {
+    const uint8_t* rn = buf.data();
+    for (unsigned i = 0; i < kDecodeLen; ++i) {
+      rn = Varint::Parse32Inline(rn, &output[i]);
+    }
+    sink_result(output[kDecodeLen - 1]);
+  }
+}
+BENCHMARK(BM_VarintDecodeLoop)->Arg(7)->Arg(14)->Arg(32);
+
+static void BM_VarintDecodeN(benchmark::State& state) {
+  std::vector<uint32_t> input = RandUint32Vec(kDecodeLen, state.range(0));
+  std::vector<uint8_t> buf(kDecodeLen * Varint::kMax32);
+  uint8_t* next = buf.data();
+  for (uint32_t val : input)
+    next = Varint::Encode32(next, val);
+  std::vector<uint32_t> output(kDecodeLen);
+
+  while (state.KeepRunning()) {
+    sink_result(Varint::DecodeN(buf.data(), kDecodeLen, output.data()));
+  }
+}
+BENCHMARK(BM_VarintDecodeN)->Arg(7)->Arg(14)->Arg(32);
+
 }  // namespace util
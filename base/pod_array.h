@@ -110,10 +110,11 @@ template<size_t ELEM_SIZE, size_t ALIGNMENT> class PODArrayBase {
   size_t size() const { return (c_end_ - c_start_) / ELEM_SIZE; }
 
   void swap(PODArrayBase& other) {
-    // must be allocated from the same memory resource.
+    // The memory resource travels together with the memory it allocated.
     std::swap(c_start_, other.c_start_);
     std::swap(c_end_, other.c_end_);
     std::swap(c_end_of_storage_, other.c_end_of_storage_);
+    std::swap(mr_, other.mr_);
   }
 
   pmr::memory_resource* mr() { return mr_; }
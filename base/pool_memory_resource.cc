@@ -0,0 +1,197 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "base/pool_memory_resource.h"
+
+#include <cstdlib>
+
+#include "base/logging.h"
+
+namespace base {
+
+using namespace std;
+
+constexpr size_t PoolMemoryResource::kMaxPooledSize;
+
+namespace {
+
+constexpr size_t kSpanSize = 1 << 16;
+constexpr size_t kSpanHeaderSize = 64;
+constexpr size_t kMinAlign = 16;
+
+constexpr uint16_t kClassSize[] = {16,  32,  48,  64,   80,   96,   112,  128,  192,
+                                   256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096};
+constexpr unsigned kNumClasses = sizeof(kClassSize) / sizeof(kClassSize[0]);
+
+static_assert(kClassSize[kNumClasses - 1] == PoolMemoryResource::kMaxPooledSize, "");
+
+// Maps (bytes + 15) / 16 to the size class.
+struct ClassIndex {
+  uint8_t index[PoolMemoryResource::kMaxPooledSize / kMinAlign + 1];
+
+  constexpr ClassIndex() : index{0} {
+    unsigned cls = 0;
+    for (unsigned i = 0; i < sizeof(index); ++i) {
+      if (i * kMinAlign > kClassSize[cls])
+        ++cls;
+      index[i] = cls;
+    }
+  }
+};
+
+// constexpr, so that the resource can be used during static initialization.
+constexpr ClassIndex class_index;
+
+inline unsigned SizeClass(size_t bytes) {
+  return class_index.index[(bytes + kMinAlign - 1) / kMinAlign];
+}
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+// The first kSpanHeaderSize bytes of each span.
+struct SpanHeader {
+  void* owner;
+  unsigned size_class;
+};
+
+static_assert(sizeof(SpanHeader) <= kSpanHeaderSize, "");
+
+inline SpanHeader* SpanOf(void* ptr) {
+  return reinterpret_cast<SpanHeader*>(reinterpret_cast<uintptr_t>(ptr) & ~(kSpanSize - 1));
+}
+
+atomic<unsigned> next_thread_index{0};
+thread_local unsigned thread_index = UINT32_MAX;
+
+}  // namespace
+
+struct PoolMemoryResource::ThreadCache {
+  FreeBlock* free_list[kNumClasses] = {nullptr};
+
+  // Multiple-producers single-consumer stack of blocks freed by other threads.
+  // The consumer always takes the whole list, hence it does not suffer from ABA problem.
+  atomic<FreeBlock*> remote_free{nullptr};
+
+  void PushRemote(FreeBlock* block) {
+    FreeBlock* head = remote_free.load(memory_order_relaxed);
+    do {
+      block->next = head;
+    } while (!remote_free.compare_exchange_weak(head, block, memory_order_release,
+                                                memory_order_relaxed));
+  }
+
+  // Moves remotely freed blocks into the local free lists. Returns false if there were none.
+  bool DrainRemote() {
+    FreeBlock* block = remote_free.exchange(nullptr, memory_order_acquire);
+    if (!block)
+      return false;
+    while (block) {
+      FreeBlock* next = block->next;
+      unsigned cls = SpanOf(block)->size_class;
+      block->next = free_list[cls];
+      free_list[cls] = block;
+      block = next;
+    }
+    return true;
+  }
+};
+
+PoolMemoryResource::PoolMemoryResource(pmr::memory_resource* upstream)
+    : upstream_(upstream), overflow_(new ThreadCache) {}
+
+PoolMemoryResource::~PoolMemoryResource() {
+  for (void* span : spans_)
+    free(span);
+}
+
+auto PoolMemoryResource::LocalCache() -> ThreadCache* {
+  if (thread_index == UINT32_MAX) {
+    thread_index = next_thread_index.fetch_add(1, memory_order_relaxed);
+  }
+  if (thread_index >= kMaxThreads)
+    return nullptr;
+
+  // Only the thread itself creates its cache.
+  ThreadCache* tc = caches_[thread_index].get();
+  if (!tc) {
+    tc = new ThreadCache;
+    caches_[thread_index].reset(tc);
+  }
+  return tc;
+}
+
+void PoolMemoryResource::Refill(ThreadCache* tc, unsigned size_class) {
+  void* span = aligned_alloc(kSpanSize, kSpanSize);
+  CHECK(span) << "Out of memory";
+
+  SpanHeader* header = new (span) SpanHeader;
+  header->owner = tc;
+  header->size_class = size_class;
+
+  {
+    std::lock_guard<mutex> lk(spans_mu_);
+    spans_.push_back(span);
+  }
+  span_bytes_.fetch_add(kSpanSize, memory_order_relaxed);
+
+  size_t block_size = kClassSize[size_class];
+  char* start = reinterpret_cast<char*>(span) + kSpanHeaderSize;
+  char* end = reinterpret_cast<char*>(span) + kSpanSize;
+
+  FreeBlock* head = tc->free_list[size_class];
+  for (char* next = start; next + block_size <= end; next += block_size) {
+    FreeBlock* block = reinterpret_cast<FreeBlock*>(next);
+    block->next = head;
+    head = block;
+  }
+  tc->free_list[size_class] = head;
+}
+
+void* PoolMemoryResource::AllocateFrom(ThreadCache* tc, unsigned size_class) {
+  FreeBlock* block = tc->free_list[size_class];
+  if (!block) {
+    if (!tc->DrainRemote() || !tc->free_list[size_class]) {
+      Refill(tc, size_class);
+    }
+    block = tc->free_list[size_class];
+  }
+  tc->free_list[size_class] = block->next;
+
+  return block;
+}
+
+void* PoolMemoryResource::do_allocate(std::size_t bytes, std::size_t align) {
+  if (bytes > kMaxPooledSize || align > kMinAlign)
+    return upstream_->allocate(bytes, align);
+
+  unsigned cls = SizeClass(bytes);
+  ThreadCache* tc = LocalCache();
+  if (tc)
+    return AllocateFrom(tc, cls);
+
+  std::lock_guard<mutex> lk(overflow_mu_);
+  return AllocateFrom(overflow_.get(), cls);
+}
+
+void PoolMemoryResource::do_deallocate(void* ptr, std::size_t bytes, std::size_t align) {
+  if (bytes > kMaxPooledSize || align > kMinAlign)
+    return upstream_->deallocate(ptr, bytes, align);
+
+  FreeBlock* block = reinterpret_cast<FreeBlock*>(ptr);
+  SpanHeader* span = SpanOf(ptr);
+  DCHECK_EQ(span->size_class, SizeClass(bytes));
+
+  ThreadCache* owner = reinterpret_cast<ThreadCache*>(span->owner);
+
+  // Overflow threads have no local cache, therefore they always use the remote queue.
+  if (owner == LocalCache()) {
+    block->next = owner->free_list[span->size_class];
+    owner->free_list[span->size_class] = block;
+  } else {
+    owner->PushRemote(block);
+  }
+}
+
+}  // namespace base
@@ -0,0 +1,70 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <pmr/memory_resource.h>
+
+namespace base {
+
+// Thread-caching memory resource for small objects.
+// Allocations of up to kMaxPooledSize bytes are rounded up to a size class and served from
+// per-thread free lists without synchronization. Each thread carves its blocks from its own
+// spans, so a block freed by a thread other than its owner is pushed to the owner's
+// lock-free remote-free queue. The owner reclaims those blocks when its free list runs dry.
+// Larger allocations or those with alignment above 16 go to the upstream resource.
+//
+// Designed for a fixed set of long living threads, like IoContextPool threads.
+// Memory of the pooled blocks is returned to the system only when the resource is destroyed,
+// hence it must outlive all its allocations.
+class PoolMemoryResource : public pmr::memory_resource {
+ public:
+  static constexpr size_t kMaxPooledSize = 4096;
+
+  explicit PoolMemoryResource(pmr::memory_resource* upstream = pmr::get_default_resource());
+  ~PoolMemoryResource();
+
+  // Returns the number of bytes held in spans.
+  size_t MemoryUsage() const { return span_bytes_.load(std::memory_order_relaxed); }
+
+  pmr::memory_resource* upstream() const { return upstream_; }
+
+ protected:
+  void* do_allocate(std::size_t bytes, std::size_t align) override;
+
+  void do_deallocate(void* ptr, std::size_t bytes, std::size_t align) override;
+
+  bool do_is_equal(const pmr::memory_resource& o) const override { return &o == this; }
+
+ private:
+  struct ThreadCache;
+
+  ThreadCache* LocalCache();
+  void* AllocateFrom(ThreadCache* tc, unsigned size_class);
+
+  // Allocates a span for size_class, carves it into blocks and adds them to tc.
+  void Refill(ThreadCache* tc, unsigned size_class);
+
+  pmr::memory_resource* upstream_;
+
+  // Thread caches are indexed by a process-wide thread index.
+  // Threads with index above the limit share overflow_ cache under overflow_mu_.
+  enum { kMaxThreads = 256 };
+  std::unique_ptr<ThreadCache> caches_[kMaxThreads];
+  std::unique_ptr<ThreadCache> overflow_;
+  std::mutex overflow_mu_;
+
+  std::mutex spans_mu_;
+  std::vector<void*> spans_;
+  std::atomic<size_t> span_bytes_{0};
+
+  PoolMemoryResource(const PoolMemoryResource&) = delete;
+  void operator=(const PoolMemoryResource&) = delete;
+};
+
+}  // namespace base
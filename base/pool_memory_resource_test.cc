@@ -0,0 +1,140 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "base/pool_memory_resource.h"
+
+#include <thread>
+
+#include "base/chunked_array.h"
+#include "base/gtest.h"
+#include "base/pod_array.h"
+
+namespace base {
+
+using namespace std;
+
+class PoolMemoryResourceTest : public testing::Test {
+ protected:
+  PoolMemoryResource pool_;
+};
+
+TEST_F(PoolMemoryResourceTest, Basic) {
+  void* p1 = pool_.allocate(24);
+  void* p2 = pool_.allocate(24);
+  EXPECT_NE(p1, p2);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(p1) % 16);
+  size_t usage = pool_.MemoryUsage();
+  EXPECT_GT(usage, 0);
+
+  pool_.deallocate(p1, 24);
+  void* p3 = pool_.allocate(20);  // same size class.
+  EXPECT_EQ(p1, p3);
+
+  pool_.deallocate(p2, 24);
+  pool_.deallocate(p3, 20);
+
+  for (size_t sz : {1, 16, 17, 100, 129, 1000, 4096}) {
+    char* p = reinterpret_cast<char*>(pool_.allocate(sz));
+    memset(p, 'a', sz);
+    pool_.deallocate(p, sz);
+  }
+
+  void* big = pool_.allocate(1 << 20);
+  pool_.deallocate(big, 1 << 20);
+}
+
+TEST_F(PoolMemoryResourceTest, Containers) {
+  PODArray<uint8_t> arr(&pool_);
+  for (unsigned i = 0; i < 10000; ++i)
+    arr.push_back(i);
+  EXPECT_EQ(10000, arr.size());
+
+  ChunkedArray<int, 16> chunked(&pool_);
+  for (int i = 0; i < 1000; ++i)
+    chunked.emplace_back(i);
+  EXPECT_EQ(999, chunked[999]);
+}
+
+TEST_F(PoolMemoryResourceTest, RemoteFree) {
+  constexpr unsigned kNum = 10000;
+  vector<void*> ptrs(kNum);
+  for (auto& p : ptrs)
+    p = pool_.allocate(64);
+  size_t usage = pool_.MemoryUsage();
+
+  // Free from other threads while the owner keeps allocating.
+  thread t1([&] {
+    for (unsigned i = 0; i < kNum; i += 2)
+      pool_.deallocate(ptrs[i], 64);
+  });
+  thread t2([&] {
+    for (unsigned i = 1; i < kNum; i += 2)
+      pool_.deallocate(ptrs[i], 64);
+  });
+  t1.join();
+  t2.join();
+
+  // The owner reclaims the remotely freed blocks instead of allocating new spans.
+  for (auto& p : ptrs)
+    p = pool_.allocate(64);
+  EXPECT_EQ(usage, pool_.MemoryUsage());
+
+  for (auto& p : ptrs)
+    pool_.deallocate(p, 64);
+}
+
+TEST_F(PoolMemoryResourceTest, ProducerConsumer) {
+  constexpr unsigned kNum = 100000;
+  vector<atomic<void*>> slots(16);
+  for (auto& s : slots)
+    s.store(nullptr);
+
+  thread consumer([&] {
+    for (unsigned i = 0; i < kNum;) {
+      void* p = slots[i % slots.size()].exchange(nullptr);
+      if (p) {
+        pool_.deallocate(p, 32);
+        ++i;
+      }
+    }
+  });
+
+  for (unsigned i = 0; i < kNum; ++i) {
+    void* p = pool_.allocate(32);
+    auto& slot = slots[i % slots.size()];
+    void* expected = nullptr;
+    while (!slot.compare_exchange_weak(expected, p))
+      expected = nullptr;
+  }
+  consumer.join();
+}
+
+static void BM_PoolAllocate(benchmark::State& state) {
+  PoolMemoryResource pool;
+  vector<void*> ptrs(1024);
+  size_t sz = state.range(0);
+  while (state.KeepRunning()) {
+    for (auto& p : ptrs)
+      p = pool.allocate(sz);
+    for (auto p : ptrs)
+      pool.deallocate(p, sz);
+  }
+  state.SetItemsProcessed(state.iterations() * ptrs.size());
+}
+BENCHMARK(BM_PoolAllocate)->Arg(32)->Arg(256)->Arg(2000);
+
+static void BM_DefaultAllocate(benchmark::State& state) {
+  pmr::memory_resource* mr = pmr::get_default_resource();
+  vector<void*> ptrs(1024);
+  size_t sz = state.range(0);
+  while (state.KeepRunning()) {
+    for (auto& p : ptrs)
+      p = mr->allocate(sz);
+    for (auto p : ptrs)
+      mr->deallocate(p, sz);
+  }
+  state.SetItemsProcessed(state.iterations() * ptrs.size());
+}
+BENCHMARK(BM_DefaultAllocate)->Arg(32)->Arg(256)->Arg(2000);
+
+}  // namespace base
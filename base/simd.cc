@@ -50,6 +50,32 @@ size_t CountVal8(const uint8_t* ptr, size_t len, char c) {
   return res;
 }
 
+namespace {
+
+struct Shuffle4x32Table {
+  alignas(16) uint8_t mask[256][16];
+
+  constexpr Shuffle4x32Table() : mask{} {
+    for (unsigned code = 0; code < 256; ++code) {
+      unsigned src = 0;
+      for (unsigned lane = 0; lane < 4; ++lane) {
+        unsigned len = ((code >> (2 * lane)) & 3) + 1;
+        for (unsigned j = 0; j < 4; ++j) {
+          // pshufb zeroes the destination byte if the MSB of the mask byte is set.
+          mask[code][lane * 4 + j] = j < len ? src + j : 0x80;
+        }
+        src += len;
+      }
+    }
+  }
+};
+
+constexpr Shuffle4x32Table kShuffleTable;
+
+}  // namespace
+
+const uint8_t (&kShuffle4x32)[256][16] = kShuffleTable.mask;
+
 #ifdef __SSE4_1__
 
 // taken from: https://github.com/lemire/FastDifferentialCoding/blob/master/src/fastdelta.c
@@ -109,6 +135,59 @@ void ComputeDeltasInplace(uint16_t* buffer, size_t length, uint16_t starting_poi
   }
 }
 
+void ComputePrefixSumInplace(uint32_t* buffer, size_t length, uint32_t starting_point) {
+  __m128i prev = _mm_set1_epi32(starting_point);
+  size_t i = 0;
+  __m128i* buf16 = (__m128i*)buffer;
+
+  for (; i < length / 4; i++) {
+    __m128i curr = _mm_lddqu_si128(buf16 + i);
+
+    // Two shift-add steps compute the running sums of 4 lanes:
+    // d3+d2+d1+d0, d2+d1+d0, d1+d0, d0.
+    curr = _mm_add_epi32(curr, _mm_slli_si128(curr, 4));
+    curr = _mm_add_epi32(curr, _mm_slli_si128(curr, 8));
+
+    // prev holds the last sum of the previous block replicated 4 times.
+    curr = _mm_add_epi32(curr, prev);
+    _mm_storeu_si128(buf16 + i, curr);
+    prev = _mm_shuffle_epi32(curr, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+
+  uint32_t sum = _mm_cvtsi128_si32(prev);
+  for (i = 4 * i; i < length; ++i) {
+    sum += buffer[i];
+    buffer[i] = sum;
+  }
+}
+
+void ComputePrefixSumInplace(uint16_t* buffer, size_t length, uint16_t starting_point) {
+  __m128i prev = _mm_set1_epi16(starting_point);
+  size_t i = 0;
+  __m128i* buf16 = (__m128i*)buffer;
+
+  for (; i < length / 8; i++) {
+    __m128i curr = _mm_lddqu_si128(buf16 + i);
+
+    curr = _mm_add_epi16(curr, _mm_slli_si128(curr, 2));
+    curr = _mm_add_epi16(curr, _mm_slli_si128(curr, 4));
+    curr = _mm_add_epi16(curr, _mm_slli_si128(curr, 8));
+
+    curr = _mm_add_epi16(curr, prev);
+    _mm_storeu_si128(buf16 + i, curr);
+
+    // Replicate the last uint16 into all the lanes.
+    prev = _mm_shufflehi_epi16(curr, _MM_SHUFFLE(3, 3, 3, 3));
+    prev = _mm_unpackhi_epi64(prev, prev);
+  }
+
+  uint16_t sum = _mm_extract_epi16(prev, 0);
+  for (i = 8 * i; i < length; ++i) {
+    sum += buffer[i];
+    buffer[i] = sum;
+  }
+}
+
 #endif
 
 }  // namespace base
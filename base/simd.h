@@ -18,4 +18,15 @@ size_t CountVal8(const uint8_t* ptr, size_t len, char val);
 void ComputeDeltasInplace(uint32_t * buffer, size_t length, uint32_t starting_point);
 void ComputeDeltasInplace(uint16_t * buffer, size_t length, uint16_t starting_point);
 
+// Inverse of ComputeDeltasInplace: replaces buffer with its running sums
+// (starting_point + buffer[0], starting_point + buffer[0] + buffer[1], ...)
+void ComputePrefixSumInplace(uint32_t* buffer, size_t length, uint32_t starting_point);
+void ComputePrefixSumInplace(uint16_t* buffer, size_t length, uint16_t starting_point);
+
+// pshufb masks that spread 4 consecutive little-endian integers of 1-4 bytes each
+// into 4 uint32 lanes, zero-extending them. Indexed by the lengths code
+// (len0 - 1) | (len1 - 1) << 2 | (len2 - 1) << 4 | (len3 - 1) << 6.
+// Used by the bulk varint and flit decoders.
+extern const uint8_t (&kShuffle4x32)[256][16];
+
 }  // namespace base
@@ -66,6 +66,24 @@ TEST(SimdTest, Deltas) {
     EXPECT_EQ(buf16[i], i);
 }
 
+TEST(SimdTest, PrefixSum) {
+  for (size_t len : {0, 3, 4, 17, 1024}) {
+    std::vector<uint32> buf(len);
+    for (unsigned i = 0; i < len; ++i)
+      buf[i] = i * 7 + 1000;
+    std::vector<uint32> orig = buf;
+
+    ComputeDeltasInplace(buf.data(), len, 5);
+    ComputePrefixSumInplace(buf.data(), len, 5);
+    EXPECT_EQ(orig, buf) << len;
+  }
+
+  std::vector<uint16> buf16(19, 1);
+  ComputePrefixSumInplace(buf16.data(), buf16.size(), 100);
+  for (unsigned i = 0; i < buf16.size(); ++i)
+    EXPECT_EQ(101 + i, buf16[i]);
+}
+
 TEST(SimdTest, OverFlow) {
   std::unique_ptr<uint8_t[]> buf(new uint8_t[32]);
   memset(buf.get(), 1, 32);
@@ -6,6 +6,11 @@
 #include <string>
 
 #include "base/varint.h"
+#include "base/simd.h"
+
+#ifdef __SSE4_1__
+#include <x86intrin.h>
+#endif
 
 constexpr int Varint::kMax32;
 constexpr int Varint::kMax64;
@@ -257,3 +262,158 @@ int Varint::Length64(uint64 v) {
   }
   return nb + Varint::Length32(tmp);
 }
+
+#ifdef __SSE4_1__
+
+namespace {
+
+// Describes up to 4 leading varints of at most 4 bytes each that are fully contained
+// in a 12 byte window, given continuation bits of the window.
+struct VarintGroup {
+  uint8 code;   // Lengths code for base::kShuffle4x32.
+  uint8 count;  // 0 if the first varint is longer than 4 bytes or crosses the window.
+  uint8 bytes;  // Total length of the group.
+};
+
+struct VarintGroupTable {
+  static constexpr unsigned kWindow = 12;
+
+  VarintGroup group[1 << kWindow];
+
+  constexpr VarintGroupTable() : group{} {
+    for (unsigned mask = 0; mask < (1 << kWindow); ++mask) {
+      unsigned pos = 0, count = 0, code = 0;
+      while (count < 4 && pos < kWindow) {
+        unsigned len = 1;
+        while (pos + len <= kWindow && (mask & (1 << (pos + len - 1))))
+          ++len;
+        if (pos + len > kWindow || len > 4)
+          break;
+        code |= (len - 1) << (2 * count);
+        ++count;
+        pos += len;
+      }
+      group[mask].code = code;
+      group[mask].count = count;
+      group[mask].bytes = pos;
+    }
+  }
+};
+
+constexpr VarintGroupTable kVarintGroups;
+
+// Zero-extends 4 uint32 lanes into dest.
+inline void Store4(__m128i v, uint32* dest) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), v);
+}
+
+inline void Store4(__m128i v, uint64* dest) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_cvtepu32_epi64(v));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest) + 1,
+                   _mm_cvtepu32_epi64(_mm_srli_si128(v, 8)));
+}
+
+// Zero-extends 4 low bytes of v into dest.
+inline void Store4Bytes(__m128i v, uint32* dest) {
+  Store4(_mm_cvtepu8_epi32(v), dest);
+}
+
+inline void Store4Bytes(__m128i v, uint64* dest) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_cvtepu8_epi64(v));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest) + 1,
+                   _mm_cvtepu8_epi64(_mm_srli_si128(v, 2)));
+}
+
+// Writes 16 or 8 byte values from in into dest.
+template <typename T> inline void StoreBytes(__m128i in, unsigned num, T* dest) {
+  for (unsigned i = 0; i < num; i += 4) {
+    Store4Bytes(in, dest + i);
+    in = _mm_srli_si128(in, 4);
+  }
+}
+
+template <typename T> const uint8* DecodeVarintN(const uint8* src, size_t n, T* dest) {
+  T* const end = dest + n;
+  const __m128i low7 = _mm_set1_epi32(0x7f);
+
+  // Every value takes at least one byte, so 16 pending values guarantee that
+  // the 16 byte load stays inside the input and the 4 lane store inside dest.
+  while (end - dest >= 16) {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    unsigned mask = _mm_movemask_epi8(in);
+
+    if (mask == 0) {
+      StoreBytes(in, 16, dest);
+      src += 16;
+      dest += 16;
+      continue;
+    }
+
+    if ((mask & 0xFF) == 0) {
+      StoreBytes(in, 8, dest);
+      src += 8;
+      dest += 8;
+      continue;
+    }
+
+    const VarintGroup& g = kVarintGroups.group[mask & ((1 << VarintGroupTable::kWindow) - 1)];
+    if (g.count == 0) {
+      src = Varint::Parse(src, dest);
+      ++dest;
+      continue;
+    }
+
+    __m128i shuf = _mm_load_si128(reinterpret_cast<const __m128i*>(base::kShuffle4x32[g.code]));
+
+    // Each lane holds up to 4 little-endian varint bytes. Drops continuation bits and
+    // concatenates 7-bit groups.
+    __m128i x = _mm_shuffle_epi8(in, shuf);
+    __m128i v = _mm_and_si128(x, low7);
+    v = _mm_or_si128(v, _mm_and_si128(_mm_srli_epi32(x, 1), _mm_slli_epi32(low7, 7)));
+    v = _mm_or_si128(v, _mm_and_si128(_mm_srli_epi32(x, 2), _mm_slli_epi32(low7, 14)));
+    v = _mm_or_si128(v, _mm_and_si128(_mm_srli_epi32(x, 3), _mm_slli_epi32(low7, 21)));
+
+    Store4(v, dest);
+    src += g.bytes;
+    dest += g.count;
+  }
+
+  for (; dest < end; ++dest) {
+    src = Varint::Parse(src, dest);
+  }
+  return src;
+}
+
+}  // namespace
+
+const uint8* Varint::DecodeN(const uint8* src, size_t n, uint32* dest) {
+  return DecodeVarintN(src, n, dest);
+}
+
+const uint8* Varint::DecodeN(const uint8* src, size_t n, uint64* dest) {
+  return DecodeVarintN(src, n, dest);
+}
+
+#else
+
+const uint8* Varint::DecodeN(const uint8* src, size_t n, uint32* dest) {
+  for (uint32* end = dest + n; dest < end; ++dest) {
+    src = Parse32Inline(src, dest);
+  }
+  return src;
+}
+
+const uint8* Varint::DecodeN(const uint8* src, size_t n, uint64* dest) {
+  for (uint64* end = dest + n; dest < end; ++dest) {
+    src = Parse64(src, dest);
+  }
+  return src;
+}
+
+#endif
+
+const uint8* Varint::DecodeDeltasN(const uint8* src, size_t n, uint32 base, uint32* dest) {
+  src = DecodeN(src, n, dest);
+  base::ComputePrefixSumInplace(dest, n, base);
+  return src;
+}
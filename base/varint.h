@@ -138,6 +138,19 @@ class Varint {
   //            "out" stores the actual sum.
   static const uint8* FastDecodeDeltas(const uint8* ptr, int64 goal, int64* out);
 
+  // Bulk decoding of n consecutive varints into dest, masked-VByte style:
+  // a continuation mask of 16 input bytes selects a shuffle that decodes up to 4 values at once.
+  // Runs of single byte values are expanded 8 or 16 at a time.
+  // It is several times faster than calling ParseXXInline in a loop.
+  // REQUIRES   "src" points to n valid varints. Does not read past them.
+  // EFFECTS    Returns a pointer just past the last read byte.
+  static const uint8* DecodeN(const uint8* src, size_t n, uint32* dest);
+  static const uint8* DecodeN(const uint8* src, size_t n, uint64* dest);
+
+  // Decodes n varint-encoded deltas and converts them into absolute values
+  // relative to "base", i.e. the inverse of base::ComputeDeltasInplace.
+  static const uint8* DecodeDeltasN(const uint8* src, size_t n, uint32 base, uint32* dest);
+
  private:
   static const uint8* Parse32FallbackInline(const uint8* p, uint32* val);
   static const uint8* Parse32Fallback(const uint8* p, uint32* val);
@@ -70,6 +70,18 @@ set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -fno-builtin-realloc -fno-builtin-free")
 set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -fno-omit-frame-pointer -Wno-unused-parameter")
 set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -DGOOGLE_PROTOBUF_NO_RTTI")
 
+# rapidjson SIMD must be configured identically in all translation units. It may read upto
+# 15 bytes past the end of the parsed string, hence the parsed buffers are padded, see
+# mr/ptable.h. Debug builds run with sanitizers and keep the scalar parser.
+if (CMAKE_SYSTEM_PROCESSOR MATCHES "aarch64|arm")
+  set(RAPIDJSON_SIMD_FLAG "-DRAPIDJSON_NEON")
+else()
+  set(RAPIDJSON_SIMD_FLAG "-DRAPIDJSON_SSE42")
+endif()
+foreach(cfg RELEASE RELWITHDEBINFO MINSIZEREL)
+  set(CMAKE_CXX_FLAGS_${cfg} "${CMAKE_CXX_FLAGS_${cfg}} ${RAPIDJSON_SIMD_FLAG}")
+endforeach()
+
 # Need -fPIC in order to link against shared libraries. For example when creating python modules.
 set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -Wno-unused-result")
 
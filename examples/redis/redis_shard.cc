@@ -0,0 +1,109 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "examples/redis/redis_shard.h"
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "base/logging.h"
+
+namespace redis {
+
+using namespace util;
+
+// Erases its key when fired. Owned by the entry, so erasing destroys the event as well,
+// which is fine because TimerWheel does not access events after running them.
+struct Shard::ExpireEvent : public base::TimerEventInterface {
+  ExpireEvent(Shard* s, absl::string_view k) : shard(s), key(k) {}
+
+  void execute() override { shard->table_.erase(key); }
+
+  Shard* shard;
+  std::string key;
+};
+
+Shard::Shard(IoContext* context) : context_(context) {}
+
+Shard::~Shard() {}
+
+const std::string* Shard::Get(absl::string_view key) const {
+  auto it = table_.find(key);
+  return it == table_.end() ? nullptr : &it->second.value;
+}
+
+void Shard::Set(absl::string_view key, absl::string_view value, uint64_t expire_msec) {
+  auto it = table_.find(key);
+  if (it == table_.end()) {
+    it = table_.emplace(std::string(key), Entry{}).first;
+  }
+
+  Entry& entry = it->second;
+  entry.value.assign(value.data(), value.size());
+  if (expire_msec) {
+    ScheduleExpiry(key, expire_msec, &entry);
+  } else {
+    entry.expire.reset();
+  }
+}
+
+bool Shard::Del(absl::string_view key) {
+  auto it = table_.find(key);
+  if (it == table_.end())
+    return false;
+  table_.erase(it);
+  return true;
+}
+
+bool Shard::IncrBy(absl::string_view key, int64_t delta, int64_t* result) {
+  auto it = table_.find(key);
+  int64_t val = 0;
+  if (it != table_.end() && !absl::SimpleAtoi(it->second.value, &val))
+    return false;
+
+  if (__builtin_add_overflow(val, delta, result))
+    return false;
+
+  if (it == table_.end()) {
+    it = table_.emplace(std::string(key), Entry{}).first;
+  }
+  absl::AlphaNum an(*result);
+  it->second.value.assign(an.data(), an.size());
+
+  return true;
+}
+
+bool Shard::Expire(absl::string_view key, int64_t msec) {
+  auto it = table_.find(key);
+  if (it == table_.end())
+    return false;
+
+  if (msec <= 0) {
+    table_.erase(it);
+  } else {
+    ScheduleExpiry(key, msec, &it->second);
+  }
+  return true;
+}
+
+void Shard::ScheduleExpiry(absl::string_view key, uint64_t msec, Entry* entry) {
+  if (!entry->expire) {
+    entry->expire.reset(new ExpireEvent(this, key));
+  }
+
+  // Rescheduling an active event moves it to the new deadline.
+  context_->timer_service().ScheduleAt(
+      entry->expire.get(), TimerService::clock_t::now() + std::chrono::milliseconds(msec));
+}
+
+ShardSet::ShardSet(IoContextPool* pool) : pool_(pool), shards_(pool->size()) {
+  pool->AwaitOnAll([this](unsigned index, IoContext& context) {
+    shards_[index].reset(new Shard(&context));
+  });
+}
+
+ShardSet::~ShardSet() {
+  // Shards cancel their timer events, which must happen in their threads.
+  pool_->AwaitOnAll([this](unsigned index, IoContext&) { shards_[index].reset(); });
+}
+
+}  // namespace redis
@@ -0,0 +1,96 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "base/hash.h"
+#include "util/asio/io_context_pool.h"
+
+namespace redis {
+
+/**
+ * @brief A part of the keyspace owned by a single IoContext thread.
+ *
+ * Shard is not thread-safe. It must be created, accessed and destroyed in its IoContext thread,
+ * hence the keyspace is shared-nothing: other threads access it via ShardSet::Await.
+ * Keys with TTL are expired by events scheduled on the TimerService of the thread.
+ */
+class Shard {
+ public:
+  explicit Shard(util::IoContext* context);
+  ~Shard();
+
+  //! Returns nullptr if the key does not exist.
+  const std::string* Get(absl::string_view key) const;
+
+  //! Sets the value and clears the ttl of the key. expire_msec = 0 means no ttl.
+  void Set(absl::string_view key, absl::string_view value, uint64_t expire_msec);
+
+  //! Returns true if the key existed.
+  bool Del(absl::string_view key);
+
+  //! Increments the integer value of the key, missing keys are considered to be 0.
+  //! Returns false if the value is not an integer or the increment overflows.
+  bool IncrBy(absl::string_view key, int64_t delta, int64_t* result);
+
+  //! Sets the ttl of the key, non-positive ttl deletes the key.
+  //! Returns false if the key does not exist.
+  bool Expire(absl::string_view key, int64_t msec);
+
+  size_t size() const { return table_.size(); }
+
+ private:
+  struct ExpireEvent;
+
+  struct Entry {
+    std::string value;
+    std::unique_ptr<ExpireEvent> expire;  // null if the key has no ttl.
+  };
+
+  void ScheduleExpiry(absl::string_view key, uint64_t msec, Entry* entry);
+
+  util::IoContext* context_;
+  absl::flat_hash_map<std::string, Entry> table_;
+
+  Shard(const Shard&) = delete;
+  void operator=(const Shard&) = delete;
+};
+
+/**
+ * @brief Partitions the keyspace between the threads of IoContextPool.
+ *
+ * Shard i lives in the thread of pool->at(i). Commands hop to the thread of the key's shard
+ * via IoContext::Await, which runs directly when the connection fiber is already there.
+ * Must be destroyed while the pool is running.
+ */
+class ShardSet {
+ public:
+  explicit ShardSet(util::IoContextPool* pool);
+  ~ShardSet();
+
+  unsigned size() const { return shards_.size(); }
+
+  unsigned ShardId(absl::string_view key) const {
+    return base::Fingerprint(key.data(), key.size()) % shards_.size();
+  }
+
+  //! Runs f(Shard&) in the thread of shard sid and returns its result.
+  //! Blocks the calling fiber. f should not block because it runs directly from the IO loop.
+  template <typename Func> auto Await(unsigned sid, Func&& f) -> decltype(f(*(Shard*)0)) {
+    Shard* shard = shards_[sid].get();
+    return pool_->at(sid).Await([&] { return f(*shard); });
+  }
+
+ private:
+  util::IoContextPool* pool_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+}  // namespace redis
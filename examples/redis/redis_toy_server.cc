@@ -3,6 +3,7 @@
 //
 
 #include "base/init.h"
+#include "examples/redis/redis_shard.h"
 #include "examples/redis/resp_connection_handler.h"
 #include "util/asio/accept_server.h"
 #include "util/asio/io_context_pool.h"
@@ -19,13 +20,16 @@ int main(int argc, char** argv) {
   IoContextPool pool;
   pool.Run();
 
+  // Destroyed before the pool.
+  ShardSet shard_set(&pool);
+
   std::unique_ptr<util::AcceptServer> server(new AcceptServer(&pool));
   http::Listener<> http_listener;
   uint16_t port = server->AddListener(FLAGS_http_port, &http_listener);
 
   LOG(INFO) << "Started http server on port " << port;
 
-  RespListener resp_listener;
+  RespListener resp_listener(&shard_set);
   port = server->AddListener(FLAGS_port, &resp_listener);
   LOG(INFO) << "Started redis server on port " << port;
   server->Run();
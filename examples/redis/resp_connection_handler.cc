@@ -3,117 +3,277 @@
 //
 #include "examples/redis/resp_connection_handler.h"
 
-#include "absl/strings/ascii.h"
+#include <algorithm>
+#include <boost/asio/write.hpp>
+
+#include "absl/strings/match.h"
 #include "absl/strings/numbers.h"
-#include "absl/strings/string_view.h"
+#include "absl/strings/str_cat.h"
 #include "base/logging.h"
+#include "examples/redis/redis_shard.h"
 
 namespace redis {
 using namespace util;
 using namespace boost;
 
 namespace {
-uint8_t* ParseLine(uint8_t* buf, const uint8_t* end, absl::string_view* res) {
-  uint8_t* start = buf;
 
-  while (start < end) {
-    size_t sz = end - start;
-    uint8_t* next = reinterpret_cast<uint8_t*>(memchr(start, '\r', sz));
-    if (!next)
+constexpr size_t kInitialBufSize = 1 << 14;
+
+// Long pipelines are flushed in the middle to bound the reply buffer.
+constexpr size_t kFlushThreshold = 1 << 16;
+
+// Keeps the deadlines far from the steady clock overflow.
+constexpr int64_t kMaxExpireMsec = int64_t(1) << 42;
+
+inline bool IsCmd(absl::string_view cmd, absl::string_view name) {
+  return absl::EqualsIgnoreCase(cmd, name);
+}
+
+}  // namespace
+
+RespConnectionHandler::RespConnectionHandler(util::IoContext* context, ShardSet* shard_set)
+    : ConnectionHandler(context), shard_set_(shard_set) {}
+
+/*
+   Example commands: echo -e '*1\r\n$4\r\nPING\r\n', echo -e 'PING\r\n',
+   echo -e ' \r\n*3\r\n$3\r\nSET\r\n$3\r\nfoo\r\n$3\r\nbar\r\n'
+*/
+system::error_code RespConnectionHandler::HandleRequest() {
+  // The buffer is full only if it holds a prefix of a command that does not fit into it.
+  if (read_len_ == read_buf_.size()) {
+    read_buf_.resize(read_buf_.empty() ? kInitialBufSize : read_buf_.size() * 2);
+  }
+
+  system::error_code ec;
+  size_t read_sz = socket_->read_some(
+      asio::mutable_buffer(read_buf_.data() + read_len_, read_buf_.size() - read_len_), ec);
+  if (ec)
+    return ec;
+  read_len_ += read_sz;
+
+  const char* next = read_buf_.data();
+  size_t left = read_len_;
+  while (true) {
+    size_t consumed = 0;
+    RespParser::Result res = RespParser::Parse(next, left, &consumed, &args_);
+    if (res == RespParser::INCOMPLETE)
       break;
 
-    if (next[1] == '\n') {
-      next[0] = '\0';
-      *res = absl::string_view{reinterpret_cast<char*>(buf), size_t(next - buf)};
-      return next + 2;
+    if (res == RespParser::BAD_REQUEST) {
+      AppendError("Protocol error");
+      Flush();
+      return system::errc::make_error_code(system::errc::bad_message);
+    }
+
+    if (!args_.empty()) {
+      HandleCmd(args_);
+    }
+    next += consumed;
+    left -= consumed;
+
+    if (out_.size() >= kFlushThreshold) {
+      ec = Flush();
+      if (ec)
+        return ec;
     }
-    start = next + 1;
   }
-  return nullptr;
-}
 
-class StaticInstr {
- public:
-  StaticInstr() : read_start_(buf_.begin()), read_eob_(buf_.begin()) {
-    buf_[kBufSz] = '\r';
-    buf_[kBufSz + 1] = '\n';
+  // Moves the incomplete command to the beginning of the buffer.
+  if (left && next != read_buf_.data()) {
+    memmove(read_buf_.data(), next, left);
   }
+  read_len_ = left;
 
-  system::error_code Parse(FiberSyncSocket* socket, absl::string_view* line);
+  return Flush();
+}
 
-  asio::mutable_buffer GetRemainder() const {
-    return asio::mutable_buffer(read_start_, read_eob_ - read_start_);
+system::error_code RespConnectionHandler::Flush() {
+  system::error_code ec;
+  if (!out_.empty()) {
+    asio::write(*socket_, asio::buffer(out_), ec);
+    out_.clear();
   }
+  return ec;
+}
 
- private:
-  static constexpr uint16_t kBufSz = 256;
-  std::array<uint8_t, kBufSz + 4> buf_;
-  uint8_t *read_start_, *read_eob_;
-};
+void RespConnectionHandler::HandleCmd(const Args& args) {
+  absl::string_view cmd = args[0];
 
-system::error_code StaticInstr::Parse(FiberSyncSocket* socket, absl::string_view* line) {
-  uint8_t* eob = buf_.begin() + kBufSz;
+  if (IsCmd(cmd, "GET")) {
+    Get(args);
+  } else if (IsCmd(cmd, "SET")) {
+    Set(args);
+  } else if (IsCmd(cmd, "INCR")) {
+    Incr(args, 1);
+  } else if (IsCmd(cmd, "DECR")) {
+    Incr(args, -1);
+  } else if (IsCmd(cmd, "MGET")) {
+    MGet(args);
+  } else if (IsCmd(cmd, "DEL")) {
+    Del(args);
+  } else if (IsCmd(cmd, "EXPIRE")) {
+    Expire(args);
+  } else if (IsCmd(cmd, "PING")) {
+    if (args.size() == 1) {
+      out_.append("+PONG\r\n");
+    } else if (args.size() == 2) {
+      AppendBulk(args[1]);
+    } else {
+      AppendArgsError("ping");
+    }
+  } else {
+    absl::StrAppend(&out_, "-ERR unknown command '", cmd, "'\r\n");
+  }
+}
 
-  system::error_code ec;
-  while (read_start_ < eob) {
-    size_t read_sz = socket->read_some(asio::mutable_buffer(read_start_, eob - read_start_), ec);
-    if (ec)
-      return ec;
-    read_eob_ = read_start_ + read_sz;
-    read_start_ = ParseLine(read_start_, read_eob_, line);
-
-    if (read_start_) {
-      char* bb = reinterpret_cast<char*>(buf_.begin());
-      *line = absl::StripAsciiWhitespace(absl::string_view{bb, size_t(line->end() - bb)});
-      if (!line->empty())
-        return system::error_code{};
-
-      if (read_start_ != read_eob_) {
-        read_sz = read_eob_ - read_start_;
-        memmove(buf_.begin(), read_start_, read_sz);
-        read_eob_ = buf_.begin() + read_sz;
-      }
+void RespConnectionHandler::Get(const Args& args) {
+  if (args.size() != 2)
+    return AppendArgsError("get");
+
+  // Formats the reply directly in the shard thread, this fiber is suspended meanwhile.
+  shard_set_->Await(shard_set_->ShardId(args[1]), [&](Shard& shard) {
+    const std::string* val = shard.Get(args[1]);
+    if (val) {
+      AppendBulk(*val);
+    } else {
+      AppendNil();
     }
+  });
+}
+
+// SET key value [EX seconds|PX milliseconds]
+void RespConnectionHandler::Set(const Args& args) {
+  if (args.size() < 3)
+    return AppendArgsError("set");
 
-    read_start_ = read_eob_;
+  int64_t expire_msec = 0;
+  for (size_t i = 3; i < args.size(); i += 2) {
+    bool is_ex = IsCmd(args[i], "EX");
+    if ((!is_ex && !IsCmd(args[i], "PX")) || i + 1 == args.size() || expire_msec)
+      return AppendError("syntax error");
+
+    int64_t val;
+    if (!absl::SimpleAtoi(args[i + 1], &val))
+      return AppendError("value is not an integer or out of range");
+
+    if (val <= 0 || val > (is_ex ? kMaxExpireMsec / 1000 : kMaxExpireMsec))
+      return AppendError("invalid expire time in 'set' command");
+    expire_msec = is_ex ? val * 1000 : val;
   }
 
-  return system::errc::make_error_code(system::errc::no_buffer_space);
+  shard_set_->Await(shard_set_->ShardId(args[1]),
+                    [&](Shard& shard) { shard.Set(args[1], args[2], expire_msec); });
+  out_.append("+OK\r\n");
 }
 
-}  // namespace
+void RespConnectionHandler::Del(const Args& args) {
+  if (args.size() < 2)
+    return AppendArgsError("del");
 
-RespConnectionHandler::RespConnectionHandler(util::IoContext* context)
-    : ConnectionHandler(context) {}
-
-/*
-   Example commands: echo -e '*1\r\n$4\r\PING\r\n', echo -e 'PING\r\n',
-   echo -e ' \r\n*1\r\n$7\r\nCOMMAND\r\n'
-*/
-system::error_code RespConnectionHandler::HandleRequest() {
-  absl::string_view cmd;
-  StaticInstr parser;
+  int64_t deleted = 0;
+  for (size_t i = 1; i < args.size(); ++i) {
+    deleted += shard_set_->Await(shard_set_->ShardId(args[i]),
+                                 [&](Shard& shard) { return shard.Del(args[i]); });
+  }
+  AppendInteger(deleted);
+}
 
-  system::error_code ec = parser.Parse(&socket_.value(), &cmd);
+void RespConnectionHandler::Incr(const Args& args, int64_t delta) {
+  if (args.size() != 2)
+    return AppendArgsError(delta > 0 ? "incr" : "decr");
 
-  if (ec)
-    return ec;
-  return HandleCmd(cmd, parser.GetRemainder());
+  int64_t result = 0;
+  bool ok = shard_set_->Await(shard_set_->ShardId(args[1]),
+                              [&](Shard& shard) { return shard.IncrBy(args[1], delta, &result); });
+  if (ok) {
+    AppendInteger(result);
+  } else {
+    AppendError("value is not an integer or out of range");
+  }
 }
 
-system::error_code RespConnectionHandler::HandleCmd(absl::string_view cmd,
-                                                    asio::mutable_buffer mb) {
-  if (cmd[0] == '*') {
-    cmd.remove_prefix(1);
-    unsigned cnt;
-    if (!absl::SimpleAtoi(cmd, &cnt))
-      return system::errc::make_error_code(system::errc::invalid_argument);
+// Hops once per shard that owns any of the keys, rather than once per key.
+void RespConnectionHandler::MGet(const Args& args) {
+  if (args.size() < 2)
+    return AppendArgsError("mget");
+
+  size_t num_keys = args.size() - 1;
+  key_shard_.resize(num_keys);
+  if (values_.size() < num_keys) {
+    values_.resize(num_keys);
+  }
+  found_.assign(num_keys, 0);
+
+  for (size_t i = 0; i < num_keys; ++i) {
+    key_shard_[i] = shard_set_->ShardId(args[i + 1]);
+  }
+
+  for (unsigned sid = 0; sid < shard_set_->size(); ++sid) {
+    if (std::find(key_shard_.begin(), key_shard_.end(), sid) == key_shard_.end())
+      continue;
+
+    // Values are copied because the shard may change once we leave its thread.
+    shard_set_->Await(sid, [&](Shard& shard) {
+      for (size_t i = 0; i < num_keys; ++i) {
+        if (key_shard_[i] != sid)
+          continue;
+        const std::string* val = shard.Get(args[i + 1]);
+        if (val) {
+          values_[i].assign(*val);
+          found_[i] = 1;
+        }
+      }
+    });
+  }
+
+  absl::StrAppend(&out_, "*", num_keys, "\r\n");
+  for (size_t i = 0; i < num_keys; ++i) {
+    if (found_[i]) {
+      AppendBulk(values_[i]);
+    } else {
+      AppendNil();
+    }
   }
-  return system::error_code{};
+}
+
+void RespConnectionHandler::Expire(const Args& args) {
+  if (args.size() != 3)
+    return AppendArgsError("expire");
+
+  int64_t sec;
+  if (!absl::SimpleAtoi(args[2], &sec))
+    return AppendError("value is not an integer or out of range");
+  if (sec > kMaxExpireMsec / 1000)
+    return AppendError("invalid expire time in 'expire' command");
+
+  // Negative values are clamped so that msec does not overflow, they delete the key anyway.
+  int64_t msec = std::max<int64_t>(sec, -1) * 1000;
+  bool res = shard_set_->Await(shard_set_->ShardId(args[1]),
+                               [&](Shard& shard) { return shard.Expire(args[1], msec); });
+  AppendInteger(res);
+}
+
+void RespConnectionHandler::AppendError(absl::string_view msg) {
+  absl::StrAppend(&out_, "-ERR ", msg, "\r\n");
+}
+
+void RespConnectionHandler::AppendArgsError(absl::string_view cmd) {
+  absl::StrAppend(&out_, "-ERR wrong number of arguments for '", cmd, "' command\r\n");
+}
+
+void RespConnectionHandler::AppendInteger(int64_t val) {
+  absl::StrAppend(&out_, ":", val, "\r\n");
+}
+
+void RespConnectionHandler::AppendBulk(absl::string_view str) {
+  absl::StrAppend(&out_, "$", str.size(), "\r\n");
+  out_.append(str.data(), str.size());
+  out_.append("\r\n");
 }
 
 ConnectionHandler* RespListener::NewConnection(util::IoContext& context) {
-  return new RespConnectionHandler(&context);
+  return new RespConnectionHandler(&context, shard_set_);
 }
 
 }  // namespace redis
@@ -5,30 +5,71 @@
 #pragma once
 
 #include "absl/strings/string_view.h"
+#include "base/pod_array.h"
+#include "examples/redis/resp_parser.h"
 #include "util/asio/connection_handler.h"
 
 namespace redis {
 
+class ShardSet;
+
 /**
  * @brief Server side handler that talks RESP (REdis Serialization Protocol)
  *
+ * Supports pipelining: all the complete commands in the read buffer are executed and their
+ * replies are written back with a single write. Buffers are reused between the requests,
+ * so in the steady state commands are handled without allocations.
  */
 class RespConnectionHandler : public ::util::ConnectionHandler {
  public:
-  RespConnectionHandler(util::IoContext* context);
+  RespConnectionHandler(util::IoContext* context, ShardSet* shard_set);
 
  protected:
   boost::system::error_code HandleRequest() final;
 
  private:
-  boost::system::error_code HandleCmd(absl::string_view cmd, boost::asio::mutable_buffer suffix);
+  using Args = RespParser::Args;
+
+  // Executes a single command and appends its reply to out_.
+  void HandleCmd(const Args& args);
+
+  void Get(const Args& args);
+  void Set(const Args& args);
+  void Del(const Args& args);
+  void Incr(const Args& args, int64_t delta);
+  void MGet(const Args& args);
+  void Expire(const Args& args);
+
+  boost::system::error_code Flush();
+
+  void AppendError(absl::string_view msg);
+  void AppendArgsError(absl::string_view cmd);
+  void AppendInteger(int64_t val);
+  void AppendBulk(absl::string_view str);
+  void AppendNil() { out_.append("$-1\r\n"); }
+
+  ShardSet* shard_set_;
 
-  std::string line_buffer_;
+  base::PODArray<char> read_buf_;
+  size_t read_len_ = 0;
+
+  Args args_;
+  std::string out_;
+
+  // MGET state.
+  std::vector<unsigned> key_shard_;
+  std::vector<std::string> values_;
+  std::vector<uint8_t> found_;
 };
 
 class RespListener : public ::util::ListenerInterface {
  public:
+  explicit RespListener(ShardSet* shard_set) : shard_set_(shard_set) {}
+
   util::ConnectionHandler* NewConnection(util::IoContext& context) final;
+
+ private:
+  ShardSet* shard_set_;
 };
 
 }  // namespace redis
@@ -0,0 +1,138 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "examples/redis/resp_parser.h"
+
+#include <cstring>
+
+#include "absl/strings/numbers.h"
+
+namespace redis {
+
+constexpr size_t RespParser::kMaxBulkLen;
+constexpr size_t RespParser::kMaxArgs;
+constexpr size_t RespParser::kMaxInlineLen;
+
+namespace {
+
+// Length lines like "*3" or "$128" must fit into that many bytes.
+constexpr size_t kMaxLenLine = 32;
+
+// Returns the position of CRLF that ends the line starting at buf or nullptr if the line
+// is not complete.
+const char* FindCrlf(const char* buf, const char* end) {
+  while (buf < end) {
+    const char* cr = reinterpret_cast<const char*>(memchr(buf, '\r', end - buf));
+    if (!cr || cr + 1 == end)
+      break;
+    if (cr[1] == '\n')
+      return cr;
+    buf = cr + 1;
+  }
+  return nullptr;
+}
+
+// Parses the length of the line [start, eol) that has a single type character prefix.
+bool ParseLen(const char* start, const char* eol, size_t max, size_t* res) {
+  int64_t val;
+  if (!absl::SimpleAtoi(absl::string_view(start + 1, eol - start - 1), &val) || val < 0 ||
+      size_t(val) > max)
+    return false;
+  *res = val;
+  return true;
+}
+
+inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+
+}  // namespace
+
+auto RespParser::Parse(const char* buf, size_t len, size_t* consumed, Args* args) -> Result {
+  if (len == 0) {
+    *consumed = 1;
+    return INCOMPLETE;
+  }
+
+  if (buf[0] != '*')
+    return ParseInline(buf, len, consumed, args);
+
+  const char* end = buf + len;
+  const char* eol = FindCrlf(buf, end);
+  if (!eol) {
+    *consumed = len + 1;
+    return len > kMaxLenLine ? BAD_REQUEST : INCOMPLETE;
+  }
+
+  size_t num_args;
+  if (!ParseLen(buf, eol, kMaxArgs, &num_args))
+    return BAD_REQUEST;
+
+  args->clear();
+  const char* next = eol + 2;
+
+  for (size_t i = 0; i < num_args; ++i) {
+    if (next == end) {
+      *consumed = len + 1;
+      return INCOMPLETE;
+    }
+    if (*next != '$')
+      return BAD_REQUEST;
+
+    eol = FindCrlf(next, end);
+    if (!eol) {
+      *consumed = len + 1;
+      return size_t(end - next) > kMaxLenLine ? BAD_REQUEST : INCOMPLETE;
+    }
+
+    size_t bulk_len;
+    if (!ParseLen(next, eol, kMaxBulkLen, &bulk_len))
+      return BAD_REQUEST;
+    next = eol + 2;
+
+    // Bulk data followed by CRLF.
+    if (size_t(end - next) < bulk_len + 2) {
+      *consumed = next - buf + bulk_len + 2;
+      return INCOMPLETE;
+    }
+    if (next[bulk_len] != '\r' || next[bulk_len + 1] != '\n')
+      return BAD_REQUEST;
+
+    args->emplace_back(next, bulk_len);
+    next += bulk_len + 2;
+  }
+
+  *consumed = next - buf;
+  return OK;
+}
+
+// Inline commands are space separated words terminated by a newline, for example "PING\r\n".
+auto RespParser::ParseInline(const char* buf, size_t len, size_t* consumed, Args* args)
+    -> Result {
+  const char* nl = reinterpret_cast<const char*>(memchr(buf, '\n', len));
+  if (!nl) {
+    *consumed = len + 1;
+    return len > kMaxInlineLen ? BAD_REQUEST : INCOMPLETE;
+  }
+  *consumed = nl + 1 - buf;
+
+  const char* end = nl;
+  if (end > buf && end[-1] == '\r')
+    --end;
+
+  args->clear();
+  const char* next = buf;
+  while (true) {
+    while (next < end && IsSpace(*next))
+      ++next;
+    if (next == end)
+      break;
+
+    const char* word = next;
+    while (next < end && !IsSpace(*next))
+      ++next;
+    args->emplace_back(word, next - word);
+  }
+
+  return OK;
+}
+
+}  // namespace redis
@@ -0,0 +1,45 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+
+#pragma once
+
+#include <vector>
+
+#include "absl/strings/string_view.h"
+
+namespace redis {
+
+/**
+ * @brief Parses RESP2 requests: arrays of bulk strings and inline commands.
+ *
+ * The parser is stateless - each call parses a single command from the beginning of the buffer,
+ * therefore a partially received command is parsed again once more data arrives.
+ * Arguments point into the parsed buffer, so no memory is allocated besides the reusable
+ * arguments vector.
+ */
+class RespParser {
+ public:
+  enum Result { OK, INCOMPLETE, BAD_REQUEST };
+
+  using Args = std::vector<absl::string_view>;
+
+  // Redis limits.
+  static constexpr size_t kMaxBulkLen = 512 << 20;
+  static constexpr size_t kMaxArgs = 1 << 20;
+  static constexpr size_t kMaxInlineLen = 64 << 10;
+
+  /**
+   * @brief Parses a single command at the beginning of [buf, buf + len).
+   *
+   * On OK, sets consumed to the command length and fills args. args may be empty
+   * for empty inline lines that should be skipped.
+   * On INCOMPLETE, consumed is set to the minimal buffer length needed to make a progress.
+   */
+  static Result Parse(const char* buf, size_t len, size_t* consumed, Args* args);
+
+ private:
+  static Result ParseInline(const char* buf, size_t len, size_t* consumed, Args* args);
+};
+
+}  // namespace redis
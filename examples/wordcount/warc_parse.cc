@@ -9,6 +9,7 @@
 #include <boost/beast/websocket/detail/utf8_checker.hpp>
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
 #include "base/hash.h"
 #include "base/init.h"
 #include "base/logging.h"
@@ -34,93 +35,66 @@ using namespace util;
 using re2::RE2;
 
 /**
- * @brief Parses WARC format.
+ * @brief Parses WARC records framed by the "warc" RecordFramer.
  *
  */
 class WarcMapper {
  public:
   WarcMapper();
-  void Do(string did, mr3::DoContext<string>* cntx);
+  void Do(string record, mr3::DoContext<string>* cntx);
 
  private:
-  bool ParseHeader(StringPiece str);
-  void HandlePage(string str, mr3::DoContext<string>* cntx);
+  void HandleLine(StringPiece line, mr3::DoContext<string>* cntx);
 
-  enum { INIT, START, PAGE_START, PAGE_CONT } state_ = INIT;
-  size_t content_len_ = 0, cur_page_len_ = 0, empty_cnt_ = 0;
-  string doc_;
   absl::optional<RE2> re_;
+  string line_;
 };
 
 WarcMapper::WarcMapper() {
   re_.emplace(R"([^\w\p{L}\p{P}])");
 }
 
-void WarcMapper::Do(string line, mr3::DoContext<string>* cntx) {
-  absl::StripAsciiWhitespace(&line);
+void WarcMapper::Do(string record, mr3::DoContext<string>* cntx) {
+  StringPiece rest(record);
 
-  switch (state_) {
-    case INIT:
-      if (line == "WARC/1.0") {
-        state_ = START;
-      }
-      break;
-    case START:
-      if (!ParseHeader(line)) {
-        cntx->raw()->Inc("bad-header");
-        LOG(WARNING) << "Bad header " << line;
-        state_ = INIT;
-      }
-      break;
-    case PAGE_START:
-      CHECK(line.empty()) << line;
-      cur_page_len_ = empty_cnt_ = 0;
-      state_ = PAGE_CONT;
-      break;
-    case PAGE_CONT:
-      HandlePage(std::move(line), cntx);
+  // The header ends with an empty line.
+  while (true) {
+    size_t pos = rest.find('\n');
+    if (pos == StringPiece::npos) {
+      cntx->raw()->Inc("bad-header");
+      return;
+    }
+    StringPiece line = absl::StripAsciiWhitespace(rest.substr(0, pos));
+    rest.remove_prefix(pos + 1);
+    if (line.empty())
       break;
-  }
-}
-
-bool WarcMapper::ParseHeader(StringPiece str) {
-  size_t pos = str.find(':');
-  if (pos == StringPiece::npos)
-    return false;
-
-  StringPiece name = str.substr(0, pos);
-  StringPiece val = absl::StripAsciiWhitespace(str.substr(pos + 1));
 
-  if (name == "WARC-Type") {
-    if (val != "conversion") {
-      state_ = INIT;  // Ignore non-conversion records.
+    size_t colon = line.find(':');
+    if (colon != StringPiece::npos && line.substr(0, colon) == "WARC-Type" &&
+        absl::StripAsciiWhitespace(line.substr(colon + 1)) != "conversion") {
+      return;  // Ignore non-conversion records.
     }
-  } else if (name == "Content-Length") {
-    CHECK(absl::SimpleAtoi(val, &content_len_));
-    state_ = PAGE_START;
   }
-  return true;
-}
 
-void WarcMapper::HandlePage(string str, mr3::DoContext<string>* cntx) {
-  if (str.empty()) {
-    ++empty_cnt_;
-    return;
+  for (StringPiece line : absl::StrSplit(rest, '\n')) {
+    HandleLine(line, cntx);
   }
-  if (str == "WARC/1.0") {  // reset
-    state_ = START;
-  } else {
-    beast::websocket::detail::utf8_checker ut8checker;
+}
 
-    if (!ut8checker.write(reinterpret_cast<const uint8_t*>(str.data()), str.size())) {
-      cntx->raw()->Inc("invalid-utf8");
-      return;
-    }
+void WarcMapper::HandleLine(StringPiece line, mr3::DoContext<string>* cntx) {
+  line = absl::StripAsciiWhitespace(line);
+  if (line.empty())
+    return;
 
-    cur_page_len_ += str.size();
-    RE2::GlobalReplace(&str, *re_, " ");
-    cntx->Write(std::move(str));  // Write doc line
+  beast::websocket::detail::utf8_checker ut8checker;
+  if (!ut8checker.write(reinterpret_cast<const uint8_t*>(line.data()), line.size())) {
+    cntx->raw()->Inc("invalid-utf8");
+    return;
   }
+
+  line_.assign(line.data(), line.size());
+  RE2::GlobalReplace(&line_, *re_, " ");
+  cntx->Write(std::move(line_));  // Write doc line
 }
 
 int main(int argc, char** argv) {
@@ -134,7 +108,8 @@ int main(int argc, char** argv) {
 
   Pipeline* pipeline = pm.pipeline();
 
-  StringTable ss = pipeline->ReadText("inp1", inputs).Map<WarcMapper>("warc_extract");
+  StringTable ss =
+      pipeline->ReadText("inp1", inputs).set_framer("warc").Map<WarcMapper>("warc_extract");
   auto& outp = ss.Write("outp1", pb::WireFormat::TXT)
                    .WithModNSharding(FLAGS_num_shards,
                                      [](const string& str) { return base::Fingerprint(str); });
@@ -65,7 +65,6 @@ template <> class RecordTraits<WordCount> {
 
 class WordCountTable {
  public:
-  WordCountTable() { word_cnts_.set_empty_key(StringPiece()); }
   void AddWord(StringPiece word, uint64_t count) { word_cnts_[word] += count; }
 
   void Flush(DoContext<WordCount>* cntx) {
@@ -79,7 +78,7 @@ class WordCountTable {
   size_t size() const { return word_cnts_.size(); }
 
  private:
-  StringPieceDenseMap<uint64_t> word_cnts_;
+  StringPieceFlatMap<uint64_t> word_cnts_;
 };
 
 class WordSplitter {
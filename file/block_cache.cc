@@ -0,0 +1,358 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "file/block_cache.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "base/flags.h"
+#include "base/hash.h"
+#include "base/logging.h"
+#include "file/compressors.h"
+#include "util/stats/varz_stats.h"
+
+DEFINE_uint32(file_block_cache_mb, 256, "Size of the default file block cache, 0 disables it.");
+DEFINE_bool(file_block_cache_compress, false, "Whether to compress blocks in the default cache.");
+
+namespace file {
+
+using strings::ByteRange;
+using strings::MutableByteRange;
+using util::Status;
+using util::StatusObject;
+
+namespace {
+
+struct Key {
+  uint64_t file_id;
+  uint64_t offset;
+
+  bool operator==(const Key& o) const { return file_id == o.file_id && offset == o.offset; }
+};
+
+struct KeyHash {
+  size_t operator()(const Key& k) const {
+    return k.file_id ^ (k.offset * 0x9E3779B97F4A7C15ULL);
+  }
+};
+
+}  // namespace
+
+struct BlockCache::Entry {
+  Key key;
+  std::unique_ptr<uint8_t[]> data;
+  uint32_t size;
+  uint32_t raw_size;
+  uint32_t pins = 0;
+  bool compressed;
+};
+
+struct BlockCache::Shard {
+  typedef std::list<Entry> List;
+
+  std::mutex mu;
+  List lru;  // most recently used first.
+  std::unordered_map<Key, List::iterator, KeyHash> map;
+
+  size_t capacity = 0;
+  Stats stats;
+
+  // Evicts unpinned blocks from the tail until the shard fits the capacity.
+  // Pinned blocks may temporarily exceed it.
+  void EvictLocked() {
+    auto it = lru.end();
+    while (stats.bytes > capacity && it != lru.begin()) {
+      --it;
+      if (it->pins)
+        continue;
+      stats.bytes -= it->size;
+      stats.raw_bytes -= it->raw_size;
+      --stats.entries;
+      ++stats.evictions;
+      map.erase(it->key);
+      it = lru.erase(it);
+    }
+  }
+
+  void Unpin(Entry* e) {
+    std::lock_guard<std::mutex> lk(mu);
+    DCHECK_GT(e->pins, 0);
+    if (--e->pins == 0 && stats.bytes > capacity)
+      EvictLocked();
+  }
+};
+
+auto BlockCache::Handle::operator=(Handle&& o) noexcept -> Handle& {
+  if (this != &o) {
+    Release();
+    shard_ = o.shard_;
+    entry_ = o.entry_;
+    data_ = o.data_;
+    buf_ = std::move(o.buf_);
+    o.shard_ = nullptr;
+    o.entry_ = nullptr;
+    o.data_.clear();
+  }
+  return *this;
+}
+
+void BlockCache::Handle::Release() {
+  if (entry_) {
+    shard_->Unpin(entry_);
+    entry_ = nullptr;
+  }
+  shard_ = nullptr;
+  data_.clear();
+  buf_.reset();
+}
+
+BlockCache::BlockCache(const Options& opts) : opts_(opts) {
+  CHECK_GT(opts_.block_size, 0);
+  unsigned num_shards = 1;
+  while (num_shards < opts_.num_shards)
+    num_shards *= 2;
+  shard_mask_ = num_shards - 1;
+  shards_.reset(new Shard[num_shards]);
+  for (unsigned i = 0; i < num_shards; ++i) {
+    shards_[i].capacity = opts_.capacity / num_shards;
+  }
+
+  if (!opts_.varz_name.empty()) {
+    varz_.reset(new util::VarzFunction(opts_.varz_name.c_str(), [this] {
+      Stats st = GetStats();
+      util::VarzValue::Map res;
+      res.emplace_back("hits", util::VarzValue::FromInt(st.hits));
+      res.emplace_back("misses", util::VarzValue::FromInt(st.misses));
+      res.emplace_back("inserts", util::VarzValue::FromInt(st.inserts));
+      res.emplace_back("evictions", util::VarzValue::FromInt(st.evictions));
+      res.emplace_back("bytes", util::VarzValue::FromInt(st.bytes));
+      res.emplace_back("raw_bytes", util::VarzValue::FromInt(st.raw_bytes));
+      res.emplace_back("entries", util::VarzValue::FromInt(st.entries));
+      return res;
+    }));
+  }
+}
+
+BlockCache::~BlockCache() {
+  varz_.reset();
+  for (unsigned i = 0; i <= shard_mask_; ++i) {
+    for (const Entry& e : shards_[i].lru) {
+      CHECK_EQ(0, e.pins) << "Block cache is destroyed while its blocks are in use";
+    }
+  }
+}
+
+BlockCache* BlockCache::Default() {
+  static BlockCache* cache = [] () -> BlockCache* {
+    if (FLAGS_file_block_cache_mb == 0)
+      return nullptr;
+    Options opts;
+    opts.capacity = size_t(FLAGS_file_block_cache_mb) << 20;
+    opts.compress = FLAGS_file_block_cache_compress;
+    opts.varz_name = "file-block-cache";
+    return new BlockCache(opts);
+  }();
+  return cache;
+}
+
+uint64_t BlockCache::FileId(StringPiece name, size_t size) {
+  return base::Fingerprint(name.data(), name.size()) ^ (size * 0xC2B2AE3D27D4EB4FULL);
+}
+
+auto BlockCache::GetShard(uint64_t file_id, uint64_t offset) -> Shard* {
+  size_t h = KeyHash{}(Key{file_id, offset});
+  return &shards_[(h >> 32 ^ h) & shard_mask_];
+}
+
+void BlockCache::Uncompress(const Entry& entry, Handle* handle) {
+  handle->buf_.reset(new uint8_t[entry.raw_size]);
+  size_t sz = entry.raw_size;
+  Status st = GetUncompress(list_file::kCompressionLZ4)(entry.data.get(), entry.size,
+                                                        handle->buf_.get(), &sz);
+  CHECK(st.ok() && sz == entry.raw_size) << st;
+  handle->data_.reset(handle->buf_.get(), sz);
+}
+
+auto BlockCache::Lookup(uint64_t file_id, uint64_t offset) -> Handle {
+  Shard* shard = GetShard(file_id, offset);
+  Handle res;
+  Entry* entry;
+  {
+    std::lock_guard<std::mutex> lk(shard->mu);
+    auto it = shard->map.find(Key{file_id, offset});
+    if (it == shard->map.end()) {
+      ++shard->stats.misses;
+      return res;
+    }
+    ++shard->stats.hits;
+    shard->lru.splice(shard->lru.begin(), shard->lru, it->second);
+    entry = &*it->second;
+    ++entry->pins;
+  }
+
+  res.shard_ = shard;
+  res.entry_ = entry;
+  if (entry->compressed) {
+    // Compressed blocks are pinned only while being uncompressed.
+    Uncompress(*entry, &res);
+    shard->Unpin(entry);
+    res.entry_ = nullptr;
+  } else {
+    res.data_.reset(entry->data.get(), entry->size);
+  }
+  return res;
+}
+
+auto BlockCache::Insert(uint64_t file_id, uint64_t offset, ByteRange data) -> Handle {
+  CHECK_LE(data.size(), opts_.block_size);
+
+  Entry entry;
+  entry.key = Key{file_id, offset};
+  entry.raw_size = data.size();
+  entry.compressed = false;
+
+  if (opts_.compress && !data.empty()) {
+    size_t bound = GetCompressBound(list_file::kCompressionLZ4)(data.size());
+    std::unique_ptr<uint8_t[]> buf(new uint8_t[bound]);
+    size_t sz = bound;
+    Status st = GetCompress(list_file::kCompressionLZ4)(1, data.data(), data.size(),
+                                                        buf.get(), &sz);
+    if (st.ok() && sz < data.size()) {
+      entry.data.reset(new uint8_t[sz]);
+      memcpy(entry.data.get(), buf.get(), sz);
+      entry.size = sz;
+      entry.compressed = true;
+    }
+  }
+  if (!entry.compressed) {
+    entry.data.reset(new uint8_t[data.size()]);
+    memcpy(entry.data.get(), data.data(), data.size());
+    entry.size = data.size();
+  }
+
+  Shard* shard = GetShard(file_id, offset);
+  Handle res;
+  Entry* dest;
+  {
+    std::lock_guard<std::mutex> lk(shard->mu);
+    auto it = shard->map.find(entry.key);
+    if (it != shard->map.end()) {
+      shard->lru.splice(shard->lru.begin(), shard->lru, it->second);
+      dest = &*it->second;
+    } else {
+      shard->lru.push_front(std::move(entry));
+      shard->map.emplace(shard->lru.front().key, shard->lru.begin());
+      dest = &shard->lru.front();
+
+      ++shard->stats.inserts;
+      ++shard->stats.entries;
+      shard->stats.bytes += dest->size;
+      shard->stats.raw_bytes += dest->raw_size;
+    }
+    ++dest->pins;
+    shard->EvictLocked();
+  }
+
+  res.shard_ = shard;
+  res.entry_ = dest;
+  if (dest->compressed) {
+    Uncompress(*dest, &res);
+    shard->Unpin(dest);
+    res.entry_ = nullptr;
+  } else {
+    res.data_.reset(dest->data.get(), dest->size);
+  }
+  return res;
+}
+
+auto BlockCache::GetStats() const -> Stats {
+  Stats res;
+  for (unsigned i = 0; i <= shard_mask_; ++i) {
+    Shard& shard = shards_[i];
+    std::lock_guard<std::mutex> lk(shard.mu);
+    res.hits += shard.stats.hits;
+    res.misses += shard.stats.misses;
+    res.inserts += shard.stats.inserts;
+    res.evictions += shard.stats.evictions;
+    res.bytes += shard.stats.bytes;
+    res.raw_bytes += shard.stats.raw_bytes;
+    res.entries += shard.stats.entries;
+  }
+  return res;
+}
+
+namespace {
+
+class CachedReadFile : public ReadonlyFile {
+ public:
+  CachedReadFile(ReadonlyFile* file, uint64_t file_id, BlockCache* cache)
+      : file_(file), file_id_(file_id), cache_(cache) {}
+
+  StatusObject<size_t> Read(size_t offset, const MutableByteRange& range) final;
+
+  Status Close() final { return file_->Close(); }
+
+  size_t Size() const final { return file_->Size(); }
+
+  int Handle() const final { return file_->Handle(); }
+
+ private:
+  // Reads the block at block_offset from the file and inserts it into the cache.
+  Status Fetch(size_t block_offset, BlockCache::Handle* handle);
+
+  std::unique_ptr<ReadonlyFile> file_;
+  uint64_t file_id_;
+  BlockCache* cache_;
+  std::unique_ptr<uint8_t[]> buf_;
+};
+
+StatusObject<size_t> CachedReadFile::Read(size_t offset, const MutableByteRange& range) {
+  const size_t fsize = Size();
+  const size_t bs = cache_->block_size();
+  size_t end = std::min(offset + range.size(), fsize);
+  size_t copied = 0;
+
+  while (offset < end) {
+    size_t block_offset = offset - offset % bs;
+    BlockCache::Handle handle = cache_->Lookup(file_id_, block_offset);
+    if (!handle) {
+      RETURN_IF_ERROR(Fetch(block_offset, &handle));
+    }
+
+    ByteRange block = handle.data();
+    size_t in_block = offset - block_offset;
+    if (in_block >= block.size())  // The file was truncated.
+      break;
+    size_t len = std::min(block.size() - in_block, end - offset);
+    memcpy(range.data() + copied, block.data() + in_block, len);
+    copied += len;
+    offset += len;
+  }
+  return copied;
+}
+
+Status CachedReadFile::Fetch(size_t block_offset, BlockCache::Handle* handle) {
+  const size_t bs = cache_->block_size();
+  if (!buf_)
+    buf_.reset(new uint8_t[bs]);
+
+  // Sequential sources reopen themselves at block_offset if it is not where they stopped.
+  size_t len = std::min<size_t>(bs, Size() - block_offset);
+  auto res = file_->Read(block_offset, MutableByteRange(buf_.get(), len));
+  if (!res.ok())
+    return res.status;
+  *handle = cache_->Insert(file_id_, block_offset, ByteRange(buf_.get(), res.obj));
+  return Status::OK;
+}
+
+}  // namespace
+
+ReadonlyFile* NewCachedReadFile(ReadonlyFile* file, StringPiece name, BlockCache* cache) {
+  CHECK(file && cache);
+  uint64_t file_id = BlockCache::FileId(name, file->Size());
+  return new CachedReadFile(file, file_id, cache);
+}
+
+}  // namespace file
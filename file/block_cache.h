@@ -0,0 +1,111 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "file/file.h"
+#include "strings/stringpiece.h"
+
+namespace util {
+class VarzFunction;
+}  // namespace util
+
+namespace file {
+
+/**
+ * @brief Process-wide cache of fixed size file blocks keyed by (file id, block offset).
+ *
+ * The cache is split into shards, each with its own lock and LRU list, so that concurrent
+ * readers rarely contend. Blocks are optionally stored LZ4 compressed, in which case
+ * they are uncompressed into the handle upon lookup. Uncompressed blocks are pinned while
+ * their handles are alive and are never evicted while pinned.
+ * The cache is thread-safe and can be shared by readers running in different threads.
+ */
+class BlockCache {
+  struct Shard;
+  struct Entry;
+
+ public:
+  struct Options {
+    size_t capacity = 256 << 20;  // in bytes, counts the stored (maybe compressed) size.
+    uint32_t block_size = 1 << 16;
+    unsigned num_shards = 16;     // rounded up to the power of 2.
+    bool compress = false;        // compress cached blocks with LZ4.
+
+    // If not empty, exports the cache statistics via varz under this name.
+    std::string varz_name;
+
+    Options() {}
+  };
+
+  struct Stats {
+    size_t hits = 0, misses = 0, inserts = 0, evictions = 0;
+    size_t bytes = 0;      // stored bytes.
+    size_t raw_bytes = 0;  // uncompressed bytes of the stored blocks.
+    size_t entries = 0;
+  };
+
+  // A reference to a cached block.
+  class Handle {
+   public:
+    Handle() {}
+    Handle(Handle&& o) noexcept { *this = std::move(o); }
+    Handle& operator=(Handle&& o) noexcept;
+    ~Handle() { Release(); }
+
+    strings::ByteRange data() const { return data_; }
+    explicit operator bool() const { return data_.data() != nullptr; }
+
+    void Release();
+
+   private:
+    friend class BlockCache;
+
+    Shard* shard_ = nullptr;
+    Entry* entry_ = nullptr;  // set if the entry is pinned by this handle.
+    strings::ByteRange data_;
+    std::unique_ptr<uint8_t[]> buf_;  // holds uncompressed data of compressed blocks.
+  };
+
+  explicit BlockCache(const Options& opts = Options());
+  ~BlockCache();
+
+  // Returns the cache sized by --file_block_cache_mb or nullptr if the flag is 0.
+  static BlockCache* Default();
+
+  // Identifies a file by its name and size, so that modified files do not hit stale blocks.
+  static uint64_t FileId(StringPiece name, size_t size);
+
+  // Returns an empty handle if the block is not cached.
+  Handle Lookup(uint64_t file_id, uint64_t offset);
+
+  // Copies data into the cache and returns the handle to the cached block.
+  // If the block is already cached, returns the existing one.
+  Handle Insert(uint64_t file_id, uint64_t offset, strings::ByteRange data);
+
+  uint32_t block_size() const { return opts_.block_size; }
+
+  Stats GetStats() const;
+
+ private:
+  Shard* GetShard(uint64_t file_id, uint64_t offset);
+  void Uncompress(const Entry& entry, Handle* handle);
+
+  Options opts_;
+  unsigned shard_mask_;
+  std::unique_ptr<Shard[]> shards_;
+  std::unique_ptr<util::VarzFunction> varz_;
+
+  BlockCache(const BlockCache&) = delete;
+  void operator=(const BlockCache&) = delete;
+};
+
+// Wraps file with a block cache. Takes ownership over file. All reads are served in whole blocks
+// via the cache, hence only the missing blocks are read from file. Streaming files, like GCS
+// files, must support reads at any offset, for example by reopening the stream at that offset.
+ReadonlyFile* NewCachedReadFile(ReadonlyFile* file, StringPiece name, BlockCache* cache);
+
+}  // namespace file
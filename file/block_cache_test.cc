@@ -0,0 +1,210 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "file/block_cache.h"
+
+#include <thread>
+
+#include "base/gtest.h"
+#include "base/logging.h"
+#include "file/file_util.h"
+#include "file/test_util.h"
+
+namespace file {
+
+using strings::ByteRange;
+using strings::MutableByteRange;
+using std::string;
+
+// Mimics GCS files that are read as a stream and reopened when read at another offset.
+class SequentialStringFile : public ReadonlyStringFile {
+ public:
+  using ReadonlyStringFile::ReadonlyStringFile;
+
+  util::StatusObject<size_t> Read(size_t offset, const MutableByteRange& range) override {
+    if (offset != offset_)
+      ++reopens;
+    auto res = ReadonlyStringFile::Read(offset, range);
+    if (res.ok()) {
+      offset_ = offset + res.obj;
+      bytes_read += res.obj;
+    }
+    return res;
+  }
+
+  unsigned reopens = 0;
+  size_t bytes_read = 0;
+
+ private:
+  size_t offset_ = 0;
+};
+
+class BlockCacheTest : public testing::Test {
+ protected:
+  static string Block(char c, size_t sz) { return string(sz, c); }
+
+  static string ToString(const BlockCache::Handle& h) {
+    return string(reinterpret_cast<const char*>(h.data().data()), h.data().size());
+  }
+};
+
+TEST_F(BlockCacheTest, Basic) {
+  BlockCache::Options opts;
+  opts.capacity = 1000;
+  opts.block_size = 100;
+  opts.num_shards = 1;
+  BlockCache cache(opts);
+
+  EXPECT_FALSE(cache.Lookup(1, 0));
+  string blk = Block('a', 100);
+  {
+    auto h = cache.Insert(1, 0, strings::ToByteRange(blk));
+    EXPECT_EQ(blk, ToString(h));
+  }
+  auto h = cache.Lookup(1, 0);
+  ASSERT_TRUE(h);
+  EXPECT_EQ(blk, ToString(h));
+  EXPECT_FALSE(cache.Lookup(2, 0));
+
+  BlockCache::Stats st = cache.GetStats();
+  EXPECT_EQ(1, st.hits);
+  EXPECT_EQ(2, st.misses);
+  EXPECT_EQ(100, st.bytes);
+}
+
+TEST_F(BlockCacheTest, EvictAndPin) {
+  BlockCache::Options opts;
+  opts.capacity = 300;
+  opts.block_size = 100;
+  opts.num_shards = 1;
+  BlockCache cache(opts);
+
+  string blk = Block('a', 100);
+  BlockCache::Handle pinned = cache.Insert(1, 0, strings::ToByteRange(blk));
+  for (unsigned i = 1; i < 10; ++i) {
+    cache.Insert(1, i * 100, strings::ToByteRange(blk));
+  }
+  BlockCache::Stats st = cache.GetStats();
+  EXPECT_EQ(3, st.entries);
+  EXPECT_EQ(7, st.evictions);
+
+  // The pinned block survives although it is the least recently used.
+  EXPECT_TRUE(cache.Lookup(1, 0));
+  EXPECT_TRUE(cache.Lookup(1, 900));
+  EXPECT_FALSE(cache.Lookup(1, 100));
+  EXPECT_EQ(blk, ToString(pinned));
+}
+
+TEST_F(BlockCacheTest, Compress) {
+  BlockCache::Options opts;
+  opts.block_size = 1000;
+  opts.compress = true;
+  BlockCache cache(opts);
+
+  string blk = Block('a', 1000);
+  cache.Insert(5, 1000, strings::ToByteRange(blk));
+  auto h = cache.Lookup(5, 1000);
+  ASSERT_TRUE(h);
+  EXPECT_EQ(blk, ToString(h));
+
+  BlockCache::Stats st = cache.GetStats();
+  EXPECT_EQ(1000, st.raw_bytes);
+  EXPECT_LT(st.bytes, 100);
+}
+
+TEST_F(BlockCacheTest, File) {
+  string name = file_util::TempFile::TempFilename("/tmp");
+  string contents;
+  for (unsigned i = 0; i < 1000; ++i)
+    contents.append(std::to_string(i)).append(" ");
+  file_util::WriteStringToFileOrDie(contents, name);
+
+  BlockCache::Options opts;
+  opts.block_size = 256;
+  BlockCache cache(opts);
+
+  ReadonlyFile::Options ro;
+  ro.block_cache = &cache;
+  for (unsigned pass = 0; pass < 2; ++pass) {
+    auto res = ReadonlyFile::Open(name, ro);
+    ASSERT_TRUE(res.ok()) << res.status;
+    std::unique_ptr<ReadonlyFile> fl(res.obj);
+    ASSERT_EQ(contents.size(), fl->Size());
+
+    string buf(contents.size() + 10, '\0');
+    auto read = fl->Read(0, MutableByteRange(reinterpret_cast<uint8_t*>(&buf[0]), buf.size()));
+    ASSERT_TRUE(read.ok());
+    EXPECT_EQ(contents, buf.substr(0, read.obj));
+
+    read = fl->Read(300, MutableByteRange(reinterpret_cast<uint8_t*>(&buf[0]), 500));
+    ASSERT_TRUE(read.ok());
+    EXPECT_EQ(contents.substr(300, 500), buf.substr(0, read.obj));
+    ASSERT_TRUE(fl->Close().ok());
+  }
+
+  size_t num_blocks = (contents.size() + 255) / 256;
+  BlockCache::Stats st = cache.GetStats();
+  EXPECT_EQ(num_blocks, st.inserts);
+  EXPECT_EQ(num_blocks, st.misses);
+  unlink(name.c_str());
+}
+
+TEST_F(BlockCacheTest, Sequential) {
+  string contents(1000, 'x');
+  for (size_t i = 0; i < contents.size(); ++i)
+    contents[i] = 'a' + i % 26;
+
+  BlockCache::Options opts;
+  opts.block_size = 100;
+  BlockCache cache(opts);
+
+  // The first pass caches the first two blocks.
+  {
+    std::unique_ptr<ReadonlyFile> fl(
+        NewCachedReadFile(new SequentialStringFile(contents), "foo", &cache));
+    uint8_t buf[150];
+    auto read = fl->Read(0, MutableByteRange(buf, sizeof(buf)));
+    ASSERT_TRUE(read.ok());
+  }
+
+  // The cached blocks are not read from the source, it is reopened at the first missing block.
+  SequentialStringFile* source = new SequentialStringFile(contents);
+  std::unique_ptr<ReadonlyFile> fl(NewCachedReadFile(source, "foo", &cache));
+  string buf(contents.size(), '\0');
+  for (size_t offs = 0; offs < contents.size(); offs += 250) {
+    auto read = fl->Read(offs, MutableByteRange(reinterpret_cast<uint8_t*>(&buf[offs]), 250));
+    ASSERT_TRUE(read.ok());
+    ASSERT_EQ(250, read.obj);
+  }
+  EXPECT_EQ(contents, buf);
+  EXPECT_EQ(10, cache.GetStats().inserts);
+  EXPECT_EQ(800, source->bytes_read);
+  EXPECT_EQ(1, source->reopens);
+}
+
+TEST_F(BlockCacheTest, Threads) {
+  BlockCache::Options opts;
+  opts.capacity = 1 << 16;
+  opts.block_size = 1024;
+  opts.compress = true;
+  BlockCache cache(opts);
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < 4; ++t) {
+    threads.emplace_back([&cache, t] {
+      for (unsigned i = 0; i < 2000; ++i) {
+        uint64_t offs = (i * 7 + t) % 200 * 1024;
+        string blk = Block('a' + offs % 26, 1024);
+        auto h = cache.Lookup(3, offs);
+        if (!h)
+          h = cache.Insert(3, offs, strings::ToByteRange(blk));
+        ASSERT_EQ(blk, ToString(h));
+      }
+    });
+  }
+  for (auto& t : threads)
+    t.join();
+  EXPECT_LE(cache.GetStats().bytes, 1 << 16);
+}
+
+}  // namespace file
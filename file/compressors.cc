@@ -6,6 +6,8 @@
 
 #include <zlib.h>
 #include <lz4.h>
+#include <zdict.h>
+#include <zstd.h>
 
 #include "base/logging.h"
 
@@ -114,9 +116,90 @@ Status CompressLZ4(int level, const void* src, size_t len, void* dest,
   return Status::OK;
 }
 
+// Contexts are reused by all the writers and readers of the thread.
+ZSTD_CCtx* ThreadZstdCCtx() {
+  static thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> cctx(
+      ZSTD_createCCtx(), ZSTD_freeCCtx);
+  return cctx.get();
+}
+
+ZSTD_DCtx* ThreadZstdDCtx() {
+  static thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> dctx(
+      ZSTD_createDCtx(), ZSTD_freeDCtx);
+  return dctx.get();
+}
+
+inline Status ZstdResult(size_t res, size_t* dest_size) {
+  if (ZSTD_isError(res)) {
+    return Status(StatusCode::INTERNAL_ERROR, ZSTD_getErrorName(res));
+  }
+  *dest_size = res;
+  return Status::OK;
+}
+
+size_t BoundFunctionZstd(size_t len) {
+  return ZSTD_compressBound(len);
+}
+
+Status CompressZstd(int level, const void* src, size_t len, void* dest, size_t* compress_size) {
+  size_t res = ZSTD_compressCCtx(ThreadZstdCCtx(), dest, *compress_size, src, len, level);
+  return ZstdResult(res, compress_size);
+}
+
+Status UncompressZstd(const void* src, size_t len, void* dest, size_t* uncompress_size) {
+  size_t res = ZSTD_decompressDCtx(ThreadZstdDCtx(), dest, *uncompress_size, src, len);
+  return ZstdResult(res, uncompress_size);
+}
+
 }  // namespace
 
+ZstdDict::ZstdDict(std::string data, int compress_level) : data_(std::move(data)) {
+  if (compress_level > 0) {
+    cdict_ = ZSTD_createCDict(data_.data(), data_.size(), compress_level);
+    CHECK(cdict_);
+  }
+  ddict_ = ZSTD_createDDict(data_.data(), data_.size());
+  CHECK(ddict_);
+}
+
+ZstdDict::~ZstdDict() {
+  ZSTD_freeCDict(cdict_);
+  ZSTD_freeDDict(ddict_);
+}
+
+std::string ZstdDict::Train(const std::vector<StringPiece>& samples, size_t max_size) {
+  std::string buf;
+  std::vector<size_t> sizes;
+  sizes.reserve(samples.size());
+  for (const auto& s : samples) {
+    buf.append(s.data(), s.size());
+    sizes.push_back(s.size());
+  }
+
+  std::string dict(max_size, '\0');
+  size_t res = ZDICT_trainFromBuffer(&dict.front(), max_size, buf.data(), sizes.data(),
+                                     sizes.size());
+  if (ZDICT_isError(res)) {
+    VLOG(1) << "Could not train zstd dictionary: " << ZDICT_getErrorName(res);
+    return std::string();
+  }
+  dict.resize(res);
+  return dict;
+}
+
+Status ZstdDict::Compress(const void* src, size_t len, void* dest, size_t* compress_size) const {
+  CHECK(cdict_) << "Dictionary was created for decompression only";
+  size_t res =
+      ZSTD_compress_usingCDict(ThreadZstdCCtx(), dest, *compress_size, src, len, cdict_);
+  return ZstdResult(res, compress_size);
+}
 
+Status ZstdDict::Uncompress(const void* src, size_t len, void* dest,
+                            size_t* uncompress_size) const {
+  size_t res =
+      ZSTD_decompress_usingDDict(ThreadZstdDCtx(), dest, *uncompress_size, src, len, ddict_);
+  return ZstdResult(res, uncompress_size);
+}
 
 UncompressFunction GetUncompress(CompressMethod m) {
   switch (m) {
@@ -126,6 +209,9 @@ UncompressFunction GetUncompress(CompressMethod m) {
     case CompressMethod::kCompressionLZ4:
       return UncompressZ4;
     break;
+    case CompressMethod::kCompressionZstd:
+      return UncompressZstd;
+    break;
     default:;
   }
   return nullptr;
@@ -139,6 +225,9 @@ CompressFunction GetCompress(CompressMethod m) {
     case CompressMethod::kCompressionLZ4:
       return CompressLZ4;
     break;
+    case CompressMethod::kCompressionZstd:
+      return CompressZstd;
+    break;
     default:;
   }
   return nullptr;
@@ -152,6 +241,9 @@ CompressBoundFunction GetCompressBound(list_file::CompressMethod m) {
     case CompressMethod::kCompressionLZ4:
       return BoundFunctionLZ4;
     break;
+    case CompressMethod::kCompressionZstd:
+      return BoundFunctionZstd;
+    break;
     default:;
   }
   return nullptr;
@@ -5,7 +5,12 @@
 
 #include "util/status.h"
 #include "file/list_file_format.h"
+#include "strings/stringpiece.h"
 #include <functional>
+#include <vector>
+
+typedef struct ZSTD_CDict_s ZSTD_CDict;
+typedef struct ZSTD_DDict_s ZSTD_DDict;
 
 namespace file {
 
@@ -22,4 +27,31 @@ CompressFunction GetCompress(list_file::CompressMethod m);
 
 CompressBoundFunction GetCompressBound(list_file::CompressMethod method);
 
+// Zstd dictionary shared by all the compressed blocks of a file. Immutable, hence can be used
+// concurrently by multiple threads. Compression and decompression contexts are thread local.
+class ZstdDict {
+ public:
+  // If compress_level is 0, the dictionary can be used for decompression only.
+  explicit ZstdDict(std::string data, int compress_level = 0);
+  ~ZstdDict();
+
+  // Trains a dictionary of upto max_size bytes from samples. Returns an empty string if there
+  // are not enough samples.
+  static std::string Train(const std::vector<StringPiece>& samples, size_t max_size = 1 << 16);
+
+  const std::string& data() const { return data_; }
+
+  util::Status Compress(const void* src, size_t len, void* dest, size_t* compress_size) const;
+  util::Status Uncompress(const void* src, size_t len, void* dest, size_t* uncompress_size) const;
+
+ private:
+  std::string data_;
+  ZSTD_CDict* cdict_ = nullptr;
+  ZSTD_DDict* ddict_ = nullptr;
+
+  ZstdDict(const ZstdDict&) = delete;
+  void operator=(const ZstdDict&) = delete;
+};
+
+
 }  // namespace file
@@ -5,11 +5,14 @@
 
 #include <sys/uio.h>
 #include <atomic>
+#include <mutex>
 
 #include "base/hash.h"
 #include "base/histogram.h"
 #include "base/logging.h"
 #include "base/walltime.h"
+#include "file/block_cache.h"
+#include "util/fibers/event_count.h"
 
 namespace file {
 using namespace util;
@@ -100,6 +103,9 @@ class WriteFileImpl : public WriteFile {
 
   Status Write(const uint8* buffer, uint64 length) final;
 
+  // Writes all the slices with a single pool call.
+  Status WriteV(absl::Span<const strings::ByteRange> slices) final;
+
  private:
   virtual ~WriteFileImpl() {}
 
@@ -314,15 +320,170 @@ Status WriteFileImpl::Write(const uint8* buffer, uint64 length) {
     return tp_->Await(hash_, std::move(cb));
 }
 
+Status WriteFileImpl::WriteV(absl::Span<const strings::ByteRange> slices) {
+  auto cb = [&] { return real_->WriteV(slices); };
+  if (hash_ < 0)
+    return tp_->Await(std::move(cb));
+  else
+    return tp_->Await(hash_, std::move(cb));
+}
+
+// The pool helper fills the ring buffers in order, while the reader consumes them from head_.
+// At most one helper task runs at a time, so upstream is never read concurrently.
+class PrefetchSource : public util::Source {
+ public:
+  PrefetchSource(util::Source* upstream, fibers_ext::FiberQueueThreadPool* tp,
+                 const PrefetchSourceOptions& opts);
+  ~PrefetchSource();
+
+ private:
+  struct Buf {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size = 0;
+  };
+
+  StatusObject<size_t> ReadInternal(const strings::MutableByteRange& range) final;
+
+  // Runs in the pool and fills the free buffers until the ring is full or upstream ends.
+  void Fill();
+
+  // Must be called with mu_ locked. Returns true if the helper should be started.
+  bool ShouldFillLocked() {
+    if (filling_ || eof_ || stop_ || ready_ == ring_.size())
+      return false;
+    filling_ = true;
+    return true;
+  }
+
+  std::unique_ptr<util::Source> upstream_;
+  fibers_ext::FiberQueueThreadPool* tp_;
+  size_t buf_size_;
+  std::vector<Buf> ring_;
+  size_t head_ = 0;  // the buffer being consumed, accessed by the reader only.
+  size_t offs_ = 0;  // read offset within ring_[head_].
+  size_t fill_index_ = 0;  // the next buffer to fill, accessed by the helper only.
+
+  std::mutex mu_;
+  fibers_ext::EventCount ec_;
+
+  // Guarded by mu_.
+  size_t ready_ = 0;  // number of filled buffers starting from head_.
+  bool filling_ = false, eof_ = false, stop_ = false;
+  Status status_;
+};
+
+PrefetchSource::PrefetchSource(util::Source* upstream, fibers_ext::FiberQueueThreadPool* tp,
+                               const PrefetchSourceOptions& opts)
+    : upstream_(upstream), tp_(tp), buf_size_(opts.buffer_size), ring_(opts.num_buffers) {
+  CHECK_GT(opts.num_buffers, 0);
+  CHECK_GT(buf_size_, 0);
+  for (Buf& b : ring_) {
+    b.data.reset(new uint8_t[buf_size_]);
+  }
+
+  // Starts reading ahead right away.
+  filling_ = true;
+  tp_->Add([this] { Fill(); });
+}
+
+PrefetchSource::~PrefetchSource() {
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    stop_ = true;
+  }
+  ec_.await([this] {
+    std::lock_guard<std::mutex> lk(mu_);
+    return !filling_;
+  });
+}
+
+void PrefetchSource::Fill() {
+  while (true) {
+    Buf& buf = ring_[fill_index_];
+    auto res = upstream_->Read(strings::MutableByteRange(buf.data.get(), buf_size_));
+
+    std::lock_guard<std::mutex> lk(mu_);
+    if (res.ok()) {
+      buf.size = res.obj;
+      fill_index_ = (fill_index_ + 1) % ring_.size();
+      ++ready_;
+      eof_ = res.obj < buf_size_;
+    } else {
+      status_ = res.status;
+      eof_ = true;
+    }
+
+    // Notifies under the lock, otherwise the destructor may free ec_ before we touch it.
+    if (eof_ || stop_ || ready_ == ring_.size()) {
+      filling_ = false;
+      ec_.notifyAll();
+      return;
+    }
+    ec_.notifyAll();
+  }
+}
+
+StatusObject<size_t> PrefetchSource::ReadInternal(const strings::MutableByteRange& range) {
+  size_t copied = 0;
+
+  while (copied < range.size()) {
+    bool has_data = false;
+    ec_.await([&] {
+      std::lock_guard<std::mutex> lk(mu_);
+      has_data = ready_ > 0;
+      return has_data || !filling_;
+    });
+
+    if (!has_data) {
+      std::lock_guard<std::mutex> lk(mu_);
+      if (ready_ == 0) {  // Upstream ended or failed.
+        if (copied == 0 && !status_.ok())
+          return status_;
+        break;
+      }
+    }
+
+    Buf& buf = ring_[head_];
+    size_t len = std::min(buf.size - offs_, range.size() - copied);
+    memcpy(range.data() + copied, buf.data.get() + offs_, len);
+    copied += len;
+    offs_ += len;
+
+    if (offs_ == buf.size) {  // Returns the buffer to the helper.
+      offs_ = 0;
+      head_ = (head_ + 1) % ring_.size();
+
+      bool fill;
+      {
+        std::lock_guard<std::mutex> lk(mu_);
+        --ready_;
+        fill = ShouldFillLocked();
+      }
+      if (fill) {
+        tp_->Add([this] { Fill(); });
+      }
+    }
+  }
+
+  return copied;
+}
+
 }  // namespace
 
 StatusObject<ReadonlyFile*> OpenFiberReadFile(StringPiece name,
                                               util::fibers_ext::FiberQueueThreadPool* tp,
                                               const FiberReadOptions& opts) {
-  StatusObject<ReadonlyFile*> res = ReadonlyFile::Open(name, opts);
+  // The cache wraps the fiber file, so that cache hits do not go through the thread pool.
+  ReadonlyFile::Options file_opts = opts;
+  file_opts.block_cache = nullptr;
+  StatusObject<ReadonlyFile*> res = ReadonlyFile::Open(name, file_opts);
   if (!res.ok())
     return res;
-  return new FiberReadFile(opts, res.obj, tp);
+  ReadonlyFile* fl = new FiberReadFile(opts, res.obj, tp);
+  if (opts.block_cache) {
+    fl = NewCachedReadFile(fl, name, opts.block_cache);
+  }
+  return fl;
 }
 
 StatusObject<WriteFile*> OpenFiberWriteFile(StringPiece name,
@@ -338,4 +499,9 @@ StatusObject<WriteFile*> OpenFiberWriteFile(StringPiece name,
   return new WriteFileImpl(wf, hash, tp);
 }
 
+util::Source* NewPrefetchSource(util::Source* upstream, util::fibers_ext::FiberQueueThreadPool* tp,
+                                const PrefetchSourceOptions& opts) {
+  return new PrefetchSource(upstream, tp, opts);
+}
+
 }  // namespace file
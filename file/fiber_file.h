@@ -4,6 +4,7 @@
 
 #include "file/file.h"
 #include "util/fibers/fiberqueue_threadpool.h"
+#include "util/sinksource.h"
 
 namespace file {
 
@@ -26,6 +27,8 @@ util::StatusObject<ReadonlyFile*> OpenFiberReadFile(
     StringPiece name, util::fibers_ext::FiberQueueThreadPool* tp,
     const FiberReadOptions& opts = FiberReadOptions{}) MUST_USE_RESULT;
 
+// Set OpenOptions::direct to write with O_DIRECT. Direct writes are submitted asynchronously,
+// so the pool thread blocks only when all the write slots of the file are in flight.
 struct FiberWriteOptions : public OpenOptions {
   bool consistent_thread = true;  // whether to send the write request to the same pool-thread.
 };
@@ -34,4 +37,18 @@ util::StatusObject<WriteFile*>
 OpenFiberWriteFile(StringPiece name, util::fibers_ext::FiberQueueThreadPool* tp,
                    const FiberWriteOptions& opts = FiberWriteOptions()) MUST_USE_RESULT;
 
+struct PrefetchSourceOptions {
+  unsigned num_buffers = 4;
+  size_t buffer_size = 1 << 17;
+};
+
+// Returns a source that reads upstream ahead in FiberQueueThreadPool into a ring of
+// num_buffers buffers, so that the reading fiber consumes the data that is already there.
+// Suits decompressing sources, whose decompression then overlaps with the processing of
+// their output. The helper stops reading when all the buffers are full and resumes when the
+// reader frees one. Takes ownership over upstream, which must be safe to read from
+// the pool threads, i.e. must not block on fibers of other threads like FiberReadFile does.
+util::Source* NewPrefetchSource(util::Source* upstream, util::fibers_ext::FiberQueueThreadPool* tp,
+                                const PrefetchSourceOptions& opts = PrefetchSourceOptions{});
+
 }  // namespace file
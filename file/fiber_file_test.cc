@@ -0,0 +1,105 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "file/fiber_file.h"
+
+#include "base/gtest.h"
+#include "base/logging.h"
+#include "file/filesource.h"
+
+namespace file {
+
+using namespace util;
+using std::string;
+
+// Fails after returning limit bytes.
+class FailingSource : public util::Source {
+ public:
+  FailingSource(const string& input, size_t limit) : input_(input), limit_(limit) {}
+
+  size_t read_bytes() const { return offs_; }
+
+ private:
+  StatusObject<size_t> ReadInternal(const strings::MutableByteRange& range) override {
+    if (offs_ >= limit_)
+      return Status(StatusCode::IO_ERROR, "failed");
+    size_t len = std::min(range.size(), limit_ - offs_);
+    memcpy(range.data(), input_.data() + offs_, len);
+    offs_ += len;
+    return len;
+  }
+
+  const string& input_;
+  size_t limit_, offs_ = 0;
+};
+
+class FiberFileTest : public testing::Test {
+ protected:
+  static string Lines(unsigned count) {
+    string res;
+    for (unsigned i = 0; i < count; ++i) {
+      res.append(std::to_string(i)).append(i % 7, 'x').append("\n");
+    }
+    return res;
+  }
+};
+
+TEST_F(FiberFileTest, PrefetchSource) {
+  fibers_ext::FiberQueueThreadPool pool(2);
+  const string input = Lines(10000);
+
+  PrefetchSourceOptions opts;
+  opts.num_buffers = 3;
+  opts.buffer_size = 1000;
+  util::Source* src = NewPrefetchSource(new StringSource(input, 333), &pool, opts);
+  LineReader lr(src, TAKE_OWNERSHIP);
+
+  StringPiece line;
+  string scratch;
+  for (unsigned i = 0; i < 10000; ++i) {
+    ASSERT_TRUE(lr.Next(&line, &scratch));
+    ASSERT_EQ(std::to_string(i) + string(i % 7, 'x'), line);
+  }
+  EXPECT_FALSE(lr.Next(&line, &scratch));
+  EXPECT_TRUE(lr.status().ok());
+}
+
+TEST_F(FiberFileTest, PrefetchSourceError) {
+  fibers_ext::FiberQueueThreadPool pool(1);
+  const string input = Lines(1000);
+
+  PrefetchSourceOptions opts;
+  opts.buffer_size = 128;
+  std::unique_ptr<util::Source> src(
+      NewPrefetchSource(new FailingSource(input, 1000), &pool, opts));
+
+  string buf(input.size(), '\0');
+  auto res = src->Read(strings::MutableByteRange(reinterpret_cast<uint8_t*>(&buf[0]), 500));
+  ASSERT_TRUE(res.ok());
+  EXPECT_EQ(500, res.obj);
+  EXPECT_EQ(input.substr(0, 500), buf.substr(0, 500));
+
+  res = src->Read(strings::MutableByteRange(reinterpret_cast<uint8_t*>(&buf[0]), buf.size()));
+  EXPECT_FALSE(res.ok());
+  EXPECT_EQ(StatusCode::IO_ERROR, res.status.code());
+}
+
+TEST_F(FiberFileTest, PrefetchSourceBackpressure) {
+  fibers_ext::FiberQueueThreadPool pool(1);
+  const string input = Lines(10000);
+
+  PrefetchSourceOptions opts;
+  opts.num_buffers = 2;
+  opts.buffer_size = 100;
+  FailingSource* upstream = new FailingSource(input, input.size());
+  std::unique_ptr<util::Source> src(NewPrefetchSource(upstream, &pool, opts));
+
+  uint8_t buf[10];
+  ASSERT_TRUE(src->Read(strings::MutableByteRange(buf, sizeof(buf))).ok());
+
+  // The pool has a single thread, so the helper has stopped on the full ring once Await returns.
+  pool.Await([] {});
+  EXPECT_EQ(200, upstream->read_bytes());
+}
+
+}  // namespace file
@@ -18,13 +18,22 @@
 #include "file/file.h"
 
 #include <fcntl.h>
+#include <linux/aio_abi.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <algorithm>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "base/logging.h"
 #include "base/macros.h"
+#include "file/block_cache.h"
 
 using std::string;
 using util::Status;
@@ -43,6 +52,9 @@ Status StatusFileError() {
 
 namespace {
 
+// The number of iovec entries passed to a single readv/writev call.
+constexpr int kIovBatch = 64;
+
 static ssize_t read_all(int fd, uint8* buffer, size_t length, size_t offset) {
   size_t left_to_read = length;
   uint8* curr_buf = buffer;
@@ -59,6 +71,35 @@ static ssize_t read_all(int fd, uint8* buffer, size_t length, size_t offset) {
   return length;
 }
 
+// Advances iov by len bytes and returns the number of the remaining entries.
+static int AdvanceIov(size_t len, struct iovec** iov, int cnt) {
+  while (cnt && len >= (*iov)->iov_len) {
+    len -= (*iov)->iov_len;
+    ++*iov;
+    --cnt;
+  }
+  if (cnt) {
+    (*iov)->iov_base = reinterpret_cast<uint8*>((*iov)->iov_base) + len;
+    (*iov)->iov_len -= len;
+  }
+  return cnt;
+}
+
+// Returns the number of bytes read, which is less than the total length at EOF, or -1.
+static ssize_t readv_all(int fd, struct iovec* iov, int cnt, size_t offset) {
+  size_t total = 0;
+  while (cnt > 0) {
+    ssize_t read = preadv(fd, iov, cnt, offset);
+    if (read <= 0) {
+      return read == 0 ? total : read;
+    }
+    total += read;
+    offset += read;
+    cnt = AdvanceIov(read, &iov, cnt);
+  }
+  return total;
+}
+
 // Returns true if a uint64 actually looks like a negative int64. This checks
 // if the most significant bit is one.
 //
@@ -89,6 +130,7 @@ class LocalFileImpl : public WriteFile {
   bool Close() override;
 
   Status Write(const uint8* buffer, uint64 length) final;
+  Status WriteV(absl::Span<const strings::ByteRange> slices) final;
 
  protected:
   int fd_ = 0;
@@ -136,6 +178,271 @@ Status LocalFileImpl::Write(const uint8* buffer, uint64 length) {
   return Status::OK;
 }
 
+Status LocalFileImpl::WriteV(absl::Span<const strings::ByteRange> slices) {
+  struct iovec iov[kIovBatch];
+
+  while (!slices.empty()) {
+    int cnt = std::min<size_t>(slices.size(), kIovBatch);
+    for (int i = 0; i < cnt; ++i) {
+      iov[i].iov_base = const_cast<uint8*>(slices[i].data());
+      iov[i].iov_len = slices[i].size();
+    }
+    slices.remove_prefix(cnt);
+
+    struct iovec* next = iov;
+    while (cnt > 0) {
+      ssize_t written = writev(fd_, next, cnt);
+      if (written < 0) {
+        return StatusFileError();
+      }
+      cnt = AdvanceIov(written, &next, cnt);
+    }
+  }
+  return Status::OK;
+}
+
+// ----------------- DirectFileImpl -------------------------------------------
+// O_DIRECT writes require the buffers, their sizes and the file offsets to be aligned.
+constexpr size_t kDirectAlign = 4096;
+
+// Process-wide cache of aligned buffers. Recycles the buffers of closed files,
+// so that opening many outputs does not churn the allocator.
+class AlignedBufferPool {
+ public:
+  ~AlignedBufferPool() {
+    for (const auto& k_v : free_) {
+      for (uint8* buf : k_v.second)
+        free(buf);
+    }
+  }
+
+  uint8* Get(size_t size) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      auto& vec = free_[size];
+      if (!vec.empty()) {
+        uint8* res = vec.back();
+        vec.pop_back();
+        cached_bytes_ -= size;
+        return res;
+      }
+    }
+    void* ptr = nullptr;
+    CHECK_EQ(0, posix_memalign(&ptr, kDirectAlign, size));
+    return reinterpret_cast<uint8*>(ptr);
+  }
+
+  void Return(uint8* buf, size_t size) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      if (cached_bytes_ + size <= kMaxCachedBytes) {
+        free_[size].push_back(buf);
+        cached_bytes_ += size;
+        return;
+      }
+    }
+    free(buf);
+  }
+
+ private:
+  static constexpr size_t kMaxCachedBytes = 1ULL << 28;
+
+  std::mutex mu_;
+  std::unordered_map<size_t, std::vector<uint8*>> free_;
+  size_t cached_bytes_ = 0;
+};
+
+AlignedBufferPool* GetBufferPool() {
+  static AlignedBufferPool pool;
+  return &pool;
+}
+
+// Writes the data with O_DIRECT using linux native AIO. Write() copies the data into an aligned
+// buffer and submits it once it fills up, without waiting for the completion unless
+// all the write slots are in flight. The unaligned tail is padded when the file is closed
+// and the file is truncated back to its real size.
+class DirectFileImpl : public WriteFile {
+ public:
+  DirectFileImpl(StringPiece file_name, const OpenOptions& opts);
+
+  DirectFileImpl(const DirectFileImpl&) = delete;
+
+  virtual ~DirectFileImpl() override;
+
+  bool Open() override;
+
+  bool Close() override;
+
+  Status Write(const uint8* buffer, uint64 length) final;
+
+ private:
+  struct Request {
+    iocb cb;
+    uint8* buf = nullptr;
+  };
+
+  // Submits the current buffer, len bytes of which are written.
+  Status Submit(size_t len);
+
+  // Waits for at least min_events completions.
+  Status Reap(unsigned min_events);
+
+  int fd_ = -1;
+  aio_context_t ctx_ = 0;
+  const size_t buf_size_;
+
+  std::vector<Request> requests_;
+  std::vector<Request*> free_;
+  std::vector<io_event> events_;  // Completions buffer for Reap(), one per request.
+
+  uint8* cur_ = nullptr;
+  size_t cur_len_ = 0;
+  uint64 offset_ = 0;  // file offset of cur_.
+  Status status_;      // The first error of the asynchronous writes.
+};
+
+DirectFileImpl::DirectFileImpl(StringPiece file_name, const OpenOptions& opts)
+    : WriteFile(file_name),
+      buf_size_((std::max<size_t>(opts.direct_buf_size, 1) + kDirectAlign - 1) &
+                ~(kDirectAlign - 1)),
+      requests_(std::max(1u, opts.direct_pending_writes)), events_(requests_.size()) {
+  for (auto& r : requests_) {
+    free_.push_back(&r);
+  }
+}
+
+DirectFileImpl::~DirectFileImpl() {
+  // Waits for the outstanding requests, if any, so it is safe to release their buffers.
+  if (ctx_)
+    syscall(__NR_io_destroy, ctx_);
+  for (auto& r : requests_) {
+    if (r.buf)
+      GetBufferPool()->Return(r.buf, buf_size_);
+  }
+  if (cur_)
+    GetBufferPool()->Return(cur_, buf_size_);
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool DirectFileImpl::Open() {
+  fd_ = open(create_file_name_.c_str(), O_CREAT | O_WRONLY | O_CLOEXEC | O_TRUNC | O_DIRECT,
+             0644);
+  if (fd_ < 0) {
+    VLOG(1) << "Could not open file with O_DIRECT " << strerror(errno) << " file "
+            << create_file_name_;
+    return false;
+  }
+
+  if (syscall(__NR_io_setup, requests_.size(), &ctx_) < 0) {
+    LOG(WARNING) << "io_setup failed " << strerror(errno);
+    ctx_ = 0;
+    return false;
+  }
+  return true;
+}
+
+Status DirectFileImpl::Write(const uint8* buffer, uint64 length) {
+  DCHECK(!IsUInt64ANegativeInt64(length));
+
+  while (length > 0) {
+    if (!cur_)
+      cur_ = GetBufferPool()->Get(buf_size_);
+
+    size_t sz = std::min<uint64>(length, buf_size_ - cur_len_);
+    memcpy(cur_ + cur_len_, buffer, sz);
+    cur_len_ += sz;
+    buffer += sz;
+    length -= sz;
+
+    if (cur_len_ == buf_size_) {
+      RETURN_IF_ERROR(Submit(buf_size_));
+    }
+  }
+  return status_;
+}
+
+Status DirectFileImpl::Submit(size_t len) {
+  if (free_.empty()) {
+    RETURN_IF_ERROR(Reap(1));
+  }
+  Request* req = free_.back();
+
+  memset(&req->cb, 0, sizeof(req->cb));
+  req->cb.aio_data = reinterpret_cast<uintptr_t>(req);
+  req->cb.aio_lio_opcode = IOCB_CMD_PWRITE;
+  req->cb.aio_fildes = fd_;
+  req->cb.aio_buf = reinterpret_cast<uintptr_t>(cur_);
+  req->cb.aio_nbytes = len;
+  req->cb.aio_offset = offset_;
+
+  iocb* cbs[1] = {&req->cb};
+  if (syscall(__NR_io_submit, ctx_, 1, cbs) != 1) {
+    return StatusFileError();
+  }
+  free_.pop_back();
+  req->buf = cur_;
+  cur_ = nullptr;
+  cur_len_ = 0;
+  offset_ += len;
+
+  return Status::OK;
+}
+
+Status DirectFileImpl::Reap(unsigned min_events) {
+  if (min_events == 0)
+    return status_;
+
+  DCHECK_LE(min_events, events_.size());
+  io_event* events = events_.data();
+  unsigned left = min_events;
+  while (left > 0) {
+    long res = syscall(__NR_io_getevents, ctx_, left, left, events, nullptr);
+    if (res < 0) {
+      if (errno == EINTR)
+        continue;
+      return StatusFileError();
+    }
+
+    for (long i = 0; i < res; ++i) {
+      Request* req = reinterpret_cast<Request*>(events[i].data);
+      if (events[i].res < 0) {
+        errno = -events[i].res;
+        status_ = StatusFileError();
+      } else if (size_t(events[i].res) != req->cb.aio_nbytes && status_.ok()) {
+        status_ = Status(StatusCode::IO_ERROR, "Short write");
+      }
+      GetBufferPool()->Return(req->buf, buf_size_);
+      req->buf = nullptr;
+      free_.push_back(req);
+    }
+    left -= res;
+  }
+  return status_;
+}
+
+bool DirectFileImpl::Close() {
+  uint64 file_size = offset_ + cur_len_;
+  Status st;
+  if (cur_len_ > 0) {
+    size_t aligned_len = (cur_len_ + kDirectAlign - 1) & ~(kDirectAlign - 1);
+    memset(cur_ + cur_len_, 0, aligned_len - cur_len_);
+    st = Submit(aligned_len);
+  }
+
+  Status reap_st = Reap(requests_.size() - free_.size());
+  if (st.ok())
+    st = reap_st;
+
+  if (st.ok() && ftruncate(fd_, file_size) < 0) {
+    st = StatusFileError();
+  }
+  LOG_IF(ERROR, !st.ok()) << "Error writing " << create_file_name_ << ": " << st;
+
+  delete this;
+  return st.ok();
+}
+
 }  // namespace
 
 WriteFile::WriteFile(StringPiece name)
@@ -143,9 +450,23 @@ WriteFile::WriteFile(StringPiece name)
 
 WriteFile::~WriteFile() { }
 
+Status WriteFile::WriteV(absl::Span<const strings::ByteRange> slices) {
+  for (const auto& slice : slices) {
+    RETURN_IF_ERROR(Write(slice.data(), slice.size()));
+  }
+  return Status::OK;
+}
+
 
 
 WriteFile* Open(StringPiece file_name, OpenOptions opts) {
+  if (opts.direct && !opts.append) {
+    DirectFileImpl* ptr = new DirectFileImpl(file_name, opts);
+    if (ptr->Open())
+      return ptr;
+    delete ptr;
+  }
+
   int flags = O_CREAT | O_WRONLY | O_CLOEXEC;
   if (opts.append)
     flags |= O_APPEND;
@@ -174,6 +495,26 @@ bool Delete(StringPiece name) {
 ReadonlyFile::~ReadonlyFile() {
 }
 
+StatusObject<size_t> ReadonlyFile::ReadV(size_t offset,
+                                         absl::Span<const strings::MutableByteRange> ranges) {
+  size_t read = 0;
+  for (const auto& range : ranges) {
+    if (range.empty())
+      continue;
+    auto res = Read(offset + read, range);
+    if (!res.ok())
+      return res;
+    read += res.obj;
+    if (res.obj < range.size())
+      break;
+  }
+  return read;
+}
+
+StatusObject<strings::ByteRange> ReadonlyFile::ReadView(size_t offset, size_t length) {
+  return Status(StatusCode::NOT_IMPLEMENTED_ERROR, "ReadView is not supported");
+}
+
 // pread() based access.
 class PosixReadFile final: public ReadonlyFile {
  private:
@@ -214,11 +555,104 @@ class PosixReadFile final: public ReadonlyFile {
     return r;
   }
 
+  StatusObject<size_t> ReadV(size_t offset,
+                             absl::Span<const strings::MutableByteRange> ranges) override {
+    if (offset > file_size_) {
+      return Status(StatusCode::RUNTIME_ERROR, "Invalid read range");
+    }
+
+    struct iovec iov[kIovBatch];
+    size_t read = 0;
+    while (!ranges.empty()) {
+      int cnt = std::min<size_t>(ranges.size(), kIovBatch);
+      size_t len = 0;
+      for (int i = 0; i < cnt; ++i) {
+        iov[i].iov_base = ranges[i].data();
+        iov[i].iov_len = ranges[i].size();
+        len += ranges[i].size();
+      }
+      ranges.remove_prefix(cnt);
+
+      ssize_t r = readv_all(fd_, iov, cnt, offset + read);
+      if (r < 0) {
+        return StatusFileError();
+      }
+      read += r;
+      if (size_t(r) < len)
+        break;
+    }
+    return read;
+  }
+
+  size_t Size() const final { return file_size_; }
+
+  int Handle() const final { return fd_; };
+};
+
+// mmap() based access. Reads copy from the mapping, ReadView returns it directly.
+class MmapReadFile final : public ReadonlyFile {
+ private:
+  int fd_;
+  const uint8* base_;
+  const size_t file_size_;
+  bool drop_cache_;
+
+ public:
+  MmapReadFile(int fd, const uint8* base, size_t sz, bool drop)
+      : fd_(fd), base_(base), file_size_(sz), drop_cache_(drop) {}
+
+  virtual ~MmapReadFile() {
+    Close();
+  }
+
+  Status Close() override {
+    if (base_) {
+      munmap(const_cast<uint8*>(base_), file_size_);
+      base_ = nullptr;
+    }
+    if (fd_) {
+      if (drop_cache_)
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
+      close(fd_);
+      fd_ = 0;
+    }
+    return Status::OK;
+  }
+
+  StatusObject<size_t> Read(size_t offset, const strings::MutableByteRange& range) override {
+    auto res = ReadView(offset, range.size());
+    if (!res.ok())
+      return res.status;
+    if (!res.obj.empty())
+      memcpy(range.begin(), res.obj.data(), res.obj.size());
+    return res.obj.size();
+  }
+
+  StatusObject<strings::ByteRange> ReadView(size_t offset, size_t length) override {
+    if (offset > file_size_) {
+      return Status(StatusCode::RUNTIME_ERROR, "Invalid read range");
+    }
+    return strings::ByteRange(base_ + offset, std::min(length, file_size_ - offset));
+  }
+
+  bool SupportsReadView() const final { return true; }
+
   size_t Size() const final { return file_size_; }
 
   int Handle() const final { return fd_; };
 };
 
+static void AdviseMapping(void* addr, size_t sz, const ReadonlyFile::Options& opts) {
+  // Hints are best effort, hence errors are ignored.
+  madvise(addr, sz, opts.sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+  if (opts.will_need)
+    madvise(addr, sz, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+  if (opts.huge_pages)
+    madvise(addr, sz, MADV_HUGEPAGE);
+#endif
+}
+
 StatusObject<ReadonlyFile*> ReadonlyFile::Open(StringPiece name, const Options& opts) {
   int fd = open(name.data(), O_RDONLY);
   if (fd < 0) {
@@ -231,7 +665,26 @@ StatusObject<ReadonlyFile*> ReadonlyFile::Open(StringPiece name, const Options&
   }
 
   int advice = opts.sequential ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_NORMAL;
-  return new PosixReadFile(fd, sb.st_size, advice, opts.drop_cache_on_close);
+
+  // Empty files can not be mapped.
+  if (opts.use_mmap && sb.st_size > 0) {
+    void* addr = mmap(nullptr, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      Status st = StatusFileError();
+      close(fd);
+      return st;
+    }
+    AdviseMapping(addr, sb.st_size, opts);
+
+    return new MmapReadFile(fd, reinterpret_cast<const uint8*>(addr), sb.st_size,
+                            opts.drop_cache_on_close);
+  }
+
+  ReadonlyFile* res = new PosixReadFile(fd, sb.st_size, advice, opts.drop_cache_on_close);
+  if (opts.block_cache) {
+    res = NewCachedReadFile(res, name, opts.block_cache);
+  }
+  return res;
 }
 
 
@@ -5,6 +5,7 @@
 
 #include <string>
 
+#include "absl/types/span.h"
 #include "base/integral_types.h"
 #include "strings/stringpiece.h"
 
@@ -13,6 +14,8 @@
 
 namespace file {
 
+class BlockCache;
+
 util::Status StatusFileError();
 
 // ReadonlyFile objects are created via ReadonlyFile::Open() factory function
@@ -26,6 +29,20 @@ class ReadonlyFile {
   struct Options {
     bool sequential = true;
     bool drop_cache_on_close = true;
+
+    // Maps the file into memory instead of reading it with pread. Mapped files support
+    // ReadView(), which is preferable for hot files that reside in the page cache.
+    bool use_mmap = false;
+
+    // Mapped files only: asks the kernel to read ahead the whole file and
+    // to back the mapping with transparent huge pages, when the filesystem supports it.
+    bool will_need = false;
+    bool huge_pages = false;
+
+    // If set, reads are served via the cache in whole blocks, which is shared with the other
+    // files opened with the same cache. Ignored for mapped files. See file/block_cache.h.
+    BlockCache* block_cache = nullptr;
+
     Options()  {}
   };
 
@@ -37,6 +54,19 @@ class ReadonlyFile {
   virtual util::StatusObject<size_t>
       Read(size_t offset, const strings::MutableByteRange& range) MUST_USE_RESULT = 0;
 
+  // Scatter version of Read(). Reads the consecutive bytes starting at offset into ranges.
+  // The default implementation calls Read() for each range.
+  virtual util::StatusObject<size_t> ReadV(
+      size_t offset, absl::Span<const strings::MutableByteRange> ranges) MUST_USE_RESULT;
+
+  // Returns the range of upto length bytes at offset that points directly into the file mapping.
+  // The range is valid until the file is closed. Supported only if SupportsReadView()
+  // returns true, otherwise returns NOT_IMPLEMENTED_ERROR.
+  virtual util::StatusObject<strings::ByteRange>
+      ReadView(size_t offset, size_t length) MUST_USE_RESULT;
+
+  virtual bool SupportsReadView() const { return false; }
+
   // releases the system handle for this file. Does not delete this.
   virtual util::Status Close() = 0;
 
@@ -70,6 +100,9 @@ class WriteFile {
 
   virtual util::Status Write(const uint8* buffer, uint64 length) MUST_USE_RESULT = 0 ;
 
+  //! Gather version of Write(). The default implementation calls Write() for each slice.
+  virtual util::Status WriteV(absl::Span<const strings::ByteRange> slices) MUST_USE_RESULT;
+
   util::Status Write(const absl::string_view slice) MUST_USE_RESULT {
     return Write(reinterpret_cast<const uint8*>(slice.data()), slice.size());
   }
@@ -90,6 +123,14 @@ class WriteFile {
 
 struct OpenOptions {
   bool append = false;
+
+  // Writes with O_DIRECT, bypassing the page cache. Data is staged in aligned buffers of
+  // direct_buf_size bytes that are written asynchronously, with upto direct_pending_writes
+  // writes in flight. Falls back to the buffered writes if the file system does not support
+  // direct IO or if the file is opened for append.
+  bool direct = false;
+  unsigned direct_pending_writes = 2;
+  size_t direct_buf_size = 1 << 20;
 };
 
 //! Factory method to create a new writable file object. Calls Open on the
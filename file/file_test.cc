@@ -15,6 +15,7 @@
 
 #include "util/sinksource.h"
 #include "util/zlib_source.h"
+#include "util/zstd_sinksource.h"
 
 using testing::ElementsAre;
 
@@ -149,6 +150,106 @@ TEST_F(FileTest, UniquePtr) {
   std::unique_ptr<WriteFile> file(Open(base::GetTestTempPath("foo.txt")));
 }
 
+TEST_F(FileTest, WriteVReadV) {
+  const string kFileName = "/tmp/writev_file.txt";
+  std::vector<string> parts;
+  std::vector<strings::ByteRange> slices;
+  string expected;
+  for (unsigned i = 0; i < 200; ++i) {
+    parts.push_back(string(i % 7 ? i : 0, 'a' + i % 26));
+  }
+  for (const auto& p : parts) {
+    slices.push_back(strings::ToByteRange(p));
+    expected.append(p);
+  }
+
+  WriteFile* file = Open(kFileName);
+  ASSERT_TRUE(file != nullptr);
+  Sink sink(file, TAKE_OWNERSHIP);
+  ASSERT_TRUE(sink.AppendV(slices).ok());
+  ASSERT_TRUE(sink.AppendV(slices).ok());
+  expected += expected;
+
+  string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(kFileName, &contents));
+  EXPECT_EQ(expected, contents);
+
+  // Reads a part of the file, the last range crosses its end.
+  auto res = ReadonlyFile::Open(kFileName);
+  ASSERT_TRUE(res.ok()) << res.status;
+  Source src(res.obj, 100, 1000);
+  string a(600, '\0'), b(600, '\0');
+  strings::MutableByteRange ranges[] = {strings::AsMutableByteRange(a),
+                                        strings::AsMutableByteRange(b)};
+  auto read = src.ReadV(ranges);
+  ASSERT_TRUE(read.ok()) << read.status;
+  ASSERT_EQ(1000, read.obj);
+  EXPECT_EQ(expected.substr(100, 1000), a + b.substr(0, 400));
+}
+
+TEST_F(FileTest, DirectWrite) {
+  string file_path = base::GetTestTempPath("direct.txt");
+  OpenOptions opts;
+  opts.direct = true;
+  opts.direct_buf_size = 4096;
+  opts.direct_pending_writes = 3;
+
+  WriteFile* file = Open(file_path, opts);
+  ASSERT_TRUE(file != nullptr);
+
+  string expected;
+  for (unsigned i = 0; i < 1000; ++i) {
+    string data(i % 97, 'a' + i % 26);
+    expected.append(data);
+    ASSERT_TRUE(file->Write(data).ok());
+  }
+  ASSERT_TRUE(file->Close());
+
+  string data;
+  file_util::ReadFileToStringOrDie(file_path, &data);
+  EXPECT_EQ(expected, data);
+}
+
+TEST_F(FileTest, Mmap) {
+  string file_path = base::GetTestTempPath("mmap.txt");
+  file_util::WriteStringToFileOrDie("Test\r\n\nFoo\nBar", file_path);
+
+  ReadonlyFile::Options opts;
+  opts.use_mmap = true;
+  opts.huge_pages = true;
+  auto res = ReadonlyFile::Open(file_path, opts);
+  ASSERT_TRUE(res.ok()) << res.status;
+  std::unique_ptr<ReadonlyFile> file(res.obj);
+  ASSERT_TRUE(file->SupportsReadView());
+  EXPECT_EQ(14, file->Size());
+
+  auto view = file->ReadView(10, 100);
+  ASSERT_TRUE(view.ok());
+  EXPECT_EQ("\nBar", strings::FromBuf(view.obj.data(), view.obj.size()));
+
+  uint8 buf[4];
+  auto rres = file->Read(1, strings::MutableByteRange(buf, sizeof(buf)));
+  ASSERT_TRUE(rres.ok());
+  EXPECT_EQ("est\r", strings::FromBuf(buf, rres.obj));
+  EXPECT_FALSE(file->ReadView(15, 1).ok());
+
+  LineReader lr(file.release(), file_path);
+  std::vector<string> lines;
+  StringPiece line;
+  while (lr.Next(&line)) {
+    lines.emplace_back(line);
+  }
+  EXPECT_THAT(lines, ElementsAre("Test", "", "Foo", "Bar"));
+  EXPECT_EQ(4, lr.line_num());
+
+  file_util::WriteStringToFileOrDie("", file_path);
+  res = ReadonlyFile::Open(file_path, opts);
+  ASSERT_TRUE(res.ok()) << res.status;
+  EXPECT_FALSE(res.obj->SupportsReadView());
+  EXPECT_TRUE(res.obj->Close().ok());
+  delete res.obj;
+}
+
 constexpr size_t kStrLen = 1 << 17;
 
 static void BM_GZipFile(benchmark::State& state) {
@@ -180,6 +281,33 @@ static void BM_ZipSink(benchmark::State& state) {
 }
 BENCHMARK(BM_ZipSink)->Range(8, 32);
 
+// Raw records -> zstd -> file. range(0) records are passed to ZStdSink at once.
+static void BM_ZStdFileSink(benchmark::State& state) {
+  std::vector<string> records;
+  for (unsigned i = 0; i < 4096; ++i) {
+    records.push_back(base::RandStr(20 + i % 100) + "\n");
+  }
+  std::vector<strings::ByteRange> slices;
+  for (const auto& r : records)
+    slices.push_back(strings::ToByteRange(r));
+  const size_t batch = state.range(0);
+
+  while (state.KeepRunning()) {
+    util::ZStdSink zsink(new Sink(Open("/dev/null"), TAKE_OWNERSHIP));
+    CHECK_STATUS(zsink.Init(1));
+    for (size_t i = 0; i < slices.size(); i += batch) {
+      size_t len = std::min(batch, slices.size() - i);
+      if (len == 1) {
+        CHECK_STATUS(zsink.Append(slices[i]));
+      } else {
+        CHECK_STATUS(zsink.AppendV(absl::MakeConstSpan(slices).subspan(i, len)));
+      }
+    }
+    CHECK_STATUS(zsink.Flush());
+  }
+}
+BENCHMARK(BM_ZStdFileSink)->Arg(1)->Arg(16)->Arg(256);
+
 static void BM_LineReader(benchmark::State& state) {
   string buffer;
   const size_t line_sz = state.range(0);
@@ -5,7 +5,13 @@
 #include "file/filesource.h"
 
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
+#include "absl/container/inlined_vector.h"
+#include "absl/strings/str_cat.h"
 #include "base/logging.h"
 #include "file/file.h"
 #include "strings/split.h"
@@ -20,8 +26,9 @@ using util::Status;
 using util::StatusObject;
 using namespace std;
 
-Source::Source(ReadonlyFile* file)
- : file_(file) {
+Source::Source(ReadonlyFile* file, uint64 offset, uint64 length)
+ : file_(file), offset_(offset) {
+  end_ = length > kuint64max - offset ? kuint64max : offset + length;
 }
 
 Source::~Source() {
@@ -29,7 +36,14 @@ Source::~Source() {
 }
 
 util::StatusObject<size_t> Source::ReadInternal(const strings::MutableByteRange& range) {
-  auto res = file_->Read(offset_, range);
+  if (offset_ >= end_)
+    return 0;
+
+  strings::MutableByteRange dest = range;
+  if (end_ - offset_ < dest.size())
+    dest.reset(range.begin(), end_ - offset_);
+
+  auto res = file_->Read(offset_, dest);
   if (res.ok()) {
     offset_ += res.obj;
   }
@@ -37,9 +51,110 @@ util::StatusObject<size_t> Source::ReadInternal(const strings::MutableByteRange&
   return res;
 }
 
+util::StatusObject<size_t> Source::ReadInternalV(
+    absl::Span<const strings::MutableByteRange> ranges) {
+  if (offset_ >= end_)
+    return 0;
+
+  // Clips the ranges to the end of the part being read.
+  size_t left = end_ - offset_;
+  absl::InlinedVector<strings::MutableByteRange, 8> clipped;
+  for (const auto& range : ranges) {
+    if (left == 0)
+      break;
+    size_t sz = std::min(range.size(), left);
+    clipped.emplace_back(range.begin(), sz);
+    left -= sz;
+  }
+
+  auto res = file_->ReadV(offset_, clipped);
+  if (res.ok()) {
+    offset_ += res.obj;
+  }
+  return res;
+}
+
+
+namespace {
+
+// Smaller gzip files are not worth parallelizing.
+constexpr uint64 kMinIndexedSize = 1ULL << 26;
+constexpr uint64 kIndexSpan = 1ULL << 22;
+constexpr size_t kMaxIndexCacheBytes = 1ULL << 28;
+
+// Process-wide cache of gzip indices. Evicts the oldest indices when it becomes too large.
+class GzipIndexCache {
+ public:
+  std::shared_ptr<const util::GzipIndex> Get(const std::string& key) {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = map_.find(key);
+    return it == map_.end() ? nullptr : it->second;
+  }
+
+  void Put(const std::string& key, std::unique_ptr<util::GzipIndex> index) {
+    if (index->points().empty())
+      return;
+
+    size_t bytes = index->MemoryUsage();
+    std::lock_guard<std::mutex> lk(mu_);
+    if (!map_.emplace(key, std::move(index)).second)
+      return;
+    bytes_ += bytes;
+    order_.push_back(key);
+
+    while (bytes_ > kMaxIndexCacheBytes && order_.size() > 1) {
+      auto it = map_.find(order_.front());
+      bytes_ -= it->second->MemoryUsage();
+      map_.erase(it);
+      order_.pop_front();
+    }
+  }
+
+ private:
+  std::mutex mu_;
+  std::unordered_map<std::string, std::shared_ptr<const util::GzipIndex>> map_;
+  std::deque<std::string> order_;
+  size_t bytes_ = 0;
+};
+
+GzipIndexCache* GetIndexCache() {
+  static GzipIndexCache cache;
+  return &cache;
+}
+
+}  // namespace
+
+util::Source* Source::UncompressedIndexed(ReadonlyFile* file, const std::string& name,
+                                         util::fibers_ext::FiberQueueThreadPool* pool) {
+  uint64 size = file->Size();
+  if (!pool || size < kMinIndexedSize)
+    return Uncompressed(file);
 
-util::Source* Source::Uncompressed(ReadonlyFile* file) {
   Source* first = new Source(file);
+  if (!util::ZlibSource::IsZlibSource(first))
+    return DetectCompression(first);
+
+  unsigned parallelism = std::min(8u, std::max(2u, std::thread::hardware_concurrency() / 2));
+
+  // The size guards against reading stale indices of rewritten files.
+  std::string key = absl::StrCat(name, ":", size);
+  auto index = GetIndexCache()->Get(key);
+  if (index) {
+    return new util::ParallelGzipSource(first, std::move(index), pool, parallelism);
+  }
+
+  return new util::ParallelGzipSource(
+      first, pool, parallelism, kIndexSpan,
+      [key = std::move(key)](std::unique_ptr<util::GzipIndex> index) {
+        GetIndexCache()->Put(key, std::move(index));
+      });
+}
+
+util::Source* Source::Uncompressed(ReadonlyFile* file, uint64 offset, uint64 length) {
+  return DetectCompression(new Source(file, offset, length));
+}
+
+util::Source* Source::DetectCompression(Source* first) {
   if (util::ZStdSource::HasValidHeader(first))
     return new util::ZStdSource(first);
 
@@ -50,6 +165,38 @@ util::Source* Source::Uncompressed(ReadonlyFile* file) {
   return first;
 }
 
+util::Status ReadZStdSeekTable(ReadonlyFile* file, util::ZStdSeekTable* table) {
+  using util::ZStdSeekTable;
+
+  *table = ZStdSeekTable{};
+  size_t file_size = file->Size();
+  if (file_size < ZStdSeekTable::FOOTER_SIZE)
+    return Status::OK;
+
+  uint8 footer[ZStdSeekTable::FOOTER_SIZE];
+  auto res =
+      file->Read(file_size - sizeof(footer), strings::MutableByteRange(footer, sizeof(footer)));
+  if (!res.ok())
+    return res.status;
+  if (res.obj != sizeof(footer))
+    return Status(util::StatusCode::IO_ERROR, "Short read");
+
+  size_t table_size = ZStdSeekTable::TableSize(strings::ByteRange(footer, sizeof(footer)));
+  if (table_size == 0)
+    return Status::OK;
+  if (table_size > file_size)
+    return Status(util::StatusCode::PARSE_ERROR, "Invalid zstd seek table");
+
+  std::unique_ptr<uint8[]> buf(new uint8[table_size]);
+  res = file->Read(file_size - table_size, strings::MutableByteRange(buf.get(), table_size));
+  if (!res.ok())
+    return res.status;
+  if (res.obj != table_size)
+    return Status(util::StatusCode::IO_ERROR, "Short read");
+
+  return table->Parse(strings::ByteRange(buf.get(), table_size));
+}
+
 Sink::~Sink() {
   if (ownership_ == TAKE_OWNERSHIP)
     CHECK(file_->Close());
@@ -59,6 +206,10 @@ util::Status Sink::Append(const strings::ByteRange& slice) {
   return file_->Write(slice.data(), slice.size());
 }
 
+util::Status Sink::AppendV(absl::Span<const strings::ByteRange> slices) {
+  return file_->WriteV(slices);
+}
+
 
 void LineReader::Init(uint32_t buf_log) {
   CHECK(buf_log > 10 && buf_log < 28) << buf_log;
@@ -69,11 +220,33 @@ void LineReader::Init(uint32_t buf_log) {
   *next_ = '\n';
 }
 
-LineReader::LineReader(const std::string& fl) : ownership_(TAKE_OWNERSHIP) {
+static ReadonlyFile* OpenOrDie(const std::string& fl) {
   auto res = ReadonlyFile::Open(fl);
   CHECK(res.ok()) << fl << res.status;
+  return res.obj;
+}
 
-  source_ = file::Source::Uncompressed(res.obj);
+LineReader::LineReader(const std::string& fl) : LineReader(OpenOrDie(fl), fl) {}
+
+LineReader::LineReader(ReadonlyFile* file, const std::string& name, SourceWrapper wrapper,
+                       util::fibers_ext::FiberQueueThreadPool* pool)
+    : ownership_(TAKE_OWNERSHIP) {
+  source_ = file::Source::UncompressedIndexed(file, name, pool);
+
+  // Uncompressed files are returned as is. source_ still owns the file.
+  if (file->SupportsReadView() && dynamic_cast<file::Source*>(source_)) {
+    auto res = file->ReadView(0, file->Size());
+    if (res.ok()) {
+      view_ = res.obj;
+      use_view_ = true;
+    }
+  }
+
+  // ParallelGzipSource already inflates in the pool. Reading it from the pool threads
+  // could also deadlock them.
+  if (!use_view_ && wrapper && !dynamic_cast<util::ParallelGzipSource*>(source_)) {
+    source_ = wrapper(source_);
+  }
 
   Init(DEFAULT_BUF_LOG);
 }
@@ -84,7 +257,29 @@ LineReader::~LineReader() {
   }
 }
 
+bool LineReader::NextView(StringPiece* result) {
+  if (view_.empty()) {
+    line_num_ |= kEofMask;
+    return false;
+  }
+
+  const char* start = strings::charptr(view_.data());
+  const char* eol = reinterpret_cast<const char*>(memchr(start, '\n', view_.size()));
+  size_t len = eol ? eol - start : view_.size();
+  view_.advance(eol ? len + 1 : len);
+
+  if (eol && len > 0 && start[len - 1] == '\r')
+    --len;
+  *result = StringPiece(start, len);
+  ++line_num_;
+
+  return true;
+}
+
 bool LineReader::Next(StringPiece* result, std::string* scratch) {
+  if (use_view_)
+    return NextView(result);
+
   bool use_scratch = false;
 
   const char* const eof_page = buf_.get() + page_size_ - 1;
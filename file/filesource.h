@@ -11,6 +11,14 @@
 #include "strings/stringpiece.h"
 #include "util/sinksource.h"
 
+namespace util {
+class ZStdSeekTable;
+
+namespace fibers_ext {
+class FiberQueueThreadPool;
+}  // namespace fibers_ext
+}  // namespace util
+
 namespace file {
 class ReadonlyFile;
 class WriteFile;
@@ -18,26 +26,51 @@ class WriteFile;
 class Source : public util::Source {
  public:
   // File must be open for reading. Source takes ownership over it.
-  Source(ReadonlyFile* file);
+  // Reads length bytes starting from offset.
+  Source(ReadonlyFile* file, uint64 offset = 0, uint64 length = kuint64max);
   ~Source();
 
 
   // Returns the source wrapping the file. If the file is compressed, than the stream
   // automatically inflates the compressed data. The returned source owns the file object.
-  static util::Source* Uncompressed(ReadonlyFile* file);
+  // offset and length allow reading a part of the file, for example the frames of
+  // a zstd seekable file, see ReadZStdSeekTable.
+  static util::Source* Uncompressed(ReadonlyFile* file, uint64 offset = 0,
+                                    uint64 length = kuint64max);
+
+  // Similar to Uncompressed() but large gzip files are inflated in pool ahead of the reader,
+  // see util::ParallelGzipSource. The first read of a file builds its index while inflating
+  // it sequentially, and the subsequent reads of the same name inflate it in parallel using
+  // the index. Indices are cached in memory for the lifetime of the process.
+  // The file is still read by the calling fiber. If pool is null, same as Uncompressed().
+  // Indexing costs the first read extra CPU, so it suits only the callers that read the same
+  // files again.
+  static util::Source* UncompressedIndexed(ReadonlyFile* file, const std::string& name,
+                                           util::fibers_ext::FiberQueueThreadPool* pool);
  private:
+  // Wraps first with the decompressing source that matches its header.
+  static util::Source* DetectCompression(Source* first);
+
   util::StatusObject<size_t> ReadInternal(const strings::MutableByteRange& range) override;
+  util::StatusObject<size_t> ReadInternalV(
+      absl::Span<const strings::MutableByteRange> ranges) override;
 
   std::unique_ptr<ReadonlyFile> file_;
-  uint64 offset_ = 0;
+  uint64 offset_ = 0, end_;
 };
 
+// Reads the seek table of zstd seekable file. Returns an empty table if the file is not seekable.
+// Frames of the seekable file can be decoded independently, hence it can be split
+// into ranges that are read in parallel.
+util::Status ReadZStdSeekTable(ReadonlyFile* file, util::ZStdSeekTable* table);
+
 class Sink : public util::Sink {
 public:
   // file must be open for writing.
   Sink(WriteFile* file, Ownership ownership) : file_(file), ownership_(ownership) {}
   ~Sink();
   util::Status Append(const strings::ByteRange& slice) override;
+  util::Status AppendV(absl::Span<const strings::ByteRange> slices) override;
 
 private:
   WriteFile* file_;
@@ -57,12 +90,23 @@ public:
 
   explicit LineReader(const std::string& filename);
 
+  // Wraps the source the lines are read from and takes ownership over it.
+  typedef std::function<util::Source*(util::Source*)> SourceWrapper;
+
+  // Takes ownership over the file. If the file supports ReadView() and is not compressed,
+  // lines point directly into its mapping without copying. Such lines are read-only and
+  // are not null-terminated. If pool is set, large gzip files are inflated in it,
+  // see Source::UncompressedIndexed. Otherwise, if wrapper is set, the lines are read from
+  // the source it returns, for example from file::NewPrefetchSource.
+  LineReader(ReadonlyFile* file, const std::string& name, SourceWrapper wrapper = nullptr,
+             util::fibers_ext::FiberQueueThreadPool* pool = nullptr);
+
   ~LineReader();
 
   uint64 line_num() const { return line_num_ & (kEofMask - 1);}
 
-  // Sets the result to point to null-terminated line.
-  // Empty lines are also returned.
+  // Sets the result to point to null-terminated line, unless the lines are read from
+  // the file mapping. Empty lines are also returned.
   // Returns true if new line was found or false if end of stream was reached.
   bool Next(StringPiece* result, std::string* scratch = nullptr);
 
@@ -70,8 +114,11 @@ public:
 
 private:
   void Init(uint32_t buf_log);
+  bool NextView(StringPiece* result);
 
   util::Source* source_;
+  strings::ByteRange view_;  // The remaining part of the mapped file.
+  bool use_view_ = false;
   uint64 line_num_ = 0;   // MSB bit means EOF was reached.
   std::unique_ptr<char[]> buf_;
   char* next_, *end_;
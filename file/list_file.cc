@@ -6,11 +6,14 @@
 
 #include <crc32c/crc32c.h>
 
+#include <deque>
+
 #include "base/fixed.h"
 #include "file/compressors.h"
 #include "file/file_util.h"
 #include "file/filesource.h"
 #include "file/lst2_impl.h"
+#include "util/fibers/fiberqueue_threadpool.h"
 
 #include "base/coder.h"
 #include "base/varint.h"
@@ -26,6 +29,7 @@ namespace file {
 namespace list_file {
 
 const char kMagicString[] = "LST1";
+const char kZstdDictMetaKey[] = "__lst_zstd_dict";
 
 class BlockHeader {
   uint8 buf_[kBlockHeaderSize];
@@ -132,6 +136,12 @@ class Lst1Impl : public ListWriter::WriterImpl {
   Status AddRecord(StringPiece slice) final;
   Status Flush() final;
 
+  // Fills the rest of the current block with zeroes, so that the next record starts
+  // at the block boundary.
+  Status PadBlock();
+
+  uint32 block_offset() const { return block_offset_; }
+
  private:
   util::Status EmitPhysicalRecord(list_file::RecordType type, const uint8* ptr, size_t length);
 
@@ -164,7 +174,14 @@ Lst1Impl::Lst1Impl(util::Sink* sink, const ListWriter::Options& opts)
 
   if (opts.use_compression) {
     CompressBoundFunction bound_f = GetCompressBound(opts.compress_method);
-    compress_func_ = GetCompress(opts.compress_method);
+    if (opts.compress_method == kCompressionZstd && opts.zstd_dict) {
+      const ZstdDict* dict = opts.zstd_dict.get();
+      compress_func_ = [dict](int, const void* src, size_t len, void* dest, size_t* sz) {
+        return dict->Compress(src, len, dest, sz);
+      };
+    } else {
+      compress_func_ = GetCompress(opts.compress_method);
+    }
     CHECK(bound_f && compress_func_);
     compress_buf_size_ = bound_f(block_size_);
 
@@ -172,7 +189,8 @@ Lst1Impl::Lst1Impl(util::Sink* sink, const ListWriter::Options& opts)
   }
 
   if (opts.append) {
-    block_leftover_ = block_size_ - (opts.internal_append_offset % block_size_);
+    block_offset_ = opts.internal_append_offset % block_size_;
+    block_leftover_ = block_size_ - block_offset_;
   }
 }
 
@@ -279,6 +297,28 @@ Status Lst1Impl::AddRecord(StringPiece record) {
 
 Status Lst1Impl::Flush() { return FlushArray(); }
 
+Status Lst1Impl::PadBlock() {
+  RETURN_IF_ERROR(FlushArray());
+  if (block_offset_ == 0)
+    return Status::OK;
+
+  std::unique_ptr<uint8[]> zeroes(new uint8[block_leftover_]());
+  if (block_leftover_ <= kBlockHeaderSize) {
+    // Block trailing bytes, same as in AddRecord.
+    RETURN_IF_ERROR(dest_->Append(ByteRange(zeroes.get(), block_leftover_)));
+  } else {
+    // Readers skip the padding record like any other record.
+    size_t length = block_leftover_ - kBlockHeaderSize;
+    BlockHeader block_header(kPaddingType);
+    block_header.SetCrcAndLength(zeroes.get(), length);
+    RETURN_IF_ERROR(block_header.Write(dest_.get()));
+    RETURN_IF_ERROR(dest_->Append(ByteRange(zeroes.get(), length)));
+  }
+  block_offset_ = 0;
+  block_leftover_ = block_size_;
+  return Status::OK;
+}
+
 Status Lst1Impl::EmitPhysicalRecord(RecordType type, const uint8* ptr, size_t length) {
   DCHECK_LE(kBlockHeaderSize + length, block_leftover());
 
@@ -313,8 +353,198 @@ Status Lst1Impl::EmitPhysicalRecord(RecordType type, const uint8* ptr, size_t le
   block_leftover_ = block_size_ - block_offset_;
   return Status::OK;
 }
+// Buffers records in chunks and encodes each chunk with its own Lst1Impl in the pool.
+// Chunks that are followed by other chunks are padded to the block boundary, so their layout
+// does not depend on the compressed size of the preceding chunks.
+class ParallelLst1Impl : public ListWriter::WriterImpl {
+ public:
+  ParallelLst1Impl(util::Sink* sink, const ListWriter::Options& opts);
+  ~ParallelLst1Impl();
+
+  Status Init(const std::map<string, string>& meta) final;
+  Status AddRecord(StringPiece slice) final;
+  Status AddRecords(absl::Span<const StringPiece> records) final;
+  Status Flush() final;
+
+ private:
+  struct Chunk {
+    string data;
+    Status status;
+    uint32 records = 0;
+    uint32 end_offset = 0;  // block offset at the end of the chunk.
+    uint64 bytes = 0, savings = 0;
+    bool ready = false;     // Guarded by mu_.
+  };
+
+  // buf contains the records prefixed with their varint32 sizes.
+  static void Encode(const string& buf, ListWriter::Options opts, uint32 block_offset, bool pad,
+                     Chunk* chunk);
+
+  void AppendToBuf(StringPiece record) {
+    Varint32Encoder enc(record.size());
+    buf_.append(enc.slice().data(), enc.size()).append(record.data(), record.size());
+  }
+
+  // Hands the buffered records to the pool.
+  Status Submit(bool pad);
+
+  // Waits for the oldest chunk and writes it to dest_.
+  Status WriteFront();
+
+  string buf_;
+  std::deque<std::unique_ptr<Chunk>> pending_;
+
+  // Offset in block where the next chunk starts, when no chunks are pending.
+  uint32 block_offset_ = 0;
+
+  std::mutex mu_;
+  util::fibers_ext::EventCount ec_;
+};
+
+ParallelLst1Impl::ParallelLst1Impl(util::Sink* sink, const ListWriter::Options& opts)
+    : WriterImpl(sink, opts) {
+  CHECK_GT(opts.block_size_multiplier, 0);
+  CHECK(opts.pool) << "parallelism requires the pool";
+  if (opts.append) {
+    block_offset_ = opts.internal_append_offset % (kBlockSizeFactor * opts.block_size_multiplier);
+  }
+  buf_.reserve(options_.parallel_chunk_size);
+}
+
+ParallelLst1Impl::~ParallelLst1Impl() {
+  CHECK(Flush().ok());
+}
+
+Status ParallelLst1Impl::Init(const std::map<string, string>& meta) {
+  if (!options_.append) {
+    CHECK(!init_called_);
+    FileHeader header(options_.block_size_multiplier, meta);
+
+    RETURN_IF_ERROR(header.Write(dest_.get()));
+    init_called_ = true;
+  }
+  return Status::OK;
+}
+
+Status ParallelLst1Impl::AddRecord(StringPiece record) {
+  AppendToBuf(record);
+  if (buf_.size() >= options_.parallel_chunk_size)
+    return Submit(true);
+  return Status::OK;
+}
+
+Status ParallelLst1Impl::AddRecords(absl::Span<const StringPiece> records) {
+  for (StringPiece record : records) {
+    AppendToBuf(record);
+    if (buf_.size() >= options_.parallel_chunk_size) {
+      RETURN_IF_ERROR(Submit(true));
+    }
+  }
+  return Status::OK;
+}
+
+Status ParallelLst1Impl::Flush() {
+  // The last chunk is not padded. Its end offset is known once all the chunks are written.
+  Status st = Submit(false);
+
+  // Writes all the chunks even after an error since the pool tasks reference them.
+  while (!pending_.empty()) {
+    Status write_st = WriteFront();
+    if (st.ok())
+      st = write_st;
+  }
+  return st;
+}
+
+void ParallelLst1Impl::Encode(const string& buf, ListWriter::Options opts, uint32 block_offset,
+                              bool pad, Chunk* chunk) {
+  StringSink* sink = new StringSink;
+
+  opts.append = true;
+  opts.internal_append_offset = block_offset;
+  Lst1Impl impl(sink, opts);
+
+  const uint8* next = u8ptr(buf.data());
+  const uint8* end = next + buf.size();
+  while (next < end) {
+    uint32 sz = 0;
+    next = Varint::Parse32WithLimit(next, end, &sz);
+    CHECK(next && next + sz <= end);
+    chunk->status = impl.AddRecord(StringPiece(strings::charptr(next), sz));
+    if (!chunk->status.ok())
+      return;
+    next += sz;
+  }
+
+  chunk->status = pad ? impl.PadBlock() : impl.Flush();
+  chunk->records = impl.records_added();
+  chunk->end_offset = impl.block_offset();
+  chunk->bytes = impl.bytes_added();
+  chunk->savings = impl.compression_savings();
+  chunk->data.swap(sink->contents());
+}
+
+Status ParallelLst1Impl::Submit(bool pad) {
+  if (buf_.empty())
+    return Status::OK;
+
+  // Bounds the memory of the chunks in flight.
+  while (pending_.size() >= options_.parallelism) {
+    RETURN_IF_ERROR(WriteFront());
+  }
+
+  // Pending chunks are always padded, so the next chunk starts at the block boundary.
+  uint32 offset = pending_.empty() ? block_offset_ : 0;
+  pending_.emplace_back(new Chunk);
+  Chunk* chunk = pending_.back().get();
+
+  options_.pool->Add([this, chunk, buf = std::move(buf_), offset, pad] {
+    Encode(buf, options_, offset, pad, chunk);
+
+    // Notifies under the lock, otherwise the writer may be destroyed before we touch ec_.
+    std::lock_guard<std::mutex> lk(mu_);
+    chunk->ready = true;
+    ec_.notifyAll();
+  });
+  buf_.clear();
+  buf_.reserve(options_.parallel_chunk_size);
+
+  return Status::OK;
+}
+
+Status ParallelLst1Impl::WriteFront() {
+  std::unique_ptr<Chunk> chunk = std::move(pending_.front());
+  pending_.pop_front();
+
+  ec_.await([&] {
+    std::lock_guard<std::mutex> lk(mu_);
+    return chunk->ready;
+  });
+  RETURN_IF_ERROR(chunk->status);
+
+  records_added_ += chunk->records;
+  bytes_added_ += chunk->bytes;
+  compression_savings_ += chunk->savings;
+  block_offset_ = chunk->end_offset;
+
+  return dest_->Append(strings::ToByteRange(chunk->data));
+}
+
+ListWriter::WriterImpl* CreateLst1Impl(util::Sink* sink, const ListWriter::Options& opts) {
+  if (opts.parallelism > 0)
+    return new ParallelLst1Impl(sink, opts);
+  return new Lst1Impl(sink, opts);
+}
+
 }  // namespace
 
+Status ListWriter::WriterImpl::AddRecords(absl::Span<const StringPiece> records) {
+  for (StringPiece record : records) {
+    RETURN_IF_ERROR(AddRecord(record));
+  }
+  return Status::OK;
+}
+
 ListWriter::ListWriter(StringPiece filename, const Options& options) {
   Options opts = options;
   size_t header_offset = 0;
@@ -328,6 +558,17 @@ ListWriter::ListWriter(StringPiece filename, const Options& options) {
       if (parser.Parse(status_obj.obj, &meta).ok()) {
         opts.block_size_multiplier = parser.block_multiplier();
         header_offset = parser.offset();
+
+        // The header is not rewritten, so the records must use the dictionary of the file.
+        auto it = meta.find(kZstdDictMetaKey);
+        if (it == meta.end()) {
+          LOG_IF(WARNING, opts.zstd_dict) << "Ignoring zstd dictionary, " << filename
+                                          << " was written without it";
+          opts.zstd_dict.reset();
+        } else if (opts.compress_method == kCompressionZstd) {
+          int level = std::max(1, int(opts.compress_level));
+          opts.zstd_dict = std::make_shared<ZstdDict>(it->second, level);
+        }
         file_offset = status_obj.obj->Size();
 
         CHECK_GE(file_offset, header_offset);
@@ -343,21 +584,30 @@ ListWriter::ListWriter(StringPiece filename, const Options& options) {
   open_options.append = opts.append;
   WriteFile* file = file::Open(filename, open_options);
 
-  impl_.reset(new Lst1Impl(new Sink(file, TAKE_OWNERSHIP), opts));
+  impl_.reset(CreateLst1Impl(new Sink(file, TAKE_OWNERSHIP), opts));
 }
 
 ListWriter::ListWriter(util::Sink* dest, const Options& options) {
   if (options.v2) {
     impl_.reset(new lst2::Lst2Impl(dest, options));
   } else {
-    impl_.reset(new Lst1Impl(dest, options));
+    impl_.reset(CreateLst1Impl(dest, options));
   }
 }
 
 // Adds user provided meta information about the file. Must be called before Init.
 void ListWriter::AddMeta(StringPiece key, StringPiece value) {
   CHECK(!impl_->init_called());
+  CHECK_NE(key, kZstdDictMetaKey) << "Reserved meta key";
   meta_[AsString(key)] = AsString(value);
 }
 
+Status ListWriter::Init() {
+  const Options& opts = impl_->options();
+  if (opts.use_compression && opts.compress_method == kCompressionZstd && opts.zstd_dict) {
+    meta_[kZstdDictMetaKey] = opts.zstd_dict->data();
+  }
+  return impl_->Init(meta_);
+}
+
 }  // namespace file
@@ -7,14 +7,24 @@
 
 #include <functional>
 #include <map>
+#include <memory>
 
+#include "absl/types/span.h"
 #include "file/list_file_format.h"
 #include "file/file.h"
 #include "strings/slice.h"
 #include "util/sinksource.h"
 
+namespace util {
+namespace fibers_ext {
+class FiberQueueThreadPool;
+}  // namespace fibers_ext
+}  // namespace util
+
 namespace file {
 
+class ZstdDict;
+
 class ListWriter {
  public:
   struct Options {
@@ -25,6 +35,23 @@ class ListWriter {
     bool append = false;
     bool v2 = false;
 
+    // If positive, records are buffered in chunks of parallel_chunk_size bytes that are
+    // encoded and compressed in pool and written in order. At most parallelism chunks are
+    // in flight. Each chunk starts at a block boundary, hence all but the last chunk end with
+    // a padding record. Supported by LST1 only.
+    // Such files are not readable by the readers that predate list_file::kPaddingType,
+    // which report the padding as a corruption.
+    // The writer blocks on the pool, so it must not be used from the pool threads.
+    unsigned parallelism = 0;
+    uint32 parallel_chunk_size = 1 << 22;
+    util::fibers_ext::FiberQueueThreadPool* pool = nullptr;
+
+    // Optional dictionary for kCompressionZstd, see ZstdDict::Train. It must be created
+    // with a positive compression level. The dictionary is stored once in the meta block of the
+    // file. When appending to an existing file, the dictionary of the file is used instead and
+    // if the file has none, records are compressed without a dictionary.
+    std::shared_ptr<const ZstdDict> zstd_dict;
+
     Options() {}
 
     size_t internal_append_offset = 0;
@@ -39,10 +66,15 @@ class ListWriter {
   // Adds user provided meta information about the file. Must be called before Init.
   void AddMeta(StringPiece key, StringPiece value);
 
-  util::Status Init() { return impl_->Init(meta_); }
+  util::Status Init();
 
   util::Status AddRecord(StringPiece slice) { return impl_->AddRecord(slice); }
 
+  // Adds a batch of records, which is cheaper than adding them one by one.
+  util::Status AddRecords(absl::Span<const StringPiece> records) {
+    return impl_->AddRecords(records);
+  }
+
   util::Status Flush() { return impl_->Flush(); }
 
   uint32 records_added() const { return impl_->records_added(); }
@@ -59,6 +91,8 @@ class ListWriter {
     virtual util::Status AddRecord(StringPiece slice) = 0;
     virtual util::Status Flush() = 0;
 
+    virtual util::Status AddRecords(absl::Span<const StringPiece> records);
+
     uint32 records_added() const { return records_added_; }
     uint64 bytes_added() const { return bytes_added_; }
     uint64 compression_savings() const { return compression_savings_; }
@@ -25,7 +25,12 @@ enum RecordType {
   kFirstType = 2,
   kMiddleType = 3,
   kArrayType = 4,
-  kLastType = 5
+  kLastType = 5,
+
+  // A record of zeroes that pads the rest of the block, see ListWriter::Options::parallelism.
+  // It breaks the format for readers that predate it: they report each padded block as
+  // corrupted, which is fatal for their mr inputs.
+  kPaddingType = 15
 };
 constexpr uint8 kMaxRecordType = kLastType;
 
@@ -36,7 +41,8 @@ constexpr uint8 kCompressedMask = 0x10;
 enum CompressMethod : uint8_t {
   kCompressionNone = 0,
   kCompressionZlib = 2,
-  kCompressionLZ4 = 3
+  kCompressionLZ4 = 3,
+  kCompressionZstd = 4,
 };
 
 // The file header is:
@@ -63,6 +69,10 @@ constexpr uint32 kArrayRecordMaxHeaderSize = 5 /*Varint::kMax32*/ + kBlockHeader
 
 extern const char kMagicString[];
 
+// Meta key under which the writer stores the zstd dictionary of kCompressionZstd files.
+// The key is reserved and is not returned by ListReader::GetMetaData.
+extern const char kZstdDictMetaKey[];
+
 class HeaderParser {
   unsigned offset_ = 0;
   unsigned block_multiplier_ = 0;
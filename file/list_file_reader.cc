@@ -40,11 +40,17 @@ class Lst1Impl : public ListReader::FormatImpl {
   // Return type, or one of the preceding special values
   unsigned int ReadPhysicalRecord(StringPiece* result);
 
+  // Points block_buffer_ to the next block. Mapped files are not copied.
+  Status ReadBlock();
+
   // 'size' is size of the compressed blob.
   // Returns true if succeeded. In that case uncompress_buf_ will contain the uncompressed data
   // and size will be updated to the uncompressed size.
   bool Uncompress(const uint8* data_ptr, uint32* size);
 
+  // Set if the file was written with kCompressionZstd and a dictionary.
+  std::unique_ptr<ZstdDict> zstd_dict_;
+
   // Extend record types with the following special values
   enum {
     kEof = list_file::kMaxRecordType + 1,
@@ -66,6 +72,12 @@ bool Lst1Impl::ReadHeader(std::map<std::string, std::string>* dest) {
     return false;
   }
 
+  auto it = dest->find(list_file::kZstdDictMetaKey);
+  if (it != dest->end()) {
+    zstd_dict_.reset(new ZstdDict(std::move(it->second)));
+    dest->erase(it);
+  }
+
   file_offset_ = wrapper_->read_header_bytes = parser.offset();
   wrapper_->block_size = parser.block_multiplier() * list_file::kBlockSizeFactor;
 
@@ -187,21 +199,35 @@ bool Lst1Impl::ReadRecord(StringPiece* record, std::string* scratch) {
   return true;
 }
 
+Status Lst1Impl::ReadBlock() {
+  ReadonlyFile* file = wrapper_->file;
+  if (file->SupportsReadView()) {
+    auto res = file->ReadView(file_offset_, wrapper_->block_size);
+    if (res.ok())
+      block_buffer_ = res.obj;
+    return res.status;
+  }
+
+  strings::MutableByteRange mbr(backing_store_.get(), wrapper_->block_size);
+  auto res = file->Read(file_offset_, mbr);
+  if (res.ok())
+    block_buffer_.reset(backing_store_.get(), res.obj);
+  return res.status;
+}
+
 unsigned int Lst1Impl::ReadPhysicalRecord(StringPiece* result) {
   using list_file::kBlockHeaderSize;
   while (true) {
     if (block_buffer_.size() <= kBlockHeaderSize) {
       if (!wrapper_->eof) {
         size_t fsize = wrapper_->file->Size();
-        strings::MutableByteRange mbr(backing_store_.get(), wrapper_->block_size);
-        auto res = wrapper_->file->Read(file_offset_, mbr);
-        VLOG(2) << "read_size: " << res.obj << ", status: " << res.status;
-        if (!res.ok()) {
-          wrapper_->ReportDrop(res.obj, res.status);
+        Status st = ReadBlock();
+        VLOG(2) << "read_size: " << block_buffer_.size() << ", status: " << st;
+        if (!st.ok()) {
+          wrapper_->ReportDrop(0, st);
           wrapper_->eof = true;
           return kEof;
         }
-        block_buffer_.reset(backing_store_.get(), res.obj);
         file_offset_ += block_buffer_.size();
         if (file_offset_ >= fsize) {
           wrapper_->eof = true;
@@ -264,6 +290,9 @@ unsigned int Lst1Impl::ReadPhysicalRecord(StringPiece* result) {
     uint32 record_size = length + kBlockHeaderSize;
     block_buffer_.advance(record_size);
 
+    if (type == list_file::kPaddingType)
+      continue;
+
     if (type & list_file::kCompressedMask) {
       if (!Uncompress(data_ptr, &length)) {
         wrapper_->ReportCorruption(record_size, "Uncompress failed.");
@@ -283,7 +312,15 @@ bool Lst1Impl::Uncompress(const uint8* data_ptr, uint32* size) {
 
   uint32 inp_sz = *size - 1;
 
-  UncompressFunction uncompr_func = GetUncompress(list_file::CompressMethod(method));
+  UncompressFunction uncompr_func;
+  if (method == list_file::kCompressionZstd && zstd_dict_) {
+    const ZstdDict* dict = zstd_dict_.get();
+    uncompr_func = [dict](const void* src, size_t len, void* dest, size_t* sz) {
+      return dict->Uncompress(src, len, dest, sz);
+    };
+  } else {
+    uncompr_func = GetUncompress(list_file::CompressMethod(method));
+  }
 
   if (!uncompr_func) {
     LOG(ERROR) << "Could not find uncompress method " << int(method);
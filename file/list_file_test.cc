@@ -14,6 +14,9 @@
 #include "base/fixed.h"
 #include "base/crc32c.h"
 #include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "file/compressors.h"
+#include "util/fibers/fiberqueue_threadpool.h"
 
 namespace file {
 
@@ -512,6 +515,88 @@ TEST_F(LogTest, Zlib) {
   ASSERT_EQ(BigString("foo", 1000), Read());
 }
 
+TEST_F(LogTest, Zstd) {
+  vector<string> records;
+  vector<StringPiece> samples;
+  for (int i = 0; i < 3000; ++i) {
+    records.push_back(absl::StrCat("{\"id\": ", i, ", \"name\": \"user", i % 97,
+                                   "\", \"tags\": [\"foo\", \"bar\"]}"));
+    samples.push_back(records.back());
+  }
+  string dict = ZstdDict::Train(samples, 4096);
+  ASSERT_FALSE(dict.empty());
+
+  ListWriter::Options options;
+  options.use_compression = true;
+  options.compress_method = kCompressionZstd;
+  options.compress_level = 3;
+  options.zstd_dict = std::make_shared<ZstdDict>(dict, options.compress_level);
+  SetupWriter(options, false);
+  writer_->AddMeta("key", "val");
+  ASSERT_TRUE(writer_->Init().ok());
+
+  for (const auto& r : records)
+    Write(r);
+  Write(BigString("foo", 3 * block_size_));
+  FlushWriter();
+  EXPECT_GT(writer_->compression_savings(), 0);
+
+  for (const auto& r : records) {
+    ASSERT_EQ(r, Read());
+  }
+  ASSERT_EQ(BigString("foo", 3 * block_size_), Read());
+  ASSERT_EQ("EOF", Read());
+  EXPECT_EQ(0, DroppedBytes());
+
+  std::map<string, string> meta;
+  ASSERT_TRUE(reader_->GetMetaData(&meta));
+  EXPECT_EQ(1, meta.size());
+  EXPECT_EQ("val", meta["key"]);
+}
+
+TEST_F(LogTest, Parallel) {
+  util::fibers_ext::FiberQueueThreadPool pool(3);
+  ListWriter::Options options;
+  options.block_size_multiplier = 1;
+  options.use_compression = true;
+  options.parallelism = 3;
+  options.parallel_chunk_size = 100000;
+  options.pool = &pool;
+  SetupWriter(options);
+
+  vector<string> expected;
+  vector<StringPiece> batch;
+  for (int i = 0; i < 5000; ++i) {
+    expected.push_back(RandomSkewedString(i));
+    if (i % 100 == 0) {
+      expected.push_back(BigString(NumberString(i), 3 * block_size_ / 2));
+    }
+  }
+  for (size_t i = 0; i < expected.size(); ++i) {
+    if (i % 3) {
+      batch.push_back(expected[i]);
+    } else {
+      ASSERT_TRUE(writer_->AddRecords(batch).ok());
+      batch.clear();
+      Write(expected[i]);
+    }
+    if (i == expected.size() / 2) {
+      ASSERT_TRUE(writer_->AddRecords(batch).ok());
+      batch.clear();
+      ASSERT_TRUE(writer_->Flush().ok());  // The chunks continue from the middle of the block.
+    }
+  }
+  ASSERT_TRUE(writer_->AddRecords(batch).ok());
+  FlushWriter();
+  EXPECT_EQ(expected.size(), writer_->records_added());
+
+  for (const auto& record : expected) {
+    ASSERT_EQ(record, Read());
+  }
+  ASSERT_EQ("EOF", Read());
+  EXPECT_EQ(0, DroppedBytes());
+}
+
 TEST_F(LogTest, MetaData) {
   SetupWriter(ListWriter::Options(), false);
   string kMetaVal1 = "data1";
@@ -584,6 +669,76 @@ TEST_F(LogTest, Append) {
   EXPECT_THAT(results, ElementsAre("Foo", "Bar", "Roman", "R1"));
 }
 
+TEST_F(LogTest, AppendZstdDict) {
+  string file_name = file_util::TempFile::TempFilename("/tmp");
+  vector<StringPiece> samples;
+  vector<string> records;
+  for (int i = 0; i < 1000; ++i) {
+    records.push_back(absl::StrCat("{\"id\": ", i, ", \"name\": \"user", i % 97, "\"}"));
+    samples.push_back(records.back());
+  }
+  string dict = ZstdDict::Train(samples, 4096);
+  ASSERT_FALSE(dict.empty());
+
+  ListWriter::Options opts;
+  opts.compress_method = kCompressionZstd;
+  opts.compress_level = 3;
+  std::unique_ptr<ListWriter> writer(new ListWriter(file_name, opts));
+  ASSERT_TRUE(writer->Init().ok());
+  for (size_t i = 0; i < records.size() / 2; ++i) {
+    ASSERT_TRUE(writer->AddRecord(records[i]).ok());
+  }
+  ASSERT_TRUE(writer->Flush().ok());
+
+  // The file has no dictionary, hence the appended records must not use it.
+  opts.append = true;
+  opts.zstd_dict = std::make_shared<ZstdDict>(dict, opts.compress_level);
+  writer.reset(new ListWriter(file_name, opts));
+  ASSERT_TRUE(writer->Init().ok());
+  for (size_t i = records.size() / 2; i < records.size(); ++i) {
+    ASSERT_TRUE(writer->AddRecord(records[i]).ok());
+  }
+  ASSERT_TRUE(writer->Flush().ok());
+  writer.reset();
+
+  ListReader reader(file_name);
+  string buf;
+  StringPiece record;
+  vector<string> results;
+  while (reader.ReadRecord(&record, &buf)) {
+    results.push_back(AsString(record));
+  }
+  EXPECT_EQ(records, results);
+}
+
+TEST_F(LogTest, Mmap) {
+  string file_name = file_util::TempFile::TempFilename("/tmp");
+
+  std::unique_ptr<ListWriter> writer(new ListWriter(file_name));
+  ASSERT_TRUE(writer->Init().ok());
+  for (unsigned i = 0; i < 10000; ++i) {
+    ASSERT_TRUE(writer->AddRecord(BigString(std::to_string(i), i % 500)).ok());
+  }
+  ASSERT_TRUE(writer->Flush().ok());
+  writer.reset();
+
+  ReadonlyFile::Options opts;
+  opts.use_mmap = true;
+  auto res = ReadonlyFile::Open(file_name, opts);
+  ASSERT_TRUE(res.ok()) << res.status;
+  ASSERT_TRUE(res.obj->SupportsReadView());
+
+  ListReader reader(res.obj, TAKE_OWNERSHIP, true /* checksum */);
+  string buf;
+  StringPiece record;
+  unsigned index = 0;
+  while (reader.ReadRecord(&record, &buf)) {
+    ASSERT_EQ(BigString(std::to_string(index), index % 500), record) << index;
+    ++index;
+  }
+  EXPECT_EQ(10000, index);
+}
+
 /*TEST_F(LogTest, ReadStart) {
   CheckInitialOffsetRecord(0, 0);
 }
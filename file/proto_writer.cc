@@ -7,9 +7,11 @@
 #include <unordered_set>
 #include <vector>
 
+#include "base/logging.h"
 #include "file/filesource.h"
 #include "file/list_file.h"
 #include "strings/stringprintf.h"
+#include "util/fibers/fiberqueue_threadpool.h"
 
 using std::string;
 using util::Status;
@@ -27,6 +29,8 @@ inline list_file::CompressMethod CompressType(ListProtoWriter::Options::Compress
   switch (m) {
     case ListProtoWriter::Options::LZ4_COMPRESS:
       return list_file::kCompressionLZ4;
+    case ListProtoWriter::Options::ZSTD_COMPRESS:
+      return list_file::kCompressionZstd;
     default:;
   }
   return list_file::kCompressionZlib;
@@ -42,7 +46,10 @@ ListWriter::Options GetListOptions(const ListProtoWriter::Options& src) {
   res.block_size_multiplier = 4;
   res.compress_method = CompressType(src.compress_method);
   res.compress_level = src.compress_level;
+  res.zstd_dict = src.zstd_dict;
   res.append = src.append;
+  res.parallelism = src.parallelism;
+  res.pool = src.pool;
   return res;
 }
 
@@ -56,6 +63,7 @@ BaseProtoWriter::BaseProtoWriter(const gpb::Descriptor* dscr)
 ListProtoWriter::ListProtoWriter(StringPiece filename, const ::google::protobuf::Descriptor* dscr,
                                  const Options& options)
     : BaseProtoWriter(dscr), options_(options) {
+  CHECK(!options_.close_pool || options_.close_pool != options_.pool);
   string file_name_buf;
   if (options_.max_entries_per_file > 0) {
     base_name_ = strings::AsString(filename);
@@ -66,29 +74,44 @@ ListProtoWriter::ListProtoWriter(StringPiece filename, const ::google::protobuf:
 }
 
 ListProtoWriter::~ListProtoWriter() {
+  Status st = WaitForClose();
+  LOG_IF(ERROR, !st.ok()) << "Failed to close the previous shard " << st;
   if (writer_)
     writer_->Flush();
 }
 
 util::Status ListProtoWriter::Add(const ::google::protobuf::MessageLite& msg) {
-  CHECK(writer_);
   CHECK_EQ(dscr_->full_name(), msg.GetTypeName());
+  const gpb::MessageLite* ptr = &msg;
+  return AddBatch(absl::MakeConstSpan(&ptr, 1));
+}
+
+util::Status ListProtoWriter::AddBatch(absl::Span<const gpb::MessageLite* const> msgs) {
+  CHECK(writer_);
   if (!was_init_) {
     RETURN_IF_ERROR(writer_->Init());
     was_init_ = true;
   }
 
-  if (options_.max_entries_per_file > 0 && ++entries_per_shard_ > options_.max_entries_per_file) {
-    RETURN_IF_ERROR(writer_->Flush());
+  if (options_.max_entries_per_file == 0)
+    return AddToWriter(msgs);
 
-    entries_per_shard_ = 0;
-    CreateWriter(GetOutputFileName(base_name_, ++shard_index_));
-    RETURN_IF_ERROR(writer_->Init());
+  while (!msgs.empty()) {
+    // Shards are switched lazily, so that we do not create empty shards.
+    if (entries_per_shard_ == options_.max_entries_per_file) {
+      RETURN_IF_ERROR(NextShard());
+    }
+    size_t count = std::min<size_t>(msgs.size(),
+                                    options_.max_entries_per_file - entries_per_shard_);
+    RETURN_IF_ERROR(AddToWriter(msgs.subspan(0, count)));
+    entries_per_shard_ += count;
+    msgs.remove_prefix(count);
   }
-  return writer_->AddRecord(msg.SerializeAsString());
+  return Status::OK;
 }
 
 util::Status ListProtoWriter::Flush() {
+  RETURN_IF_ERROR(WaitForClose());
   if (writer_) {
     if (!was_init_) {
       RETURN_IF_ERROR(writer_->Init());
@@ -99,6 +122,57 @@ util::Status ListProtoWriter::Flush() {
   return Status::OK;
 }
 
+util::Status ListProtoWriter::AddToWriter(absl::Span<const gpb::MessageLite* const> msgs) {
+  // ByteSizeLong caches the sizes that are used by SerializeWithCachedSizesToArray.
+  size_t total = 0;
+  for (const gpb::MessageLite* msg : msgs) {
+    DCHECK_EQ(dscr_->full_name(), msg->GetTypeName());
+    total += msg->ByteSizeLong();
+  }
+  if (buf_.size() < total)
+    buf_.resize(total);
+
+  uint8* next = reinterpret_cast<uint8*>(&buf_[0]);
+  records_.clear();
+  for (const gpb::MessageLite* msg : msgs) {
+    uint8* end = msg->SerializeWithCachedSizesToArray(next);
+    records_.emplace_back(reinterpret_cast<const char*>(next), end - next);
+    next = end;
+  }
+  return writer_->AddRecords(records_);
+}
+
+util::Status ListProtoWriter::NextShard() {
+  RETURN_IF_ERROR(WaitForClose());
+
+  if (options_.close_pool) {
+    closing_ = true;
+    close_done_.Reset();
+
+    // The writer is destroyed in the pool as well, since it closes the file.
+    options_.close_pool->Add([this, w = std::move(writer_)]() mutable {
+      close_status_ = w->Flush();
+      w.reset();
+      close_done_.Notify();
+    });
+  } else {
+    RETURN_IF_ERROR(writer_->Flush());
+    writer_.reset();
+  }
+
+  entries_per_shard_ = 0;
+  CreateWriter(GetOutputFileName(base_name_, ++shard_index_));
+  return writer_->Init();
+}
+
+util::Status ListProtoWriter::WaitForClose() {
+  if (!closing_)
+    return Status::OK;
+  close_done_.Wait();
+  closing_ = false;
+  return close_status_;
+}
+
 void ListProtoWriter::CreateWriter(StringPiece name) {
   ListWriter::Options opts = GetListOptions(options_);
   writer_.reset(new ListWriter(name, opts));
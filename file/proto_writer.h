@@ -5,10 +5,13 @@
 #define _PROTO_WRITER_H
 
 #include <memory>
+#include <vector>
 
+#include "absl/types/span.h"
 #include "strings/stringpiece.h"
 #include "base/arena.h"
 #include "base/integral_types.h"
+#include "util/fibers/fibers_ext.h"
 #include "util/status.h"
 
 namespace google {
@@ -18,9 +21,15 @@ class MessageLite;
 }  // namespace protobuf
 }  // namespace google
 
+namespace util {
+namespace fibers_ext {
+class FiberQueueThreadPool;
+}  // namespace fibers_ext
+}  // namespace util
 
 namespace file {
 class ListWriter;
+class ZstdDict;
 
 extern const char kProtoSetKey[];
 extern const char kProtoTypeKey[];
@@ -37,16 +46,29 @@ protected:
 class ListProtoWriter : public BaseProtoWriter {
  public:
   struct Options {
-    enum CompressMethod {ZLIB_COMPRESS = 2, LZ4_COMPRESS = 3} compress_method
+    enum CompressMethod {ZLIB_COMPRESS = 2, LZ4_COMPRESS = 3, ZSTD_COMPRESS = 4} compress_method
           = LZ4_COMPRESS;
     uint8 compress_level = 1;
 
+    // Optional dictionary for ZSTD_COMPRESS, see ListWriter::Options::zstd_dict.
+    std::shared_ptr<const ZstdDict> zstd_dict;
+
     // if max_entries_per_file > 0 then
     // ProtoWriter uses filename as prefix for generating upto 10000 shards of data when each
     // contains upto max_entries_per_file entries.
     // The file name will be concatenated with "-%04d.lst" suffix for each shard.
     uint32 max_entries_per_file = 0;
 
+    // If set, a full shard is flushed and closed in close_pool while the next one is written,
+    // otherwise by the calling fiber. At most one shard is being closed at a time.
+    // Must differ from pool, since closing a shard waits for its chunks in pool.
+    util::fibers_ext::FiberQueueThreadPool* close_pool = nullptr;
+
+    // If positive, upto parallelism chunks of each shard are compressed in pool,
+    // see ListWriter::Options::parallelism.
+    unsigned parallelism = 0;
+    util::fibers_ext::FiberQueueThreadPool* pool = nullptr;
+
     // Whether to append to the existing file or otherwrite it.
     bool append = false;
 
@@ -61,11 +83,25 @@ class ListProtoWriter : public BaseProtoWriter {
 
   util::Status Add(const ::google::protobuf::MessageLite& msg);
 
+  // Serializes the batch into a single buffer and adds its records at once. Much cheaper
+  // than adding the messages one by one. The messages may be allocated on a protobuf arena,
+  // which can be reset once AddBatch returns.
+  util::Status AddBatch(absl::Span<const ::google::protobuf::MessageLite* const> msgs);
+
   util::Status Flush();
 
  private:
   void CreateWriter(StringPiece name);
 
+  // Adds msgs to the current shard.
+  util::Status AddToWriter(absl::Span<const ::google::protobuf::MessageLite* const> msgs);
+
+  // Closes the current shard, in close_pool if set, and opens the next one.
+  util::Status NextShard();
+
+  // Waits for the previous shard to close.
+  util::Status WaitForClose();
+
   std::string base_name_;
   bool was_init_ = false;
   uint32 entries_per_shard_ = 0;
@@ -73,6 +109,14 @@ class ListProtoWriter : public BaseProtoWriter {
 
   std::unique_ptr<ListWriter> writer_;
   Options options_;
+
+  std::string buf_;
+  std::vector<StringPiece> records_;
+
+  // Set while the previous shard is closed in close_pool.
+  bool closing_ = false;
+  util::Status close_status_;
+  util::fibers_ext::Done close_done_;
 };
 
 std::string GenerateSerializedFdSet(const ::google::protobuf::Descriptor* dscr);
@@ -2,13 +2,24 @@
 // Author: Roman Gershman (romange@gmail.com)
 //
 #include "file/proto_writer.h"
+
+#include <google/protobuf/arena.h>
+
 #include "file/proto_writer_test.pb.h"
 #include "base/gtest.h"
+#include "file/file_util.h"
+#include "file/list_file_reader.h"
+#include "strings/stringprintf.h"
+#include "util/fibers/fiberqueue_threadpool.h"
 
 namespace file {
 
+using std::string;
+
 class ProtoWriterTest : public ::testing::Test {
 protected:
+  // Writes 26 messages into shards of 10 entries and checks the shards.
+  void WriteBatches(ListProtoWriter::Options opts);
 };
 
 TEST_F(ProtoWriterTest, Basic) {
@@ -23,4 +34,58 @@ TEST_F(ProtoWriterTest, Empty) {
   ListProtoWriter writer("foo.lst", test::Container::descriptor());
 }
 
+void ProtoWriterTest::WriteBatches(ListProtoWriter::Options opts) {
+  string base = file_util::TempFile::TempFilename("/tmp");
+  google::protobuf::Arena arena;
+  std::vector<const google::protobuf::MessageLite*> batch;
+  for (unsigned i = 0; i < 25; ++i) {
+    test::Container* c = google::protobuf::Arena::CreateMessage<test::Container>(&arena);
+    c->mutable_person()->set_name(StringPrintf("name%u", i));
+    c->mutable_person()->set_id(i);
+    c->mutable_person()->set_dval(i);
+    batch.push_back(c);
+  }
+
+  opts.max_entries_per_file = 10;
+  {
+    ListProtoWriter writer(base, test::Container::descriptor(), opts);
+    ASSERT_TRUE(writer.AddBatch(batch).ok());
+    ASSERT_TRUE(writer.Add(*batch[0]).ok());
+    ASSERT_TRUE(writer.Flush().ok());
+  }
+  arena.Reset();
+
+  // 26 messages are split into shards of 10, 10 and 6 entries.
+  unsigned id = 0;
+  for (unsigned shard = 0; shard < 3; ++shard) {
+    string name = StringPrintf("%s-%04d.lst", base.c_str(), shard);
+    ListReader reader(name);
+    StringPiece record;
+    string scratch;
+    unsigned count = 0;
+    while (reader.ReadRecord(&record, &scratch)) {
+      test::Container c;
+      ASSERT_TRUE(c.ParseFromArray(record.data(), record.size()));
+      EXPECT_EQ(id % 25, c.person().id());
+      EXPECT_EQ(StringPrintf("name%u", id % 25), c.person().name());
+      ++id;
+      ++count;
+    }
+    EXPECT_EQ(shard < 2 ? 10 : 6, count);
+    unlink(name.c_str());
+  }
+  EXPECT_EQ(26, id);
+}
+
+TEST_F(ProtoWriterTest, Batch) {
+  WriteBatches(ListProtoWriter::Options());
+}
+
+TEST_F(ProtoWriterTest, BatchClosePool) {
+  util::fibers_ext::FiberQueueThreadPool close_pool(1);
+  ListProtoWriter::Options opts;
+  opts.close_pool = &close_pool;
+  WriteBatches(opts);
+}
+
 }  // namespace file
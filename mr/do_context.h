@@ -6,6 +6,7 @@
 #include <string>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
 
 #include "mr/mr_types.h"
 #include "mr/output.h"
@@ -21,6 +22,15 @@ template <typename Handler, typename ToType> class HandlerWrapper;
 
 void VerifyUnspecifiedSharding(const pb::Output& outp);
 
+// True if RT has SerializeTo(bool, const T&, std::string*) method.
+template <typename RT, typename T, typename = void> struct HasSerializeTo : std::false_type {};
+
+template <typename RT, typename T>
+struct HasSerializeTo<RT, T,
+                      base::void_t<decltype(std::declval<RT&>().SerializeTo(
+                          true, std::declval<const T&>(), std::declval<std::string*>()))>>
+    : std::true_type {};
+
 }  // namespace detail
 
 // User facing interfaces. void tag for dispatching per class of types
@@ -28,6 +38,11 @@ void VerifyUnspecifiedSharding(const pb::Output& outp);
 // TODO: this design is not composable.
 // i.e. I would like to be able to define serializers for basic types and easily compose more
 // complicated ones.
+//
+// Besides Serialize(), traits may define
+//   void SerializeTo(bool is_binary, const Record& r, std::string* dest);
+// that appends the serialized record to dest. DoContext prefers it over Serialize(), so that
+// records are encoded directly into the output buffer without allocating a string per record.
 template <typename Record, typename = void> struct RecordTraits {
   static_assert(sizeof(base::void_t<Record>) == 0, "Please specify RecordTraits<> for this type");
 };
@@ -52,6 +67,10 @@ class RawContext {
   template <typename T> friend class DoContext;
   friend class OperatorExecutor;
  public:
+  //! Appends a single serialized record to its argument. Does not own the callable, so that
+  //! passing a capturing lambda per record does not allocate.
+  using AppendCb = absl::FunctionRef<void(std::string*)>;
+
   //! std/absl monostate is an empty class that gives variant optional semantics.
   using InputMetaData = absl::variant<absl::monostate, int64_t, std::string>;
   using FreqMapRegistry = absl::flat_hash_map<std::string, std::unique_ptr<FrequencyMap<uint32_t>>>;
@@ -68,7 +87,7 @@ class RawContext {
   //! MR metrics - are used for monitoring, exposing statistics via http
   void IncBy(StringPiece name, long delta) { metric_map_[name] += delta; }
   void Inc(StringPiece name) { IncBy(name, 1); }
-  // const StringPieceDenseMap<long>& metric_map() const { return metric_map_; }
+  // const StringPieceFlatMap<long>& metric_map() const { return metric_map_; }
 
   // Used only in tests.
   void TEST_Write(const ShardId& shard_id, std::string&& record) {
@@ -103,10 +122,23 @@ class RawContext {
     WriteInternal(shard_id, std::move(record));
   }
 
+  void Append(const ShardId& shard_id, AppendCb cb) {
+    ++item_writes_;
+    AppendInternal(shard_id, cb);
+  }
+
   // To allow testing we mark this function as public.
   virtual void WriteInternal(const ShardId& shard_id, std::string&& record) = 0;
 
-  StringPieceDenseMap<long> metric_map_;
+  // Contexts that buffer their output may override it to let cb serialize the record directly
+  // into their buffer. By default, the record is serialized into a temporary string.
+  virtual void AppendInternal(const ShardId& shard_id, AppendCb cb) {
+    std::string record;
+    cb(&record);
+    WriteInternal(shard_id, std::move(record));
+  }
+
+  StringPieceFlatMap<long> metric_map_;
   size_t parse_errors_ = 0, item_writes_ = 0;
   std::string file_name_;
   ShardId current_shard_;
@@ -128,7 +160,7 @@ template <typename T> class DoContext {
   DoContext(const Output<T>& out, RawContext* context) : out_(out), context_(context) {}
 
   template<typename U> void Write(const ShardId& shard_id, U&& u) {
-    context_->Write(shard_id, rt_.Serialize(out_.is_binary(), std::forward<U>(u)));
+    WriteImpl(detail::HasSerializeTo<RecordTraits<T>, T>{}, shard_id, std::forward<U>(u));
   }
 
   void Write(T& t) {
@@ -152,6 +184,16 @@ template <typename T> class DoContext {
   void CloseShard(const ShardId& sid) { raw()->CloseShard(sid); }
 
  private:
+  template <typename U> void WriteImpl(std::false_type, const ShardId& shard_id, U&& u) {
+    context_->Write(shard_id, rt_.Serialize(out_.is_binary(), std::forward<U>(u)));
+  }
+
+  template <typename U> void WriteImpl(std::true_type, const ShardId& shard_id, U&& u) {
+    const T& t = u;
+    bool is_binary = out_.is_binary();
+    context_->Append(shard_id, [&](std::string* dest) { rt_.SerializeTo(is_binary, t, dest); });
+  }
+
   Output<T> out_;
   RawContext* context_;
   RecordTraits<T> rt_;
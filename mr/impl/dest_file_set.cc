@@ -26,6 +26,13 @@ namespace mr3 {
 util::VarzMapAverage5m dest_files("dest-files-set");
 
 DEFINE_uint32(gcs_connect_deadline_ms, 2000, "Deadline in milliseconds when connecting to GCS");
+DEFINE_bool(dest_direct_io, false,
+            "If true, local outputs are written with O_DIRECT and do not pollute the page cache");
+DEFINE_uint32(dest_lst_parallelism, 0, "If positive, upto that many chunks of each lst output "
+              "are compressed in parallel. The outputs then contain padding records that "
+              "binaries built before their support fail to read");
+DEFINE_uint32(dest_direct_pending_writes, 4, "Maximal number of in-flight O_DIRECT writes per "
+              "output file");
 
 namespace detail {
 
@@ -36,6 +43,7 @@ using namespace util;
 namespace {
 
 constexpr size_t kBufLimit = 1 << 16;
+constexpr size_t kCompressBatchLimit = 1 << 14;  // raw bytes passed to the compressor at once.
 
 string FileName(StringPiece base, const pb::Output& pb_out, int32 sub_shard) {
   string res(base);
@@ -85,6 +93,10 @@ class CompressHandle : public DestHandle {
 
  private:
   void Open() override;
+  void WriteCompressed(StringGenCb cb);
+
+  // Enqueues data into io_queue_ and releases lk, which must hold zmu_.
+  void Submit(string data, std::unique_lock<fibers::mutex>* lk);
   void WriteThreadLocal(uint64_t start_usec, string data);
 
   size_t start_delta_ = 0;
@@ -106,6 +118,7 @@ class LstHandle : public DestHandle {
   void Open() override;
 
   void OpenThreadLocal();
+  void AddRecordsThreadLocal(const std::vector<string>& vec);
   void CloseThreadLocal(bool abort_write);
 
   std::unique_ptr<file::ListWriter> lst_writer_;
@@ -125,7 +138,8 @@ CompressHandle::CompressHandle(DestFileSet* owner, const ShardId& sid) : DestHan
       compress_sink_.reset(new ZlibSink(compress_out_buf_, level));
     } else if (owner->output().compress().type() == pb::Output::ZSTD) {
       std::unique_ptr<ZStdSink> zsink{new ZStdSink(compress_out_buf_)};
-      CHECK_STATUS(zsink->Init(level));
+      size_t frame_size = size_t(owner->output().compress().frame_size_mb()) << 20;
+      CHECK_STATUS(zsink->Init(level, frame_size));
       compress_sink_ = std::move(zsink);
     } else {
       LOG(FATAL) << "Unsupported format " << owner->output().compress().ShortDebugString();
@@ -162,15 +176,47 @@ void CompressHandle::Open() {
 
 // CompressHandle::Write runs in "other" threads, no necessarily where we write the data into.
 void CompressHandle::Write(StringGenCb cb) {
+  if (compress_sink_) {
+    WriteCompressed(std::move(cb));
+    return;
+  }
+
   absl::optional<string> tmp_str;
   while (true) {
     tmp_str = cb();
     if (!tmp_str)
       break;
 
-    if (compress_sink_) {
-      this_fiber::yield();
+    std::unique_lock<fibers::mutex> lk(zmu_);
+    Submit(std::move(*tmp_str), &lk);
+  }
+}
+
+void CompressHandle::WriteCompressed(StringGenCb cb) {
+  // Records are compressed in batches, so that the compressor appends its output once per batch
+  // rather than once per record.
+  std::vector<string> batch;
+  std::vector<strings::ByteRange> slices;
+  size_t batch_size = 0;
+  bool more = true;
+
+  while (more) {
+    absl::optional<string> tmp_str = cb();
+    more = bool(tmp_str);
+    if (more) {
+      batch_size += tmp_str->size();
+      batch.push_back(std::move(*tmp_str));
+      if (batch_size < kCompressBatchLimit)
+        continue;
     }
+    if (batch.empty())
+      break;
+
+    this_fiber::yield();
+
+    slices.clear();
+    for (const string& str : batch)
+      slices.push_back(strings::ToByteRange(str));
 
     // We must lock both the compression and the enquing calls because the order of writing
     // compressed chunks is important and we need to preserve transactional semantics.
@@ -178,33 +224,34 @@ void CompressHandle::Write(StringGenCb cb) {
     // the system balances itself: it spends producer CPU on the compression step before
     // enqueing it into io queue that could be full.
     std::unique_lock<fibers::mutex> lk(zmu_);
+    CHECK_STATUS(compress_sink_->AppendV(slices));
+    batch.clear();
+    batch_size = 0;
 
-    if (compress_sink_) {
-      strings::ByteRange br = strings::ToByteRange(*tmp_str);
-      CHECK_STATUS(compress_sink_->Append(br));
-
-      if (start_delta_ + compress_out_buf_->contents().size() < kBufLimit)
-        continue;
+    if (start_delta_ + compress_out_buf_->contents().size() < kBufLimit)
+      continue;
 
-      tmp_str->clear();
-      tmp_str->swap(compress_out_buf_->contents());
-      start_delta_ = 0;
-    }
+    string data;
+    data.swap(compress_out_buf_->contents());
+    start_delta_ = 0;
+    Submit(std::move(data), &lk);
+  }
+}
 
-    auto start = base::GetMonotonicMicrosFast();
-    auto cb = [start, this, str = std::move(*tmp_str)]() mutable {
-      WriteThreadLocal(start, std::move(str));
-    };
+void CompressHandle::Submit(string data, std::unique_lock<fibers::mutex>* lk) {
+  auto start = base::GetMonotonicMicrosFast();
+  auto cb = [start, this, str = std::move(data)]() mutable {
+    WriteThreadLocal(start, std::move(str));
+  };
 
-    bool preempted = io_queue_->Add(std::move(cb));
-    lk.unlock();  // unlock the transaction. Must be after io_queue_->Add call.
+  bool preempted = io_queue_->Add(std::move(cb));
+  lk->unlock();  // unlock the transaction. Must be after io_queue_->Add call.
 
-    auto delta = base::GetMonotonicMicrosFast() - start;
-    if (preempted) {
-      dest_files.IncBy("io-submit-preempted", delta);
-    } else {
-      dest_files.IncBy("io-submit-fast", delta);
-    }
+  auto delta = base::GetMonotonicMicrosFast() - start;
+  if (preempted) {
+    dest_files.IncBy("io-submit-preempted", delta);
+  } else {
+    dest_files.IncBy("io-submit-fast", delta);
   }
 }
 
@@ -283,19 +330,16 @@ void LstHandle::Write(StringGenCb cb) {
       break;
     str_vec.push_back(std::move(*tmp_str));
     if (str_vec.size() >= kBufSize) {
-      io_queue_->Add([this, vec = std::move(str_vec)] {
-        for (const auto& v : vec) {
-          CHECK_STATUS(lst_writer_->AddRecord(v));
-        }
-      });
+      io_queue_->Add([this, vec = std::move(str_vec)] { AddRecordsThreadLocal(vec); });
       CHECK_EQ(str_vec.capacity(), kBufSize);  // move does not deallocate the storage.
     }
   }
-  io_queue_->Add([this, vec = std::move(str_vec)] {
-    for (const auto& v : vec) {
-      CHECK_STATUS(lst_writer_->AddRecord(v));
-    }
-  });
+  io_queue_->Add([this, vec = std::move(str_vec)] { AddRecordsThreadLocal(vec); });
+}
+
+void LstHandle::AddRecordsThreadLocal(const std::vector<string>& vec) {
+  std::vector<StringPiece> records(vec.begin(), vec.end());
+  CHECK_STATUS(lst_writer_->AddRecords(records));
 }
 
 void LstHandle::Open() {
@@ -309,7 +353,10 @@ void LstHandle::OpenThreadLocal() {
   namespace gpb = google::protobuf;
 
   util::Sink* fs = new file::Sink{write_file_, DO_NOT_TAKE_OWNERSHIP};
-  lst_writer_.reset(new file::ListWriter{fs});
+  file::ListWriter::Options opts;
+  opts.parallelism = FLAGS_dest_lst_parallelism;
+  opts.pool = owner_->compress_pool();
+  lst_writer_.reset(new file::ListWriter{fs, opts});
   if (!owner_->output().type_name().empty()) {
     lst_writer_->AddMeta(file::kProtoTypeKey, owner_->output().type_name());
 
@@ -339,6 +386,9 @@ DestFileSet::DestFileSet(const std::string& root_dir, const pb::Output& out,
                          util::IoContextPool* pool, fibers_ext::FiberQueueThreadPool* fq)
     : root_dir_(root_dir), pb_out_(out), io_pool_(*pool), fq_(*fq) {
   is_gcs_dest_ = util::IsGcsPath(root_dir_);
+  if (FLAGS_dest_lst_parallelism > 0 && pb_out_.format().type() == pb::WireFormat::LST) {
+    compress_pool_.reset(new fibers_ext::FiberQueueThreadPool);
+  }
 }
 
 DestFileSet::~DestFileSet() {
@@ -487,7 +537,10 @@ void DestHandle::OpenWriteFileLocal() {
     // writing data (i.e. Write(StringPiece) where ownership stays with owner).
     // To support asynchronous writes we need to design an abstract class AsyncWriteFile
     // which should take ownership over data chunks that are passed to it for writing.
-    write_file_ = file::Open(full_path_);
+    file::OpenOptions opts;
+    opts.direct = FLAGS_dest_direct_io;
+    opts.direct_pending_writes = FLAGS_dest_direct_pending_writes;
+    write_file_ = file::Open(full_path_, opts);
   }
   CHECK(write_file_);
 }
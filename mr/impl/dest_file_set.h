@@ -56,6 +56,10 @@ class DestFileSet {
 
   util::fibers_ext::FiberQueueThreadPool* pool() { return &fq_; }
 
+  //! Compresses the chunks of lst outputs, null unless --dest_lst_parallelism is set.
+  //! Separate from pool() since the lst handles write from pool() threads.
+  util::fibers_ext::FiberQueueThreadPool* compress_pool() { return compress_pool_.get(); }
+
   std::vector<ShardId> GetShards() const;
 
   size_t HandleCount() const;
@@ -86,6 +90,8 @@ class DestFileSet {
  private:
   typedef absl::flat_hash_map<ShardId, std::unique_ptr<DestHandle>> HandleMap;
 
+  // Declared before dest_files_ so that it outlives the handles.
+  std::unique_ptr<util::fibers_ext::FiberQueueThreadPool> compress_pool_;
   HandleMap dest_files_;
   mutable ::boost::fibers::mutex handles_mu_;
 
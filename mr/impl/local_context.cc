@@ -30,9 +30,14 @@ class BufferedWriter {
 
   void Write(string&& val);
 
+  // Lets cb serialize the record directly into the buffer.
+  void Append(RawContext::AppendCb cb);
+
  private:
   static constexpr size_t kFlushLimit = 1 << 13;
 
+  void OnWrite();
+
   void operator=(const BufferedWriter&) = delete;
 
   bool is_binary_;
@@ -80,7 +85,24 @@ void BufferedWriter::Write(string&& val) {
   } else {
     buffer_.append(val).append("\n");
   }
+  OnWrite();
+}
+
+void BufferedWriter::Append(RawContext::AppendCb cb) {
+  if (is_binary_) {
+    items_.emplace_back();
+    cb(&items_.back());
+    buffered_size_ += (items_.back().size() + 1);
+  } else {
+    size_t prev_size = buffer_.size();
+    cb(&buffer_);
+    buffer_.push_back('\n');
+    buffered_size_ += (buffer_.size() - prev_size);
+  }
+  OnWrite();
+}
 
+void BufferedWriter::OnWrite() {
   VLOG_IF(2, ++writes_ % 1000 == 0) << "BufferedWrite " << writes_;
   if (buffered_size_ >= kFlushLimit) {
     VLOG(2) << "Flush " << ++flushes_;
@@ -93,6 +115,14 @@ void BufferedWriter::Write(string&& val) {
 LocalContext::LocalContext(DestFileSet* mgr) : mgr_(mgr) { CHECK(mgr_); }
 
 void LocalContext::WriteInternal(const ShardId& shard_id, std::string&& record) {
+  GetWriter(shard_id)->Write(std::move(record));
+}
+
+void LocalContext::AppendInternal(const ShardId& shard_id, AppendCb cb) {
+  GetWriter(shard_id)->Append(cb);
+}
+
+BufferedWriter* LocalContext::GetWriter(const ShardId& shard_id) {
   DCHECK(shard_id.is_defined()) << "Undefined shard id";
   const auto* props = static_cast<IoFiberProperties*>(fibers::context::active()->get_properties());
   if (props) {
@@ -109,7 +139,7 @@ void LocalContext::WriteInternal(const ShardId& shard_id, std::string&& record)
     bool is_binary = mgr_->output().format().type() == pb::WireFormat::LST;
     it = custom_shard_files_.emplace(shard_id, new BufferedWriter{res, is_binary}).first;
   }
-  it->second->Write(std::move(record));
+  return it->second;
 }
 
 void LocalContext::Flush() {
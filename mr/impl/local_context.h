@@ -23,6 +23,9 @@ class LocalContext : public RawContext {
 
  private:
   void WriteInternal(const ShardId& shard_id, std::string&& record) final;
+  void AppendInternal(const ShardId& shard_id, AppendCb cb) final;
+
+  BufferedWriter* GetWriter(const ShardId& shard_id);
 
   absl::flat_hash_map<ShardId, BufferedWriter*> custom_shard_files_;
 
@@ -169,7 +169,7 @@ void JoinerExecutor::ProcessInputQ(detail::TableBase* tb) {
 
       SetFileName(is_binary, ii.fspec->url_glob(), raw_context.get());
       SetMetaData(*ii.fspec, raw_context.get());
-      cnt += runner_->ProcessInputFile(ii.fspec->url_glob(), ii.wf->type(), emit_cb);
+      cnt += runner_->ProcessInputFile(ii.fspec->url_glob(), *ii.wf, emit_cb);
     }
     auto start = base::GetMonotonicMicrosFast();
     handler_wrapper->OnShardFinish();
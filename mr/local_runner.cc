@@ -10,6 +10,7 @@
 #include "base/logging.h"
 #include "base/walltime.h"
 
+#include "file/block_cache.h"
 #include "file/fiber_file.h"
 #include "file/file_util.h"
 #include "file/filesource.h"
@@ -17,6 +18,7 @@
 
 #include "mr/do_context.h"
 #include "mr/impl/local_context.h"
+#include "mr/record_framer.h"
 
 #include "util/asio/io_context_pool.h"
 #include "util/fibers/fiberqueue_threadpool.h"
@@ -32,6 +34,19 @@ DEFINE_uint32(local_runner_prefetch_size, 1 << 16, "File input prefetch size");
 DEFINE_bool(local_runner_raw_shortcut_read, false,
             "If true, reads the input without parsing it "
             "into records and calling mappers. Used for testing the IO read path.");
+DEFINE_bool(local_runner_mmap_inputs, false,
+            "If true, memory-maps local input files. Suits hot inputs that reside in "
+            "the page cache, since uncompressed data is then parsed without copying.");
+DEFINE_bool(local_runner_block_cache, false,
+            "If true, reads the inputs via the process-wide block cache sized by "
+            "--file_block_cache_mb. Suits the pipelines that read the same inputs many times.");
+DEFINE_bool(local_runner_decompress_ahead, false,
+            "If true, local text inputs are read and decompressed ahead in the file thread pool, "
+            "while the IO fiber only splits them into lines.");
+DEFINE_bool(local_runner_gzip_index, false,
+            "If true, large gzip inputs are indexed on their first read and the following "
+            "reads of the same inputs are inflated in parallel. Suits the pipelines that read "
+            "the same inputs many times.");
 DECLARE_uint32(gcs_connect_deadline_ms);
 
 using namespace util;
@@ -59,9 +74,15 @@ struct LocalRunner::Impl {
         varz_stats_("local-runner", [this] { return GetStats(); }) {
   }
 
-  uint64_t ProcessText(const string& fname, file::ReadonlyFile* fd, RawSinkCb cb);
+  // If read_ahead is true, fd must be safe to read from fq_pool_ threads.
+  uint64_t ProcessText(const string& fname, file::ReadonlyFile* fd, bool read_ahead,
+                       RawSinkCb cb);
   uint64_t ProcessLst(file::ReadonlyFile* fd, RawSinkCb cb);
 
+  // Splits the text input into records using the framer and passes each record as a whole.
+  uint64_t ProcessFramed(const string& fname, file::ReadonlyFile* fd, bool read_ahead,
+                         RecordFramer* framer, RawSinkCb cb);
+
   /// Called from the main thread orchestrating the pipeline run.
   void Start(const pb::Operator* op);
 
@@ -71,7 +92,9 @@ struct LocalRunner::Impl {
   /// The functions below are called from IO threads.
   void ExpandGCS(absl::string_view glob, ExpandCb cb);
 
-  StatusObject<file::ReadonlyFile*> OpenLocalFile(const std::string& filename,
+  // If pool_reads is true, returns the file that is read from fq_pool_ threads rather than
+  // from the IO fibers.
+  StatusObject<file::ReadonlyFile*> OpenLocalFile(const std::string& filename, bool pool_reads,
                                                   file::FiberReadOptions::Stats* stats);
 
   StatusObject<file::ReadonlyFile*> OpenGcsFile(const std::string& filename);
@@ -90,6 +113,11 @@ struct LocalRunner::Impl {
 
   util::VarzValue::Map GetStats() const;
 
+  // The pool that inflates the indexed gzip inputs, see file::Source::UncompressedIndexed.
+  fibers_ext::FiberQueueThreadPool* gzip_index_pool() {
+    return FLAGS_local_runner_gzip_index ? &fq_pool_ : nullptr;
+  }
+
   IoContextPool* io_pool_;
   string data_dir;
   fibers_ext::FiberQueueThreadPool fq_pool_;
@@ -138,9 +166,9 @@ class LocalRunner::Impl::Source {
   Source(LocalRunner::Impl* impl, const string& fn) : impl_(impl), fname_(fn) {
   }
 
-  Status Open();
+  Status Open(pb::WireFormat::Type type);
 
-  size_t Process(pb::WireFormat::Type type, RawSinkCb cb);
+  size_t Process(const pb::WireFormat& format, RawSinkCb cb);
 
  private:
   LocalRunner::Impl* impl_;
@@ -149,18 +177,22 @@ class LocalRunner::Impl::Source {
 
   std::unique_ptr<file::ReadonlyFile> rd_file_;
   bool is_gcs_ = false;
+  bool read_ahead_ = false;
 };
 
 thread_local std::unique_ptr<LocalRunner::Impl::PerThread> LocalRunner::Impl::per_thread_;
 
-Status LocalRunner::Impl::Source::Open() {
+Status LocalRunner::Impl::Source::Open(pb::WireFormat::Type type) {
   is_gcs_ = IsGcsPath(fname_);
 
+  // GCS files are read by the IO threads, hence they can not be read ahead in the pool.
+  read_ahead_ = !is_gcs_ && type == pb::WireFormat::TXT && FLAGS_local_runner_decompress_ahead;
+
   StatusObject<file::ReadonlyFile*> fl_res;
   if (is_gcs_) {
     fl_res = impl_->OpenGcsFile(fname_);
   } else {
-    fl_res = impl_->OpenLocalFile(fname_, &stats_);
+    fl_res = impl_->OpenLocalFile(fname_, read_ahead_, &stats_);
   }
 
   if (fl_res.ok()) {
@@ -169,19 +201,25 @@ Status LocalRunner::Impl::Source::Open() {
   return fl_res.status;
 }
 
-size_t LocalRunner::Impl::Source::Process(pb::WireFormat::Type type, RawSinkCb cb) {
+size_t LocalRunner::Impl::Source::Process(const pb::WireFormat& format, RawSinkCb cb) {
   LOG(INFO) << "Processing file " << fname_;
 
   size_t cnt = 0;
-  switch (type) {
+  switch (format.type()) {
     case pb::WireFormat::TXT:
-      cnt = impl_->ProcessText(fname_, rd_file_.release(), cb);
+      if (format.has_framer()) {
+        std::unique_ptr<RecordFramer> framer(RecordFramer::Create(format.framer()));
+        CHECK(framer) << "Unknown framer " << format.framer();
+        cnt = impl_->ProcessFramed(fname_, rd_file_.release(), read_ahead_, framer.get(), cb);
+      } else {
+        cnt = impl_->ProcessText(fname_, rd_file_.release(), read_ahead_, cb);
+      }
       break;
     case pb::WireFormat::LST:
       cnt = impl_->ProcessLst(rd_file_.release(), cb);
       break;
     default:
-      LOG(FATAL) << "Not implemented " << pb::WireFormat::Type_Name(type);
+      LOG(FATAL) << "Not implemented " << pb::WireFormat::Type_Name(format.type());
       break;
   }
 
@@ -254,18 +292,22 @@ VarzValue::Map LocalRunner::Impl::GetStats() const {
   return map;
 }
 
-uint64_t LocalRunner::Impl::ProcessText(const string& fname, file::ReadonlyFile* fd, RawSinkCb cb) {
-  std::unique_ptr<util::Source> src(file::Source::Uncompressed(fd));
+uint64_t LocalRunner::Impl::ProcessText(const string& fname, file::ReadonlyFile* fd,
+                                        bool read_ahead, RawSinkCb cb) {
   uint64_t cnt = 0;
 
-  file::LineReader lr(src.release(), TAKE_OWNERSHIP);
+  file::LineReader::SourceWrapper wrapper;
+  if (read_ahead) {
+    wrapper = [this](util::Source* src) { return file::NewPrefetchSource(src, &fq_pool_); };
+  }
+  file::LineReader lr(fd, fname, std::move(wrapper), gzip_index_pool());
   StringPiece result;
   string scratch;
 
   uint64_t start = base::GetMonotonicMicrosFast();
   while (!stop_signal_.load(std::memory_order_relaxed) && lr.Next(&result, &scratch)) {
     if (!FLAGS_local_runner_raw_shortcut_read) {
-      string tmp{result};
+      RawRecord tmp = MakePaddedRecord(result);
       if (VLOG_IS_ON(1)) {
         int64_t delta = base::GetMonotonicMicrosFast() - start;
         if (delta > 5)  // Filter out uninteresting fast Next calls.
@@ -288,6 +330,66 @@ uint64_t LocalRunner::Impl::ProcessText(const string& fname, file::ReadonlyFile*
   return cnt;
 }
 
+uint64_t LocalRunner::Impl::ProcessFramed(const string& fname, file::ReadonlyFile* fd,
+                                          bool read_ahead, RecordFramer* framer, RawSinkCb cb) {
+  std::unique_ptr<util::Source> src(file::Source::UncompressedIndexed(fd, fname,
+                                                                     gzip_index_pool()));
+  if (read_ahead && !dynamic_cast<util::ParallelGzipSource*>(src.get())) {
+    src.reset(file::NewPrefetchSource(src.release(), &fq_pool_));
+  }
+
+  // [start, end) is the unconsumed input. Grows to fit the largest record.
+  size_t capacity = 1 << 17, start = 0, end = 0;
+  std::unique_ptr<char[]> buf(new char[capacity]);
+  bool eof = false;
+  uint64_t cnt = 0;
+
+  while (!stop_signal_.load(std::memory_order_relaxed)) {
+    StringPiece record;
+    size_t consumed = 0;
+    RecordFramer::Result res = RecordFramer::NEED_MORE;
+    if (start < end) {
+      res = framer->Frame(StringPiece(buf.get() + start, end - start), eof, &record, &consumed);
+    }
+
+    if (res != RecordFramer::NEED_MORE) {
+      CHECK(consumed > 0 && consumed <= end - start);
+      start += consumed;
+      if (res == RecordFramer::RECORD) {
+        cb(MakePaddedRecord(record));
+        if (++cnt % 100 == 0) {
+          this_fiber::yield();
+        }
+      }
+      continue;
+    }
+
+    if (eof)
+      break;
+
+    if (start > 0) {
+      memmove(buf.get(), buf.get() + start, end - start);
+      end -= start;
+      start = 0;
+    }
+    if (end == capacity) {
+      std::unique_ptr<char[]> tmp(new char[capacity * 2]);
+      memcpy(tmp.get(), buf.get(), end);
+      buf.swap(tmp);
+      capacity *= 2;
+    }
+
+    auto read = src->Read(strings::MutableByteRange(reinterpret_cast<uint8_t*>(buf.get()) + end,
+                                                    capacity - end));
+    CHECK_STATUS(read.status) << "Failed reading " << fname;
+    end += read.obj;
+    eof = end < capacity;
+  }
+  VLOG(1) << "ProcessFramed Read " << cnt << " records from " << fname;
+
+  return cnt;
+}
+
 uint64_t LocalRunner::Impl::ProcessLst(file::ReadonlyFile* fd, RawSinkCb cb) {
   file::ListReader::CorruptionReporter error_fn = [](size_t bytes, const util::Status& status) {
     LOG(FATAL) << "Lost " << bytes << " bytes, status: " << status;
@@ -384,19 +486,41 @@ StatusObject<file::ReadonlyFile*> LocalRunner::Impl::OpenGcsFile(const std::stri
 
   input_gcs_conn_.fetch_add(1, std::memory_order_acq_rel);
   auto pt = per_thread_.get();
-  return OpenGcsReadFile(filename, *gce_handle_, &pt->api_conn_pool.value());
+  file::ReadonlyFile::Options opts;
+  if (FLAGS_local_runner_block_cache)
+    opts.block_cache = file::BlockCache::Default();
+  return OpenGcsReadFile(filename, *gce_handle_, &pt->api_conn_pool.value(), opts);
 }
 
 StatusObject<file::ReadonlyFile*> LocalRunner::Impl::OpenLocalFile(
-    const std::string& filename, file::FiberReadOptions::Stats* stats) {
+    const std::string& filename, bool pool_reads, file::FiberReadOptions::Stats* stats) {
   if (!per_thread_) {
     per_thread_.reset(new PerThread);
   }
   CHECK(!IsGcsPath(filename));
 
+  // Page faults block the IO thread, which is fine when the input is in the page cache.
+  if (FLAGS_local_runner_mmap_inputs) {
+    file::ReadonlyFile::Options opts;
+    opts.use_mmap = true;
+    opts.huge_pages = true;
+    opts.drop_cache_on_close = false;
+    return file::ReadonlyFile::Open(filename, opts);
+  }
+
+  // Blocking reads are fine in the pool threads.
+  if (pool_reads) {
+    file::ReadonlyFile::Options opts;
+    if (FLAGS_local_runner_block_cache)
+      opts.block_cache = file::BlockCache::Default();
+    return file::ReadonlyFile::Open(filename, opts);
+  }
+
   file::FiberReadOptions opts;
   opts.prefetch_size = FLAGS_local_runner_prefetch_size;
   opts.stats = stats;
+  if (FLAGS_local_runner_block_cache)
+    opts.block_cache = file::BlockCache::Default();
 
   return file::OpenFiberReadFile(filename, &fq_pool_, opts);
 }
@@ -485,12 +609,12 @@ void LocalRunner::ExpandGlob(const std::string& glob, ExpandCb cb) {
 }
 
 // Read file and fill queue. This function must be fiber-friendly.
-size_t LocalRunner::ProcessInputFile(const std::string& filename, pb::WireFormat::Type type,
+size_t LocalRunner::ProcessInputFile(const std::string& filename, const pb::WireFormat& format,
                                      RawSinkCb cb) {
   Impl::Source src(impl_.get(), filename);
 
-  CHECK_STATUS(src.Open()) << filename;
-  size_t cnt = src.Process(type, std::move(cb));
+  CHECK_STATUS(src.Open(format.type())) << filename;
+  size_t cnt = src.Process(format, std::move(cb));
 
   return cnt;
 }
@@ -35,7 +35,7 @@ class LocalRunner : public Runner {
   void ExpandGlob(const std::string& glob, ExpandCb cb) final;
 
   // Read file and fill queue. This function must be fiber-friendly.
-  size_t ProcessInputFile(const std::string& filename, pb::WireFormat::Type type,
+  size_t ProcessInputFile(const std::string& filename, const pb::WireFormat& format,
                           RawSinkCb cb) final;
 
   void Stop();
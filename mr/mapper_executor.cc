@@ -23,8 +23,6 @@ using namespace std;
 using namespace boost;
 using namespace util;
 
-using fibers::channel_op_status;
-
 struct MapperExecutor::PerIoStruct {
   unsigned index;
   std::vector<::boost::fibers::fiber> process_fd;
@@ -67,9 +65,9 @@ void MapperExecutor::Stop() {
 
   // small race condition at the end, not important since this function called only on SIGTERM
   if (file_name_q_) {
-    file_name_q_->close();
+    file_name_q_->StartClosing();
     pool_->AwaitOnAll([&](IoContext&) {
-      if (per_io_) {  // "file_name_q_->close();"" might cause per_io be already freed.
+      if (per_io_) {  // "file_name_q_->StartClosing()" might cause per_io be already freed.
         per_io_->stop_early = true;
       }
       VLOG(1) << "StopEarly";
@@ -108,11 +106,11 @@ void MapperExecutor::Run(const std::vector<const InputBase*>& inputs, detail::Ta
   for (const auto& input : inputs) {
     PushInput(input);
 
-    if (file_name_q_->is_closed())
+    if (file_name_q_->IsClosing())
       break;
   }
 
-  file_name_q_->close();
+  file_name_q_->StartClosing();
 
   // Use AwaitFiberOnAll because Shutdown() blocks the callback.
   pool_->AwaitFiberOnAll([&](IoContext&) {
@@ -150,12 +148,8 @@ void MapperExecutor::PushInput(const InputBase* input) {
             [](const auto& l, auto& r) { return l.file_size > r.file_size; });
 
   LOG(INFO) << "Running on input " << input->msg().name() << " with " << files.size() << " files";
-  for (const auto& fl_name : files) {
-    channel_op_status st = file_name_q_->push(fl_name);
-    if (st != channel_op_status::closed) {
-      CHECK_EQ(channel_op_status::success, st);
-    }
-  }
+  // Fails to push everything only if the executor is stopped.
+  file_name_q_->PushBatch(files.begin(), files.end());
 }
 
 void MapperExecutor::IOReadFiber(detail::TableBase* tb) {
@@ -177,11 +171,9 @@ void MapperExecutor::IOReadFiber(detail::TableBase* tb) {
   VLOG(1) << "Starting MapFiber on " << tb->op().output().DebugString();
 
   while (!aux_local->stop_early) {
-    channel_op_status st = file_name_q_->pop(file_input);
-    if (st == channel_op_status::closed)
+    if (!file_name_q_->Pop(file_input))
       break;
 
-    CHECK_EQ(channel_op_status::success, st);
     const pb::Input* pb_input = file_input.input;
     bool is_binary = detail::IsBinary(pb_input->format().type());
     Record::Operand op = is_binary ? Record::BINARY_FORMAT : Record::TEXT_FORMAT;
@@ -196,8 +188,7 @@ void MapperExecutor::IOReadFiber(detail::TableBase* tb) {
       ++aux_local->records_read;
     };
 
-    cnt +=
-        runner_->ProcessInputFile(file_input.file_name, pb_input->format().type(), std::move(cb));
+    cnt += runner_->ProcessInputFile(file_input.file_name, pb_input->format(), std::move(cb));
   }
   VLOG(1) << "IOReadFiber closing after processing " << cnt << " items";
 
@@ -3,10 +3,10 @@
 //
 #pragma once
 
-#include <boost/fiber/buffered_channel.hpp>
 #include <functional>
 
 #include "mr/operator_executor.h"
+#include "util/fibers/mpmc_channel.h"
 #include "util/fibers/simple_channel.h"
 #include "util/stats/varz_value.h"
 
@@ -19,7 +19,7 @@ class MapperExecutor : public OperatorExecutor {
     size_t file_size;
     ::std::string file_name;
   };
-  using FileNameQueue = ::boost::fibers::buffered_channel<FileInput>;
+  using FileNameQueue = util::fibers_ext::MPMCChannel<FileInput>;
 
   struct Record {
     enum Operand { UNDEFINED, BINARY_FORMAT, TEXT_FORMAT, METADATA, RECORD} op = UNDEFINED;
@@ -80,6 +80,8 @@ void TableBase::ValidateGroupInputOrDie(const TableBase* other) {
 
 namespace {
 
+constexpr size_t kInitialPoolSize = 1 << 16;  // User buffer of the json parse allocator.
+
 struct ShardVisitor {
   absl::string_view base;
 
@@ -96,7 +98,7 @@ struct ShardVisitor {
 
 }  // namespace
 
-RawContext::RawContext() { metric_map_.set_empty_key(StringPiece{}); }
+RawContext::RawContext() {}
 
 RawContext::~RawContext() {}
 
@@ -129,6 +131,14 @@ void OutputBase::SetCompress(pb::Output::CompressType ct, int level) {
   }
 }
 
+void OutputBase::SetCompressFrameSize(unsigned frame_size_mb) {
+  CHECK(out_->has_compress() && out_->compress().type() == pb::Output::ZSTD)
+      << "Seekable frames require zstd compression. \n" << out_->ShortDebugString();
+  CHECK(frame_size_mb > 0 && frame_size_mb < 1024) << frame_size_mb;
+
+  out_->mutable_compress()->set_frame_size_mb(frame_size_mb);
+}
+
 void OutputBase::SetShardSpec(pb::ShardSpec::Type st, unsigned modn) {
   CHECK(!out_->has_shard_spec()) << "Must be defined only once. \n" << out_->ShortDebugString();
 
@@ -145,18 +155,43 @@ void OutputBase::FailUndefinedShard() const {
 }
 
 std::string RecordTraits<rj::Document>::Serialize(bool is_binary, const rj::Document& doc) {
+  string res;
+  SerializeTo(is_binary, doc, &res);
+  return res;
+}
+
+void RecordTraits<rj::Document>::SerializeTo(bool is_binary, const rj::Document& doc,
+                                             std::string* dest) {
   sb_.Clear();
   rj::Writer<rj::StringBuffer> writer(sb_);
   doc.Accept(writer);
 
-  return string(sb_.GetString(), sb_.GetLength());
+  dest->append(sb_.GetString(), sb_.GetLength());
 }
 
 bool RecordTraits<rj::Document>::Parse(bool is_binary, std::string&& tmp, rj::Document* res) {
   tmp_ = std::move(tmp);
 
+  // Records that did not come through the text input path, like LST records,
+  // may lack the padding.
+  if (tmp_.capacity() < tmp_.size() + kRawRecordPadding)
+    tmp_.reserve(tmp_.size() + kRawRecordPadding);
+
+  // The previous document has been destroyed by now, so its memory can be reused.
+  // If it did not fit into the user buffer, the buffer grows to the capacity it needed.
+  if (!pool_ || pool_->Capacity() > pool_buf_size_) {
+    pool_buf_size_ = pool_ ? pool_->Capacity() : kInitialPoolSize;
+    pool_.reset();
+    pool_buf_.reset(new char[pool_buf_size_]);
+    pool_.reset(new rj::MemoryPoolAllocator<>(pool_buf_.get(), pool_buf_size_));
+  } else {
+    pool_->Clear();
+  }
+  rj::Document doc(pool_.get());
+
   constexpr unsigned kFlags = rj::kParseTrailingCommasFlag | rj::kParseCommentsFlag;
-  res->ParseInsitu<kFlags>(&tmp_.front());
+  doc.ParseInsitu<kFlags>(&tmp_.front());
+  res->Swap(doc);
 
   bool has_error = res->HasParseError();
   LOG_IF(INFO, has_error) << rj::GetParseError_En(res->GetParseError()) << " for string " << tmp_;
@@ -13,6 +13,22 @@ std::string PB_Serializer::To(bool is_binary, const Message* msg) {
   return util::Pb2Json(*msg);
 }
 
+void PB_Serializer::AppendTo(bool is_binary, const Message* msg, std::string* dest) {
+  if (!is_binary) {
+    util::Pb2Json(*msg, util::Pb2JsonOptions(), dest);
+    return;
+  }
+
+  size_t sz = msg->ByteSizeLong();
+  if (sz == 0)
+    return;
+
+  size_t prev_size = dest->size();
+  dest->resize(prev_size + sz);
+  uint8_t* start = reinterpret_cast<uint8_t*>(&(*dest)[prev_size]);
+  msg->SerializeWithCachedSizesToArray(start);
+}
+
 bool PB_Serializer::From(bool is_binary, std::string tmp, Message* res) {
   if (is_binary) {
     return res->ParseFromString(tmp);
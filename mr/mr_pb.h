@@ -15,6 +15,9 @@ struct PB_Serializer {
 
   static std::string To(bool is_binary, const Message* msg);
 
+  // Appends the serialized msg to dest.
+  static void AppendTo(bool is_binary, const Message* msg, std::string* dest);
+
   // Need std::string on stack because of json2pb which requires mutable string for insitu parsing.
   static bool From(bool is_binary, std::string tmp, Message* res);
 };
@@ -27,6 +30,10 @@ class RecordTraits<PB, std::enable_if_t<std::is_base_of<google::protobuf::Messag
     return PB_Serializer::To(is_binary, &doc);
   }
 
+  static void SerializeTo(bool is_binary, const PB& doc, std::string* dest) {
+    PB_Serializer::AppendTo(is_binary, &doc, dest);
+  }
+
   static bool Parse(bool is_binary, std::string tmp, PB* res) {
     return PB_Serializer::From(is_binary, std::move(tmp), res);
   }
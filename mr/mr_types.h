@@ -18,6 +18,18 @@ using EmitMemberFn = void (Class::*)(FromType, DoContext<O>*);
 
 using RawRecord = ::std::string;
 
+// Text records are allocated with at least kRawRecordPadding bytes of capacity beyond their
+// size, so that SIMD parsers may read past their end.
+constexpr size_t kRawRecordPadding = 16;
+
+// Returns a record that holds str and satisfies the padding requirement above.
+inline RawRecord MakePaddedRecord(absl::string_view str) {
+  RawRecord res;
+  res.reserve(str.size() + kRawRecordPadding);
+  res.append(str.data(), str.size());
+  return res;
+}
+
 typedef std::function<void(RawRecord&& record)> RawSinkCb;
 
 template <typename Handler, typename ToType>
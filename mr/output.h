@@ -29,6 +29,7 @@ class OutputBase {
   OutputBase(pb::Output* out) : out_(out) {}
 
   void SetCompress(pb::Output::CompressType ct, int level);
+  void SetCompressFrameSize(unsigned frame_size_mb);
   void SetShardSpec(pb::ShardSpec::Type st, unsigned modn = 0);
   void FailUndefinedShard() const;
 };
@@ -79,6 +80,13 @@ template <typename T> class Output : public OutputBase {
 
   Output& AndCompress(pb::Output::CompressType ct, int level = -10000);
 
+  // Writes ZSTD output as independent frames of about frame_size_mb uncompressed megabytes,
+  // so that the files can be split when they are read. Must follow AndCompress(ZSTD).
+  Output& AndSeekableFrames(unsigned frame_size_mb) {
+    SetCompressFrameSize(frame_size_mb);
+    return *this;
+  }
+
   ShardId Shard(const T& t) const {
     auto res = absl::visit(Visitor{t, modn_}, shard_op_);
     if (absl::holds_alternative<absl::monostate>(res)) {
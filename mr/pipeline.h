@@ -28,6 +28,12 @@ template <typename T> class PInput : public PTable<T> {
     return *this;
   }
 
+  //! Splits text input into records by the framer registered under name, see RecordFramer.
+  PInput<T>& set_framer(const std::string& name) {
+    input_->mutable_msg()->mutable_format()->set_framer(name);
+    return *this;
+  }
+
  private:
   InputBase* input_;
 };
@@ -3,14 +3,15 @@
 //
 #pragma once
 
-// I do not enable SSE42 for rapidjson because it may go out of boundaries, they assume
-// all the inputs are aligned at the end.
-//
-// #define RAPIDJSON_SSE42
+// Release builds enable SSE4.2 (NEON on ARM) in rapidjson, see cmake/internal.cmake.
+// Its SIMD parsing may read upto 15 bytes past the end of the input, hence the json records
+// are parsed in buffers padded with kRawRecordPadding bytes.
 
 #include <rapidjson/document.h>
 #include <rapidjson/stringbuffer.h>
 
+#include <memory>
+
 #include "base/type_traits.h"
 #include "mr/do_context.h"
 #include "mr/impl/table_impl.h"
@@ -111,15 +112,25 @@ PTable<typename detail::MapperTraits<MapType>::OutputType> PTable<OutT>::Map(
   return PTable<NewOutType>{std::move(res)};
 }
 
+// Parsed documents are allocated from the pool of their parser, which is reused for each record
+// of the same MapFiber. Therefore a document is valid only until its handler returns.
+// To keep it, copy it into a document with its own allocator via CopyFrom().
 template <> class RecordTraits<rapidjson::Document> {
   std::string tmp_;
   rapidjson::StringBuffer sb_;  // Used by serialize.
 
+  // Used by parse. The allocator keeps its user buffer on Clear(), so records whose documents
+  // fit into pool_buf_ do not allocate.
+  std::unique_ptr<char[]> pool_buf_;
+  size_t pool_buf_size_ = 0;
+  std::unique_ptr<rapidjson::MemoryPoolAllocator<>> pool_;
+
  public:
   RecordTraits(const RecordTraits& r) {}  // we do not copy temporary fields.
   RecordTraits() {}
 
   std::string Serialize(bool is_binary, const rapidjson::Document& doc);
+  void SerializeTo(bool is_binary, const rapidjson::Document& doc, std::string* dest);
   bool Parse(bool is_binary, std::string&& tmp, rapidjson::Document* res);
 };
 
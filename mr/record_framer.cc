@@ -0,0 +1,186 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "mr/record_framer.h"
+
+#include <mutex>
+#include <unordered_map>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "base/logging.h"
+
+namespace mr3 {
+
+namespace {
+
+// Frames WARC records: "WARC/1.0" line, header lines, an empty line and then
+// Content-Length bytes of content. The record includes its header.
+class WarcFramer : public RecordFramer {
+ public:
+  Result Frame(StringPiece buf, bool eof, StringPiece* record, size_t* consumed) final;
+
+ private:
+  // Skips the bytes up to the beginning of the next line that may start a record.
+  static Result SkipLine(StringPiece buf, bool eof, size_t* consumed);
+};
+
+auto WarcFramer::SkipLine(StringPiece buf, bool eof, size_t* consumed) -> Result {
+  size_t pos = buf.find('\n');
+  if (pos == StringPiece::npos) {
+    if (!eof || buf.empty())
+      return NEED_MORE;
+    pos = buf.size() - 1;
+  }
+  *consumed = pos + 1;
+  return SKIP;
+}
+
+auto WarcFramer::Frame(StringPiece buf, bool eof, StringPiece* record, size_t* consumed)
+    -> Result {
+  constexpr StringPiece kMagic("WARC/");
+
+  if (buf.size() < kMagic.size() && !eof)
+    return NEED_MORE;
+  if (!absl::StartsWith(buf, kMagic))
+    return SkipLine(buf, eof, consumed);
+
+  size_t content_len = StringPiece::npos;
+  size_t line_start = buf.find('\n');
+  while (true) {
+    if (line_start == StringPiece::npos)
+      return eof ? SkipLine(buf, eof, consumed) : NEED_MORE;
+    ++line_start;
+
+    size_t line_end = buf.find('\n', line_start);
+    if (line_end == StringPiece::npos)
+      return eof ? SkipLine(buf, eof, consumed) : NEED_MORE;
+
+    StringPiece line = absl::StripTrailingAsciiWhitespace(
+        buf.substr(line_start, line_end - line_start));
+    if (line.empty())  // The end of the header.
+      break;
+
+    size_t colon = line.find(':');
+    if (colon != StringPiece::npos &&
+        absl::EqualsIgnoreCase(line.substr(0, colon), "Content-Length")) {
+      StringPiece val = absl::StripAsciiWhitespace(line.substr(colon + 1));
+      if (!absl::SimpleAtoi(val, &content_len)) {
+        LOG(WARNING) << "Bad Content-Length " << val;
+        return SkipLine(buf, eof, consumed);
+      }
+    }
+    line_start = line_end;
+  }
+
+  size_t header_end = buf.find('\n', line_start) + 1;
+  if (content_len == StringPiece::npos) {
+    LOG(WARNING) << "WARC record without Content-Length";
+    return SkipLine(buf, eof, consumed);
+  }
+
+  if (buf.size() - header_end < content_len) {
+    if (!eof)
+      return NEED_MORE;
+    LOG(WARNING) << "Truncated WARC record";
+    *consumed = buf.size();
+    return SKIP;
+  }
+
+  // The blank lines separating the records are skipped by the next calls.
+  *record = buf.substr(0, header_end + content_len);
+  *consumed = record->size();
+  return RECORD;
+}
+
+// Frames JSON objects by balancing their braces. The objects may span multiple lines and
+// may be separated by any bytes that do not contain '{'.
+class JsonFramer : public RecordFramer {
+ public:
+  Result Frame(StringPiece buf, bool eof, StringPiece* record, size_t* consumed) final;
+
+ private:
+  // The scanning state of the current object, kept between NEED_MORE calls.
+  size_t pos_ = 0;
+  unsigned depth_ = 0;
+  bool in_string_ = false, escape_ = false;
+};
+
+auto JsonFramer::Frame(StringPiece buf, bool eof, StringPiece* record, size_t* consumed)
+    -> Result {
+  if (pos_ == 0) {
+    if (buf.empty())
+      return NEED_MORE;
+    if (buf[0] != '{') {
+      size_t pos = buf.find('{');
+      *consumed = pos == StringPiece::npos ? buf.size() : pos;
+      return SKIP;
+    }
+  }
+
+  const char* data = buf.data();
+  for (; pos_ < buf.size(); ++pos_) {
+    char c = data[pos_];
+    if (in_string_) {
+      if (escape_) {
+        escape_ = false;
+      } else if (c == '\\') {
+        escape_ = true;
+      } else if (c == '"') {
+        in_string_ = false;
+      }
+      continue;
+    }
+
+    if (c == '"') {
+      in_string_ = true;
+    } else if (c == '{') {
+      ++depth_;
+    } else if (c == '}' && --depth_ == 0) {
+      *record = buf.substr(0, pos_ + 1);
+      *consumed = pos_ + 1;
+      pos_ = 0;
+      return RECORD;
+    }
+  }
+
+  if (eof) {
+    LOG(WARNING) << "Truncated JSON object of " << buf.size() << " bytes";
+    pos_ = depth_ = 0;
+    in_string_ = escape_ = false;
+  }
+  return NEED_MORE;
+}
+
+struct Registry {
+  std::mutex mu;
+  std::unordered_map<std::string, RecordFramer::Factory> factories;
+
+  Registry() {
+    factories.emplace("warc", [] { return new WarcFramer; });
+    factories.emplace("json", [] { return new JsonFramer; });
+  }
+};
+
+Registry& GetRegistry() {
+  static Registry registry;
+  return registry;
+}
+
+}  // namespace
+
+RecordFramer* RecordFramer::Create(const std::string& name) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lk(registry.mu);
+  auto it = registry.factories.find(name);
+  return it == registry.factories.end() ? nullptr : it->second();
+}
+
+void RecordFramer::Register(const std::string& name, Factory factory) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lk(registry.mu);
+  registry.factories[name] = std::move(factory);
+}
+
+}  // namespace mr3
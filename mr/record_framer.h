@@ -0,0 +1,56 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "strings/stringpiece.h"
+
+namespace mr3 {
+
+/**
+ * @brief Splits text inputs into records that may span multiple lines.
+ *
+ * Inputs declare their framer by name via PInput::set_framer(). The runner reads the input
+ * into a buffer and calls Frame() repeatedly on its unconsumed part, so that each record is
+ * delivered to the mapper as a whole rather than line by line.
+ * Framers are created per input file and may keep state between the calls.
+ */
+class RecordFramer {
+ public:
+  enum Result {
+    RECORD,     // record points to a complete record.
+    SKIP,       // consumed bytes do not belong to any record.
+    NEED_MORE,  // buf does not contain a complete record.
+  };
+
+  using Factory = std::function<RecordFramer*()>;
+
+  virtual ~RecordFramer() {}
+
+  /**
+   * @brief Finds the first record in buf.
+   *
+   * @param buf - the unconsumed part of the input.
+   * @param eof - true if buf holds the rest of the input.
+   * @param record - set to the record within buf if RECORD is returned.
+   * @param consumed - set to the number of bytes to skip before the next call
+   *                   if RECORD or SKIP is returned. Must be positive.
+   *
+   * After NEED_MORE, the next call receives the same unconsumed bytes followed by more input,
+   * hence framers may resume scanning where they stopped. If NEED_MORE is returned with eof
+   * set, the rest of the input is dropped.
+   */
+  virtual Result Frame(StringPiece buf, bool eof, StringPiece* record, size_t* consumed) = 0;
+
+  // Returns a new framer registered under name or nullptr if there is none.
+  // "warc" and "json" framers are registered by default.
+  static RecordFramer* Create(const std::string& name);
+
+  // Registers a framer factory. Should be called before the pipeline runs.
+  static void Register(const std::string& name, Factory factory);
+};
+
+}  // namespace mr3
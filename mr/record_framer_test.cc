@@ -0,0 +1,191 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "mr/record_framer.h"
+
+#include <benchmark/benchmark.h>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "base/gtest.h"
+#include "base/logging.h"
+#include "file/filesource.h"
+
+namespace mr3 {
+
+using namespace std;
+
+class RecordFramerTest : public testing::Test {
+ protected:
+  // Frames input fed in chunks of chunk_size bytes, similarly to LocalRunner.
+  static vector<string> FrameAll(const string& name, const string& input, size_t chunk_size) {
+    std::unique_ptr<RecordFramer> framer(RecordFramer::Create(name));
+    CHECK(framer);
+
+    vector<string> res;
+    size_t start = 0, end = 0;
+    while (true) {
+      bool eof = end == input.size();
+      StringPiece record;
+      size_t consumed = 0;
+      RecordFramer::Result fr = RecordFramer::NEED_MORE;
+      if (start < end) {
+        fr = framer->Frame(StringPiece(input.data() + start, end - start), eof, &record,
+                           &consumed);
+      }
+      if (fr == RecordFramer::NEED_MORE) {
+        if (eof)
+          break;
+        end = std::min(input.size(), end + chunk_size);
+        continue;
+      }
+      CHECK_GT(consumed, 0);
+      if (fr == RecordFramer::RECORD)
+        res.emplace_back(record);
+      start += consumed;
+    }
+    return res;
+  }
+};
+
+static string WarcRecord(const string& content) {
+  return absl::StrCat("WARC/1.0\r\nWARC-Type: conversion\r\nContent-Length: ", content.size(),
+                      "\r\n\r\n", content, "\r\n\r\n");
+}
+
+TEST_F(RecordFramerTest, Warc) {
+  string r1 = WarcRecord("line1\nline2\n"), r2 = WarcRecord("WARC/1.0\nfoo"),
+         r3 = WarcRecord("");
+  string input = "garbage\n" + r1 + r2 + r3;
+
+  for (size_t chunk : {1, 7, 1000}) {
+    vector<string> records = FrameAll("warc", input, chunk);
+    ASSERT_EQ(3, records.size()) << chunk;
+    EXPECT_EQ(r1.substr(0, r1.size() - 4), records[0]);
+    EXPECT_EQ(r2.substr(0, r2.size() - 4), records[1]);
+    EXPECT_EQ(r3.substr(0, r3.size() - 4), records[2]);
+  }
+
+  // Truncated record is dropped.
+  vector<string> records = FrameAll("warc", r1 + r2.substr(0, r2.size() - 6), 100);
+  ASSERT_EQ(1, records.size());
+}
+
+TEST_F(RecordFramerTest, Json) {
+  string input = R"({"a": 1}
+  {
+    "b": {"c": "}{\"}"},
+    "d": [1, 2]
+  }
+junk {"e": {}} {"f": )";
+
+  for (size_t chunk : {1, 5, 1000}) {
+    vector<string> records = FrameAll("json", input, chunk);
+    ASSERT_EQ(3, records.size()) << chunk;
+    EXPECT_EQ(R"({"a": 1})", records[0]);
+    EXPECT_EQ(R"({
+    "b": {"c": "}{\"}"},
+    "d": [1, 2]
+  })", records[1]);
+    EXPECT_EQ(R"({"e": {}})", records[2]);
+  }
+}
+
+TEST_F(RecordFramerTest, Register) {
+  EXPECT_EQ(nullptr, RecordFramer::Create("foo"));
+
+  struct LineFramer : public RecordFramer {
+    Result Frame(StringPiece buf, bool eof, StringPiece* record, size_t* consumed) final {
+      size_t pos = buf.find('\n');
+      if (pos == StringPiece::npos)
+        return NEED_MORE;
+      *record = buf.substr(0, pos);
+      *consumed = pos + 1;
+      return RECORD;
+    }
+  };
+  RecordFramer::Register("foo", [] { return new LineFramer; });
+  EXPECT_EQ(vector<string>({"a", "bc"}), FrameAll("foo", "a\nbc\n", 2));
+}
+
+static string WarcInput() {
+  string res;
+  for (unsigned i = 0; i < 200; ++i) {
+    string content;
+    for (unsigned j = 0; j < 50; ++j) {
+      absl::StrAppend(&content, "This is line ", j, " of the document number ", i, "\n");
+    }
+    res += WarcRecord(content);
+  }
+  return res;
+}
+
+static void BM_WarcFramer(benchmark::State& state) {
+  string input = WarcInput();
+  std::unique_ptr<RecordFramer> framer(RecordFramer::Create("warc"));
+
+  while (state.KeepRunning()) {
+    StringPiece buf(input);
+    while (!buf.empty()) {
+      StringPiece record;
+      size_t consumed;
+      if (framer->Frame(buf, true, &record, &consumed) == RecordFramer::RECORD) {
+        string doc(record);  // The record is passed to the mapper as a string.
+        benchmark::DoNotOptimize(doc);
+      }
+      buf.remove_prefix(consumed);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_WarcFramer);
+
+// Mimics the per-line state machine of examples/wordcount/warc_parse.cc that receives
+// each line as a separate string.
+static void BM_WarcLines(benchmark::State& state) {
+  string input = WarcInput();
+
+  while (state.KeepRunning()) {
+    file::LineReader lr(new util::StringSource(input), TAKE_OWNERSHIP);
+    enum { INIT, START, PAGE_START, PAGE_CONT } st = INIT;
+    StringPiece line;
+    string scratch, doc;
+    size_t content_len = 0;
+
+    while (lr.Next(&line, &scratch)) {
+      string str(line);
+      absl::StripAsciiWhitespace(&str);
+      switch (st) {
+        case INIT:
+          if (str == "WARC/1.0")
+            st = START;
+          break;
+        case START:
+          if (absl::StartsWith(str, "Content-Length:")) {
+            CHECK(absl::SimpleAtoi(absl::StripAsciiWhitespace(StringPiece(str).substr(15)),
+                                   &content_len));
+            st = PAGE_START;
+          }
+          break;
+        case PAGE_START:
+          st = PAGE_CONT;
+          doc.clear();
+          break;
+        case PAGE_CONT:
+          if (str == "WARC/1.0") {
+            benchmark::DoNotOptimize(doc);
+            st = START;
+          } else if (!str.empty()) {
+            doc.append(str).push_back('\n');
+          }
+          break;
+      }
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_WarcLines);
+
+}  // namespace mr3
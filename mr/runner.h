@@ -38,7 +38,7 @@ class Runner {
 
   // Read file and fill queue. This function must be fiber-friendly.
   // Returns number of records processed.
-  virtual size_t ProcessInputFile(const std::string& filename, pb::WireFormat::Type type,
+  virtual size_t ProcessInputFile(const std::string& filename, const pb::WireFormat& format,
                                   RawSinkCb cb) = 0;
 };
 
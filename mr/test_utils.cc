@@ -64,7 +64,7 @@ void TestRunner::OperatorEnd(ShardFileMap* out_files) {
 }
 
 // Read file and fill queue. This function must be fiber-friendly.
-size_t TestRunner::ProcessInputFile(const std::string& filename, pb::WireFormat::Type type,
+size_t TestRunner::ProcessInputFile(const std::string& filename, const pb::WireFormat& format,
                                     RawSinkCb cb) {
   auto it = input_fs_.find(filename);
   CHECK(it != input_fs_.end());
@@ -82,7 +82,7 @@ const ShardedOutput& TestRunner::Table(const std::string& tb_name) const {
   return it->second->s_out;
 }
 
-size_t EmptyRunner::ProcessInputFile(const std::string& filename, pb::WireFormat::Type type,
+size_t EmptyRunner::ProcessInputFile(const std::string& filename, const pb::WireFormat& format,
                                      RawSinkCb cb) {
   CHECK(gen_fn);
   string val;
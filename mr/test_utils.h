@@ -66,7 +66,7 @@ class TestRunner : public Runner {
   void ExpandGlob(const std::string& glob, ExpandCb cb) final;
 
   // Read file and fill queue. This function must be fiber-friendly.
-  size_t ProcessInputFile(const std::string& filename, pb::WireFormat::Type type,
+  size_t ProcessInputFile(const std::string& filename, const pb::WireFormat& format,
                           RawSinkCb cb) final;
 
   void OperatorStart(const pb::Operator* op) final { op_ = op; }
@@ -91,17 +91,44 @@ class EmptyRunner : public Runner {
  public:
   std::function<bool(std::string* val)> gen_fn;
 
+  // If set, the contexts let the records serialize directly into their buffer.
+  bool direct_append = true;
+
+  // Buffers the written records similarly to the local runner and discards them.
   class Context : public RawContext {
-    public:
-    void WriteInternal(const ShardId& shard_id, std::string&& record) {}
+    std::string buf_;
+    bool direct_append_;
+
+   public:
+    explicit Context(bool direct_append) : direct_append_(direct_append) {}
+
+    void WriteInternal(const ShardId& shard_id, std::string&& record) {
+      buf_.append(record).append("\n");
+      MaybeClear();
+    }
+
+    void AppendInternal(const ShardId& shard_id, AppendCb cb) {
+      if (!direct_append_)
+        return RawContext::AppendInternal(shard_id, cb);
+      cb(&buf_);
+      buf_.push_back('\n');
+      MaybeClear();
+    }
+
     void CloseShard(const ShardId& sid) {}
+
+   private:
+    void MaybeClear() {
+      if (buf_.size() >= (1 << 13))
+        buf_.clear();
+    }
   };
 
   void Init() final {}
 
   void Shutdown() final {}
 
-  RawContext* CreateContext() final { return new Context; }
+  RawContext* CreateContext() final { return new Context(direct_append); }
 
   void ExpandGlob(const std::string& glob, ExpandCb cb) final {
     cb(0, glob);
@@ -110,7 +137,7 @@ class EmptyRunner : public Runner {
   void OperatorStart(const pb::Operator* op) final {}
   void OperatorEnd(ShardFileMap* out_files) final  {}
 
-  size_t ProcessInputFile(const std::string& filename, pb::WireFormat::Type type,
+  size_t ProcessInputFile(const std::string& filename, const pb::WireFormat& format,
                           RawSinkCb cb) final;
 };
 
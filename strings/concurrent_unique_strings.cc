@@ -0,0 +1,194 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "strings/concurrent_unique_strings.h"
+
+#include <cstring>
+
+#include "base/bits.h"
+#include "base/logging.h"
+#include "strings/hash.h"
+
+namespace strings {
+
+using namespace std;
+
+constexpr uint32_t ConcurrentUniqueStrings::kInvalidId;
+
+struct ConcurrentUniqueStrings::Entry {
+  uint64_t hash;
+  uint32_t id;
+  uint32_t len;
+
+  StringPiece str() const { return StringPiece(reinterpret_cast<const char*>(this + 1), len); }
+};
+
+struct ConcurrentUniqueStrings::Table {
+  size_t mask;
+  size_t size = 0;
+  unique_ptr<atomic<const Entry*>[]> slots;
+
+  explicit Table(size_t capacity) : mask(capacity - 1), slots(new atomic<const Entry*>[capacity]) {
+    for (size_t i = 0; i < capacity; ++i)
+      slots[i].store(nullptr, memory_order_relaxed);
+  }
+
+  size_t capacity() const { return mask + 1; }
+};
+
+struct ConcurrentUniqueStrings::Stripe {
+  mutex mu;
+  base::Arena arena;
+
+  atomic<Table*> table{nullptr};
+
+  // Tables that were replaced during growth. Lock-free readers might still access them.
+  vector<unique_ptr<Table>> retired;
+
+  Stripe() { table.store(new Table(16), memory_order_relaxed); }
+  ~Stripe() { delete table.load(memory_order_relaxed); }
+};
+
+ConcurrentUniqueStrings::ConcurrentUniqueStrings() : stripes_(new Stripe[kNumStripes]) {
+  for (auto& seg : segments_)
+    seg.store(nullptr, memory_order_relaxed);
+}
+
+ConcurrentUniqueStrings::~ConcurrentUniqueStrings() {
+  for (auto& seg : segments_)
+    delete[] seg.load(memory_order_relaxed);
+}
+
+// Stripes use the high bits of the hash and tables use the low bits.
+inline static unsigned StripeIndex(uint64_t hash, unsigned stripe_bits) {
+  return hash >> (64 - stripe_bits);
+}
+
+auto ConcurrentUniqueStrings::FindInTable(const Table* table, uint64_t hash, StringPiece str)
+    -> const Entry* {
+  for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+    const Entry* e = table->slots[i].load(memory_order_acquire);
+    if (!e)
+      return nullptr;
+    if (e->hash == hash && e->str() == str)
+      return e;
+  }
+}
+
+void ConcurrentUniqueStrings::InsertToTable(Table* table, const Entry* entry) {
+  size_t i = entry->hash & table->mask;
+  while (table->slots[i].load(memory_order_relaxed)) {
+    i = (i + 1) & table->mask;
+  }
+  table->slots[i].store(entry, memory_order_release);
+  ++table->size;
+}
+
+auto ConcurrentUniqueStrings::IdSlot(uint32_t id) -> atomic<const Entry*>* {
+  uint64_t v = uint64_t(id) + (1u << kFirstSegmentBits);
+  unsigned msb = Bits::FindMSBSet64NonZero(v);
+  unsigned seg_index = msb - kFirstSegmentBits;
+  atomic<const Entry*>* seg = segments_[seg_index].load(memory_order_acquire);
+
+  if (!seg) {
+    size_t seg_size = size_t(1) << msb;
+    atomic<const Entry*>* new_seg = new atomic<const Entry*>[seg_size];
+    for (size_t i = 0; i < seg_size; ++i)
+      new_seg[i].store(nullptr, memory_order_relaxed);
+
+    // Several stripes may race on allocating the same segment.
+    if (segments_[seg_index].compare_exchange_strong(seg, new_seg, memory_order_acq_rel)) {
+      seg = new_seg;
+    } else {
+      delete[] new_seg;
+    }
+  }
+
+  return seg + (v - (uint64_t(1) << msb));
+}
+
+pair<uint32_t, bool> ConcurrentUniqueStrings::Intern(StringPiece str) {
+  uint64_t hash = StringPieceHash64{}(str);
+  Stripe& stripe = stripes_[StripeIndex(hash, kStripeBits)];
+
+  const Entry* e = FindInTable(stripe.table.load(memory_order_acquire), hash, str);
+  if (e)
+    return make_pair(e->id, false);
+
+  std::lock_guard<mutex> lk(stripe.mu);
+  Table* table = stripe.table.load(memory_order_relaxed);
+
+  // Another thread could insert str while we waited for the lock.
+  e = FindInTable(table, hash, str);
+  if (e)
+    return make_pair(e->id, false);
+
+  uint32_t id = next_id_.fetch_add(1, memory_order_relaxed);
+  CHECK_NE(kInvalidId, id);
+
+  char* ptr = stripe.arena.AllocateAligned(sizeof(Entry) + str.size());
+  Entry* entry = new (ptr) Entry{hash, id, uint32_t(str.size())};
+  if (!str.empty())
+    memcpy(ptr + sizeof(Entry), str.data(), str.size());
+
+  IdSlot(id)->store(entry, memory_order_release);
+
+  // Keep the load factor at most 1/2 so that probe sequences stay short.
+  if ((table->size + 1) * 2 > table->capacity()) {
+    Table* next = new Table(table->capacity() * 2);
+    for (size_t i = 0; i < table->capacity(); ++i) {
+      const Entry* cur = table->slots[i].load(memory_order_relaxed);
+      if (cur)
+        InsertToTable(next, cur);
+    }
+    InsertToTable(next, entry);
+    stripe.table.store(next, memory_order_release);
+    stripe.retired.emplace_back(table);
+  } else {
+    InsertToTable(table, entry);
+  }
+  size_.fetch_add(1, memory_order_release);
+
+  return make_pair(id, true);
+}
+
+uint32_t ConcurrentUniqueStrings::Find(StringPiece str) const {
+  uint64_t hash = StringPieceHash64{}(str);
+  const Stripe& stripe = stripes_[StripeIndex(hash, kStripeBits)];
+  const Entry* e = FindInTable(stripe.table.load(memory_order_acquire), hash, str);
+
+  return e ? e->id : kInvalidId;
+}
+
+StringPiece ConcurrentUniqueStrings::FromId(uint32_t id) const {
+  uint64_t v = uint64_t(id) + (1u << kFirstSegmentBits);
+  unsigned msb = Bits::FindMSBSet64NonZero(v);
+  const atomic<const Entry*>* seg =
+      segments_[msb - kFirstSegmentBits].load(memory_order_acquire);
+  DCHECK(seg) << id;
+
+  const Entry* e = seg[v - (uint64_t(1) << msb)].load(memory_order_acquire);
+  DCHECK(e) << id;
+
+  return e->str();
+}
+
+size_t ConcurrentUniqueStrings::MemoryUsage() const {
+  size_t res = 0;
+  for (unsigned i = 0; i < kNumStripes; ++i) {
+    Stripe& stripe = stripes_[i];
+    std::lock_guard<mutex> lk(stripe.mu);
+    res += stripe.arena.MemoryUsage();
+    res += stripe.table.load(memory_order_relaxed)->capacity() * sizeof(Entry*);
+    for (const auto& t : stripe.retired)
+      res += t->capacity() * sizeof(Entry*);
+  }
+
+  for (unsigned i = 0; i < kNumSegments; ++i) {
+    if (segments_[i].load(memory_order_relaxed))
+      res += (size_t(1) << (i + kFirstSegmentBits)) * sizeof(Entry*);
+  }
+  return res;
+}
+
+}  // namespace strings
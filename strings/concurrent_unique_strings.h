@@ -0,0 +1,74 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "base/arena.h"
+#include "strings/stringpiece.h"
+
+namespace strings {
+
+// Thread-safe string interner that assigns dense ids (0, 1, 2...) to unique strings.
+// Suitable for process-wide dictionaries shared by all IO threads.
+//
+// Keys are spread over stripes by their hash. Each stripe has its own lock, arena and
+// open-addressing table. Lookups (Find, FromId) do not take locks: tables are published with
+// release semantics and grown by copying, old tables are retired until destruction.
+// Returned StringPieces are stable for the lifetime of the object.
+class ConcurrentUniqueStrings {
+ public:
+  static constexpr uint32_t kInvalidId = UINT32_MAX;
+
+  ConcurrentUniqueStrings();
+  ~ConcurrentUniqueStrings();
+
+  // Returns id of str, inserting it if needed.
+  uint32_t Insert(StringPiece str) { return Intern(str).first; }
+
+  // Returns the interned copy of str, inserting it if needed.
+  StringPiece Get(StringPiece str) { return FromId(Insert(str)); }
+
+  // Returns id of str and whether the insertion took place.
+  std::pair<uint32_t, bool> Intern(StringPiece str);
+
+  // Lock-free. Returns kInvalidId if str was not inserted.
+  uint32_t Find(StringPiece str) const;
+
+  // Lock-free. id must have been returned by Insert/Intern.
+  StringPiece FromId(uint32_t id) const;
+
+  size_t size() const { return size_.load(std::memory_order_acquire); }
+
+  size_t MemoryUsage() const;
+
+ private:
+  struct Entry;
+  struct Table;
+  struct Stripe;
+
+  enum { kStripeBits = 6, kNumStripes = 1 << kStripeBits };
+
+  // id -> Entry mapping is stored in segments of exponentially growing sizes,
+  // so that it can be read without locks while growing.
+  enum { kFirstSegmentBits = 10, kNumSegments = 32 - kFirstSegmentBits + 1 };
+
+  static const Entry* FindInTable(const Table* table, uint64_t hash, StringPiece str);
+  static void InsertToTable(Table* table, const Entry* entry);
+
+  std::atomic<const Entry*>* IdSlot(uint32_t id);
+
+  std::unique_ptr<Stripe[]> stripes_;
+  std::atomic<std::atomic<const Entry*>*> segments_[kNumSegments];
+  std::atomic<uint32_t> next_id_{0};
+  std::atomic<size_t> size_{0};
+
+  ConcurrentUniqueStrings(const ConcurrentUniqueStrings&) = delete;
+  void operator=(const ConcurrentUniqueStrings&) = delete;
+};
+
+}  // namespace strings
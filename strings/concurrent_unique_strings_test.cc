@@ -0,0 +1,89 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "strings/concurrent_unique_strings.h"
+
+#include <thread>
+
+#include "absl/strings/str_cat.h"
+#include "base/gtest.h"
+
+namespace strings {
+
+using namespace std;
+
+class ConcurrentUniqueStringsTest : public testing::Test {
+ protected:
+  ConcurrentUniqueStrings dict_;
+};
+
+TEST_F(ConcurrentUniqueStringsTest, Basic) {
+  EXPECT_EQ(ConcurrentUniqueStrings::kInvalidId, dict_.Find("foo"));
+
+  auto res = dict_.Intern("foo");
+  EXPECT_TRUE(res.second);
+  EXPECT_EQ(0, res.first);
+
+  string str("foo");
+  res = dict_.Intern(str);
+  EXPECT_FALSE(res.second);
+  EXPECT_EQ(0, res.first);
+
+  StringPiece foo = dict_.Get(str);
+  EXPECT_EQ("foo", foo);
+  EXPECT_NE(str.data(), foo.data());
+  EXPECT_EQ(foo.data(), dict_.FromId(0).data());
+
+  EXPECT_EQ(1, dict_.Insert("bar"));
+  EXPECT_EQ(2, dict_.Insert(""));
+  EXPECT_EQ("", dict_.FromId(2));
+  EXPECT_EQ(3, dict_.size());
+  EXPECT_GT(dict_.MemoryUsage(), 0);
+}
+
+TEST_F(ConcurrentUniqueStringsTest, Grow) {
+  constexpr unsigned kNum = 100000;
+  for (unsigned i = 0; i < kNum; ++i) {
+    ASSERT_EQ(i, dict_.Insert(absl::StrCat("key", i)));
+  }
+  for (unsigned i = 0; i < kNum; ++i) {
+    string key = absl::StrCat("key", i);
+    ASSERT_EQ(i, dict_.Find(key));
+    ASSERT_EQ(key, dict_.FromId(i));
+  }
+}
+
+TEST_F(ConcurrentUniqueStringsTest, MultiThreaded) {
+  constexpr unsigned kNumThreads = 8, kNum = 1 << 16;
+  vector<vector<uint32_t>> ids(kNumThreads);
+  vector<thread> threads;
+
+  // All threads intern the same keys in different orders. kNum is a power of 2, hence
+  // multiplying by an odd number permutes [0, kNum).
+  for (unsigned t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&, t] {
+      ids[t].resize(kNum);
+      for (unsigned i = 0; i < kNum; ++i) {
+        unsigned j = (i * (t * 2 + 1)) % kNum;
+        ids[t][j] = dict_.Insert(absl::StrCat(j));
+      }
+    });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  ASSERT_EQ(kNum, dict_.size());
+  vector<bool> seen(kNum);
+  for (unsigned i = 0; i < kNum; ++i) {
+    uint32_t id = ids[0][i];
+    ASSERT_LT(id, kNum);
+    ASSERT_FALSE(seen[id]);
+    seen[id] = true;
+    ASSERT_EQ(absl::StrCat(i), dict_.FromId(id));
+    for (unsigned t = 1; t < kNumThreads; ++t) {
+      ASSERT_EQ(id, ids[t][i]);
+    }
+  }
+}
+
+}  // namespace strings
@@ -4,10 +4,33 @@
 #ifndef _STRINGS_HASH_H
 #define _STRINGS_HASH_H
 
+#include <xxhash.h>
+
 #include <functional>
 #include "base/hash.h"
 #include "strings/stringpiece.h"
 
+namespace strings {
+
+// 64-bit hash for string keys, considerably faster than std::hash<StringPiece>
+// on medium and long keys. Transparent, so maps keyed by StringPiece can be probed with
+// std::string or const char* without conversions.
+struct StringPieceHash64 {
+  using is_transparent = void;
+
+  size_t operator()(StringPiece slice) const {
+    return XXH64(slice.data(), slice.size(), 24061983);
+  }
+};
+
+struct StringPieceEq {
+  using is_transparent = void;
+
+  bool operator()(StringPiece a, StringPiece b) const { return a == b; }
+};
+
+}  // namespace strings
+
 namespace std {
 
 template<> struct hash<StringPiece> {
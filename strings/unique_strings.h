@@ -9,6 +9,8 @@
 
 #include <sparsehash/dense_hash_map>
 
+#include "absl/container/flat_hash_map.h"
+
 #include "base/arena.h"
 #include "base/counting_allocator.h"
 #include "strings/stringpiece.h"
@@ -182,5 +184,43 @@ public:
 
 };
 
+// Arena-backed map from strings to T based on absl Swiss tables.
+// Does not require an empty key, unlike StringPieceDenseMap, and inserts with a single probe.
+// Pointers to values are not stable across insertions.
+template<typename T> class StringPieceFlatMap
+    : public ArenaMapBase<absl::flat_hash_map<StringPiece, T, strings::StringPieceHash64,
+                                              strings::StringPieceEq>> {
+  typedef ArenaMapBase<absl::flat_hash_map<StringPiece, T, strings::StringPieceHash64,
+                                           strings::StringPieceEq>> Parent;
+public:
+  using typename Parent::value_type;
+  using typename Parent::iterator;
+  using Parent::map_;
+
+  std::pair<iterator, bool> insert(const value_type& val) {
+    return emplace(val.first, val.second);
+  }
+
+  template<typename... Args> std::pair<iterator, bool> emplace(StringPiece key, Args&&... args) {
+    bool inserted = false;
+    auto it = map_.lazy_emplace(key, [&](const typename Parent::SMap::constructor& ctor) {
+      inserted = true;
+      ctor(std::piecewise_construct, std::forward_as_tuple(this->AllocateStr(key)),
+           std::forward_as_tuple(std::forward<Args>(args)...));
+    });
+    return std::make_pair(it, inserted);
+  }
+
+  T& operator[](StringPiece key) {
+    return emplace(key).first->second;
+  }
+
+  void reserve(size_t sz) { map_.reserve(sz); }
+
+  // Accounts for the slots array and for the control bytes of the table.
+  size_t MemoryUsage() const {
+    return this->arena_.MemoryUsage() + map_.capacity() * (sizeof(value_type) + 1);
+  }
+};
 
 #endif  // UNIQUE_STRINGS_H
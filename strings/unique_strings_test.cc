@@ -2,7 +2,10 @@
 // Author: Roman Gershman (romange@gmail.com)
 //
 #include "strings/unique_strings.h"
-#include <gtest/gtest.h>
+
+#include <random>
+
+#include "base/gtest.h"
 
 using std::string;
 
@@ -40,3 +43,66 @@ TEST_F(UniqueStringsTest, DenseMap) {
 
   EXPECT_EQ(3, unique["r3"]);
 }
+
+TEST_F(UniqueStringsTest, FlatMap) {
+  StringPieceFlatMap<int> unique;
+  unique["r1"] = 1;
+  unique["r2"] = 2;
+  auto res = unique.insert(StringPieceFlatMap<int>::value_type("r3", 3));
+  EXPECT_TRUE(res.second);
+  res = unique.emplace("r3", 4);
+  EXPECT_FALSE(res.second);
+  EXPECT_EQ(3, res.first->second);
+
+  string key("r1");
+  auto it = unique.find(key);
+  ASSERT_TRUE(it != unique.end());
+  EXPECT_EQ(1, it->second);
+  EXPECT_NE(key.data(), it->first.data());
+
+  unique["r1"]++;
+  EXPECT_EQ(2, unique["r1"]);
+  EXPECT_EQ(0, unique[""]);
+  EXPECT_EQ(4, unique.size());
+  EXPECT_GT(unique.MemoryUsage(), 4 * sizeof(StringPieceFlatMap<int>::value_type));
+
+  unique.clear();
+  EXPECT_TRUE(unique.empty());
+  EXPECT_TRUE(unique.find("r2") == unique.end());
+}
+
+// Zipf-like distribution of words, similar to word-count over a text corpus.
+static std::vector<string> GenerateWords(unsigned count) {
+  std::vector<string> dict(20000);
+  std::mt19937 rnd(10);
+  for (auto& w : dict) {
+    w = base::RandStr(3 + rnd() % 10);
+  }
+  std::vector<string> res(count);
+  std::geometric_distribution<unsigned> dist(0.001);
+  for (auto& w : res) {
+    w = dict[dist(rnd) % dict.size()];
+  }
+  return res;
+}
+
+template <typename Map> void BM_WordCount(benchmark::State& state) {
+  std::vector<string> words = GenerateWords(100000);
+  while (state.KeepRunning()) {
+    Map word_cnt;
+    word_cnt.set_empty_key(StringPiece());
+    for (const auto& w : words) {
+      word_cnt[w] += 1;
+    }
+    base::sink_result(word_cnt.size());
+  }
+  state.SetItemsProcessed(state.iterations() * words.size());
+}
+
+// Adapter that shares the interface with StringPieceDenseMap.
+template <typename T> struct FlatMapAdapter : public StringPieceFlatMap<T> {
+  void set_empty_key(StringPiece) {}
+};
+
+BENCHMARK_TEMPLATE(BM_WordCount, StringPieceDenseMap<uint64_t>);
+BENCHMARK_TEMPLATE(BM_WordCount, FlatMapAdapter<uint64_t>);
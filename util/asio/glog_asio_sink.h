@@ -12,7 +12,7 @@
 
 namespace util {
 
-class GlogAsioSink : public IoContext::Cancellable, ::google::LogSink {
+class GlogAsioSink : public IoContext::Cancellable, public ::google::LogSink {
  public:
   GlogAsioSink();
   ~GlogAsioSink() noexcept;
@@ -0,0 +1,394 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "util/asio/glog_ring_sink.h"
+
+#include <fcntl.h>
+#include <glog/raw_logging.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <boost/fiber/operations.hpp>
+
+#include "absl/strings/str_cat.h"
+#include "base/bits.h"
+
+namespace util {
+using namespace ::boost;
+using namespace ::std;
+
+namespace {
+
+constexpr chrono::microseconds kMinIdle{500}, kMaxIdle{20000};
+
+atomic<uint64_t> next_sink_id{0};
+
+int32_t ThreadId() {
+  static thread_local int32_t tid = syscall(SYS_gettid);
+  return tid;
+}
+
+}  // namespace
+
+/* Single-producer/single-consumer byte ring. Each record is a Header followed by the message
+   and '\n', padded to 8 bytes. Records are contiguous: if a record does not fit till the end
+   of the ring, the producer writes kWrapMark and continues from the beginning.
+*/
+class GlogRingSink::Ring {
+ public:
+  struct Header {
+    uint32_t msg_len;  // kWrapMark - the rest of the ring is unused.
+    int32_t severity;
+    int32_t line;
+    int32_t tid;
+    const char* base_filename;  // glog passes static strings.
+    struct ::tm tm_time;
+  };
+
+  static constexpr uint32_t kWrapMark = ~0u;
+
+  explicit Ring(size_t size)
+      : size_(Bits::RoundUp64(std::max<size_t>(size, 4096))), buf_(new char[size_]) {}
+
+  static size_t RecordSize(size_t msg_len) { return (sizeof(Header) + msg_len + 1 + 7) & ~7ULL; }
+
+  // Longer messages are truncated so that a record always fits into an empty ring.
+  size_t max_msg_len() const { return size_ / 4 - sizeof(Header) - 8; }
+
+  // Producer side.
+  bool TryPush(const Header& hdr, const char* msg);
+
+  // Consumer side.
+  uint64_t tail() const { return tail_.load(memory_order_relaxed); }
+  uint64_t head() const { return head_.load(memory_order_acquire); }
+
+  // Returns the record at pos or nullptr if pos points to kWrapMark,
+  // in which case pos is advanced to the beginning of the ring.
+  const Header* Read(uint64_t* pos) const;
+
+  void Release(uint64_t pos) { tail_.store(pos, memory_order_release); }
+
+  bool empty() const { return tail() == head(); }
+
+  atomic<uint64_t> dropped{0};
+  atomic_bool closed{false};  // Set when the sink is destroyed.
+
+ private:
+  const size_t size_;
+  unique_ptr<char[]> buf_;
+
+  // Separates the producer and consumer positions into different cache lines.
+  char pad1_[64];
+  atomic<uint64_t> head_{0};
+  char pad2_[64];
+  atomic<uint64_t> tail_{0};
+};
+
+bool GlogRingSink::Ring::TryPush(const Header& hdr, const char* msg) {
+  size_t need = RecordSize(hdr.msg_len);
+  uint64_t head = head_.load(memory_order_relaxed);
+  size_t idx = head & (size_ - 1);
+  size_t to_end = size_ - idx;
+  size_t total = need <= to_end ? need : to_end + need;
+
+  if (size_ - (head - tail_.load(memory_order_acquire)) < total)
+    return false;
+
+  if (need > to_end) {
+    reinterpret_cast<Header*>(buf_.get() + idx)->msg_len = kWrapMark;
+    head += to_end;
+    idx = 0;
+  }
+
+  char* dest = buf_.get() + idx;
+  memcpy(dest, &hdr, sizeof(Header));
+  memcpy(dest + sizeof(Header), msg, hdr.msg_len);
+  dest[sizeof(Header) + hdr.msg_len] = '\n';
+
+  head_.store(head + need, memory_order_release);
+  return true;
+}
+
+auto GlogRingSink::Ring::Read(uint64_t* pos) const -> const Header* {
+  size_t idx = *pos & (size_ - 1);
+  const Header* hdr = reinterpret_cast<const Header*>(buf_.get() + idx);
+  if (hdr->msg_len == kWrapMark) {
+    *pos += size_ - idx;
+    return nullptr;
+  }
+  *pos += RecordSize(hdr->msg_len);
+  return hdr;
+}
+
+struct GlogRingSink::Batch {
+  static constexpr unsigned kMaxRecords = 256;  // 2 iovecs per record, below IOV_MAX.
+  static constexpr unsigned kPrefixLen = 128;
+
+  iovec iov[kMaxRecords * 2];
+  char prefix[kMaxRecords][kPrefixLen];
+  unsigned records = 0;
+
+  // Ring positions to release once the batch is written.
+  vector<pair<Ring*, uint64_t>> tails;
+
+  void Add(const Ring::Header& hdr);
+};
+
+void GlogRingSink::Batch::Add(const Ring::Header& hdr) {
+  const struct ::tm& t = hdr.tm_time;
+  char* dest = prefix[records];
+  int sz = snprintf(dest, kPrefixLen, "%c%02d%02d %02d:%02d:%02d %5d %s:%d] ",
+                    "IWEF"[std::min<unsigned>(hdr.severity, 3)], 1 + t.tm_mon, t.tm_mday,
+                    t.tm_hour, t.tm_min, t.tm_sec, hdr.tid, hdr.base_filename, hdr.line);
+
+  iovec* vec = iov + records * 2;
+  vec[0].iov_base = dest;
+  vec[0].iov_len = std::min<int>(sz, kPrefixLen - 1);
+  vec[1].iov_base = const_cast<char*>(reinterpret_cast<const char*>(&hdr + 1));
+  vec[1].iov_len = hdr.msg_len + 1;
+  ++records;
+}
+
+GlogRingSink::GlogRingSink(Options opts)
+    : opts_(std::move(opts)), id_(next_sink_id.fetch_add(1, memory_order_relaxed)),
+      batch_(new Batch) {}
+
+GlogRingSink::~GlogRingSink() noexcept {
+  for (const auto& ring : rings_) {
+    ring->closed.store(true, memory_order_relaxed);
+  }
+  if (fd_ > STDERR_FILENO)
+    close(fd_);
+}
+
+void GlogRingSink::Run() {
+  OpenFile();
+  run_thread_ = this_thread::get_id();
+
+  google::AddLogSink(this);
+  RAW_DLOG(INFO, "Started running");
+  run_started_.store(true, std::memory_order_seq_cst);
+  ec_.notifyAll();
+
+  chrono::microseconds idle = kMinIdle;
+  while (!stop_.load(memory_order_acquire)) {
+    if (Drain()) {
+      idle = kMinIdle;
+      this_fiber::yield();
+    } else {
+      this_fiber::sleep_for(idle);
+      idle = std::min(idle * 2, kMaxIdle);
+    }
+  }
+
+  // Cancel() has removed the sink, hence no messages are sent anymore.
+  Drain();
+
+  uint64_t lost = dropped();
+  if (lost) {
+    RAW_LOG(WARNING, "GlogRingSink dropped %llu messages", (unsigned long long)lost);
+  }
+}
+
+void GlogRingSink::Cancel() {
+  // Waits for the running send() calls.
+  google::RemoveLogSink(this);
+  stop_.store(true, memory_order_release);
+}
+
+void GlogRingSink::WaitTillRun() {
+  ec_.await([this] { return run_started_.load(std::memory_order_acquire); });
+}
+
+uint64_t GlogRingSink::dropped() const {
+  std::lock_guard<std::mutex> lk(rings_mu_);
+  uint64_t res = dropped_;
+  for (const auto& ring : rings_) {
+    res += ring->dropped.load(memory_order_relaxed);
+  }
+  return res;
+}
+
+void GlogRingSink::send(google::LogSeverity severity, const char* full_filename,
+                        const char* base_filename, int line, const struct ::tm* tm_time,
+                        const char* message, size_t message_len) {
+  if (severity < opts_.min_severity)
+    return;
+
+  Ring* ring = GetRing();
+
+  Ring::Header hdr;
+  hdr.msg_len = std::min(message_len, ring->max_msg_len());
+  hdr.severity = severity;
+  hdr.line = line;
+  hdr.tid = ThreadId();
+  hdr.base_filename = base_filename;
+  hdr.tm_time = *tm_time;
+
+  chrono::steady_clock::time_point deadline;
+  for (unsigned attempt = 0; !ring->TryPush(hdr, message); ++attempt) {
+    // Blocking the sink thread or a sink that does not drain would block forever.
+    if (opts_.overflow == DROP || !run_started_.load(memory_order_acquire) ||
+        stop_.load(memory_order_relaxed) || this_thread::get_id() == run_thread_) {
+      ring->dropped.fetch_add(1, memory_order_relaxed);
+      return;
+    }
+
+    // We hold glog's log mutex, so the sink thread may be stuck in LOG behind us and
+    // never drain the ring. Bounding the wait guarantees progress.
+    if (attempt == 0) {
+      deadline = chrono::steady_clock::now() + chrono::milliseconds(opts_.max_block_ms);
+    } else if (chrono::steady_clock::now() >= deadline) {
+      ring->dropped.fetch_add(1, memory_order_relaxed);
+      return;
+    }
+    this_thread::yield();
+  }
+}
+
+void GlogRingSink::WaitTillSent() {
+  /* Noop to reduce send latency */
+}
+
+auto GlogRingSink::GetRing() -> Ring* {
+  static thread_local vector<pair<uint64_t, std::shared_ptr<Ring>>> thread_rings;
+
+  for (auto it = thread_rings.begin(); it != thread_rings.end();) {
+    if (it->first == id_)
+      return it->second.get();
+
+    // Frees the rings of the destroyed sinks.
+    if (it->second->closed.load(memory_order_relaxed)) {
+      it = thread_rings.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  auto ring = std::make_shared<Ring>(opts_.ring_size);
+  {
+    std::lock_guard<std::mutex> lk(rings_mu_);
+    rings_.push_back(ring);
+  }
+  thread_rings.emplace_back(id_, ring);
+
+  return ring.get();
+}
+
+size_t GlogRingSink::Drain() {
+  vector<std::shared_ptr<Ring>> rings;
+  {
+    std::lock_guard<std::mutex> lk(rings_mu_);
+
+    // Removes the drained rings of the exited threads.
+    for (auto it = rings_.begin(); it != rings_.end();) {
+      if (it->use_count() == 1 && (*it)->empty()) {
+        dropped_ += (*it)->dropped.load(memory_order_relaxed);
+        it = rings_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    rings = rings_;
+  }
+
+  Batch* batch = batch_.get();
+  size_t res = 0;
+
+  for (const auto& ring : rings) {
+    uint64_t pos = ring->tail(), head = ring->head();
+
+    while (pos < head) {
+      if (batch->records == Batch::kMaxRecords) {
+        batch->tails.emplace_back(ring.get(), pos);
+        WriteBatch(batch);
+      }
+
+      const Ring::Header* hdr = ring->Read(&pos);
+      if (hdr) {
+        batch->Add(*hdr);
+        ++res;
+      }
+    }
+    batch->tails.emplace_back(ring.get(), pos);
+  }
+  WriteBatch(batch);
+
+  return res;
+}
+
+void GlogRingSink::WriteBatch(Batch* batch) {
+  iovec* iov = batch->iov;
+  int cnt = batch->records * 2;
+
+  while (cnt > 0) {
+    ssize_t res = writev(fd_, iov, cnt);
+    if (res < 0) {
+      if (errno == EINTR)
+        continue;
+      RAW_LOG(ERROR, "Could not write log: %s", strerror(errno));
+      break;
+    }
+    file_size_ += res;
+
+    while (cnt > 0 && size_t(res) >= iov->iov_len) {
+      res -= iov->iov_len;
+      ++iov;
+      --cnt;
+    }
+    if (cnt > 0) {
+      iov->iov_base = reinterpret_cast<char*>(iov->iov_base) + res;
+      iov->iov_len -= res;
+    }
+  }
+
+  for (const auto& ring_pos : batch->tails) {
+    ring_pos.first->Release(ring_pos.second);
+  }
+  batch->tails.clear();
+  batch->records = 0;
+
+  if (opts_.max_file_size && file_size_ >= opts_.max_file_size)
+    Rotate();
+}
+
+void GlogRingSink::OpenFile() {
+  fd_ = STDERR_FILENO;
+  file_size_ = 0;
+  if (opts_.path.empty())
+    return;
+
+  int fd = open(opts_.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    RAW_LOG(ERROR, "Could not open %s: %s, logging to stderr", opts_.path.c_str(),
+            strerror(errno));
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == 0)
+    file_size_ = st.st_size;
+  fd_ = fd;
+}
+
+void GlogRingSink::Rotate() {
+  if (fd_ == STDERR_FILENO)
+    return;
+  close(fd_);
+
+  const string& path = opts_.path;
+  for (unsigned i = opts_.max_files; i > 1; --i) {
+    rename(absl::StrCat(path, ".", i - 1).c_str(), absl::StrCat(path, ".", i).c_str());
+  }
+  if (opts_.max_files) {
+    rename(path.c_str(), absl::StrCat(path, ".1").c_str());
+  } else {
+    unlink(path.c_str());
+  }
+
+  OpenFile();
+}
+
+}  // namespace util
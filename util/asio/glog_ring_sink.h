@@ -0,0 +1,97 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+
+#pragma once
+
+#include <glog/logging.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util/asio/io_context.h"
+#include "util/fibers/event_count.h"
+
+namespace util {
+
+/**
+ * @brief Asynchronous glog sink that writes log lines into a file.
+ *
+ * Unlike GlogAsioSink, send() does not allocate: each logging thread copies its messages into
+ * its own single-producer/single-consumer byte ring. The rings are drained by the fiber of
+ * the IoContext the sink is attached to, which formats the glog prefixes and writes the lines
+ * with batched writev calls.
+ *
+ * glog calls send() under its global log mutex, therefore the consumer must not use LOG
+ * (only RAW_LOG) and blocking producers block all the logging threads, including the sink
+ * thread. Hence BLOCK waits at most Options::max_block_ms for the ring to be drained.
+ */
+class GlogRingSink : public IoContext::Cancellable, public ::google::LogSink {
+ public:
+  enum OverflowPolicy {
+    DROP,   // Messages that do not fit into the ring of their thread are dropped.
+    BLOCK,  // The logging thread waits up to max_block_ms until the ring is drained.
+            // Messages logged from the sink thread itself or before Run() are dropped anyway.
+  };
+
+  struct Options {
+    std::string path;  // Log file. Empty means stderr.
+
+    size_t ring_size = 1 << 20;  // Per logging thread. Rounded up to a power of 2.
+
+    size_t max_file_size = 0;  // Rotates the file when exceeded. 0 - never rotate.
+    unsigned max_files = 5;    // Keeps path.1 ... path.<max_files> rotated files.
+
+    OverflowPolicy overflow = DROP;
+    unsigned max_block_ms = 50;  // BLOCK drops the message after waiting that long.
+    google::LogSeverity min_severity = google::GLOG_INFO;
+  };
+
+  explicit GlogRingSink(Options opts);
+  ~GlogRingSink() noexcept;
+
+  void Run() override;
+  void Cancel() override;
+
+  void WaitTillRun();
+
+  uint64_t dropped() const;
+
+ private:
+  class Ring;
+  struct Batch;
+
+  //! Derived from LogSink.
+  void send(google::LogSeverity severity, const char* full_filename, const char* base_filename,
+            int line, const struct ::tm* tm_time, const char* message, size_t message_len) override;
+
+  void WaitTillSent() override;
+
+  Ring* GetRing();
+
+  // Drains all the rings into the file. Returns the number of written messages.
+  size_t Drain();
+  void WriteBatch(Batch* batch);
+  void OpenFile();
+  void Rotate();
+
+  Options opts_;
+  const uint64_t id_;  // Distinguishes the rings of different sinks in the logging threads.
+
+  mutable std::mutex rings_mu_;
+  std::vector<std::shared_ptr<Ring>> rings_;
+  uint64_t dropped_ = 0;  // by the rings of the exited threads.
+
+  int fd_ = -1;
+  size_t file_size_ = 0;
+  std::unique_ptr<Batch> batch_;
+
+  std::thread::id run_thread_;
+  std::atomic_bool run_started_{false}, stop_{false};
+  fibers_ext::EventCount ec_;
+};
+
+}  // namespace util
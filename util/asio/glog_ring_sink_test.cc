@@ -0,0 +1,214 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "util/asio/glog_ring_sink.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+#include <fstream>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "base/gtest.h"
+#include "base/logging.h"
+#include "base/walltime.h"
+#include "util/asio/glog_asio_sink.h"
+#include "util/asio/io_context_pool.h"
+
+namespace util {
+
+using namespace std;
+
+class GlogRingSinkTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    pool_.reset(new IoContextPool(3));
+    pool_->Run();
+    opts_.path = "/tmp/glog_ring_sink_test.log";
+    RemoveFiles();
+  }
+
+  void TearDown() override {
+    pool_->Stop();
+    RemoveFiles();
+  }
+
+  void RemoveFiles() {
+    unlink(opts_.path.c_str());
+    for (unsigned i = 1; i <= opts_.max_files; ++i) {
+      unlink(absl::StrCat(opts_.path, ".", i).c_str());
+    }
+  }
+
+  static vector<string> ReadLines(const string& path) {
+    ifstream ifs(path);
+    vector<string> res;
+    string line;
+    while (getline(ifs, line)) {
+      res.push_back(line);
+    }
+    return res;
+  }
+
+  // The sink is owned by the context.
+  GlogRingSink* Attach() {
+    GlogRingSink* sink = new GlogRingSink(opts_);
+    pool_->at(0).AttachCancellable(sink);
+    sink->WaitTillRun();
+    return sink;
+  }
+
+  std::unique_ptr<IoContextPool> pool_;
+  GlogRingSink::Options opts_;
+};
+
+TEST_F(GlogRingSinkTest, Basic) {
+  GlogRingSink* sink = Attach();
+
+  constexpr unsigned kNum = 1000;
+  pool_->AwaitOnAll([&](IoContext&) {
+    for (unsigned i = 0; i < kNum; ++i) {
+      LOG_TO_SINK_BUT_NOT_TO_LOGFILE(sink, INFO) << "Message " << i;
+    }
+  });
+  LOG_TO_SINK_BUT_NOT_TO_LOGFILE(sink, WARNING) << "Last";
+  pool_->Stop();
+
+  vector<string> lines = ReadLines(opts_.path);
+  ASSERT_EQ(kNum * pool_->size() + 1, lines.size());
+
+  unsigned count = 0;
+  for (const auto& line : lines) {
+    EXPECT_TRUE(absl::StrContains(line, "glog_ring_sink_test.cc:")) << line;
+    count += absl::StartsWith(line, "I") && absl::EndsWith(line, "] Message 999");
+  }
+  EXPECT_EQ(pool_->size(), count);
+  EXPECT_TRUE(absl::StartsWith(lines.back(), "W")) << lines.back();
+  EXPECT_TRUE(absl::EndsWith(lines.back(), "] Last")) << lines.back();
+}
+
+TEST_F(GlogRingSinkTest, Rotate) {
+  opts_.max_file_size = 1000;
+  opts_.max_files = 2;
+  GlogRingSink* sink = Attach();
+
+  for (unsigned i = 0; i < 100; ++i) {
+    LOG_TO_SINK_BUT_NOT_TO_LOGFILE(sink, INFO) << "Message " << i;
+    if (i % 10 == 0)
+      SleepForMilliseconds(5);  // Lets the sink write the batch.
+  }
+  pool_->Stop();
+
+  vector<string> lines = ReadLines(opts_.path + ".1");
+  ASSERT_FALSE(lines.empty());
+  EXPECT_FALSE(ReadLines(opts_.path + ".2").empty());
+  EXPECT_TRUE(ReadLines(opts_.path + ".3").empty());
+
+  lines = ReadLines(opts_.path);
+  if (!lines.empty()) {
+    EXPECT_TRUE(absl::EndsWith(lines.back(), "Message 99"));
+  }
+}
+
+TEST_F(GlogRingSinkTest, Drop) {
+  opts_.ring_size = 4096;
+  GlogRingSink sink(opts_);  // Not running, hence not drained.
+
+  string msg(100, 'a');
+  for (unsigned i = 0; i < 100; ++i) {
+    LOG_TO_SINK_BUT_NOT_TO_LOGFILE(&sink, INFO) << msg;
+  }
+  EXPECT_GT(sink.dropped(), 50);
+  EXPECT_LT(sink.dropped(), 100);
+}
+
+// glog calls send() under its log mutex. A producer blocked on a full ring must not
+// deadlock the sink thread, which cannot drain the ring while it waits for the mutex in LOG.
+TEST_F(GlogRingSinkTest, BlockWhileSinkThreadLogs) {
+  opts_.ring_size = 4096;
+  opts_.overflow = GlogRingSink::BLOCK;
+  opts_.max_block_ms = 10;
+  GlogRingSink* sink = Attach();
+
+  constexpr unsigned kNum = 50;
+  string msg(100, 'a');
+
+  // Occupies the sink thread, hence its ring is not drained while the producer logs.
+  pool_->at(0).Await([&] {
+    std::thread producer([&] {
+      for (unsigned i = 0; i < kNum; ++i) {
+        LOG_TO_SINK_BUT_NOT_TO_LOGFILE(sink, INFO) << msg;
+      }
+    });
+    SleepForMilliseconds(5);
+    LOG_TO_SINK_BUT_NOT_TO_LOGFILE(sink, INFO) << "From the sink thread";
+    producer.join();
+  });
+
+  // The message of the sink thread is dropped and so are the ones that did not fit.
+  uint64_t dropped = sink->dropped();
+  pool_->Stop();  // Destroys the sink.
+
+  EXPECT_GT(dropped, 1);
+  EXPECT_EQ(kNum + 1, ReadLines(opts_.path).size() + dropped);
+}
+
+namespace {
+
+class FileAsioSink : public GlogAsioSink {
+  int fd_;
+
+ public:
+  explicit FileAsioSink(int fd) : fd_(fd) {}
+
+ protected:
+  void HandleItem(const Item& item) override {
+    string line = google::LogSink::ToString(item.severity, item.base_filename, item.line,
+                                            &item.tm_time, item.message.data(),
+                                            item.message.size());
+    line.push_back('\n');
+    CHECK_EQ(line.size(), write(fd_, line.data(), line.size()));
+  }
+};
+
+}  // namespace
+
+// Measures the cost of LOG(INFO) when all the IoContextPool threads log concurrently.
+// Arg 0 - GlogAsioSink, 1 - GlogRingSink.
+static void BM_LogContention(benchmark::State& state) {
+  IoContextPool pool;
+  pool.Run();
+
+  int fd = open("/dev/null", O_WRONLY);
+  google::LogSink* sink;
+  if (state.range(0)) {
+    GlogRingSink::Options opts;
+    opts.path = "/dev/null";
+    GlogRingSink* ring_sink = new GlogRingSink(opts);
+    pool[0].AttachCancellable(ring_sink);
+    ring_sink->WaitTillRun();
+    sink = ring_sink;
+  } else {
+    FileAsioSink* asio_sink = new FileAsioSink(fd);
+    pool[0].AttachCancellable(asio_sink);
+    asio_sink->WaitTillRun();
+    sink = asio_sink;
+  }
+
+  constexpr unsigned kBatch = 100;
+  while (state.KeepRunning()) {
+    pool.AwaitOnAll([&](IoContext&) {
+      for (unsigned i = 0; i < kBatch; ++i) {
+        LOG_TO_SINK_BUT_NOT_TO_LOGFILE(sink, INFO) << "Some log message number " << i;
+      }
+    });
+  }
+  state.SetItemsProcessed(state.iterations() * kBatch * pool.size());
+  pool.Stop();
+  close(fd);
+}
+BENCHMARK(BM_LogContention)->Arg(0)->Arg(1)->UseRealTime();
+
+}  // namespace util
@@ -433,6 +433,7 @@ void IoContext::StartLoop(BlockingCounter* bc) {
   io_cntx.run_one();
 
   // Shutdown phase.
+  timer_service_->Shutdown();
   for (unsigned i = 0; i < 2; ++i) {
     DVLOG(1) << "Cleanup Loop " << i;
     while (io_cntx.poll() || scheduler->has_ready_fibers()) {
@@ -9,6 +9,7 @@
 
 #include <thread>
 
+#include "util/asio/timer_service.h"
 #include "util/fibers/fibers_ext.h"
 
 namespace util {
@@ -92,7 +93,9 @@ class IoContext {
     virtual void Cancel() = 0;
   };
 
-  IoContext() : context_ptr_(std::make_shared<io_context>()) {}
+  IoContext()
+      : context_ptr_(std::make_shared<io_context>()),
+        timer_service_(new TimerService(context_ptr_.get())) {}
 
   // We use shared_ptr because of the shared ownership with the fibers scheduler.
   typedef std::shared_ptr<io_context> ptr_t;
@@ -154,6 +157,10 @@ class IoContext {
 
   bool InContextThread() const { return std::this_thread::get_id() == thread_id_; }
 
+  // Timers shared by all the fibers and objects of this IoContext.
+  // Should be accessed only from the context thread.
+  TimerService& timer_service() { return *timer_service_; }
+
   // Attaches user processes that should live along IoContext. IoContext will shut them down via
   // Cancel() call right before closing its IO loop.
   // Takes ownership over Cancellable runner. Runs it in a dedicated fiber in IoContext thread.
@@ -171,6 +178,7 @@ class IoContext {
   using CancellablePair = std::pair<std::unique_ptr<Cancellable>, ::boost::fibers::fiber>;
 
   ptr_t context_ptr_;
+  std::unique_ptr<TimerService> timer_service_;
   std::thread::id thread_id_;
   std::vector<CancellablePair> cancellable_arr_;
 };
@@ -0,0 +1,137 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "util/asio/resource_sampler.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "absl/strings/str_cat.h"
+#include "base/logging.h"
+#include "base/walltime.h"
+#include "util/asio/io_context_pool.h"
+
+namespace util {
+
+using namespace std;
+
+ResourceSampler::ResourceSampler(IoContextPool* pool, chrono::milliseconds period)
+    : pool_(pool), period_(period),
+      varz_("resource-usage", [this] { return GetVarz(); }) {
+  CHECK(pool_);
+}
+
+ResourceSampler::~ResourceSampler() {
+  Stop();
+}
+
+void ResourceSampler::Start() {
+  CHECK(!task_);
+
+  io_tids_.resize(pool_->size());
+  pool_->AwaitOnAll([this](unsigned index, IoContext&) {
+    io_tids_[index] = syscall(SYS_gettid);
+  });
+
+  IoContext& cntx = pool_->GetNextContext();
+  cntx.Await([this] { Collect(); });  // The baseline for the rates.
+
+  task_.reset(new PeriodicTask(cntx, period_));
+  task_->Start([this](int ticks) { Collect(); });
+}
+
+void ResourceSampler::Stop() {
+  if (task_) {
+    task_->Cancel();
+    task_.reset();
+  }
+}
+
+auto ResourceSampler::GetLast() const -> Sample {
+  std::lock_guard<std::mutex> lk(mu_);
+  return last_;
+}
+
+void ResourceSampler::Collect() {
+  Sample sample;
+  if (!ResourceUsage::ReadProcess(&sample.usage)) {
+    LOG_FIRST_N(ERROR, 1) << "Could not read /proc/self/stat";
+    return;
+  }
+
+  vector<ResourceUsage> threads(io_tids_.size());
+  for (size_t i = 0; i < io_tids_.size(); ++i) {
+    ResourceUsage::ReadThread(io_tids_[i], &threads[i]);
+  }
+
+  uint64_t now = GetMonotonicMicros();
+  if (prev_usec_) {
+    const ResourceUsage& cur = sample.usage;
+    double delta_usec = now - prev_usec_;
+    auto rate = [&](uint64_t cur_val, uint64_t prev_val) {
+      return cur_val > prev_val ? (cur_val - prev_val) * 1e6 / delta_usec : 0;
+    };
+
+    // usec per usec is the number of busy cores.
+    sample.cpu_user = rate(cur.user_usec, prev_.user_usec) / 1e6;
+    sample.cpu_sys = rate(cur.sys_usec, prev_.sys_usec) / 1e6;
+    sample.ctxt_switches_per_sec =
+        rate(cur.voluntary_ctxt_switches + cur.nonvoluntary_ctxt_switches,
+             prev_.voluntary_ctxt_switches + prev_.nonvoluntary_ctxt_switches);
+    sample.major_faults_per_sec = rate(cur.major_faults, prev_.major_faults);
+    sample.read_bytes_per_sec = rate(cur.read_bytes, prev_.read_bytes);
+    sample.write_bytes_per_sec = rate(cur.write_bytes, prev_.write_bytes);
+    sample.rchar_per_sec = rate(cur.rchar, prev_.rchar);
+    sample.wchar_per_sec = rate(cur.wchar, prev_.wchar);
+
+    sample.io_thread_cpu.resize(threads.size());
+    for (size_t i = 0; i < threads.size(); ++i) {
+      sample.io_thread_cpu[i] = rate(threads[i].user_usec + threads[i].sys_usec,
+                                     prev_threads_[i].user_usec + prev_threads_[i].sys_usec) /
+                                1e6;
+    }
+  }
+
+  prev_ = sample.usage;
+  prev_threads_ = std::move(threads);
+  prev_usec_ = now;
+
+  std::lock_guard<std::mutex> lk(mu_);
+  last_ = std::move(sample);
+}
+
+VarzValue::Map ResourceSampler::GetVarz() const {
+  Sample s = GetLast();
+  const ResourceUsage& u = s.usage;
+
+  VarzValue::Map res;
+  res.emplace_back("cpu_user", VarzValue::FromDouble(s.cpu_user));
+  res.emplace_back("cpu_sys", VarzValue::FromDouble(s.cpu_sys));
+  res.emplace_back("user_usec", VarzValue::FromInt(u.user_usec));
+  res.emplace_back("sys_usec", VarzValue::FromInt(u.sys_usec));
+  res.emplace_back("voluntary_ctxt_switches", VarzValue::FromInt(u.voluntary_ctxt_switches));
+  res.emplace_back("nonvoluntary_ctxt_switches",
+                   VarzValue::FromInt(u.nonvoluntary_ctxt_switches));
+  res.emplace_back("ctxt_switches_per_sec", VarzValue::FromDouble(s.ctxt_switches_per_sec));
+  res.emplace_back("minor_faults", VarzValue::FromInt(u.minor_faults));
+  res.emplace_back("major_faults", VarzValue::FromInt(u.major_faults));
+  res.emplace_back("major_faults_per_sec", VarzValue::FromDouble(s.major_faults_per_sec));
+  res.emplace_back("read_bytes", VarzValue::FromInt(u.read_bytes));
+  res.emplace_back("write_bytes", VarzValue::FromInt(u.write_bytes));
+  res.emplace_back("read_bytes_per_sec", VarzValue::FromDouble(s.read_bytes_per_sec));
+  res.emplace_back("write_bytes_per_sec", VarzValue::FromDouble(s.write_bytes_per_sec));
+  res.emplace_back("rchar_per_sec", VarzValue::FromDouble(s.rchar_per_sec));
+  res.emplace_back("wchar_per_sec", VarzValue::FromDouble(s.wchar_per_sec));
+  res.emplace_back("vm_rss_kb", VarzValue::FromInt(u.vm_rss));
+  res.emplace_back("threads", VarzValue::FromInt(u.num_threads));
+
+  VarzValue::Map io_cpu;
+  for (size_t i = 0; i < s.io_thread_cpu.size(); ++i) {
+    io_cpu.emplace_back(absl::StrCat(i), VarzValue::FromDouble(s.io_thread_cpu[i]));
+  }
+  res.emplace_back("io_thread_cpu", VarzValue(std::move(io_cpu)));
+
+  return res;
+}
+
+}  // namespace util
@@ -0,0 +1,77 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "util/asio/periodic_task.h"
+#include "util/proc_stats.h"
+#include "util/stats/varz_stats.h"
+
+namespace util {
+
+class IoContextPool;
+
+/**
+ * @brief Periodically samples the resource usage of the process and of IoContextPool threads
+ *        and exports it as "resource-usage" varz.
+ *
+ * Helps to tell what bounds a slow job:
+ *   - CPU: cpu_user + cpu_sys close to the number of cores or io_thread_cpu close to 1.
+ *   - Page cache: rchar_per_sec much higher than read_bytes_per_sec, major faults.
+ *   - IO: high read_bytes_per_sec or write_bytes_per_sec with low cpu and many voluntary
+ *     context switches.
+ */
+class ResourceSampler {
+ public:
+  struct Sample {
+    ResourceUsage usage;
+
+    // Rates over the last period. cpu is measured in cores, i.e. 1.0 is one busy core.
+    double cpu_user = 0, cpu_sys = 0;
+    double ctxt_switches_per_sec = 0, major_faults_per_sec = 0;
+    double read_bytes_per_sec = 0, write_bytes_per_sec = 0;
+    double rchar_per_sec = 0, wchar_per_sec = 0;
+
+    // Cpu of each IoContext thread over the last period, indexed as in the pool.
+    std::vector<double> io_thread_cpu;
+  };
+
+  explicit ResourceSampler(IoContextPool* pool,
+                           std::chrono::milliseconds period = std::chrono::seconds(1));
+  ~ResourceSampler();
+
+  // Starts sampling on one of the pool contexts. The pool must be running.
+  void Start();
+
+  // Blocks until the periodic task stops, hence must not be called from IO fiber.
+  void Stop();
+
+  Sample GetLast() const;
+
+ private:
+  // Runs from the IO fiber. /proc reads do not block on IO.
+  void Collect();
+  VarzValue::Map GetVarz() const;
+
+  IoContextPool* pool_;
+  std::chrono::milliseconds period_;
+  std::vector<int> io_tids_;
+  std::unique_ptr<PeriodicTask> task_;
+
+  // Accessed by Collect() only.
+  ResourceUsage prev_;
+  std::vector<ResourceUsage> prev_threads_;
+  uint64_t prev_usec_ = 0;
+
+  mutable std::mutex mu_;
+  Sample last_;
+
+  VarzFunction varz_;
+};
+
+}  // namespace util
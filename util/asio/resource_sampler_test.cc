@@ -0,0 +1,58 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "util/asio/resource_sampler.h"
+
+#include "base/gtest.h"
+#include "base/logging.h"
+#include "base/walltime.h"
+#include "util/asio/io_context_pool.h"
+
+namespace util {
+
+using namespace std;
+using namespace chrono;
+
+class ResourceSamplerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    pool_.reset(new IoContextPool(2));
+    pool_->Run();
+  }
+
+  void TearDown() override { pool_->Stop(); }
+
+  std::unique_ptr<IoContextPool> pool_;
+};
+
+TEST_F(ResourceSamplerTest, Basic) {
+  ResourceSampler sampler(pool_.get(), milliseconds(10));
+  sampler.Start();
+
+  // Keeps the io threads busy for a few periods.
+  pool_->AwaitOnAll([](IoContext&) {
+    uint64 start = GetMonotonicMicros();
+    while (GetMonotonicMicros() - start < 50000) {
+    }
+  });
+  SleepForMilliseconds(20);
+
+  ResourceSampler::Sample sample = sampler.GetLast();
+  ASSERT_EQ(pool_->size(), sample.io_thread_cpu.size());
+  EXPECT_GT(sample.usage.user_usec + sample.usage.sys_usec, 0);
+  EXPECT_GT(sample.usage.vm_rss, 0);
+  EXPECT_GE(sample.usage.num_threads, pool_->size());
+
+  bool found = false;
+  VarzListNode::IterateValues([&](const string& name, const string& val) {
+    if (name == "resource-usage") {
+      found = true;
+      EXPECT_NE(string::npos, val.find("io_thread_cpu")) << val;
+    }
+  });
+  EXPECT_TRUE(found);
+
+  sampler.Stop();
+}
+
+}  // namespace util
@@ -0,0 +1,106 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "util/asio/timer_service.h"
+
+#include <boost/fiber/operations.hpp>
+
+#include "base/logging.h"
+#include "util/fibers/event_count.h"
+
+namespace util {
+
+using namespace boost;
+using namespace std;
+
+constexpr unsigned TimerService::kTickMsec;
+
+namespace {
+
+constexpr int64_t kTickNanos = int64_t(TimerService::kTickMsec) * 1000000;
+
+}  // namespace
+
+TimerService::TimerService(asio::io_context* cntx) : timer_(*cntx), start_(clock_t::now()) {}
+
+base::Tick TimerService::ToTickCeil(clock_t::time_point tp) const {
+  int64_t nanos = chrono::duration_cast<chrono::nanoseconds>(tp - start_).count();
+  return nanos > 0 ? (nanos + kTickNanos - 1) / kTickNanos : 0;
+}
+
+void TimerService::ScheduleAt(Event* ev, clock_t::time_point tp) {
+  if (shutdown_)
+    return;
+
+  base::Tick at = ToTickCeil(tp);
+
+  // The wheel lags behind the real time by up to a tick, so we schedule relatively to the
+  // wheel time. Past deadlines run on the next tick.
+  base::Tick delta = at > wheel_.now() ? at - wheel_.now() : 1;
+  wheel_.schedule(ev, delta);
+  Arm(wheel_.now() + delta);
+}
+
+void TimerService::SleepUntil(clock_t::time_point tp) {
+  if (shutdown_) {
+    this_fiber::sleep_until(tp);
+    return;
+  }
+
+  fibers_ext::EventCount ec;
+  bool fired = false;
+  auto cb = [&] {
+    fired = true;
+    ec.notify();
+  };
+  base::TimerEvent<decltype(cb)> ev(std::move(cb));
+
+  ScheduleAt(&ev, tp);
+  ec.await([&] { return fired; });
+}
+
+void TimerService::Shutdown() {
+  shutdown_ = true;
+
+  // Runs the pending events, so that fibers blocked in SleepUntil wake up and timeouts fire
+  // instead of hanging the shutdown. Events can not reschedule themselves at this point.
+  for (base::Tick next = wheel_.ticks_to_next_event(); next != base::Tick(-1);
+       next = wheel_.ticks_to_next_event()) {
+    wheel_.advance(std::max<base::Tick>(next, 1));
+  }
+
+  armed_at_ = 0;
+  timer_.cancel();
+}
+
+void TimerService::Arm(base::Tick at) {
+  if (shutdown_ || (armed_at_ && armed_at_ <= at))
+    return;
+
+  armed_at_ = at;
+
+  // Rearming cancels the previous wait, which completes with operation_aborted.
+  timer_.expires_at(start_ + chrono::milliseconds(at * kTickMsec));
+  timer_.async_wait([this](const system::error_code& ec) { OnTimer(ec); });
+}
+
+void TimerService::OnTimer(const system::error_code& ec) {
+  if (ec == asio::error::operation_aborted || shutdown_)
+    return;
+
+  armed_at_ = 0;
+
+  int64_t nanos = chrono::duration_cast<chrono::nanoseconds>(clock_t::now() - start_).count();
+  base::Tick now = nanos / kTickNanos;
+  if (now > wheel_.now()) {
+    wheel_.advance(now - wheel_.now());
+  }
+
+  // Scans the wheel for the earliest event. Returns Tick(-1) if the wheel is empty.
+  base::Tick next = wheel_.ticks_to_next_event();
+  if (next != base::Tick(-1)) {
+    Arm(wheel_.now() + std::max<base::Tick>(next, 1));
+  }
+}
+
+}  // namespace util
@@ -0,0 +1,70 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#pragma once
+
+#include <boost/asio/steady_timer.hpp>
+
+#include "base/wheel_timer.h"
+
+namespace util {
+
+/*! \brief Per-IoContext timer service based on hierarchical base::TimerWheel.
+
+    All the timers of IoContext thread are driven by a single asio timer that is armed
+    for the earliest scheduled event and only while there are scheduled events.
+    Therefore scheduling and cancelling are cheap and do not touch asio.
+    Timer events run directly from IO loop, hence they should not block.
+    Event objects can be cancelled via TimerEventInterface::cancel() or by destroying them.
+
+    Not thread-safe, should be accessed only from its IoContext thread.
+    See IoContext::timer_service().
+*/
+class TimerService {
+ public:
+  using clock_t = std::chrono::steady_clock;
+  using Event = ::base::TimerEventInterface;
+
+  static constexpr unsigned kTickMsec = 1;
+
+  explicit TimerService(::boost::asio::io_context* cntx);
+
+  //! Schedules ev to run in msec milliseconds. An active event is rescheduled.
+  void Schedule(Event* ev, uint32_t msec) {
+    ScheduleAt(ev, clock_t::now() + std::chrono::milliseconds(msec));
+  }
+
+  //! Schedules ev to run at tp. If tp has passed, ev runs on the next tick.
+  //! Noop after Shutdown().
+  void ScheduleAt(Event* ev, clock_t::time_point tp);
+
+  //! Suspends the calling fiber until tp. Must be called from IoContext thread.
+  void SleepUntil(clock_t::time_point tp);
+
+  void SleepFor(uint32_t msec) {
+    SleepUntil(clock_t::now() + std::chrono::milliseconds(msec));
+  }
+
+  //! Runs all the pending events immediately and cancels the driver timer.
+  //! Events scheduled afterwards never run. Called by IoContext when its loop exits.
+  void Shutdown();
+
+ private:
+  // Rounds up to the next tick, so that events never run early.
+  base::Tick ToTickCeil(clock_t::time_point tp) const;
+
+  void Arm(base::Tick at);
+  void OnTimer(const ::boost::system::error_code& ec);
+
+  ::boost::asio::steady_timer timer_;
+  clock_t::time_point start_;
+  base::TimerWheel wheel_;
+
+  base::Tick armed_at_ = 0;  // 0 if the driver timer is not armed.
+  bool shutdown_ = false;
+
+  TimerService(const TimerService&) = delete;
+  void operator=(const TimerService&) = delete;
+};
+
+}  // namespace util
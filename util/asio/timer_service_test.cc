@@ -0,0 +1,98 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "util/asio/timer_service.h"
+
+#include "base/gtest.h"
+#include "base/logging.h"
+#include "base/walltime.h"
+#include "util/asio/io_context_pool.h"
+
+using namespace std;
+using namespace chrono;
+using namespace boost;
+
+namespace util {
+
+class TimerServiceTest : public testing::Test {
+ protected:
+  void SetUp() override { pool_.Run(); }
+
+  void TearDown() { pool_.Stop(); }
+
+  IoContextPool pool_{1};
+};
+
+TEST_F(TimerServiceTest, Schedule) {
+  IoContext& cntx = pool_.GetNextContext();
+  std::vector<int> order;
+
+  auto cb1 = [&] { order.push_back(1); };
+  auto cb2 = [&] { order.push_back(2); };
+  auto cb3 = [&] { order.push_back(3); };
+  base::TimerEvent<decltype(cb1)> ev1(std::move(cb1));
+  base::TimerEvent<decltype(cb2)> ev2(std::move(cb2));
+  base::TimerEvent<decltype(cb3)> ev3(std::move(cb3));
+
+  cntx.AwaitSafe([&] {
+    TimerService& ts = cntx.timer_service();
+    ts.Schedule(&ev2, 10);
+    ts.Schedule(&ev1, 2);
+    ts.Schedule(&ev3, 5);
+    ev3.cancel();
+    ts.SleepFor(20);
+  });
+
+  EXPECT_EQ((std::vector<int>{1, 2}), order);
+}
+
+TEST_F(TimerServiceTest, SleepFor) {
+  IoContext& cntx = pool_.GetNextContext();
+
+  // Longer than a single rotation of the inner wheel.
+  constexpr uint32_t kSleepMsec = 300;
+  uint64_t start = GetMonotonicMicros();
+  cntx.AwaitSafe([&] { cntx.timer_service().SleepFor(kSleepMsec); });
+  uint64_t delta = GetMonotonicMicros() - start;
+
+  EXPECT_GE(delta + 100, kSleepMsec * 1000);
+  EXPECT_LT(delta, kSleepMsec * 2000);
+}
+
+TEST_F(TimerServiceTest, ManyFibers) {
+  IoContext& cntx = pool_.GetNextContext();
+  constexpr unsigned kNumFibers = 1000;
+  unsigned woken = 0;
+
+  cntx.AwaitSafe([&] {
+    std::vector<fibers::fiber> fbs;
+    for (unsigned i = 0; i < kNumFibers; ++i) {
+      fbs.emplace_back([&, i] {
+        cntx.timer_service().SleepFor(1 + i % 50);
+        ++woken;
+      });
+    }
+    for (auto& fb : fbs)
+      fb.join();
+  });
+
+  EXPECT_EQ(kNumFibers, woken);
+}
+
+TEST_F(TimerServiceTest, Shutdown) {
+  IoContext& cntx = pool_.GetNextContext();
+  bool woken = false;
+
+  cntx.AsyncFiber([&] {
+    cntx.timer_service().SleepFor(3600 * 1000);
+    woken = true;
+  });
+  cntx.AwaitSafe([] {});  // Lets the fiber start sleeping.
+
+  uint64_t start = GetMonotonicMicros();
+  pool_.Stop();
+  EXPECT_TRUE(woken);
+  EXPECT_LT(GetMonotonicMicros() - start, 1000000);
+}
+
+}  // namespace util
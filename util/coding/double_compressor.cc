@@ -4,11 +4,16 @@
 #include "util/coding/double_compressor.h"
 
 #include <cmath>
+#include <cstdlib>
 #include <numeric>
 
 #include <lz4.h>
 #include <shuffle.h>
 
+#ifdef __AVX2__
+#include <x86intrin.h>
+#endif
+
 #include "base/bits.h"
 #include "base/endian.h"
 #include "base/logging.h"
@@ -80,9 +85,102 @@ inline void bitunshuffle2(const uint8_t* src, size_t sz, uint8_t* dest) {
   }
 }
 
+#ifdef __AVX2__
+
+// Powers of 10 that are exactly representable as double and float respectively.
+constexpr int kMaxExactPow10 = 22;
+constexpr int kMaxExactPow10f = 10;
+
+constexpr double kPow10[kMaxExactPow10 + 1] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// 2^52 + 2^51 and its bit representation.
+constexpr double kMagic = 6755399441055744.0;
+constexpr int64_t kMagicBits = 0x4338000000000000LL;
+
+// Returns true if all the lanes are in (-2^bits, 2^bits).
+inline bool InExactRange(__m256i v, unsigned bits) {
+  __m256i biased = _mm256_add_epi64(v, _mm256_set1_epi64x((1LL << bits) - 1));
+  __m256i out = _mm256_or_si256(
+      _mm256_cmpgt_epi64(_mm256_setzero_si256(), biased),
+      _mm256_cmpgt_epi64(biased, _mm256_set1_epi64x((1LL << (bits + 1)) - 2)));
+  return _mm256_testz_si256(out, out);
+}
+
+#endif
+
+// Converts count decimals from src into dest, src and dest may point to the same buffer.
+void FromDecimals(const int64_t* src, unsigned count, int64_t min_val, int exponent,
+                  double* dest) {
+  unsigned i = 0;
+
+#ifdef __AVX2__
+  if (std::abs(exponent) <= kMaxExactPow10) {
+    const __m256d pow10 = _mm256_set1_pd(kPow10[std::abs(exponent)]);
+    const __m256i base = _mm256_set1_epi64x(min_val);
+
+    for (; i + 4 <= count; i += 4) {
+      __m256i v = _mm256_add_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)),
+                                   base);
+      if (!InExactRange(v, 51)) {
+        for (unsigned j = i; j < i + 4; ++j)
+          dest[j] = FromDecimal(src[j] + min_val, exponent);
+        continue;
+      }
+
+      // Adds v to the mantissa of 2^52 + 2^51, which is exact for |v| < 2^51.
+      __m256d d = _mm256_sub_pd(
+          _mm256_castsi256_pd(_mm256_add_epi64(v, _mm256_set1_epi64x(kMagicBits))),
+          _mm256_set1_pd(kMagic));
+
+      // Both operands are exact, hence the result is correctly rounded.
+      d = exponent >= 0 ? _mm256_mul_pd(d, pow10) : _mm256_div_pd(d, pow10);
+      _mm256_storeu_pd(dest + i, d);
+    }
+  }
+#endif
+
+  for (; i < count; ++i) {
+    dest[i] = FromDecimal(src[i] + min_val, exponent);
+  }
+}
+
+void FromDecimals(const int64_t* src, unsigned count, int64_t min_val, int exponent,
+                  float* dest) {
+  unsigned i = 0;
+
+#ifdef __AVX2__
+  if (std::abs(exponent) <= kMaxExactPow10f) {
+    const __m128 pow10 = _mm_set1_ps(kPow10[std::abs(exponent)]);
+    const __m256i base = _mm256_set1_epi64x(min_val);
+    const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+    for (; i + 4 <= count; i += 4) {
+      __m256i v = _mm256_add_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)),
+                                   base);
+      if (!InExactRange(v, 24)) {
+        for (unsigned j = i; j < i + 4; ++j)
+          dest[j] = FromDecimal(src[j] + min_val, exponent);
+        continue;
+      }
+
+      __m128i v32 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, low_halves));
+      __m128 f = _mm_cvtepi32_ps(v32);
+      f = exponent >= 0 ? _mm_mul_ps(f, pow10) : _mm_div_ps(f, pow10);
+      _mm_storeu_ps(dest + i, f);
+    }
+  }
+#endif
+
+  for (; i < count; ++i) {
+    dest[i] = FromDecimal(src[i] + min_val, exponent);
+  }
+}
+
 }  // namespace
 
-struct DoubleCompressor::ExpInfo {
+template <typename T> struct DecimalCompressor<T>::ExpInfo {
   uint16_t cnt[17];
   ExpInfo() { std::fill(cnt, cnt + 17, 0); }
 
@@ -98,7 +196,8 @@ struct DoubleCompressor::ExpInfo {
   }
 };
 
-void DoubleCompressor::DecimalHeader::Serialize(uint8_t flags, uint8_t* dest) {
+template <typename T>
+void DecimalCompressor<T>::DecimalHeader::Serialize(uint8_t flags, uint8_t* dest) {
   LittleEndian::Store64(dest, min_val); // 8
   dest += sizeof(uint64_t);
   LittleEndian::Store16(dest, exponent); //2
@@ -111,7 +210,8 @@ void DoubleCompressor::DecimalHeader::Serialize(uint8_t flags, uint8_t* dest) {
     LittleEndian::Store16(dest, first_exception_index);
 }
 
-uint32_t DoubleCompressor::DecimalHeader::Parse(uint8_t flags, const uint8_t* src) {
+template <typename T>
+uint32_t DecimalCompressor<T>::DecimalHeader::Parse(uint8_t flags, const uint8_t* src) {
   min_val = LittleEndian::Load64(src); // 8
   src += sizeof(uint64_t);
   exponent = LittleEndian::Load16(src); //2
@@ -128,7 +228,8 @@ uint32_t DoubleCompressor::DecimalHeader::Parse(uint8_t flags, const uint8_t* sr
   return res;
 }
 
-unsigned DoubleCompressor::NormalizeDecimals(unsigned count, const double* dbl_src) {
+template <typename T>
+unsigned DecimalCompressor<T>::NormalizeDecimals(unsigned count, const T* src) {
   aux_->header.min_val = kuint64max;
   aux_->header.first_exception_index = count;
 
@@ -146,7 +247,7 @@ unsigned DoubleCompressor::NormalizeDecimals(unsigned count, const double* dbl_s
         aux_->header.min_val = normal_val;
       normal_cnt++;
     } else {
-      aux_->exceptions[exception_index++] = dbl_src[i];
+      aux_->exceptions[exception_index++] = src[i];
 
       if (aux_->header.first_exception_index != count) {
         aux_->normalized[prev_exception_index] = i - prev_exception_index;
@@ -175,9 +276,10 @@ unsigned DoubleCompressor::NormalizeDecimals(unsigned count, const double* dbl_s
   return normal_cnt;
 }
 
-uint32_t DoubleCompressor::Commit(const double* src, uint32_t count, uint8_t* dest) {
+template <typename T>
+uint32_t DecimalCompressor<T>::Commit(const T* src, uint32_t count, uint8_t* dest) {
   if (count <= 16) {
-    return WriteRawDoubles(src, count, dest);
+    return WriteRaw(src, count, dest);
   }
 
   CHECK_LE(count, BLOCK_MAX_LEN);
@@ -202,7 +304,7 @@ uint32_t DoubleCompressor::Commit(const double* src, uint32_t count, uint8_t* de
 
   unsigned normal_cnt = NormalizeDecimals(count, src);
   if (normal_cnt < count / 2) {
-    return WriteRawDoubles(src, count, dest);
+    return WriteRaw(src, count, dest);
   }
   VLOG(1) << "Cost: " << cost << " normalized count: " << normal_cnt;
 
@@ -223,8 +325,8 @@ uint32_t DoubleCompressor::Commit(const double* src, uint32_t count, uint8_t* de
   int res = LZ4_compress_fast(reinterpret_cast<const char*>(shuffle_buf),  next,
                               kByteSize, LZ4_COMPRESSBOUND(kByteSize), 3 /* level */);
   CHECK_GT(res, 0);
-  if ((res + 8 * exc_count) * 1.1 > kByteSize) {
-    return WriteRawDoubles(src, count, dest);
+  if ((res + sizeof(T) * exc_count) * 1.1 > sizeof(T) * count) {
+    return WriteRaw(src, count, dest);
   }
 
   aux_->header.lz4_size = res;
@@ -232,11 +334,11 @@ uint32_t DoubleCompressor::Commit(const double* src, uint32_t count, uint8_t* de
 
   next += res;
   if (exc_count) {
-    shuffle(sizeof(uint64_t), exc_count * sizeof(uint64_t),
+    shuffle(sizeof(T), exc_count * sizeof(T),
             reinterpret_cast<const uint8_t*>(aux_->exceptions), shuffle_buf);
 
     res = LZ4_compress_fast(reinterpret_cast<const char*>(shuffle_buf), next,
-                            exc_count * 8, end - next, 5);
+                            exc_count * sizeof(T), end - next, 5);
     CHECK_GT(res, 0);
     next += res;
   }
@@ -248,7 +350,7 @@ uint32_t DoubleCompressor::Commit(const double* src, uint32_t count, uint8_t* de
   return written;
 }
 
-uint32_t DoubleCompressor::Optimize(const ExponentMap& em) {
+template <typename T> uint32_t DecimalCompressor<T>::Optimize(const ExponentMap& em) {
   uint32_t best = kuint32max;
 
   uint32_t prefix_cnt = 0;
@@ -273,16 +375,18 @@ uint32_t DoubleCompressor::Optimize(const ExponentMap& em) {
   return best;
 }
 
-uint32_t DoubleCompressor::WriteRawDoubles(const double* src, uint32_t count, uint8_t* dest) {
+template <typename T>
+uint32_t DecimalCompressor<T>::WriteRaw(const T* src, uint32_t count, uint8_t* dest) {
   *dest = kRawBit;
-  uint16_t sz = count * sizeof(double);
+  uint16_t sz = count * sizeof(T);
   LittleEndian::Store16(dest + 1, sz);
   memcpy(dest + 3, src, sz);
   return sz + 3;
 }
 
 
-int32_t  DoubleDecompressor::Decompress(const uint8_t* src, uint32_t src_len, double* dest) {
+template <typename T>
+int32_t DecimalDecompressor<T>::Decompress(const uint8_t* src, uint32_t src_len, T* dest) {
   if (src_len < 3 || LittleEndian::Load16(src + 1) != src_len - 3)
     return -1;
 
@@ -292,21 +396,21 @@ int32_t  DoubleDecompressor::Decompress(const uint8_t* src, uint32_t src_len, do
   src += 3;
 
   if ((flags & kRawBit) != 0) {
-    CHECK_EQ(0, src_len % sizeof(double));
+    CHECK_EQ(0, src_len % sizeof(T));
     memcpy(dest, src, src_len);
-    return src_len / sizeof(double);
+    return src_len / sizeof(T);
   }
-  CHECK_GT(src_len, DoubleCompressor::DECIMAL_HEADER_MAX_SIZE);
+  CHECK_GT(src_len, Compressor::DECIMAL_HEADER_MAX_SIZE);
 
   if (!aux_)
     aux_.reset(new Aux);
 
-  DoubleCompressor::DecimalHeader dh;
+  typename Compressor::DecimalHeader dh;
   uint32 read = dh.Parse(flags, src);
   src_len -= read;
 
   CHECK_LE(dh.lz4_size, src_len);
-  constexpr size_t kMaxSize = DoubleCompressor::BLOCK_MAX_BYTES;
+  constexpr size_t kMaxSize = Compressor::BLOCK_MAX_BYTES;
 
   src += read;
   src_len -= dh.lz4_size;
@@ -317,34 +421,49 @@ int32_t  DoubleDecompressor::Decompress(const uint8_t* src, uint32_t src_len, do
   CHECK_EQ(0, res % 8);
   src += dh.lz4_size;
 
-  bitunshuffle2(aux_->z4buf, res, reinterpret_cast<uint8_t*>(dest));
+  // Doubles are reconstructed in place, floats need a separate buffer for the decimals.
+  int64_t* i64 = sizeof(T) == sizeof(int64_t) ? reinterpret_cast<int64_t*>(dest)
+                                               : aux_->normalized;
+  bitunshuffle2(aux_->z4buf, res, reinterpret_cast<uint8_t*>(i64));
   unsigned count = res / 8;
 
-  unsigned exception_index = count;
-  unsigned exception_id = 0;
+  // Exception slots hold a linked list of exception positions. We collect the positions
+  // and zero the slots before the bulk conversion.
+  unsigned exception_cnt = 0;
   if (flags & kHasExceptionsBit) {
     res = LZ4_decompress_safe(reinterpret_cast<const char*>(src),
                               reinterpret_cast<char*>(aux_->z4buf), src_len,
                               kMaxSize);
     CHECK_GT(res, 0);
-    CHECK_EQ(0, res % 8);
-    unshuffle(sizeof(double), res, aux_->z4buf, reinterpret_cast<uint8*>(aux_->exceptions));
-    exception_index = dh.first_exception_index;
-  }
+    CHECK_EQ(0, res % sizeof(T));
+    unshuffle(sizeof(T), res, aux_->z4buf, reinterpret_cast<uint8*>(aux_->exceptions));
 
-  int64_t* i64 = reinterpret_cast<int64_t*>(dest);
-  for (unsigned i = 0; i < count; ++i) {
-    if (i == exception_index) {
-      unsigned delta = i64[i];
-      dest[i] = aux_->exceptions[exception_id++];
-      exception_index += delta;
+    unsigned max_exceptions = res / sizeof(T);
+    unsigned exception_index = dh.first_exception_index;
+    while (true) {
       CHECK_LT(exception_index, count);
-    } else {
-      int64_t f = i64[i] + dh.min_val;
-      dest[i] = FromDecimal(f, dh.exponent);
+      CHECK_LT(exception_cnt, max_exceptions);
+      aux_->exception_pos[exception_cnt++] = exception_index;
+
+      unsigned delta = i64[exception_index];
+      i64[exception_index] = 0;
+      if (delta == 0)
+        break;
+      exception_index += delta;
     }
   }
+
+  FromDecimals(i64, count, dh.min_val, dh.exponent, dest);
+
+  for (unsigned i = 0; i < exception_cnt; ++i) {
+    dest[aux_->exception_pos[i]] = aux_->exceptions[i];
+  }
   return count;
 }
 
+template class DecimalCompressor<double>;
+template class DecimalCompressor<float>;
+template class DecimalDecompressor<double>;
+template class DecimalDecompressor<float>;
+
 }  // namespace util
@@ -6,12 +6,21 @@
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <type_traits>
 
 namespace util {
 
-class DoubleCompressor {
+/* Compresses blocks of floating point numbers by converting them into decimals with a common
+   exponent. The decimals are bitshuffled and compressed with LZ4. Numbers that can not be
+   normalized are stored separately as exceptions.
+   double and float codecs share the block format except for the size of the raw numbers.
+*/
+template <typename T> class DecimalCompressor {
+  static_assert(std::is_same<T, double>::value || std::is_same<T, float>::value, "");
+
  public:
-  enum { BLOCK_MAX_BYTES = 1U << 16, BLOCK_MAX_LEN = BLOCK_MAX_BYTES / sizeof(double) };  // 2^13
+  // Normalized decimals always take 8 bytes, hence the block length does not depend on T.
+  enum { BLOCK_MAX_BYTES = 1U << 16, BLOCK_MAX_LEN = BLOCK_MAX_BYTES / sizeof(int64_t) };  // 2^13
   enum { COMPRESS_BLOCK_BOUND = (1U << 16) + 3,
          DECIMAL_HEADER_MAX_SIZE = 14};
 
@@ -26,15 +35,15 @@ class DoubleCompressor {
   // COMMIT_MAX_SIZE to accomodate BLOCK_MAX_LEN.
   // Commit will finally write no more than COMPRESS_BLOCK_BOUND bytes even though it will use
   // more space in between.
-  uint32_t Commit(const double* src, uint32_t sz, uint8_t* dest);
+  uint32_t Commit(const T* src, uint32_t sz, uint8_t* dest);
 
  private:
   struct ExpInfo;
   typedef std::map<int16_t, ExpInfo> ExponentMap;
 
-  unsigned NormalizeDecimals(unsigned count, const double* dbl_src);
+  unsigned NormalizeDecimals(unsigned count, const T* src);
   uint32_t Optimize(const ExponentMap& em);
-  uint32_t WriteRawDoubles(const double* src, uint32_t sz, uint8_t* dest);
+  uint32_t WriteRaw(const T* src, uint32_t sz, uint8_t* dest);
 
   struct __attribute__((aligned(4))) Decimal {
     int64_t val;
@@ -58,27 +67,31 @@ class DoubleCompressor {
 
   struct Aux {
     Decimal dec[BLOCK_MAX_LEN];
-    double exceptions[BLOCK_MAX_LEN];
+    T exceptions[BLOCK_MAX_LEN];
     int64_t normalized[BLOCK_MAX_LEN];
 
     DecimalHeader header;
   };
 
   std::unique_ptr<Aux> aux_;
-  friend class DoubleDecompressor;
+  template <typename U> friend class DecimalDecompressor;
 };
 
-class DoubleDecompressor {
+template <typename T> class DecimalDecompressor {
  public:
-  enum {BLOCK_MAX_LEN = DoubleCompressor::BLOCK_MAX_LEN};
+  using Compressor = DecimalCompressor<T>;
+  enum {BLOCK_MAX_LEN = Compressor::BLOCK_MAX_LEN};
 
-  DoubleDecompressor() {}
+  DecimalDecompressor() {}
 
   // dest must accomodate at least BLOCK_MAX_LEN.
   // Returns -1 if it can not decompress src because src_len is not exact block size.
   // Fully consumes successfully decompressed block.
-  // On success returns how many doubles were written to dest.
-  int32_t Decompress(const uint8_t* src, uint32_t src_len, double* dest);
+  // On success returns how many numbers were written to dest.
+  // Decimals are converted to T with vectorized multiplication or division by the power of 10
+  // of the block exponent. Only numbers which do not fit the exact conversion are converted
+  // one by one.
+  int32_t Decompress(const uint8_t* src, uint32_t src_len, T* dest);
 
   // a valid header must point at least 3 bytes.
   // Returns block size including the header size.
@@ -88,11 +101,26 @@ class DoubleDecompressor {
 
  private:
   struct Aux {
-    uint8_t z4buf[DoubleCompressor::BLOCK_MAX_BYTES];
-    double exceptions[BLOCK_MAX_LEN];
+    uint8_t z4buf[Compressor::BLOCK_MAX_BYTES];
+    T exceptions[BLOCK_MAX_LEN];
+    uint16_t exception_pos[BLOCK_MAX_LEN];
+
+    // Decimals of float blocks. Doubles are reconstructed in place.
+    int64_t normalized[sizeof(T) == sizeof(int64_t) ? 1 : BLOCK_MAX_LEN];
   };
 
   std::unique_ptr<Aux> aux_;
 };
 
+using DoubleCompressor = DecimalCompressor<double>;
+using DoubleDecompressor = DecimalDecompressor<double>;
+
+using FloatCompressor = DecimalCompressor<float>;
+using FloatDecompressor = DecimalDecompressor<float>;
+
+extern template class DecimalCompressor<double>;
+extern template class DecimalCompressor<float>;
+extern template class DecimalDecompressor<double>;
+extern template class DecimalDecompressor<float>;
+
 }  // namespace util
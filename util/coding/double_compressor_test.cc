@@ -4,6 +4,7 @@
 #include "util/coding/double_compressor.h"
 #include <gmock/gmock.h>
 
+#include "base/gtest.h"
 #include "base/logging.h"
 #include "util/math/float2decimal.h"
 
@@ -78,4 +79,82 @@ TEST_F(DoubleCompressorTest, BigExp) {
   ASSERT_EQ(128, res);
 }
 
+TEST_F(DoubleCompressorTest, Exact) {
+  std::vector<double> arr;
+  for (unsigned i = 0; i < 4000; ++i) {
+    arr.push_back((int64_t(i) * 7919 % 200001 - 100000) / 1000.0);
+  }
+
+  // Exceptions.
+  arr[17] = 1e300;
+  arr[18] = 1.0 / 3;
+  arr[3999] = -1e-300;
+
+  uint32_t sz = dc_.Commit(arr.data(), arr.size(), buf_);
+  ASSERT_EQ(arr.size(), dd_.Decompress(buf_, sz, actual_));
+  for (unsigned i = 0; i < arr.size(); ++i) {
+    ASSERT_EQ(arr[i], actual_[i]) << i;
+  }
+}
+
+TEST_F(DoubleCompressorTest, Float) {
+  std::vector<float> arr;
+  for (unsigned i = 0; i < 3000; ++i) {
+    arr.push_back((int(i) % 500 - 250) / 100.0f);
+  }
+  arr[5] = 1e30f;
+
+  std::unique_ptr<uint8_t[]> buf(new uint8_t[FloatCompressor::COMMIT_MAX_SIZE]);
+  std::unique_ptr<float[]> actual(new float[FloatDecompressor::BLOCK_MAX_LEN]);
+  FloatCompressor fc;
+  FloatDecompressor fd;
+
+  uint32_t sz = fc.Commit(arr.data(), arr.size(), buf.get());
+  EXPECT_LT(sz, arr.size() * sizeof(float));
+  ASSERT_EQ(arr.size(), fd.Decompress(buf.get(), sz, actual.get()));
+  for (unsigned i = 0; i < arr.size(); ++i) {
+    ASSERT_EQ(arr[i], actual[i]) << i;
+  }
+
+  // Raw block.
+  sz = fc.Commit(arr.data(), 10, buf.get());
+  EXPECT_EQ(3 + 10 * sizeof(float), sz);
+  ASSERT_EQ(10, fd.Decompress(buf.get(), sz, actual.get()));
+  EXPECT_EQ(arr[9], actual[9]);
+}
+
+static void BM_DoubleDecompress(benchmark::State& state) {
+  std::vector<double> vals(DoubleCompressor::BLOCK_MAX_LEN);
+  for (unsigned i = 0; i < vals.size(); ++i) {
+    vals[i] = (i * 7919 % 100000) / 100.0;
+  }
+  std::unique_ptr<uint8_t[]> buf(new uint8_t[DoubleCompressor::COMMIT_MAX_SIZE]);
+  DoubleCompressor dc;
+  uint32_t sz = dc.Commit(vals.data(), vals.size(), buf.get());
+
+  DoubleDecompressor dd;
+  while (state.KeepRunning()) {
+    CHECK_EQ(vals.size(), dd.Decompress(buf.get(), sz, vals.data()));
+  }
+  state.SetItemsProcessed(state.iterations() * vals.size());
+}
+BENCHMARK(BM_DoubleDecompress);
+
+static void BM_FloatDecompress(benchmark::State& state) {
+  std::vector<float> vals(FloatCompressor::BLOCK_MAX_LEN);
+  for (unsigned i = 0; i < vals.size(); ++i) {
+    vals[i] = (i % 1000) / 100.0f;
+  }
+  std::unique_ptr<uint8_t[]> buf(new uint8_t[FloatCompressor::COMMIT_MAX_SIZE]);
+  FloatCompressor fc;
+  uint32_t sz = fc.Commit(vals.data(), vals.size(), buf.get());
+
+  FloatDecompressor fd;
+  while (state.KeepRunning()) {
+    CHECK_EQ(vals.size(), fd.Decompress(buf.get(), sz, vals.data()));
+  }
+  state.SetItemsProcessed(state.iterations() * vals.size());
+}
+BENCHMARK(BM_FloatDecompress);
+
 }  // namespace util
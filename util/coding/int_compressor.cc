@@ -0,0 +1,373 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "util/coding/int_compressor.h"
+
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
+
+#include "base/bits.h"
+#include "base/endian.h"
+#include "base/flit.h"
+#include "base/logging.h"
+#include "base/varint.h"
+
+namespace util {
+
+namespace {
+
+constexpr uint8_t kDeltaBit = 1 << 7;
+constexpr uint8_t kWidthMask = 0x7F;
+constexpr unsigned kLanes = 4;
+
+static_assert(IntCompressor::BLOCK_LEN == 128, "Packing kernels assume 128 values");
+
+// Number of bytes that 128 values of width w occupy.
+constexpr unsigned PackedSize(unsigned w) {
+  return IntCompressor::BLOCK_LEN * w / 8;
+}
+
+inline unsigned BitWidth(uint64_t v) {
+  return v ? Bits::FindMSBSet64NonZero(v) + 1 : 0;
+}
+
+/* Packs 128 values of width w <= 32 into 4 interleaved lanes: value i goes to lane i % 4
+   and the lanes are written as consecutive 32 bit words, i.e. word k of the lane l is
+   stored at dest[4 * k + l]. dest must have 4 * w words.
+*/
+void Pack128(const uint32_t* src, unsigned w, uint32_t* dest) {
+  std::fill(dest, dest + kLanes * w, 0);
+  if (w == 0)
+    return;
+
+  for (unsigned i = 0; i < IntCompressor::BLOCK_LEN; ++i) {
+    unsigned lane = i % kLanes;
+    unsigned pos = (i / kLanes) * w;
+    unsigned k = pos / 32, shift = pos % 32;
+    uint32_t* word = dest + kLanes * k + lane;
+
+    word[0] |= src[i] << shift;
+    if (shift + w > 32)
+      word[kLanes] |= src[i] >> (32 - shift);
+  }
+}
+
+// Inverse of Pack128. Each step unpacks 4 values, one per lane. The width is a template
+// argument, so that the loop unrolls into constant shifts and masks.
+template <unsigned W> void Unpack128(const uint32_t* src, uint32_t* dest) {
+  const __m128i* in = reinterpret_cast<const __m128i*>(src);
+  __m128i* out = reinterpret_cast<__m128i*>(dest);
+  const __m128i mask = _mm_set1_epi32(W == 32 ? ~0U : (1U << W) - 1);
+
+#pragma GCC unroll 32
+  for (unsigned j = 0; j < IntCompressor::BLOCK_LEN / kLanes; ++j) {
+    const unsigned pos = j * W, k = pos / 32, shift = pos % 32;
+    __m128i v = _mm_srli_epi32(_mm_loadu_si128(in + k), shift);
+    if (shift + W > 32) {
+      v = _mm_or_si128(v, _mm_slli_epi32(_mm_loadu_si128(in + k + 1), 32 - shift));
+    }
+    _mm_storeu_si128(out + j, _mm_and_si128(v, mask));
+  }
+}
+
+template <> void Unpack128<0>(const uint32_t* src, uint32_t* dest) {
+  std::fill(dest, dest + IntCompressor::BLOCK_LEN, 0);
+}
+
+using UnpackFn = void (*)(const uint32_t*, uint32_t*);
+
+template <size_t... W> constexpr std::array<UnpackFn, sizeof...(W)> MakeUnpackTable(
+    std::index_sequence<W...>) {
+  return {{&Unpack128<W>...}};
+}
+
+constexpr std::array<UnpackFn, 33> kUnpack = MakeUnpackTable(std::make_index_sequence<33>{});
+
+struct BlockPlan {
+  unsigned width = 0;
+  unsigned exceptions = 0;
+  unsigned size = 0;
+};
+
+// Chooses bit width that minimizes the packed size. Offsets wider than the chosen width
+// become exceptions that cost a position byte and a varint of their high bits.
+BlockPlan PlanWidth(const uint64_t* offset, unsigned count) {
+  unsigned hist[65] = {0};
+  for (unsigned i = 0; i < count; ++i)
+    ++hist[BitWidth(offset[i])];
+
+  unsigned max_width = 64;
+  while (max_width > 0 && hist[max_width] == 0)
+    --max_width;
+
+  BlockPlan best;
+  best.width = max_width;
+  best.size = PackedSize(max_width);
+
+  unsigned wider = 0;  // number of offsets wider than w.
+  for (unsigned w = max_width; w-- > 0;) {
+    wider += hist[w + 1];
+    unsigned size = PackedSize(w) + wider * (1 + (max_width - w + 6) / 7);
+    if (size < best.size) {
+      best.width = w;
+      best.exceptions = wider;
+      best.size = size;
+    }
+  }
+
+  return best;
+}
+
+}  // namespace
+
+uint32_t IntCompressor::CommitBlock(const uint64_t* src, uint32_t count, uint8_t* dest) {
+  DCHECK_GT(count, 0);
+  DCHECK_LE(count, BLOCK_LEN);
+
+  // Frame of reference.
+  uint64_t min_val = *std::min_element(src, src + count);
+  for (unsigned i = 0; i < count; ++i)
+    offset_[i] = src[i] - min_val;
+  BlockPlan plan = PlanWidth(offset_, count);
+
+  // Delta: offsets of successive differences from their minimum. Differences are computed
+  // with wrap-around arithmetic and compared as signed numbers.
+  bool is_delta = false;
+  int64_t min_delta = 0;
+  if (count > 2) {
+    uint64_t delta[BLOCK_LEN];
+    delta[0] = 0;
+    min_delta = int64_t(src[1] - src[0]);
+    for (unsigned i = 1; i < count; ++i) {
+      delta[i] = src[i] - src[i - 1];
+      min_delta = std::min<int64_t>(min_delta, delta[i]);
+    }
+    for (unsigned i = 1; i < count; ++i)
+      delta[i] -= min_delta;
+
+    BlockPlan delta_plan = PlanWidth(delta, count);
+    if (delta_plan.size < plan.size) {
+      is_delta = true;
+      plan = delta_plan;
+      std::copy(delta, delta + count, offset_);
+    }
+  }
+  std::fill(offset_ + count, offset_ + BLOCK_LEN, 0);
+
+  uint8_t* next = dest;
+  *next++ = plan.width | (is_delta ? kDeltaBit : 0);
+  *next++ = count - 1;
+  *next++ = plan.exceptions;
+  next = Varint::Encode64(next, is_delta ? src[0] : min_val);
+  if (is_delta)
+    next = Varint::Encode64(next, base::ZigZagEncode(min_delta));
+
+  // Low halves of the offsets and then high halves for widths above 32.
+  unsigned low_width = std::min(plan.width, 32U);
+  for (unsigned i = 0; i < BLOCK_LEN; ++i)
+    half_[i] = uint32_t(offset_[i]) & (low_width == 32 ? ~0U : (1U << low_width) - 1);
+  Pack128(half_, low_width, packed_);
+  memcpy(next, packed_, PackedSize(low_width));
+  next += PackedSize(low_width);
+
+  if (plan.width > 32) {
+    unsigned high_width = plan.width - 32;
+    for (unsigned i = 0; i < BLOCK_LEN; ++i)
+      half_[i] = (offset_[i] >> 32) & ((1ULL << high_width) - 1);
+    Pack128(half_, high_width, packed_);
+    memcpy(next, packed_, PackedSize(high_width));
+    next += PackedSize(high_width);
+  }
+
+  // Exceptions: positions followed by the high bits.
+  if (plan.exceptions) {
+    uint8_t* pos = next;
+    next += plan.exceptions;
+    for (unsigned i = 0; i < count; ++i) {
+      uint64_t high = plan.width < 64 ? offset_[i] >> plan.width : 0;
+      if (high) {
+        *pos++ = i;
+        next = Varint::Encode64(next, high);
+      }
+    }
+  }
+
+  DCHECK_LE(next - dest, BLOCK_MAX_SIZE);
+  return next - dest;
+}
+
+size_t IntCompressor::Compress(const uint64_t* src, size_t count, uint8_t* dest) {
+  uint8_t* next = dest;
+  std::vector<IntDecompressor::BlockInfo> blocks;
+  blocks.reserve((count + BLOCK_LEN - 1) / BLOCK_LEN);
+
+  for (size_t i = 0; i < count; i += BLOCK_LEN) {
+    uint32_t len = std::min<size_t>(BLOCK_LEN, count - i);
+    auto mm = std::minmax_element(src + i, src + i + len);
+    blocks.push_back(IntDecompressor::BlockInfo{*mm.first, *mm.second, uint32_t(next - dest)});
+    next += CommitBlock(src + i, len, next);
+  }
+
+  for (const auto& b : blocks) {
+    LittleEndian::Store64(next, b.min_val);
+    LittleEndian::Store64(next + 8, b.max_val);
+    LittleEndian::Store32(next + 16, b.offset);
+    next += FOOTER_ENTRY_SIZE;
+  }
+  LittleEndian::Store32(next, count);
+  LittleEndian::Store32(next + 4, blocks.size());
+  next += TRAILER_SIZE;
+
+  return next - dest;
+}
+
+bool IntDecompressor::Init(const uint8_t* src, size_t len) {
+  src_ = src;
+  blocks_.clear();
+  num_values_ = 0;
+
+  if (len < IntCompressor::TRAILER_SIZE)
+    return false;
+
+  const uint8_t* trailer = src + len - IntCompressor::TRAILER_SIZE;
+  uint32_t num_values = LittleEndian::Load32(trailer);
+  uint32_t num_blocks = LittleEndian::Load32(trailer + 4);
+  if (num_blocks != (num_values + BLOCK_LEN - 1) / BLOCK_LEN)
+    return false;
+
+  size_t footer_size = size_t(num_blocks) * IntCompressor::FOOTER_ENTRY_SIZE;
+  if (footer_size > len - IntCompressor::TRAILER_SIZE)
+    return false;
+
+  const uint8_t* footer = trailer - footer_size;
+  uint32_t data_end = footer - src;
+  blocks_.resize(num_blocks);
+  for (unsigned i = 0; i < num_blocks; ++i) {
+    const uint8_t* entry = footer + i * IntCompressor::FOOTER_ENTRY_SIZE;
+    BlockInfo& b = blocks_[i];
+    b.min_val = LittleEndian::Load64(entry);
+    b.max_val = LittleEndian::Load64(entry + 8);
+    b.offset = LittleEndian::Load32(entry + 16);
+    if (b.offset > data_end || (i > 0 && b.offset <= blocks_[i - 1].offset))
+      return false;
+  }
+
+  end_offset_ = data_end;
+  num_values_ = num_values;
+
+  return true;
+}
+
+int32_t IntDecompressor::DecompressBlock(unsigned index, uint64_t* dest) {
+  DCHECK_LT(index, blocks_.size());
+
+  uint32_t start = blocks_[index].offset;
+  uint32_t end = index + 1 < blocks_.size() ? blocks_[index + 1].offset : end_offset_;
+
+  // All the blocks but the last one are full. Init() verified that num_blocks matches.
+  unsigned count = std::min<size_t>(BLOCK_LEN, num_values_ - size_t(index) * BLOCK_LEN);
+  int32_t res = DecodeBlock(src_ + start, end - start, dest, count);
+  return res == int32_t(count) ? res : -1;
+}
+
+bool IntDecompressor::Decompress(uint64_t* dest) {
+  size_t total = 0;
+  for (unsigned i = 0; i < blocks_.size(); ++i) {
+    int32_t res = DecompressBlock(i, dest + total);
+    if (res < 0)
+      return false;
+    total += res;
+  }
+  return total == num_values_;
+}
+
+int32_t IntDecompressor::DecodeBlock(const uint8_t* src, uint32_t len, uint64_t* dest,
+                                     unsigned max_count) {
+  const uint8_t* end = src + len;
+  if (len < 4)
+    return -1;
+
+  unsigned width = src[0] & kWidthMask;
+  bool is_delta = src[0] & kDeltaBit;
+  unsigned count = unsigned(src[1]) + 1;
+  unsigned num_exceptions = src[2];
+  if (count > max_count || count > BLOCK_LEN || width > 64 || num_exceptions > count ||
+      (num_exceptions && width == 64))
+    return -1;
+
+  const uint8_t* next = src + 3;
+  uint64_t reference = 0, zz_delta = 0;
+  next = Varint::Parse64WithLimit(next, end, &reference);
+  if (next && is_delta)
+    next = Varint::Parse64WithLimit(next, end, &zz_delta);
+  if (!next)
+    return -1;
+
+  unsigned low_width = std::min(width, 32U);
+  unsigned high_width = width > 32 ? width - 32 : 0;
+  if (size_t(end - next) < PackedSize(low_width) + PackedSize(high_width) + num_exceptions)
+    return -1;
+
+  alignas(16) uint32_t low[BLOCK_LEN];
+  kUnpack[low_width](reinterpret_cast<const uint32_t*>(next), low);
+  next += PackedSize(low_width);
+
+  // The common case of frame of reference without exceptions and narrow offsets
+  // widens and adds the reference 2 values at a time.
+  if (!is_delta && !num_exceptions && high_width == 0) {
+    const __m128i ref = _mm_set1_epi64x(reference);
+    __m128i* out = reinterpret_cast<__m128i*>(dest);
+    for (unsigned i = 0; i < count / 2; ++i) {
+      __m128i v = _mm_cvtepu32_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(low + i * 2)));
+      _mm_storeu_si128(out + i, _mm_add_epi64(v, ref));
+    }
+    if (count % 2)
+      dest[count - 1] = reference + low[count - 1];
+    return next == end ? count : -1;
+  }
+
+  alignas(16) uint64_t offset[BLOCK_LEN];
+  if (high_width) {
+    alignas(16) uint32_t high[BLOCK_LEN];
+    kUnpack[high_width](reinterpret_cast<const uint32_t*>(next), high);
+    next += PackedSize(high_width);
+    for (unsigned i = 0; i < count; ++i)
+      offset[i] = low[i] | (uint64_t(high[i]) << 32);
+  } else {
+    std::copy(low, low + count, offset);
+  }
+
+  // Patches the exceptions.
+  const uint8_t* pos = next;
+  next += num_exceptions;
+  for (unsigned i = 0; i < num_exceptions; ++i) {
+    uint64_t high;
+    next = Varint::Parse64WithLimit(next, end, &high);
+    if (!next || pos[i] >= count)
+      return -1;
+    offset[pos[i]] |= high << width;
+  }
+
+  if (next != end)
+    return -1;
+
+  if (is_delta) {
+    uint64_t min_delta = base::ZigZagDecode<int64_t>(zz_delta);
+    uint64_t val = reference - min_delta;
+    for (unsigned i = 0; i < count; ++i) {
+      val += offset[i] + min_delta;
+      dest[i] = val;
+    }
+  } else {
+    for (unsigned i = 0; i < count; ++i)
+      dest[i] = reference + offset[i];
+  }
+
+  return count;
+}
+
+}  // namespace util
@@ -0,0 +1,94 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace util {
+
+/* Block codec for integer columns like timestamps, ids and counters.
+
+   Values are split into blocks of BLOCK_LEN values. Each block is encoded either as
+   offsets from the block minimum (frame of reference) or as offsets of successive
+   differences from their minimum (delta), whichever is smaller.
+   The offsets are bit-packed with the bit width that minimizes the block size.
+   Offsets that do not fit the width are patched: their low bits are packed and the high bits
+   are stored separately as exceptions. The packed layout interleaves 4 lanes, so that
+   the decoder unpacks 4 values per SSE instruction.
+
+   Compress() writes the blocks followed by a footer with per-block min/max values,
+   that allows skipping blocks without decoding them.
+   Signed values should be mapped via base::ZigZagEncode.
+*/
+class IntCompressor {
+ public:
+  enum { BLOCK_LEN = 128 };
+
+  // header + 2 references + 64 bit packed values + exceptions.
+  enum { BLOCK_MAX_SIZE = 3 + 20 + BLOCK_LEN * 8 + BLOCK_LEN * 11 };
+
+  enum { FOOTER_ENTRY_SIZE = 20, TRAILER_SIZE = 8 };
+
+  static constexpr size_t CompressBound(size_t count) {
+    return (count + BLOCK_LEN - 1) / BLOCK_LEN * (BLOCK_MAX_SIZE + FOOTER_ENTRY_SIZE) +
+           TRAILER_SIZE;
+  }
+
+  // Encodes a single block of 1..BLOCK_LEN values into dest, which must have at least
+  // BLOCK_MAX_SIZE bytes. Returns number of written bytes.
+  uint32_t CommitBlock(const uint64_t* src, uint32_t count, uint8_t* dest);
+
+  // Encodes count values followed by the footer.
+  // dest must have at least CompressBound(count) bytes. Returns number of written bytes.
+  size_t Compress(const uint64_t* src, size_t count, uint8_t* dest);
+
+ private:
+  // Scratch space: 64 bit offsets, their 32 bit halves and the packed halves.
+  uint64_t offset_[BLOCK_LEN];
+  uint32_t half_[BLOCK_LEN];
+  uint32_t packed_[BLOCK_LEN];
+};
+
+class IntDecompressor {
+ public:
+  enum { BLOCK_LEN = IntCompressor::BLOCK_LEN };
+
+  struct BlockInfo {
+    uint64_t min_val, max_val;
+    uint32_t offset;  // from the beginning of the compressed data.
+  };
+
+  // Parses the footer of IntCompressor::Compress output. src must stay valid while
+  // the object is used. Returns false if the input is malformed.
+  bool Init(const uint8_t* src, size_t len);
+
+  size_t num_values() const { return num_values_; }
+  unsigned num_blocks() const { return blocks_.size(); }
+
+  // Block min/max allow skipping blocks without decoding them.
+  const BlockInfo& block(unsigned index) const { return blocks_[index]; }
+
+  // dest must accomodate BLOCK_LEN values.
+  // Returns number of decoded values or -1 if the block is corrupted.
+  int32_t DecompressBlock(unsigned index, uint64_t* dest);
+
+  // dest must accomodate num_values(). Returns false if the input is corrupted.
+  bool Decompress(uint64_t* dest);
+
+  // Decodes a single block produced by IntCompressor::CommitBlock. dest must accomodate
+  // max_count values. Returns number of decoded values or -1 if src is not a valid block of
+  // exactly len bytes with at most max_count values.
+  static int32_t DecodeBlock(const uint8_t* src, uint32_t len, uint64_t* dest,
+                             unsigned max_count = BLOCK_LEN);
+
+ private:
+  const uint8_t* src_ = nullptr;
+  size_t num_values_ = 0;
+  uint32_t end_offset_ = 0;  // end of the last block.
+  std::vector<BlockInfo> blocks_;
+};
+
+}  // namespace util
@@ -0,0 +1,171 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "util/coding/int_compressor.h"
+
+#include <random>
+
+#include "base/gtest.h"
+#include "base/logging.h"
+
+namespace util {
+
+using namespace std;
+
+class IntCompressorTest : public testing::Test {
+ protected:
+  // Compresses and decompresses vals, returns the compressed size.
+  size_t RoundTrip(const vector<uint64_t>& vals) {
+    buf_.resize(IntCompressor::CompressBound(vals.size()));
+    size_t sz = ic_.Compress(vals.data(), vals.size(), buf_.data());
+    CHECK_LE(sz, buf_.size());
+
+    CHECK(id_.Init(buf_.data(), sz));
+    EXPECT_EQ(vals.size(), id_.num_values());
+
+    vector<uint64_t> actual(vals.size());
+    EXPECT_TRUE(id_.Decompress(actual.data()));
+    EXPECT_EQ(vals, actual);
+    return sz;
+  }
+
+  IntCompressor ic_;
+  IntDecompressor id_;
+  vector<uint8_t> buf_;
+  std::mt19937_64 rnd_;
+};
+
+TEST_F(IntCompressorTest, Basic) {
+  RoundTrip({});
+  RoundTrip({5});
+  RoundTrip({1, 2});
+  RoundTrip({7, 7, 7, 7});
+
+  vector<uint64_t> vals(1000);
+  for (unsigned i = 0; i < vals.size(); ++i)
+    vals[i] = i % 17;
+  size_t sz = RoundTrip(vals);
+  EXPECT_LT(sz, vals.size());  // 5 bits per value and the footer.
+}
+
+TEST_F(IntCompressorTest, Widths) {
+  for (unsigned width = 1; width <= 64; ++width) {
+    vector<uint64_t> vals(300);
+    uint64_t mask = width == 64 ? ~0ULL : (1ULL << width) - 1;
+    for (auto& v : vals)
+      v = rnd_() & mask;
+    RoundTrip(vals);
+  }
+}
+
+TEST_F(IntCompressorTest, Timestamps) {
+  vector<uint64_t> vals(10000);
+  uint64_t ts = 1546300800000000ULL;
+  for (auto& v : vals) {
+    ts += 1000 + rnd_() % 16;
+    v = ts;
+  }
+  size_t sz = RoundTrip(vals);
+
+  // Deltas take 4 bits.
+  EXPECT_LT(sz, vals.size());
+
+  // Decreasing values produce negative deltas.
+  std::reverse(vals.begin(), vals.end());
+  EXPECT_LT(RoundTrip(vals), vals.size());
+}
+
+TEST_F(IntCompressorTest, Exceptions) {
+  vector<uint64_t> vals(1024);
+  for (auto& v : vals)
+    v = rnd_() % 8;
+
+  size_t base_sz = RoundTrip(vals);
+  for (unsigned i = 0; i < vals.size(); i += 100)
+    vals[i] = rnd_();
+
+  // Outliers are patched instead of widening their blocks.
+  EXPECT_LT(RoundTrip(vals), base_sz + 11 * 11);
+}
+
+TEST_F(IntCompressorTest, Footer) {
+  vector<uint64_t> vals(1000);
+  for (unsigned i = 0; i < vals.size(); ++i)
+    vals[i] = 1000 - i;
+  RoundTrip(vals);
+
+  ASSERT_EQ(8, id_.num_blocks());
+  uint64_t block[IntCompressor::BLOCK_LEN];
+  for (unsigned i = 0; i < id_.num_blocks(); ++i) {
+    const auto& info = id_.block(i);
+    EXPECT_EQ(1000 - i * 128, info.max_val);
+    int32_t res = id_.DecompressBlock(i, block);
+    ASSERT_EQ(i < 7 ? 128 : 1000 - 7 * 128, res);
+    EXPECT_EQ(info.min_val, *std::min_element(block, block + res));
+  }
+}
+
+TEST_F(IntCompressorTest, Corrupted) {
+  vector<uint64_t> vals(500);
+  for (auto& v : vals)
+    v = rnd_() % 1000;
+  size_t sz = RoundTrip(vals);
+
+  EXPECT_FALSE(id_.Init(buf_.data(), 5));
+  EXPECT_FALSE(id_.Init(buf_.data(), sz - 1));
+
+  uint64_t block[IntCompressor::BLOCK_LEN];
+  EXPECT_EQ(-1, IntDecompressor::DecodeBlock(buf_.data(), 3, block));
+  uint32_t block_sz = id_.block(1).offset;
+  EXPECT_EQ(128, IntDecompressor::DecodeBlock(buf_.data(), block_sz, block));
+  EXPECT_EQ(-1, IntDecompressor::DecodeBlock(buf_.data(), block_sz - 1, block));
+  EXPECT_EQ(-1, IntDecompressor::DecodeBlock(buf_.data(), block_sz, block, 127));
+}
+
+TEST_F(IntCompressorTest, CorruptedCount) {
+  vector<uint64_t> vals(300);
+  for (auto& v : vals)
+    v = rnd_() % 1000;
+  size_t sz = RoundTrip(vals);
+
+  // The last block holds 44 values. Claims a full block, which would overflow dest.
+  uint32_t last = id_.block(2).offset;
+  ASSERT_EQ(43, buf_[last + 1]);
+  buf_[last + 1] = 127;
+  ASSERT_TRUE(id_.Init(buf_.data(), sz));
+
+  uint64_t block[IntCompressor::BLOCK_LEN];
+  EXPECT_EQ(-1, id_.DecompressBlock(2, block));
+
+  vector<uint64_t> dest(vals.size() + IntCompressor::BLOCK_LEN, 0);
+  EXPECT_FALSE(id_.Decompress(dest.data()));
+  for (size_t i = vals.size(); i < dest.size(); ++i) {
+    ASSERT_EQ(0, dest[i]) << i;
+  }
+
+  // A count beyond BLOCK_LEN is rejected as well.
+  buf_[id_.block(0).offset + 1] = 255;
+  EXPECT_EQ(-1, id_.DecompressBlock(0, block));
+  EXPECT_FALSE(id_.Decompress(dest.data()));
+}
+
+static void BM_IntDecompress(benchmark::State& state) {
+  std::mt19937_64 rnd;
+  vector<uint64_t> vals(1 << 16);
+  for (auto& v : vals)
+    v = rnd() & ((1ULL << state.range(0)) - 1);
+
+  IntCompressor ic;
+  vector<uint8_t> buf(IntCompressor::CompressBound(vals.size()));
+  size_t sz = ic.Compress(vals.data(), vals.size(), buf.data());
+
+  IntDecompressor id;
+  CHECK(id.Init(buf.data(), sz));
+  while (state.KeepRunning()) {
+    CHECK(id.Decompress(vals.data()));
+  }
+  state.SetItemsProcessed(state.iterations() * vals.size());
+}
+BENCHMARK(BM_IntDecompress)->Arg(4)->Arg(13)->Arg(32);
+
+}  // namespace util
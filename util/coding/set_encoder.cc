@@ -998,13 +998,10 @@ void SeqDecoderBase::DecompressCodes(const uint8_t* src) {
                                bh_.byte_len_size_comprs);
   CHECK(!ZSTD_isError(res)) << ZSTD_getErrorName(res);
 
-  uint8_t* next = code_buf_.data(), *end = next + res;
-  size_t index = 0;
-  while (next < end && index < len_code_.size()) {
-    next += flit::ParseT(next, &len_code_[index]);
-    index++;
-  }
-  CHECK_EQ(index, len_code_.size());
+  // Each code takes at least one byte.
+  CHECK_LE(len_code_.size(), res);
+  const uint8_t* end = code_buf_.data() + res;
+  const uint8_t* next = flit::DecodeN(code_buf_.data(), len_code_.size(), len_code_.data());
   CHECK_EQ(next, end);
 }
 
@@ -15,39 +15,28 @@ FiberQueue::FiberQueue(unsigned queue_size) : queue_(queue_size) {
 }
 
 void FiberQueue::Run() {
-  bool is_closed = false;
-  CbFunc func;
-
-  auto cb = [&] {
-    if (queue_.try_dequeue(func)) {
-      push_ec_.notify();
-      return true;
-    }
-
-    if (is_closed_.load(std::memory_order_acquire)) {
-      is_closed = true;
-      return true;
-    }
-    return false;
-  };
+  constexpr size_t kBatchSize = 16;
+  CbFunc funcs[kBatchSize];
 
   while (true) {
-    pull_ec_.await(cb);
-
-    if (is_closed)
+    size_t count = queue_.PopBatch(funcs, kBatchSize);
+    if (count == 0)
       break;
-    try {
-      func();
-    } catch (std::exception& e) {
-      // std::exception_ptr p = std::current_exception();
-      LOG(FATAL) << "Exception " << e.what();
+
+    for (size_t i = 0; i < count; ++i) {
+      try {
+        funcs[i]();
+      } catch (std::exception& e) {
+        // std::exception_ptr p = std::current_exception();
+        LOG(FATAL) << "Exception " << e.what();
+      }
+      funcs[i].Reset();
     }
   }
 }
 
 void FiberQueue::Shutdown() {
-  is_closed_.store(true, memory_order_seq_cst);
-  pull_ec_.notify();
+  queue_.StartClosing();
 }
 
 FiberQueueThreadPool::FiberQueueThreadPool(unsigned num_threads, unsigned queue_size) {
@@ -77,8 +66,7 @@ void FiberQueueThreadPool::Shutdown() {
     return;
 
   for (size_t i = 0; i < worker_size_; ++i) {
-    workers_[i].q->is_closed_.store(true, memory_order_seq_cst);
-    workers_[i].q->pull_ec_.notifyAll();
+    workers_[i].q->Shutdown();
   }
 
   for (size_t i = 0; i < worker_size_; ++i) {
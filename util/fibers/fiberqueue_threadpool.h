@@ -3,8 +3,9 @@
 //
 #pragma once
 
-#include "base/mpmc_bounded_queue.h"
 #include "util/fibers/fibers_ext.h"
+#include "util/fibers/inline_task.h"
+#include "util/fibers/mpmc_channel.h"
 
 namespace util {
 namespace fibers_ext {
@@ -24,13 +25,7 @@ class FiberQueue {
   explicit FiberQueue(unsigned queue_size = 128);
   FiberQueue();
 
-  template <typename F> bool TryAdd(F&& f) {
-    if (queue_.try_enqueue(std::forward<F>(f))) {
-      pull_ec_.notify();
-      return true;
-    }
-    return false;
-  }
+  template <typename F> bool TryAdd(F&& f) { return queue_.TryPush(std::forward<F>(f)); }
 
   /**
    * @brief Submits a callback into the queue. Should not be called after calling Shutdown().
@@ -44,17 +39,8 @@ class FiberQueue {
       return false;
     }
 
-    bool result = false;
-    while (true) {
-      EventCount::Key key = push_ec_.prepareWait();
-
-      if (TryAdd(std::forward<F>(f))) {
-        break;
-      }
-      result = true;
-      push_ec_.wait(key.epoch());
-    }
-    return result;
+    queue_.Push(std::forward<F>(f));
+    return true;
   }
 
   /**
@@ -87,14 +73,10 @@ class FiberQueue {
   void Run();
 
  private:
-  typedef std::function<void()> CbFunc;
+  // Small callbacks are stored inline in the queue cells, without heap allocations.
+  using CbFunc = InlineTask;
 
-
-  using FuncQ = base::mpmc_bounded_queue<CbFunc>;
-  FuncQ queue_;
-
-  EventCount push_ec_, pull_ec_;
-  std::atomic_bool is_closed_{false};
+  MPMCChannel<CbFunc> queue_;
 };
 
 // This thread pool has a global fiber-friendly queue for incoming tasks.
@@ -134,14 +116,7 @@ class FiberQueueThreadPool {
   template <typename F> void Add(F&& f) {
     size_t start = next_index_.fetch_add(1, std::memory_order_relaxed) % worker_size_;
     Worker& main_w = workers_[start];
-    while (true) {
-      EventCount::Key key = main_w.q->push_ec_.prepareWait();
-      if (AddAnyWorker(start, std::forward<F>(f))) {
-        break;
-      }
-
-      main_w.q->push_ec_.wait(key.epoch());
-    }
+    main_w.q->queue_.AwaitPushable([&] { return AddAnyWorker(start, std::forward<F>(f)); });
   }
 
 
@@ -1,11 +1,15 @@
 // Copyright 2019, Beeri 15.  All rights reserved.
 // Author: Roman Gershman (romange@gmail.com)
 //
+#include <boost/fiber/buffered_channel.hpp>
+
 #include "base/gtest.h"
+#include "base/logging.h"
 #include "base/walltime.h"
 
 #include "util/asio/io_context_pool.h"
 #include "util/fibers/fiberqueue_threadpool.h"
+#include "util/fibers/mpmc_channel.h"
 #include "util/fibers/simple_channel.h"
 
 using namespace boost;
@@ -140,5 +144,196 @@ TEST_F(FibersTest, FiberQueue) {
   EXPECT_LT(delay / kIters, 200);
 }
 
+TEST_F(FibersTest, InlineTask) {
+  int val = 0;
+  InlineTask small([&val] { ++val; });
+  small();
+  EXPECT_EQ(1, val);
+
+  char buf[InlineTask::kInlineSize * 2] = {1};
+  InlineTask big([&val, buf] { val += buf[0]; });
+  InlineTask moved = std::move(big);
+  EXPECT_FALSE(big);
+  moved();
+  EXPECT_EQ(2, val);
+
+  std::unique_ptr<int> ptr(new int(5));
+  moved = [ptr = std::move(ptr), &val] { val += *ptr; };
+  moved();
+  EXPECT_EQ(7, val);
+}
+
+TEST_F(FibersTest, MPMCChannel) {
+  MPMCChannel<int> channel(4);
+  ASSERT_TRUE(channel.TryPush(2));
+  ASSERT_TRUE(channel.Push(4));
+
+  int val = 0;
+  ASSERT_TRUE(channel.Pop(val));
+  EXPECT_EQ(2, val);
+  ASSERT_TRUE(channel.TryPop(val));
+  EXPECT_EQ(4, val);
+  EXPECT_FALSE(channel.TryPop(val));
+
+  std::vector<int> src{1, 2, 3, 4, 5, 6};
+  fibers::fiber fb(fibers::launch::post,
+                   [&] { EXPECT_EQ(src.size(), channel.PushBatch(src.begin(), src.end())); });
+
+  int dest[8];
+  size_t total = 0;
+  while (total < src.size()) {
+    size_t count = channel.PopBatch(dest, 8);
+    ASSERT_GT(count, 0);
+    for (size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(src[total + i], dest[i]);
+    }
+    total += count;
+  }
+  fb.join();
+
+  fb = fibers::fiber(fibers::launch::post, [&] { EXPECT_FALSE(channel.Pop(val)); });
+  channel.StartClosing();
+  fb.join();
+}
+
+TEST_F(FibersTest, MPMCChannelThreads) {
+  constexpr unsigned kProducers = 4;
+  constexpr unsigned kItems = 20000;
+
+  MPMCChannel<unsigned> channel(64);
+  std::atomic<uint64_t> sum{0};
+  std::vector<std::thread> consumers, producers;
+
+  for (unsigned i = 0; i < 2; ++i) {
+    consumers.emplace_back([&] {
+      unsigned vals[16];
+      size_t count;
+      while ((count = channel.PopBatch(vals, 16)) > 0) {
+        for (size_t j = 0; j < count; ++j)
+          sum.fetch_add(vals[j], std::memory_order_relaxed);
+      }
+    });
+  }
+
+  for (unsigned i = 0; i < kProducers; ++i) {
+    producers.emplace_back([&] {
+      for (unsigned j = 1; j <= kItems; ++j)
+        ASSERT_TRUE(channel.Push(j));
+    });
+  }
+  for (auto& t : producers)
+    t.join();
+  channel.StartClosing();
+  for (auto& t : consumers)
+    t.join();
+
+  EXPECT_EQ(uint64_t(kProducers) * kItems * (kItems + 1) / 2, sum.load());
+}
+
+constexpr unsigned kBenchItems = 1 << 16;
+
+// Measures passing tasks from a producer thread to a consumer thread.
+static void BM_MPMCChannel(benchmark::State& state) {
+  const size_t batch = state.range(0);
+
+  while (state.KeepRunning()) {
+    MPMCChannel<InlineTask> channel(256);
+    std::thread consumer([&] {
+      std::unique_ptr<InlineTask[]> tasks(new InlineTask[batch]);
+      size_t count;
+      while ((count = channel.PopBatch(tasks.get(), batch)) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+          tasks[i]();
+          tasks[i].Reset();
+        }
+      }
+    });
+
+    unsigned val = 0;
+    std::vector<InlineTask> src(batch);
+    for (unsigned i = 0; i < kBenchItems; i += batch) {
+      for (auto& t : src)
+        t = [&val] { ++val; };
+      channel.PushBatch(src.begin(), src.end());
+    }
+    channel.StartClosing();
+    consumer.join();
+    CHECK_EQ(kBenchItems, val);
+  }
+  state.SetItemsProcessed(state.iterations() * kBenchItems);
+}
+BENCHMARK(BM_MPMCChannel)->Arg(1)->Arg(16);
+
+static void BM_BufferedChannel(benchmark::State& state) {
+  using CbFunc = std::function<void()>;
+
+  while (state.KeepRunning()) {
+    fibers::buffered_channel<CbFunc> channel(256);
+    std::thread consumer([&] {
+      CbFunc f;
+      while (channel.pop(f) == fibers::channel_op_status::success) {
+        f();
+      }
+    });
+
+    unsigned val = 0;
+    for (unsigned i = 0; i < kBenchItems; ++i) {
+      channel.push([&val] { ++val; });
+    }
+    channel.close();
+    consumer.join();
+    CHECK_EQ(kBenchItems, val);
+  }
+  state.SetItemsProcessed(state.iterations() * kBenchItems);
+}
+BENCHMARK(BM_BufferedChannel);
+
+// The previous FiberQueue implementation: std::function tasks and a single item per wakeup.
+static void BM_FunctionQueue(benchmark::State& state) {
+  using CbFunc = std::function<void()>;
+
+  while (state.KeepRunning()) {
+    base::mpmc_bounded_queue<CbFunc> queue(256);
+    EventCount push_ec, pull_ec;
+    std::atomic_bool is_closed{false};
+
+    std::thread consumer([&] {
+      CbFunc f;
+      bool closed = false;
+      auto cb = [&] {
+        if (queue.try_dequeue(f)) {
+          push_ec.notify();
+          return true;
+        }
+        closed = is_closed.load(std::memory_order_acquire);
+        return closed;
+      };
+      while (true) {
+        pull_ec.await(cb);
+        if (closed)
+          break;
+        f();
+      }
+    });
+
+    unsigned val = 0;
+    for (unsigned i = 0; i < kBenchItems; ++i) {
+      push_ec.await([&] {
+        if (queue.try_enqueue([&val] { ++val; })) {
+          pull_ec.notify();
+          return true;
+        }
+        return false;
+      });
+    }
+    is_closed.store(true);
+    pull_ec.notify();
+    consumer.join();
+    CHECK_EQ(kBenchItems, val);
+  }
+  state.SetItemsProcessed(state.iterations() * kBenchItems);
+}
+BENCHMARK(BM_FunctionQueue);
+
 }  // namespace fibers_ext
 }  // namespace util
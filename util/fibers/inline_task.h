@@ -0,0 +1,120 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace util {
+namespace fibers_ext {
+
+/**
+ * @brief Move-only void() callable with small-buffer storage.
+ *
+ * Unlike std::function, callables of up to kInlineSize bytes are stored inside the object,
+ * so that passing a typical lambda through a task queue does not allocate.
+ * Bigger callables are allocated on heap. Move-only callables are supported.
+ */
+class InlineTask {
+ public:
+  static constexpr size_t kInlineSize = 48;
+
+  InlineTask() noexcept = default;
+
+  template <typename F, typename D = std::decay_t<F>,
+            typename = std::enable_if_t<!std::is_same<D, InlineTask>::value>>
+  InlineTask(F&& f) {
+    Init<D>(std::forward<F>(f), std::integral_constant<bool, IsInline<D>()>{});
+  }
+
+  InlineTask(InlineTask&& o) noexcept : ops_(o.ops_) {
+    if (ops_) {
+      ops_->move(&o.storage_, &storage_);
+      o.ops_ = nullptr;
+    }
+  }
+
+  InlineTask& operator=(InlineTask&& o) noexcept {
+    if (this != &o) {
+      Reset();
+      if (o.ops_) {
+        o.ops_->move(&o.storage_, &storage_);
+        ops_ = o.ops_;
+        o.ops_ = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  ~InlineTask() { Reset(); }
+
+  void operator()() { ops_->invoke(&storage_); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  void Reset() {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+ private:
+  using Storage = std::aligned_storage_t<kInlineSize, alignof(std::max_align_t)>;
+
+  struct Ops {
+    void (*invoke)(void*);
+    void (*move)(void* src, void* dest);  // move-constructs dest and destroys src.
+    void (*destroy)(void*);
+  };
+
+  template <typename D> static constexpr bool IsInline() {
+    return sizeof(D) <= kInlineSize && alignof(D) <= alignof(std::max_align_t) &&
+           std::is_nothrow_move_constructible<D>::value;
+  }
+
+  template <typename D> struct InlineOps {
+    static void Invoke(void* p) { (*static_cast<D*>(p))(); }
+    static void Move(void* src, void* dest) {
+      D* s = static_cast<D*>(src);
+      new (dest) D(std::move(*s));
+      s->~D();
+    }
+    static void Destroy(void* p) { static_cast<D*>(p)->~D(); }
+
+    static constexpr Ops ops{&Invoke, &Move, &Destroy};
+  };
+
+  // The storage keeps a pointer to the heap allocated callable.
+  template <typename D> struct HeapOps {
+    static D*& Ptr(void* p) { return *static_cast<D**>(p); }
+
+    static void Invoke(void* p) { (*Ptr(p))(); }
+    static void Move(void* src, void* dest) { new (dest) D*(Ptr(src)); }
+    static void Destroy(void* p) { delete Ptr(p); }
+
+    static constexpr Ops ops{&Invoke, &Move, &Destroy};
+  };
+
+  template <typename D, typename F> void Init(F&& f, std::true_type) {
+    new (&storage_) D(std::forward<F>(f));
+    ops_ = &InlineOps<D>::ops;
+  }
+
+  template <typename D, typename F> void Init(F&& f, std::false_type) {
+    new (&storage_) D*(new D(std::forward<F>(f)));
+    ops_ = &HeapOps<D>::ops;
+  }
+
+  const Ops* ops_ = nullptr;
+  Storage storage_;
+};
+
+template <typename D> constexpr InlineTask::Ops InlineTask::InlineOps<D>::ops;
+template <typename D> constexpr InlineTask::Ops InlineTask::HeapOps<D>::ops;
+
+}  // namespace fibers_ext
+}  // namespace util
@@ -0,0 +1,177 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#pragma once
+
+#include "base/mpmc_bounded_queue.h"
+#include "util/fibers/event_count.h"
+
+namespace util {
+namespace fibers_ext {
+
+/*!
+  \brief Multiple producers - multiple consumers bounded, fiber-friendly channel.
+
+  Based on lock-free base::mpmc_bounded_queue. Blocked fibers are suspended on EventCounts,
+  which cost a single atomic add on the fast path when nobody waits.
+  Batch operations move multiple items with a single notification of the other side.
+  Capacity must be a power of 2.
+*/
+template <typename T> class MPMCChannel {
+ public:
+  explicit MPMCChannel(size_t capacity) : q_(capacity) {}
+
+  //! Non blocking push.
+  template <typename U> bool TryPush(U&& u) {
+    if (q_.try_enqueue(std::forward<U>(u))) {
+      pop_ec_.notify();
+      return true;
+    }
+    return false;
+  }
+
+  //! Blocks while the channel is full. Returns false if the channel started closing
+  //! while waiting, in which case u was not pushed.
+  template <typename U> bool Push(U&& u);
+
+  //! Moves items from [begin, end) into the channel, blocking while the channel is full.
+  //! Consumers are notified once per uninterrupted sequence of pushes.
+  //! Returns number of pushed items, which is less than the range size only if the channel
+  //! is closing.
+  template <typename Iter> size_t PushBatch(Iter begin, Iter end);
+
+  //! Non blocking pop.
+  bool TryPop(T& dest) {
+    if (q_.try_dequeue(dest)) {
+      push_ec_.notify();
+      return true;
+    }
+    return false;
+  }
+
+  //! Blocking call. Returns false if the channel is closing and empty,
+  //! true otherwise with the popped value.
+  bool Pop(T& dest);
+
+  //! Blocks until at least one item is available and pops up to max items into dest.
+  //! Returns 0 if the channel is closing and empty.
+  size_t PopBatch(T* dest, size_t max);
+
+  /*! /brief Signals the consumers that the channel is going to be closed.
+
+      Consumers may still pop the existing items until Pop() returns false.
+      Blocked producers are woken up and their Push() calls fail.
+      Does not block.
+  */
+  void StartClosing() {
+    is_closing_.store(true, std::memory_order_seq_cst);
+    pop_ec_.notifyAll();
+    push_ec_.notifyAll();
+  }
+
+  bool IsClosing() const { return is_closing_.load(std::memory_order_relaxed); }
+
+  //! Suspends the calling fiber until cond() returns true. cond is rechecked every time
+  //! an item is popped from the channel. Allows composing pushes into several channels.
+  template <typename Cond> void AwaitPushable(Cond&& cond) {
+    push_ec_.await(std::forward<Cond>(cond));
+  }
+
+  size_t capacity() const { return q_.capacity(); }
+
+ private:
+  // Wakes up a single waiter for a single item, otherwise everyone.
+  static void Notify(size_t count, EventCount* ec) {
+    if (count == 1)
+      ec->notify();
+    else
+      ec->notifyAll();
+  }
+
+  size_t TryPopMany(T* dest, size_t max) {
+    size_t count = 0;
+    while (count < max && q_.try_dequeue(dest[count]))
+      ++count;
+    if (count)
+      Notify(count, &push_ec_);
+    return count;
+  }
+
+  base::mpmc_bounded_queue<T> q_;
+  std::atomic_bool is_closing_{false};
+
+  EventCount push_ec_, pop_ec_;
+};
+
+template <typename T> template <typename U> bool MPMCChannel<T>::Push(U&& u) {
+  if (TryPush(std::forward<U>(u)))
+    return true;
+
+  while (true) {
+    EventCount::Key key = push_ec_.prepareWait();
+    if (IsClosing())
+      return false;
+    if (TryPush(std::forward<U>(u)))
+      return true;
+    push_ec_.wait(key.epoch());
+  }
+}
+
+template <typename T>
+template <typename Iter>
+size_t MPMCChannel<T>::PushBatch(Iter begin, Iter end) {
+  size_t pushed = 0;
+
+  while (begin != end) {
+    size_t count = 0;
+    while (begin != end && q_.try_enqueue(std::move(*begin))) {
+      ++begin;
+      ++count;
+    }
+
+    if (count) {
+      Notify(count, &pop_ec_);
+      pushed += count;
+      continue;
+    }
+
+    EventCount::Key key = push_ec_.prepareWait();
+    if (IsClosing())
+      break;
+
+    if (TryPush(std::move(*begin))) {
+      ++begin;
+      ++pushed;
+      continue;
+    }
+    push_ec_.wait(key.epoch());
+  }
+
+  return pushed;
+}
+
+template <typename T> bool MPMCChannel<T>::Pop(T& dest) {
+  return PopBatch(&dest, 1) == 1;
+}
+
+template <typename T> size_t MPMCChannel<T>::PopBatch(T* dest, size_t max) {
+  size_t count = TryPopMany(dest, max);
+  if (count)
+    return count;
+
+  while (true) {
+    EventCount::Key key = pop_ec_.prepareWait();
+    count = TryPopMany(dest, max);
+    if (count)
+      return count;
+
+    // Items pushed before StartClosing() are visible at this point.
+    if (IsClosing())
+      return TryPopMany(dest, max);
+
+    pop_ec_.wait(key.epoch());
+  }
+}
+
+}  // namespace fibers_ext
+}  // namespace util
@@ -8,6 +8,7 @@
 
 #include "base/logging.h"
 #include "base/walltime.h"
+#include "util/asio/io_context.h"
 #include "util/http/https_client.h"
 
 namespace util {
@@ -145,7 +146,7 @@ auto ApiSenderBufferBody::SendRequestIterative(const Request& req, http::HttpsCl
   if (DoesServerPushback(msg.result())) {
     LOG(INFO) << "Retrying(" << client->native_handle() << ") with " << msg;
 
-    this_fiber::sleep_for(1s);
+    client->io_context().timer_service().SleepFor(1000);
     return asio::error::try_again;  // retry
   }
 
@@ -36,6 +36,9 @@ using tcp = asio::ip::tcp;
 
 static const char kMetaDataHost[] = "metadata.google.internal";
 
+// SIMD rapidjson may read upto 15 bytes past the end of the parsed string.
+constexpr size_t kJsonPadding = 16;
+
 static Status ToStatus(const system::error_code& ec) {
   return Status(StatusCode::IO_ERROR, absl::StrCat(ec.value(), ": ", ec.message()));
 }
@@ -192,6 +195,7 @@ util::Status GCE::ReadDevCreds(const std::string& root_path) {
 
   rj::Document adc_doc;
   constexpr unsigned kFlags = rj::kParseTrailingCommasFlag | rj::kParseCommentsFlag;
+  adc.reserve(adc.size() + kJsonPadding);
   adc_doc.ParseInsitu<kFlags>(&adc.front());
 
   if (adc_doc.HasParseError()) {
@@ -274,6 +278,7 @@ StatusObject<std::string> GCE::RefreshAccessToken(IoContext* context) const {
 util::StatusObject<std::string> GCE::ParseTokenResponse(std::string&& response) const {
   rj::Document doc;
   constexpr unsigned kFlags = rj::kParseTrailingCommasFlag | rj::kParseCommentsFlag;
+  response.reserve(response.size() + kJsonPadding);
   doc.ParseInsitu<kFlags>(&response.front());
 
   if (doc.HasParseError()) {
@@ -7,6 +7,7 @@
 #include <boost/beast/http/parser.hpp>
 
 #include "base/logging.h"
+#include "file/block_cache.h"
 #include "strings/escaping.h"
 
 #include "util/gce/detail/gcs_utils.h"
@@ -89,6 +90,7 @@ Status GcsReadFile::Open() {
   auto content_len_it = msg.find(h2::field::content_length);
   if (content_len_it != msg.end()) {
     CHECK(absl::SimpleAtoi(detail::absl_sv(content_len_it->value()), &size_));
+    size_ += offs_;  // The ranged response contains the bytes from offs_.
   }
   https_handle_ = std::move(handle_res.obj);
   return Status::OK;
@@ -98,7 +100,14 @@ StatusObject<size_t> GcsReadFile::Read(size_t offset, const strings::MutableByte
   CHECK(!range.empty());
 
   if (offset != offs_) {
-    return Status(StatusCode::INVALID_ARGUMENT, "Only sequential access supported");
+    if (offset >= size_)
+      return 0;
+
+    // Reopens the object at offset. Used by the block cache that reads only the missing blocks.
+    VLOG(1) << "Reopening " << read_obj_url_ << " at " << offset << " instead of " << offs_;
+    RETURN_IF_ERROR(Close());
+    offs_ = offset;
+    RETURN_IF_ERROR(Open());
   }
 
   // We can not cache parser() into local var because Open() below recreates the parser instance.
@@ -189,6 +198,9 @@ StatusObject<ReadonlyFile*> OpenGcsReadFile(absl::string_view full_path, const G
   std::unique_ptr<GcsReadFile> fl(new GcsReadFile(gce, pool, std::move(read_obj_url)));
   RETURN_IF_ERROR(fl->Open());
 
+  if (opts.block_cache) {
+    return file::NewCachedReadFile(fl.release(), full_path, opts.block_cache);
+  }
   return fl.release();
 }
 
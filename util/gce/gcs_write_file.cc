@@ -250,7 +250,7 @@ auto ApiSenderDynamicBody::SendRequestIterative(const Request& req, http::HttpsC
   if (detail::DoesServerPushback(msg.result())) {
     LOG(INFO) << "Retrying(" << client->native_handle() << ") with " << msg;
 
-    this_fiber::sleep_for(1s);
+    client->io_context().timer_service().SleepFor(1000);
     return asio::error::try_again;  // retry
   }
 
@@ -262,7 +262,7 @@ auto ApiSenderDynamicBody::SendRequestIterative(const Request& req, http::HttpsC
     LOG(INFO) << "Closing(" << client->native_handle() << ") with " << msg << " for request "
               << header;
 
-    this_fiber::sleep_for(1s);
+    client->io_context().timer_service().SleepFor(1000);
 
     return system::errc::make_error_code(system::errc::connection_refused);
   }
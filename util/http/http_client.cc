@@ -4,6 +4,8 @@
 
 #include "util/http/http_client.h"
 
+#include <sys/socket.h>
+
 #include <boost/asio/connect.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/http/dynamic_body.hpp>
@@ -13,6 +15,7 @@
 
 #include "base/logging.h"
 #include "util/asio/fiber_socket.h"
+#include "util/asio/io_context.h"
 #include "util/asio/yield.h"
 
 namespace util {
@@ -48,11 +51,23 @@ system::error_code Client::Connect(StringPiece host, StringPiece service) {
 
   system::error_code ec;
 
+  // Shutting down the native socket is non-blocking and it wakes up the fiber blocked on IO.
+  bool timed_out = false;
+  auto on_timeout = [&] {
+    timed_out = true;
+    ::shutdown(socket_->native_handle(), SHUT_RDWR);
+  };
+  base::TimerEvent<decltype(on_timeout)> timeout_ev(std::move(on_timeout));
+  if (send_timeout_ms_) {
+    DCHECK(io_context_.InContextThread());
+    io_context_.timer_service().Schedule(&timeout_ev, send_timeout_ms_);
+  }
+
   // Send the HTTP request to the remote host.
   h2::write(*socket_, req, ec);
   if (ec) {
     VLOG(1) << "Error " << ec;
-    return ec;
+    return timed_out ? system::error_code{asio::error::timed_out} : ec;
   }
 
   // This buffer is used for reading and must be persisted
@@ -61,7 +76,7 @@ system::error_code Client::Connect(StringPiece host, StringPiece service) {
   h2::read(*socket_, buffer, *response, ec);
   VLOG(2) << "Resp: " << *response;
 
-  return ec;
+  return timed_out ? system::error_code{asio::error::timed_out} : ec;
 }
 
 void Client::Shutdown() {
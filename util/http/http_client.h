@@ -40,6 +40,10 @@ class Client {
 
   void set_connect_timeout_ms(uint32_t ms) { connect_timeout_ms_ = ms; }
 
+  // Limits the duration of a single Send() call, 0 means no limit.
+  // Upon timeout, the connection is shut down and Send() returns timed_out error.
+  void set_send_timeout_ms(uint32_t ms) { send_timeout_ms_ = ms; }
+
   // Adds header to all future requests.
   void AddHeader(std::string name, std::string value) {
     headers_.emplace_back(std::move(name), std::move(value));
@@ -48,6 +52,7 @@ class Client {
  private:
   IoContext& io_context_;
   uint32_t connect_timeout_ms_ = 2000;
+  uint32_t send_timeout_ms_ = 0;
 
   using HeaderPair = std::pair<std::string, std::string>;
 
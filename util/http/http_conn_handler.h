@@ -83,7 +83,7 @@ class ListenerBase : public ListenerInterface {
     bool is_protected;
     RequestCb cb;
   };
-  StringPieceMap<CbInfo> cb_map_;
+  StringPieceFlatMap<CbInfo> cb_map_;
 };
 
 class HttpHandler : public ConnectionHandler {
@@ -76,6 +76,8 @@ class HttpsClient {
 
   ::boost::asio::ssl::context& ssl_context() { return ssl_cntx_; }
 
+  IoContext& io_context() { return io_context_; }
+
   error_code status() const {
     namespace err = ::boost::asio::error;
 
@@ -26,6 +26,9 @@ namespace util {
 namespace {
 
 typedef gpb::FieldDescriptor FD;
+
+// Padding of the parsed json, release builds use SIMD rapidjson that reads past the end.
+constexpr size_t kJsonPadding = 16;
 using RapidWriter =
     rj::Writer<rj::StringBuffer, rj::UTF8<>, rj::UTF8<>, rj::CrtAllocator, rj::kWriteNanAndInfFlag>;
 
@@ -691,18 +694,28 @@ bool PbHandler::EndArray(size_t elementCount) {
 }  // namespace
 
 std::string Pb2Json(const ::google::protobuf::Message& msg, const Pb2JsonOptions& options) {
-  rj::StringBuffer sb;
+  string res;
+  Pb2Json(msg, options, &res);
+  return res;
+}
+
+void Pb2Json(const ::google::protobuf::Message& msg, const Pb2JsonOptions& options,
+             std::string* dest) {
+  // The buffer is reused by the calls of the same thread.
+  static thread_local rj::StringBuffer sb;
+  sb.Clear();
   RapidWriter rw(sb);
   rw.SetMaxDecimalPlaces(9);
 
   Pb2JsonInternal(msg, options, &rw);
-  return string(sb.GetString(), sb.GetSize());
+  dest->append(sb.GetString(), sb.GetSize());
 }
 
 Status Json2Pb(std::string json, ::google::protobuf::Message* msg, const Json2PbOptions& opts) {
   rj::Reader reader;
 
   PbHandler h(opts, msg);
+  json.reserve(json.size() + kJsonPadding);
   rj::InsituStringStream stream(&json.front());
 
   rj::ParseResult pr = reader.Parse<rj::kParseInsituFlag | rj::kParseTrailingCommasFlag>(stream, h);
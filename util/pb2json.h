@@ -26,6 +26,10 @@ struct Pb2JsonOptions {
 std::string Pb2Json(const ::google::protobuf::Message& msg,
                     const Pb2JsonOptions& options = Pb2JsonOptions());
 
+// Appends the json representation of msg to dest.
+void Pb2Json(const ::google::protobuf::Message& msg, const Pb2JsonOptions& options,
+             std::string* dest);
+
 struct Json2PbOptions {
   bool skip_unknown_fields;
 
@@ -3,7 +3,14 @@
 //
 #include "util/proc_stats.h"
 
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+
 #include <mutex>
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
 #include "base/walltime.h"
 #include "strings/stringpiece.h"
 #include "strings/numbers.h"
@@ -59,7 +66,7 @@ ProcessStats ProcessStats::Read() {
   while (getline(&line, &len, f) != -1) {
     if (!strncmp(line, "VmPeak:", 7)) stats.vm_peak = ParseLeadingUDec32Value(line + 8, 0);
     else if (!strncmp(line, "VmSize:", 7)) stats.vm_size = ParseLeadingUDec32Value(line + 8, 0);
-    else if (!strncmp(line, "VmRSS:", 6)) stats.vm_size = ParseLeadingUDec32Value(line + 7, 0);
+    else if (!strncmp(line, "VmRSS:", 6)) stats.vm_rss = ParseLeadingUDec32Value(line + 7, 0);
   }
   fclose(f);
   f = fopen("/proc/self/stat", "r");
@@ -97,6 +104,144 @@ ProcessStats ProcessStats::Read() {
   return stats;
 }
 
+namespace {
+
+// Reads a small /proc file into buf. Returns an empty string on error or if the file
+// does not fit into buf: a truncated file would silently lose its last fields.
+StringPiece ReadProcFile(const std::string& path, char* buf, size_t size) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return StringPiece();
+
+  // procfs may return less than requested, hence we read till EOF.
+  size_t len = 0;
+  while (len < size) {
+    ssize_t res = read(fd, buf + len, size - len);
+    if (res == 0)
+      break;
+    if (res < 0) {
+      if (errno == EINTR)
+        continue;
+      len = 0;
+      break;
+    }
+    len += res;
+  }
+  close(fd);
+
+  if (len == size) {
+    fprintf(stderr, "Buffer is too small for %s: %lu\n", path.c_str(), size);
+    return StringPiece();
+  }
+  return StringPiece(buf, len);
+}
+
+// Parses the stat file of a process or a thread. comm may contain spaces and parentheses,
+// therefore the fields are counted from its last ')'.
+bool ParseStat(StringPiece str, std::string* comm, ResourceUsage* res) {
+  size_t start = str.find('('), end = str.rfind(')');
+  if (start == StringPiece::npos || end == StringPiece::npos || end < start)
+    return false;
+  if (comm)
+    *comm = std::string(str.substr(start + 1, end - start - 1));
+
+  // fields[0] is the state, the 3rd field in proc(5).
+  StringPiece fields = str.substr(end + 2);
+  auto field = [&](unsigned index) {
+    size_t pos = index ? find_nth(fields, ' ', index - 1) : 0;
+    return pos == StringPiece::npos ? 0 : ParseLeadingUDec64Value(fields.substr(pos + 1), 0);
+  };
+
+  static const uint64 usec_per_jiffy = 1000000 / sysconf(_SC_CLK_TCK);
+  res->minor_faults = field(7);
+  res->major_faults = field(9);
+  res->user_usec = field(11) * usec_per_jiffy;
+  res->sys_usec = field(12) * usec_per_jiffy;
+  res->num_threads = field(17);
+  return true;
+}
+
+void ParseStatus(StringPiece str, ResourceUsage* res) {
+  constexpr StringPiece kVoluntary("voluntary_ctxt_switches:");
+  constexpr StringPiece kNonVoluntary("nonvoluntary_ctxt_switches:");
+  constexpr StringPiece kVmRss("VmRSS:");
+
+  for (StringPiece line : absl::StrSplit(str, '\n')) {
+    if (absl::ConsumePrefix(&line, kVoluntary)) {
+      res->voluntary_ctxt_switches = ParseLeadingUDec64Value(line, 0);
+    } else if (absl::ConsumePrefix(&line, kNonVoluntary)) {
+      res->nonvoluntary_ctxt_switches = ParseLeadingUDec64Value(line, 0);
+    } else if (absl::ConsumePrefix(&line, kVmRss)) {
+      res->vm_rss = ParseLeadingUDec32Value(line, 0);
+    }
+  }
+}
+
+void ParseIo(StringPiece str, ResourceUsage* res) {
+  for (StringPiece line : absl::StrSplit(str, '\n')) {
+    size_t pos = line.find(':');
+    if (pos == StringPiece::npos)
+      continue;
+    StringPiece key = line.substr(0, pos);
+    uint64 val = ParseLeadingUDec64Value(line.substr(pos + 1), 0);
+
+    if (key == "rchar") {
+      res->rchar = val;
+    } else if (key == "wchar") {
+      res->wchar = val;
+    } else if (key == "read_bytes") {
+      res->read_bytes = val;
+    } else if (key == "write_bytes") {
+      res->write_bytes = val;
+    }
+  }
+}
+
+bool ReadUsage(const std::string& dir, std::string* comm, ResourceUsage* res) {
+  char buf[8192];  // status is ~1.5KB and grows with the kernel version.
+  StringPiece str = ReadProcFile(dir + "/stat", buf, sizeof(buf));
+  if (str.empty() || !ParseStat(str, comm, res))
+    return false;
+
+  ParseStatus(ReadProcFile(dir + "/status", buf, sizeof(buf)), res);
+  return true;
+}
+
+}  // namespace
+
+bool ResourceUsage::ReadProcess(ResourceUsage* res) {
+  if (!ReadUsage("/proc/self", nullptr, res))
+    return false;
+
+  // /proc/self/io may be unavailable, for example, due to ptrace access checks.
+  char buf[512];
+  ParseIo(ReadProcFile("/proc/self/io", buf, sizeof(buf)), res);
+  return true;
+}
+
+bool ResourceUsage::ReadThread(int tid, ResourceUsage* res) {
+  return ReadUsage(absl::StrCat("/proc/self/task/", tid), nullptr, res);
+}
+
+std::vector<ThreadStats> ThreadStats::ReadAll() {
+  std::vector<ThreadStats> res;
+  DIR* dir = opendir("/proc/self/task");
+  if (!dir)
+    return res;
+
+  while (struct dirent* entry = readdir(dir)) {
+    ThreadStats ts;
+    ts.tid = ParseLeadingUDec32Value(entry->d_name, 0);
+    if (ts.tid == 0)  // "." and ".."
+      continue;
+    if (ReadUsage(absl::StrCat("/proc/self/task/", ts.tid), &ts.name, &ts.usage))
+      res.push_back(std::move(ts));
+  }
+  closedir(dir);
+
+  return res;
+}
+
 namespace sys {
 
 unsigned int NumCPUs() {
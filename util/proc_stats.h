@@ -5,6 +5,8 @@
 #define PROC_STATUS_H
 
 #include <ostream>
+#include <string>
+#include <vector>
 
 #include "base/integral_types.h"
 
@@ -21,6 +23,44 @@ struct ProcessStats {
   static ProcessStats Read();
 };
 
+// Cumulative resource usage counters of the process or of a single thread.
+struct ResourceUsage {
+  uint64 user_usec = 0;
+  uint64 sys_usec = 0;
+
+  uint64 minor_faults = 0;
+  uint64 major_faults = 0;
+
+  uint64 voluntary_ctxt_switches = 0;
+  uint64 nonvoluntary_ctxt_switches = 0;
+
+  // From /proc/self/io: read_bytes/write_bytes hit the storage layer,
+  // rchar/wchar include the page cache. Available for the process only.
+  uint64 read_bytes = 0;
+  uint64 write_bytes = 0;
+  uint64 rchar = 0;
+  uint64 wchar = 0;
+
+  uint32 num_threads = 0;
+  uint32 vm_rss = 0;  // In kb.
+
+  // Reads /proc/self/stat, /proc/self/status and /proc/self/io.
+  // Returns false if /proc/self/stat could not be read.
+  static bool ReadProcess(ResourceUsage* res);
+
+  // Reads /proc/self/task/<tid>/stat and /proc/self/task/<tid>/status of the thread.
+  static bool ReadThread(int tid, ResourceUsage* res);
+};
+
+struct ThreadStats {
+  int tid = 0;
+  std::string name;
+  ResourceUsage usage;
+
+  // Returns the stats of all the threads of the process by iterating /proc/self/task.
+  static std::vector<ThreadStats> ReadAll();
+};
+
 namespace sys {
   unsigned int NumCPUs();
 }  // namespace sys
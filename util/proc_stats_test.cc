@@ -0,0 +1,98 @@
+// Copyright 2019, Beeri 15.  All rights reserved.
+// Author: Roman Gershman (romange@gmail.com)
+//
+#include "util/proc_stats.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <fstream>
+#include <future>
+#include <thread>
+
+#include "base/gtest.h"
+#include "base/logging.h"
+#include "base/walltime.h"
+
+namespace util {
+
+class ProcStatsTest : public testing::Test {
+ protected:
+  // Burns some cpu so that the counters advance.
+  static uint64 Spin() {
+    uint64 res = 0;
+    for (unsigned i = 0; i < 50000000; ++i) {
+      res += i * i;
+      asm volatile("" : "+r"(res));
+    }
+    return res;
+  }
+};
+
+TEST_F(ProcStatsTest, Process) {
+  ProcessStats stats = ProcessStats::Read();
+  EXPECT_GT(stats.vm_rss, 0);
+  EXPECT_GE(stats.vm_size, stats.vm_rss);
+
+  ResourceUsage before, after;
+  ASSERT_TRUE(ResourceUsage::ReadProcess(&before));
+  Spin();
+  ASSERT_TRUE(ResourceUsage::ReadProcess(&after));
+
+  EXPECT_GT(after.user_usec + after.sys_usec, before.user_usec + before.sys_usec);
+  EXPECT_GE(after.minor_faults, before.minor_faults);
+  EXPECT_GT(after.voluntary_ctxt_switches + after.nonvoluntary_ctxt_switches, 0);
+  EXPECT_GE(after.num_threads, 1);
+}
+
+TEST_F(ProcStatsTest, Threads) {
+  int tid = syscall(SYS_gettid);
+  ResourceUsage usage;
+  ASSERT_TRUE(ResourceUsage::ReadThread(tid, &usage));
+  EXPECT_FALSE(ResourceUsage::ReadThread(0, &usage));
+
+  std::vector<ThreadStats> threads = ThreadStats::ReadAll();
+  auto it = std::find_if(threads.begin(), threads.end(),
+                         [tid](const ThreadStats& ts) { return ts.tid == tid; });
+  ASSERT_TRUE(it != threads.end());
+  EXPECT_FALSE(it->name.empty());
+}
+
+// The context switch counters are the last lines of the status file, thus the first lost
+// if it is truncated.
+TEST_F(ProcStatsTest, ThreadCtxtSwitches) {
+  std::promise<int> tid;
+  std::promise<void> done;
+  std::thread th([&] {
+    usleep(1000);
+    tid.set_value(syscall(SYS_gettid));
+    done.get_future().wait();
+  });
+
+  // The thread is blocked, hence its counters do not change while we read them.
+  int id = tid.get_future().get();
+  SleepForMilliseconds(10);
+
+  ResourceUsage usage;
+  ASSERT_TRUE(ResourceUsage::ReadThread(id, &usage));
+
+  std::ifstream ifs("/proc/self/task/" + std::to_string(id) + "/status");
+  std::string line;
+  uint64 voluntary = 0, nonvoluntary = 0;
+  unsigned found = 0;
+  while (std::getline(ifs, line)) {
+    found += sscanf(line.c_str(), "voluntary_ctxt_switches: %" SCNu64, &voluntary);
+    found += sscanf(line.c_str(), "nonvoluntary_ctxt_switches: %" SCNu64, &nonvoluntary);
+  }
+  done.set_value();
+  th.join();
+
+  ASSERT_EQ(2, found);
+  EXPECT_GT(voluntary, 0);
+  EXPECT_EQ(voluntary, usage.voluntary_ctxt_switches);
+  EXPECT_EQ(nonvoluntary, usage.nonvoluntary_ctxt_switches);
+}
+
+}  // namespace util
@@ -35,8 +35,6 @@ bool IsExpectedFinish(system::error_code ec) {
          ec == error::not_connected;
 }
 
-constexpr uint32_t kTickPrecision = 3;  // 3ms per timer tick.
-
 }  // namespace
 
 Channel::~Channel() {
@@ -62,13 +60,6 @@ auto Channel::Connect(uint32_t ms) -> error_code {
     read_fiber_ = fibers::fiber(&Channel::ReadFiber, this);
     flush_fiber_ = fibers::fiber(&Channel::FlushFiber, this);
   });
-  expiry_task_.reset(new PeriodicTask(context, chrono::milliseconds(kTickPrecision)));
-
-  expiry_task_->Start([this](int ticks) {
-    DCHECK_GT(ticks, 0);
-    this->expire_timer_.advance(ticks);
-    DVLOG(3) << "Advancing expiry to " << this->expire_timer_.now();
-  });
 
   return ec;
 }
@@ -108,8 +99,7 @@ auto Channel::Send(uint32 deadline_msec, Envelope* envelope) -> future_code_t {
     return res;
   }
 
-  uint32_t ticks = (deadline_msec + kTickPrecision - 1) / kTickPrecision;
-  std::unique_ptr<ExpiryEvent> ev(new ExpiryEvent(this));
+  auto deadline = TimerService::clock_t::now() + chrono::milliseconds(deadline_msec);
 
   // We protect against Send thread vs IoContext thread data races.
   // Fibers inside IoContext thread do not have to protect against each other since
@@ -119,12 +109,10 @@ auto Channel::Send(uint32 deadline_msec, Envelope* envelope) -> future_code_t {
   bool lock_exclusive = OutgoingBufLock();
   RpcId id = next_send_rpc_id_++;
 
-  ev->set_id(id);
-  base::Tick at = expire_timer_.schedule(ev.get(), ticks);
-  DVLOG(2) << "Scheduled expiry at " << at << " for rpcid " << id;
-
+  // The expiry is scheduled by FlushSendsGuarded in IoContext thread, since the timer service
+  // is not thread-safe.
   outgoing_buf_.emplace_back(SendItem(id, PendingCall{std::move(p), envelope}));
-  outgoing_buf_.back().second.expiry_event = std::move(ev);
+  outgoing_buf_.back().second.expiry_event.reset(new ExpiryEvent(this, id, deadline));
   outgoing_buf_size_.store(outgoing_buf_.size(), std::memory_order_relaxed);
 
   OutgoingBufUnlock(lock_exclusive);
@@ -258,9 +246,14 @@ auto Channel::FlushSendsGuarded() -> error_code {
     // Fill the pending call before the socket.Write() because otherwise in case it blocks
     // *after* it sends, the current fiber might resume after Read fiber receives results
     // and it would not find them inside pending_calls_.
+    TimerService& timer_service = socket_->context().timer_service();
     pending_calls_size_.fetch_add(count, std::memory_order_relaxed);
     for (size_t i = 0; i < count; ++i) {
       auto& item = outgoing_buf_[i];
+      ExpiryEvent* ev = item.second.expiry_event.get();
+      if (ev) {
+        timer_service.ScheduleAt(ev, ev->deadline());
+      }
       auto emplace_res = pending_calls_.emplace(item.first, std::move(item.second));
       CHECK(emplace_res.second);
     }
@@ -283,14 +276,18 @@ auto Channel::FlushSendsGuarded() -> error_code {
 void Channel::ExpirePending(RpcId id) {
   DVLOG(1) << "Expire rpc id " << id;
 
+  // Expiry events are scheduled only for the calls in pending_calls_ and cancelled when
+  // the calls are destroyed. The call might be missing only if it's being cancelled by
+  // CancelPendingCalls.
   auto it = this->pending_calls_.find(id);
   if (it == this->pending_calls_.end()) {
-    // TODO: there could be that the call is in outgoing_buf_ and we did not expiry it.
     return;
   }
+
   // The order is important to eliminate interrupts.
   EcPromise pr = std::move(it->second.promise);
   this->pending_calls_.erase(it);
+  pending_calls_size_.fetch_sub(1, std::memory_order_relaxed);
   pr.set_value(asio::error::timed_out);
 }
 
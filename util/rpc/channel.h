@@ -11,7 +11,7 @@
 #include "base/wheel_timer.h"
 
 #include "util/asio/fiber_socket.h"
-#include "util/asio/periodic_task.h"
+#include "util/asio/io_context.h"
 
 #include "util/rpc/frame_format.h"
 #include "util/rpc/rpc_envelope.h"
@@ -102,17 +102,21 @@ class Channel {
 
   class ExpiryEvent : public base::TimerEventInterface {
    public:
-    explicit ExpiryEvent(Channel* me) : me_(me) {
-   }
+    using time_point = TimerService::clock_t::time_point;
+
+    ExpiryEvent(Channel* me, RpcId id, time_point deadline)
+        : me_(me), id_(id), deadline_(deadline) {
+    }
 
    // ExpiryEvent can not be moved because its address is registered inside TimerWheel.
    void execute() final {  me_->ExpirePending(id_); }
 
-   void set_id(RpcId i) { id_ = i; }
+   time_point deadline() const { return deadline_; }
 
   private:
     Channel* me_;
-    RpcId id_ = 0;
+    RpcId id_;
+    time_point deadline_;
   };
 
   RpcId next_send_rpc_id_ = 1;
@@ -154,10 +158,6 @@ class Channel {
   typedef absl::flat_hash_map<RpcId, PendingCall> PendingMap;
   PendingMap pending_calls_;
   std::atomic_ulong pending_calls_size_{0};
-
-  // Handles expiration flow.
-  base::TimerWheel expire_timer_;
-  std::unique_ptr<PeriodicTask> expiry_task_;
 };
 
 }  // namespace rpc
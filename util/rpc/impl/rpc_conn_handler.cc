@@ -8,10 +8,14 @@
 
 #include "base/flags.h"
 #include "base/logging.h"
+#include "base/pool_memory_resource.h"
 
 #include "util/asio/asio_utils.h"
 #include "util/asio/io_context.h"
 
+DEFINE_bool(rpc_pool_allocator, false,
+            "If true, incoming envelopes are allocated from a thread-caching pool");
+
 namespace util {
 namespace rpc {
 
@@ -19,6 +23,12 @@ using namespace std::chrono_literals;
 
 namespace {
 
+// Envelopes may outlive connections, hence the pool is never destroyed.
+base::PoolMemoryResource* EnvelopePool() {
+  static base::PoolMemoryResource* pool = new base::PoolMemoryResource;
+  return pool;
+}
+
 using RpcConnList = detail::slist<RpcConnectionHandler, RpcConnectionHandler::rpc_hook_t,
                                   detail::constant_time_size<false>, detail::cache_last<false>>;
 
@@ -130,6 +140,9 @@ system::error_code RpcConnectionHandler::HandleRequest() {
   auto item_ptr = rpc_items_.make_unique();
 
   Envelope* envelope = &item_ptr->envelope;
+  if (FLAGS_rpc_pool_allocator && envelope->header.mr() != EnvelopePool()) {
+    *envelope = Envelope(EnvelopePool());
+  }
   envelope->Resize(frame.header_size, frame.letter_size);
   auto rbuf_seq = item_ptr->buf_seq();
   asio::read(*socket_, rbuf_seq, ec_);
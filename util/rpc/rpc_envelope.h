@@ -17,6 +17,9 @@ class Envelope {
 
   Envelope() = default;
 
+  // Allocates header and letter buffers from mr.
+  explicit Envelope(pmr::memory_resource* mr) : header(mr), letter(mr) {}
+
   Envelope(Envelope&& other) noexcept {
     Swap(&other);
   }
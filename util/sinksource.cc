@@ -3,6 +3,8 @@
 //
 
 #include "util/sinksource.h"
+
+#include "absl/container/inlined_vector.h"
 #include "base/logging.h"
 #include "base/port.h"
 
@@ -14,6 +16,13 @@ Sink::WritableBuffer Sink::GetAppendBuffer(size_t min_capacity, WritableBuffer s
   return scratch;
 }
 
+Status Sink::AppendV(absl::Span<const strings::ByteRange> slices) {
+  for (const auto& slice : slices) {
+    RETURN_IF_ERROR(Append(slice));
+  }
+  return Status::OK;
+}
+
 Status Sink::Flush() { return Status::OK; }
 
 StatusObject<size_t> Source::Read(const strings::MutableByteRange& range) {
@@ -56,6 +65,63 @@ StatusObject<size_t> Source::Read(const strings::MutableByteRange& range) {
   return read;
 }
 
+StatusObject<size_t> Source::ReadV(absl::Span<const strings::MutableByteRange> ranges) {
+  size_t read = 0;
+
+  // Prepended data is rare, so we do not bother to scatter it.
+  if (!prepend_buf_.empty() || ranges.size() == 1) {
+    for (const auto& range : ranges) {
+      if (range.empty())
+        continue;
+      auto res = Read(range);
+      if (!res.ok())
+        return res;
+      read += res.obj;
+      if (res.obj < range.size())
+        break;
+    }
+    return read;
+  }
+
+  absl::InlinedVector<strings::MutableByteRange, 8> left;
+  for (const auto& range : ranges) {
+    if (!range.empty())
+      left.push_back(range);
+  }
+
+  size_t first = 0;
+  while (!eof_ && first < left.size()) {
+    auto res = ReadInternalV(absl::MakeConstSpan(left).subspan(first));
+    if (!res.ok())
+      return res;
+
+    read += res.obj;
+    eof_ = res.obj == 0;
+
+    // Skips the filled ranges.
+    size_t sz = res.obj;
+    while (first < left.size() && sz >= left[first].size()) {
+      sz -= left[first++].size();
+    }
+    if (sz)
+      left[first].advance(sz);
+  }
+  return read;
+}
+
+StatusObject<size_t> Source::ReadInternalV(absl::Span<const strings::MutableByteRange> ranges) {
+  size_t read = 0;
+  for (const auto& range : ranges) {
+    auto res = ReadInternal(range);
+    if (!res.ok())
+      return res;
+    read += res.obj;
+    if (res.obj < range.size())
+      break;
+  }
+  return read;
+}
+
 StatusObject<size_t> StringSource::ReadInternal(const strings::MutableByteRange& range) {
   size_t to_fill = std::min<size_t>({range.size(), block_size_, input_.size()});
   memcpy(range.begin(), input_.begin(), to_fill);
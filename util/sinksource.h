@@ -7,6 +7,7 @@
 
 #include <memory>
 #include <string>
+#include "absl/types/span.h"
 #include "base/integral_types.h"
 #include "base/pod_array.h"
 
@@ -31,6 +32,11 @@ class Sink {
   // Appends slice to sink.
   virtual Status Append(const strings::ByteRange& slice) = 0;
 
+  // Appends slices in order. Equivalent to calling Append for each slice, which is what
+  // the default implementation does. Sinks that can pass several buffers downstream at once,
+  // for example with writev, override it to avoid gathering the slices into a single buffer.
+  virtual Status AppendV(absl::Span<const strings::ByteRange> slices);
+
   // Returns a writable buffer for appending .
   // Guarantees that result.capacity >=min_capacity.
   // May return a pointer to the caller-owned scratch buffer which must have capacity >=min_capacity.
@@ -109,6 +115,14 @@ class Source {
    */
   StatusObject<size_t> Read(const strings::MutableByteRange& range);
 
+  /**
+   * @brief Scatter version of Read(). Fills ranges in order.
+   *
+   * @return StatusObject<size_t> with the total number of bytes read. If it is smaller than
+   * the total size of ranges then source reached EOF.
+   */
+  StatusObject<size_t> ReadV(absl::Span<const strings::MutableByteRange> ranges);
+
   void Prepend(const strings::ByteRange& range) {
     prepend_buf_.insert(prepend_buf_.begin(), range.begin(), range.end());
   }
@@ -119,6 +133,10 @@ class Source {
   //! if possible.
   virtual StatusObject<size_t> ReadInternal(const strings::MutableByteRange& range) = 0;
 
+  //! Called by ReadV(), may fill less than the total size of ranges similarly to ReadInternal.
+  //! The default implementation calls ReadInternal for each range.
+  virtual StatusObject<size_t> ReadInternalV(absl::Span<const strings::MutableByteRange> ranges);
+
  private:
 
   DISALLOW_COPY_AND_ASSIGN(Source);
@@ -8,6 +8,7 @@
 #include "base/fixed.h"
 #include "base/logging.h"
 
+#include "util/fibers/fiberqueue_threadpool.h"
 #include "util/zlib_source.h"
 #include "util/zstd_sinksource.h"
 
@@ -155,6 +156,100 @@ TEST_F(SourceTest, MultipleStreams) {
   EXPECT_EQ(original_.size() * 2, read);
 }
 
+static string ReadAll(Source* src) {
+  string res;
+  std::array<uint8, 4096> buf;
+  while (true) {
+    auto result = src->Read(strings::MutableByteRange(buf));
+    CHECK_STATUS(result.status);
+    res.append(reinterpret_cast<char*>(buf.data()), result.obj);
+    if (result.obj < buf.size())
+      break;
+  }
+  return res;
+}
+
+TEST_F(SourceTest, GzipIndex) {
+  std::unique_ptr<GzipIndex> index;
+  auto cb = [&](std::unique_ptr<GzipIndex> res) { index = std::move(res); };
+
+  ZlibSource gsource(new StringSource(compressed_, 1023));
+  gsource.BuildIndex(1 << 14, cb);
+  ASSERT_EQ(original_, ReadAll(&gsource));
+  ASSERT_TRUE(index);
+
+  EXPECT_GT(index->points().size(), 10);
+  EXPECT_EQ(0, index->points().front().out_offset);
+  EXPECT_EQ(original_.size(), index->raw_size());
+  EXPECT_EQ(compressed_.size(), index->compressed_size());
+
+  // Multiple members are not indexed.
+  std::unique_ptr<GzipIndex> mult_index;
+  string mult_compr = compressed_ + compressed_;
+  ZlibSource msource(new StringSource(mult_compr));
+  msource.BuildIndex(1 << 14, [&](std::unique_ptr<GzipIndex> res) { mult_index = std::move(res); });
+  EXPECT_EQ(original_ + original_, ReadAll(&msource));
+  EXPECT_FALSE(mult_index);
+}
+
+TEST_F(SourceTest, ParallelGzip) {
+  fibers_ext::FiberQueueThreadPool pool(3);
+
+  // The first read builds the index.
+  std::unique_ptr<GzipIndex> index;
+  {
+    ParallelGzipSource psource(new StringSource(compressed_, 1023), &pool, 3, 1 << 14,
+                               [&](std::unique_ptr<GzipIndex> res) { index = std::move(res); });
+    ASSERT_EQ(original_, ReadAll(&psource));
+  }
+  ASSERT_TRUE(index);
+  EXPECT_GT(index->points().size(), 10);
+  EXPECT_EQ(original_.size(), index->raw_size());
+  EXPECT_EQ(compressed_.size(), index->compressed_size());
+
+  std::shared_ptr<const GzipIndex> shared_index(index.release());
+  for (unsigned parallelism : {1, 3}) {
+    ParallelGzipSource psource(new StringSource(compressed_, 777), shared_index, &pool,
+                               parallelism);
+    EXPECT_EQ(original_, ReadAll(&psource));
+  }
+
+  // Multiple members are read but not indexed, even when a member ends at a chunk boundary.
+  string mult_compr = compressed_ + compressed_;
+  for (uint64_t span : {uint64_t(1) << 14, uint64_t(compressed_.size() * 4)}) {
+    bool called = false;
+    ParallelGzipSource msource(new StringSource(mult_compr), &pool, 2, span,
+                               [&](std::unique_ptr<GzipIndex>) { called = true; });
+    EXPECT_EQ(original_ + original_, ReadAll(&msource));
+    EXPECT_FALSE(called);
+  }
+}
+
+TEST_F(SourceTest, ReadV) {
+  StringSource src(original_, 100);
+  string a(150, '\0'), b(0, '\0'), c(1000, '\0');
+  MutableByteRange ranges[] = {AsMutableByteRange(a), MutableByteRange(),
+                               AsMutableByteRange(c)};
+  auto res = src.ReadV(ranges);
+  ASSERT_TRUE(res.ok());
+  ASSERT_EQ(1150, res.obj);
+  EXPECT_EQ(original_.substr(0, 1150), a + c);
+
+  // Prepended data is returned first.
+  src.Prepend(ToByteRange(c.substr(990)));
+  res = src.ReadV(ranges);
+  ASSERT_TRUE(res.ok());
+  ASSERT_EQ(1150, res.obj);
+  EXPECT_EQ(original_.substr(1140, 1150), a + c);
+
+  string rest(original_.size(), '\0');
+  MutableByteRange rest_ranges[] = {AsMutableByteRange(a), AsMutableByteRange(rest)};
+  res = src.ReadV(rest_ranges);
+  ASSERT_TRUE(res.ok());
+  ASSERT_EQ(original_.size() - 2290, res.obj);
+  EXPECT_EQ(original_.substr(2290), a + rest.substr(0, res.obj - a.size()));
+}
+
 class ZstdSourceTest : public testing::Test {};
 
 TEST_F(ZstdSourceTest, Basic) {
@@ -185,4 +280,86 @@ TEST_F(ZstdSourceTest, Basic) {
   }
 }
 
+TEST_F(ZstdSourceTest, AppendV) {
+  StringSink* compressed = new StringSink;
+  ZStdSink zstd_compress(compressed);
+  ASSERT_TRUE(zstd_compress.Init(1).ok());
+
+  string expected;
+  std::vector<string> records;
+  for (unsigned i = 0; i < 10000; ++i) {
+    records.push_back(std::to_string(i * i) + "\n");
+    expected.append(records.back());
+  }
+  std::vector<ByteRange> slices;
+  for (const auto& r : records)
+    slices.push_back(ToByteRange(r));
+  ASSERT_TRUE(zstd_compress.AppendV(slices).ok());
+  ASSERT_TRUE(zstd_compress.Flush().ok());
+
+  ZStdSource zstd_src(new StringSource(compressed->contents()));
+  string buf(expected.size() + 1, '\0');
+  auto res = zstd_src.Read(AsMutableByteRange(buf));
+  ASSERT_TRUE(res.ok());
+  buf.resize(res.obj);
+  EXPECT_EQ(expected, buf);
+}
+
+TEST_F(ZstdSourceTest, Seekable) {
+  constexpr unsigned kNumRecords = 1000;
+  string expected;
+
+  StringSink* compressed = new StringSink;
+  ZStdSink zstd_compress(compressed);
+  ASSERT_TRUE(zstd_compress.Init(3, 10000).ok());
+
+  for (unsigned i = 0; i < kNumRecords; ++i) {
+    string record = std::to_string(i * i) + string(i % 50, 'a' + i % 26) + "\n";
+    expected.append(record);
+    ASSERT_TRUE(zstd_compress.Append(ToByteRange(record)).ok());
+  }
+  ASSERT_TRUE(zstd_compress.Flush().ok());
+
+  const string& contents = compressed->contents();
+  ASSERT_GT(contents.size(), ZStdSeekTable::FOOTER_SIZE);
+  ByteRange file_range = ToByteRange(contents);
+
+  size_t table_size =
+      ZStdSeekTable::TableSize(file_range.subpiece(contents.size() - ZStdSeekTable::FOOTER_SIZE));
+  ASSERT_GT(table_size, 0);
+  ZStdSeekTable table;
+  ASSERT_TRUE(table.Parse(file_range.subpiece(contents.size() - table_size)).ok());
+
+  const auto& frames = table.frames();
+  ASSERT_GT(frames.size(), 3);
+  EXPECT_EQ(contents.size(), frames.back().offset + frames.back().size + table_size);
+  EXPECT_EQ(expected.size(), frames.back().raw_offset + frames.back().raw_size);
+  EXPECT_EQ(1, table.FindFrame(frames[1].raw_offset + 1));
+  EXPECT_EQ(frames.size(), table.FindFrame(expected.size()));
+
+  // Decodes the whole file, including the seek table, and a suffix starting at frame 2.
+  for (unsigned start : {0, 2}) {
+    string suffix = contents.substr(frames[start].offset);
+    ZStdSource zstd_src(new StringSource(suffix, 333));
+    string buf(expected.size() + 1, '\0');
+    size_t read = 0;
+    while (true) {
+      auto result = zstd_src.Read(MutableByteRange(
+          reinterpret_cast<uint8*>(&buf[read]), buf.size() - read));
+      ASSERT_TRUE(result.ok()) << result.status;
+      if (result.obj == 0)
+        break;
+      read += result.obj;
+    }
+    buf.resize(read);
+
+    EXPECT_EQ(expected.substr(frames[start].raw_offset), buf);
+  }
+
+  // Frames start at record boundaries.
+  for (unsigned i = 1; i < frames.size(); ++i) {
+    EXPECT_EQ('\n', expected[frames[i].raw_offset - 1]);
+  }
+}
+
 }  // namespace util
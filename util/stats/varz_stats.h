@@ -58,12 +58,10 @@ class VarzListNode {
   Represents a family (map) of counters. Each counter has its own key name.
 **/
 class VarzMapCount : public VarzListNode {
-  typedef StringPieceDenseMap<base::atomic_wrapper<long>> Map;
+  typedef StringPieceFlatMap<base::atomic_wrapper<long>> Map;
 
  public:
-  explicit VarzMapCount(const char* varname) : VarzListNode(varname) {
-    map_counts_.set_empty_key(StringPiece());
-  }
+  explicit VarzMapCount(const char* varname) : VarzListNode(varname) {}
 
   // Increments key by delta.
   void IncBy(StringPiece key, int32 delta);
@@ -76,15 +74,13 @@ class VarzMapCount : public VarzListNode {
   Map::iterator ReadLockAndFindOrInsert(StringPiece key);
 
   mutable folly::RWSpinLock rw_spinlock_;
-  StringPieceDenseMap<base::atomic_wrapper<long>> map_counts_;
+  Map map_counts_;
 };
 
 // represents a family of averages over 5min period.
 class VarzMapAverage5m : public VarzListNode {
  public:
-  explicit VarzMapAverage5m(const char* varname) : VarzListNode(varname) {
-    avg_.set_empty_key(StringPiece());
-  }
+  explicit VarzMapAverage5m(const char* varname) : VarzListNode(varname) {}
 
   void IncBy(StringPiece key, int32 delta);
 
@@ -94,7 +90,7 @@ class VarzMapAverage5m : public VarzListNode {
   mutable std::mutex mutex_;
 
   typedef util::SlidingSecondCounterT<int64, 5, 60> Counter;
-  StringPieceDenseMap<std::pair<Counter, Counter>> avg_;
+  StringPieceFlatMap<std::pair<Counter, Counter>> avg_;
 };
 
 class VarzCount : public VarzListNode {
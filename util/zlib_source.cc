@@ -5,8 +5,10 @@
 #include "util/zlib_source.h"
 
 #include <memory>
+
 #include "base/logging.h"
 #include "strings/strcat.h"
+#include "util/fibers/fiberqueue_threadpool.h"
 
 namespace util {
 
@@ -61,20 +63,37 @@ ZlibSource::~ZlibSource() {
   delete sub_stream_;
 }
 
+void ZlibSource::BuildIndex(uint64_t span, IndexCb cb) {
+  CHECK(!zcontext_.state) << "Must be called before reading";
+  CHECK_GT(span, 0);
+
+  index_.reset(new GzipIndex);
+  index_span_ = span;
+  index_cb_ = std::move(cb);
+}
+
 StatusObject<size_t> ZlibSource::ReadInternal(const strings::MutableByteRange& range) {
   zcontext_.next_out = range.begin();
   zcontext_.avail_out = range.size();
 
   while (true) {
     if (zcontext_.avail_in > 0) {
-      int zerror = inflate(&zcontext_, Z_NO_FLUSH);
+      // Z_BLOCK stops at the block boundaries, where we can place checkpoints.
+      int zerror = inflate(&zcontext_, index_ ? Z_BLOCK : Z_NO_FLUSH);
 
       if (zerror != Z_OK) {
         if (zerror == Z_STREAM_END) {
+          if (index_) {
+            index_->compressed_size_ = zcontext_.total_in;
+            index_->raw_size_ = zcontext_.total_out;
+            index_done_ = true;
+          }
+
           // There may be multiple zlib-streams and inflate stops when it encounters
           // Z_STREAM_END before all the requested data is inflated.
           CHECK_EQ(0, inflateEnd(&zcontext_));
           if (zcontext_.avail_in) {
+            index_.reset();  // Only single member streams are indexed.
             int reset = internalInflateInit2(format_, &zcontext_);
             CHECK_EQ(Z_OK, reset);
           }
@@ -84,9 +103,16 @@ StatusObject<size_t> ZlibSource::ReadInternal(const strings::MutableByteRange& r
         return ToStatus(zerror, zcontext_.msg);
       }
 
+      if (index_) {
+        MaybeAddIndexPoint();
+      }
+
       if (zcontext_.next_out == range.end())
         break;
 
+      if (index_ && zcontext_.avail_in)
+        continue;
+
       DCHECK_EQ(0, zcontext_.avail_in);
     }
 
@@ -94,14 +120,21 @@ StatusObject<size_t> ZlibSource::ReadInternal(const strings::MutableByteRange& r
     if (!res.ok())
       return res;
 
-    if (res.obj == 0)
+    if (res.obj == 0) {
+      if (index_ && index_done_) {
+        index_cb_(std::move(index_));
+      }
       break;
+    }
 
     DVLOG(1) << "Read " << res.obj << " bytes";
 
     zcontext_.next_in = buf_.get();
     zcontext_.avail_in = res.obj;
     if (!zcontext_.state) {
+      if (index_done_) {
+        index_.reset();
+      }
       int reset = internalInflateInit2(format_, &zcontext_);
       CHECK_EQ(Z_OK, reset);
     }
@@ -114,6 +147,294 @@ StatusObject<size_t> ZlibSource::ReadInternal(const strings::MutableByteRange& r
   return zcontext_.next_out - range.begin();
 }
 
+void ZlibSource::MaybeAddIndexPoint() {
+  // Bit 7 of data_type is set at the block boundaries, bit 6 after the last block.
+  // The first checkpoint follows the gzip header.
+  int data_type = zcontext_.data_type;
+  if ((data_type & 128) == 0 || (data_type & 64))
+    return;
+
+  auto& points = index_->points_;
+  if (!points.empty() && zcontext_.total_out - points.back().out_offset < index_span_)
+    return;
+
+  GzipIndex::Point pt;
+  pt.in_offset = zcontext_.total_in;
+  pt.out_offset = zcontext_.total_out;
+  pt.bits = data_type & 7;
+
+  pt.window.resize(GzipIndex::WINDOW_SIZE);
+  uInt len = 0;
+  CHECK_EQ(Z_OK, inflateGetDictionary(&zcontext_, reinterpret_cast<Bytef*>(&pt.window[0]), &len));
+  pt.window.resize(len);
+
+  points.push_back(std::move(pt));
+}
+
+struct ParallelGzipSource::Span {
+  std::string input;
+  std::unique_ptr<uint8_t[]> output;
+  size_t size = 0, read_pos = 0;
+  bool is_last = false;  // Indexing mode, the last chunk of the upstream.
+
+  // Guarded by mu_.
+  bool ready = false;
+  Status status;
+};
+
+namespace {
+
+// Inflates raw deflate data that starts at pt. input starts with the byte holding pt.bits
+// if there are any.
+Status InflateSpan(const GzipIndex::Point& pt, const std::string& input, uint8_t* dest,
+                   size_t size) {
+  z_stream zs;
+  InitCtx(&zs);
+  CHECK_EQ(Z_OK, inflateInit2(&zs, -15));
+
+  const Bytef* next = reinterpret_cast<const Bytef*>(input.data());
+  size_t avail = input.size();
+  if (pt.bits) {
+    CHECK_EQ(Z_OK, inflatePrime(&zs, pt.bits, next[0] >> (8 - pt.bits)));
+    ++next;
+    --avail;
+  }
+
+  if (!pt.window.empty()) {
+    CHECK_EQ(Z_OK, inflateSetDictionary(&zs, reinterpret_cast<const Bytef*>(pt.window.data()),
+                                        pt.window.size()));
+  }
+
+  zs.next_in = const_cast<Bytef*>(next);
+  zs.avail_in = avail;
+  zs.next_out = dest;
+  zs.avail_out = size;
+
+  int zerror = Z_OK;
+  while (zs.avail_out && zerror == Z_OK) {
+    zerror = inflate(&zs, Z_NO_FLUSH);
+  }
+  Status st;
+  if (zerror != Z_OK && zerror != Z_STREAM_END) {
+    st = ToStatus(zerror, zs.msg);
+  } else if (zs.avail_out) {
+    st = Status(StatusCode::IO_ERROR, "Truncated gzip span");
+  }
+  inflateEnd(&zs);
+
+  return st;
+}
+
+}  // namespace
+
+ParallelGzipSource::ParallelGzipSource(Source* upstream, std::shared_ptr<const GzipIndex> index,
+                                       fibers_ext::FiberQueueThreadPool* pool,
+                                       unsigned parallelism)
+    : upstream_(upstream), index_(std::move(index)), pool_(pool),
+      parallelism_(std::max(1u, parallelism)) {
+  CHECK(pool_);
+  CHECK(!index_->points().empty());
+}
+
+ParallelGzipSource::ParallelGzipSource(Source* upstream, fibers_ext::FiberQueueThreadPool* pool,
+                                       unsigned parallelism, uint64_t span,
+                                       ZlibSource::IndexCb cb)
+    : upstream_(upstream), pool_(pool), parallelism_(std::max(1u, parallelism)),
+      index_cb_(std::move(cb)) {
+  CHECK(pool_);
+  indexer_.reset(new ZlibSource(nullptr, ZlibSource::GZIP));
+  indexer_->BuildIndex(span, [this](std::unique_ptr<GzipIndex> index) {
+    built_index_ = std::move(index);
+  });
+  chunk_size_ = std::max<uint64_t>(span / 4, 1 << 12);
+  worker_index_ = reinterpret_cast<uintptr_t>(this) / sizeof(*this);
+}
+
+ParallelGzipSource::~ParallelGzipSource() {
+  // Waits for the pending spans since they reference this object.
+  ec_.await([this] {
+    std::lock_guard<std::mutex> lk(mu_);
+    return pending_ == 0;
+  });
+}
+
+Status ParallelGzipSource::ScheduleNext() {
+  const auto& points = index_->points();
+  const GzipIndex::Point& pt = points[next_point_];
+  bool is_last = next_point_ + 1 == points.size();
+
+  uint64_t start = pt.in_offset - (pt.bits ? 1 : 0);
+  uint64_t end = is_last ? index_->compressed_size() : points[next_point_ + 1].in_offset;
+  uint64_t out_end = is_last ? index_->raw_size() : points[next_point_ + 1].out_offset;
+  CHECK_LE(start, end);
+
+  std::unique_ptr<Span> span(new Span);
+  span->input.resize(end - start);
+  uint8_t* dest = reinterpret_cast<uint8_t*>(&span->input[0]);
+
+  // Consecutive spans share the byte that holds the boundary bits.
+  if (start < in_offset_) {
+    CHECK_EQ(1, in_offset_ - start);
+    *dest++ = last_byte_;
+  }
+
+  // Skips the gzip header before the first checkpoint.
+  uint8_t skip_buf[256];
+  while (in_offset_ < start) {
+    size_t sz = std::min<uint64_t>(sizeof(skip_buf), start - in_offset_);
+    auto res = upstream_->Read(strings::MutableByteRange(skip_buf, sz));
+    if (!res.ok())
+      return res.status;
+    if (res.obj != sz)
+      return Status(StatusCode::IO_ERROR, "Truncated gzip input");
+    in_offset_ += sz;
+  }
+
+  size_t to_read = end - in_offset_;
+  if (to_read) {
+    auto res = upstream_->Read(strings::MutableByteRange(dest, to_read));
+    if (!res.ok())
+      return res.status;
+    if (res.obj != to_read)
+      return Status(StatusCode::IO_ERROR, "Truncated gzip input");
+    in_offset_ = end;
+    last_byte_ = dest[to_read - 1];
+  }
+
+  span->size = out_end - pt.out_offset;
+  span->output.reset(new uint8_t[span->size]);
+
+  Span* sp = span.get();
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    ++pending_;
+  }
+  pool_->Add([this, sp, &pt] {
+    Finish(sp, InflateSpan(pt, sp->input, sp->output.get(), sp->size));
+  });
+
+  spans_.push_back(std::move(span));
+  ++next_point_;
+
+  return Status::OK;
+}
+
+Status ParallelGzipSource::ScheduleNextChunk() {
+  std::unique_ptr<Span> span(new Span);
+  span->input.resize(chunk_size_);
+
+  auto res = upstream_->Read(strings::MutableByteRange(
+      reinterpret_cast<uint8_t*>(&span->input[0]), chunk_size_));
+  if (!res.ok())
+    return res.status;
+  span->input.resize(res.obj);
+  upstream_eof_ = span->is_last = res.obj < chunk_size_;
+
+  Span* sp = span.get();
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    ++pending_;
+  }
+
+  // The chunks share the indexer state, hence are inflated by the same worker in order.
+  pool_->Add(worker_index_, [this, sp] { InflateChunk(sp); });
+  spans_.push_back(std::move(span));
+
+  return Status::OK;
+}
+
+void ParallelGzipSource::InflateChunk(Span* span) {
+  // Source::Read does not return data once it reached EOF, hence the indexer reads every chunk
+  // via a new sub source, and we call its ReadInternal directly. The indexer keeps its inflate
+  // state between the chunks.
+  delete indexer_->sub_stream_;
+  indexer_->sub_stream_ = new StringSource(span->input);
+
+  size_t capacity = std::max<size_t>(span->input.size() * 4, 1 << 16);
+  span->output.reset(new uint8_t[capacity]);
+
+  Status st;
+  while (true) {
+    if (capacity - span->size < (1 << 15)) {
+      capacity *= 2;
+      std::unique_ptr<uint8_t[]> tmp(new uint8_t[capacity]);
+      memcpy(tmp.get(), span->output.get(), span->size);
+      span->output.swap(tmp);
+    }
+
+    auto res = indexer_->ReadInternal(
+        strings::MutableByteRange(span->output.get() + span->size, capacity - span->size));
+    if (!res.ok()) {
+      st = res.status;
+      break;
+    }
+    if (res.obj == 0)
+      break;
+    span->size += res.obj;
+  }
+  span->input.clear();
+  indexed_out_ += span->size;
+
+  // The indexer passes the index once its member ended, which can happen at a chunk boundary
+  // of a multi-member stream. Hence we check that the index covers the whole stream.
+  if (span->is_last && st.ok() && built_index_ && built_index_->raw_size() == indexed_out_) {
+    index_cb_(std::move(built_index_));
+  }
+
+  Finish(span, std::move(st));
+}
+
+void ParallelGzipSource::Finish(Span* span, Status st) {
+  std::lock_guard<std::mutex> lk(mu_);
+  span->status = std::move(st);
+  span->ready = true;
+  --pending_;
+
+  // Notifies under the lock, otherwise the destructor may free ec_ before we touch it.
+  ec_.notifyAll();
+}
+
+StatusObject<size_t> ParallelGzipSource::ReadInternal(const strings::MutableByteRange& range) {
+  while (true) {
+    while (spans_.size() < parallelism_) {
+      if (indexer_) {
+        if (upstream_eof_)
+          break;
+        RETURN_IF_ERROR(ScheduleNextChunk());
+      } else {
+        if (next_point_ == index_->points().size())
+          break;
+        RETURN_IF_ERROR(ScheduleNext());
+      }
+    }
+
+    if (spans_.empty())
+      return 0;
+
+    Span* span = spans_.front().get();
+    Status st;
+    ec_.await([&] {
+      std::lock_guard<std::mutex> lk(mu_);
+      st = span->status;
+      return span->ready;
+    });
+    if (!st.ok())
+      return st;
+    span->input.clear();
+
+    size_t sz = std::min(range.size(), span->size - span->read_pos);
+    memcpy(range.begin(), span->output.get() + span->read_pos, sz);
+    span->read_pos += sz;
+    if (span->read_pos == span->size) {
+      spans_.pop_front();
+    }
+
+    // Chunks of the indexing mode may inflate to nothing, in which case we continue.
+    if (sz || range.empty())
+      return sz;
+  }
+}
+
 ZlibSink::ZlibSink(Sink* sub, unsigned level, size_t buf_size)
     : sub_(sub), buf_(new uint8_t[buf_size]), buf_size_(buf_size) {
   InitCtx(&zcontext_);
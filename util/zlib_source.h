@@ -6,11 +6,52 @@
 
 #include <zlib.h>
 
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include "base/macros.h"
+#include "util/fibers/event_count.h"
 #include "util/sinksource.h"
 
 namespace util {
 
+namespace fibers_ext {
+class FiberQueueThreadPool;
+}  // namespace fibers_ext
+
+// Checkpoints of a single member gzip stream that allow inflating it from the middle,
+// similarly to zlib's examples/zran.c. Each checkpoint is a deflate block boundary together
+// with the preceding 32KB window of the uncompressed data.
+class GzipIndex {
+ public:
+  enum { WINDOW_SIZE = 1 << 15 };
+
+  struct Point {
+    uint64_t in_offset;   // Compressed offset of the first full byte after the boundary.
+    uint64_t out_offset;  // Uncompressed offset.
+    uint8_t bits;         // Number of bits of the block that reside in byte in_offset - 1.
+    std::string window;
+  };
+
+  const std::vector<Point>& points() const { return points_; }
+
+  // Both are defined once the stream was fully indexed.
+  uint64_t compressed_size() const { return compressed_size_; }
+  uint64_t raw_size() const { return raw_size_; }
+
+  size_t MemoryUsage() const { return points_.size() * (sizeof(Point) + WINDOW_SIZE); }
+
+ private:
+  friend class ZlibSource;
+
+  std::vector<Point> points_;
+  uint64_t compressed_size_ = 0, raw_size_ = 0;
+};
+
 class ZlibSource : public Source {
  public:
   // Format key for constructor
@@ -32,16 +73,32 @@ class ZlibSource : public Source {
 
   static bool IsZlibSource(Source* source);
 
+  using IndexCb = std::function<void(std::unique_ptr<GzipIndex>)>;
+
+  // Builds GzipIndex with checkpoints every span uncompressed bytes while reading the stream.
+  // cb is called once the whole stream was read if it consisted of a single gzip member.
+  // Must be called before the first read and requires the sub source to start at the beginning
+  // of the stream.
+  void BuildIndex(uint64_t span, IndexCb cb);
+
  private:
+  friend class ParallelGzipSource;
 
   StatusObject<size_t> ReadInternal(const strings::MutableByteRange& range) override;
 
+  void MaybeAddIndexPoint();
+
   Source* sub_stream_;
 
   Format format_;
   z_stream zcontext_;
   std::unique_ptr<uint8_t[]> buf_;
 
+  std::unique_ptr<GzipIndex> index_;
+  uint64_t index_span_ = 0;
+  bool index_done_ = false;
+  IndexCb index_cb_;
+
   int Inflate();
 
   bool RefillInternal();
@@ -49,6 +106,66 @@ class ZlibSource : public Source {
   DISALLOW_EVIL_CONSTRUCTORS(ZlibSource);
 };
 
+// Inflates a gzip stream in FiberQueueThreadPool ahead of the reader, which waits for the data
+// without blocking its thread. If the stream is indexed, the spans between the checkpoints are
+// inflated in parallel while the compressed input is read sequentially from the upstream.
+// Otherwise, a single pool worker inflates the stream sequentially and builds its index, so
+// the inflation still overlaps with the processing of its output. The upstream is always read
+// by the reader. Unlike ZlibSource, it does not verify the gzip checksum of indexed streams.
+class ParallelGzipSource : public Source {
+ public:
+  // Takes ownership over upstream, which must start at the beginning of the indexed stream.
+  // Up to "parallelism" spans are inflated at a time.
+  ParallelGzipSource(Source* upstream, std::shared_ptr<const GzipIndex> index,
+                     fibers_ext::FiberQueueThreadPool* pool, unsigned parallelism);
+
+  // Reads a stream that is not indexed yet and builds its index with checkpoints every span
+  // uncompressed bytes. cb is called as in ZlibSource::BuildIndex. Up to "parallelism"
+  // chunks of span / 4 compressed bytes are read ahead.
+  ParallelGzipSource(Source* upstream, fibers_ext::FiberQueueThreadPool* pool,
+                     unsigned parallelism, uint64_t span, ZlibSource::IndexCb cb);
+  ~ParallelGzipSource();
+
+ private:
+  struct Span;
+
+  StatusObject<size_t> ReadInternal(const strings::MutableByteRange& range) override;
+
+  // Reads the compressed data of the next span and starts inflating it.
+  Status ScheduleNext();
+  Status ScheduleNextChunk();
+
+  void InflateChunk(Span* span);
+
+  // Called from the pool when the span is inflated.
+  void Finish(Span* span, Status st);
+
+  std::unique_ptr<Source> upstream_;
+  std::shared_ptr<const GzipIndex> index_;
+  fibers_ext::FiberQueueThreadPool* pool_;
+  unsigned parallelism_;
+
+  unsigned next_point_ = 0;
+  uint64_t in_offset_ = 0;  // of upstream.
+  uint8_t last_byte_ = 0;   // The last byte read from upstream.
+  std::deque<std::unique_ptr<Span>> spans_;
+
+  // Indexing mode. The chunks are inflated in order by the same pool worker.
+  std::unique_ptr<ZlibSource> indexer_;
+  size_t chunk_size_ = 0;
+  size_t worker_index_ = 0;
+  bool upstream_eof_ = false;
+  uint64_t indexed_out_ = 0;               // Accessed by the pool worker only.
+  std::unique_ptr<GzipIndex> built_index_;  // Ditto.
+  ZlibSource::IndexCb index_cb_;
+
+  std::mutex mu_;
+  fibers_ext::EventCount ec_;
+  unsigned pending_ = 0;  // Guarded by mu_.
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelGzipSource);
+};
+
 class ZlibSink : public Sink {
  public:
   // Takes ownership over sub-sink.
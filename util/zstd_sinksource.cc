@@ -7,6 +7,9 @@
 
 #include "util/zstd_sinksource.h"
 
+#include <algorithm>
+
+#include "base/fixed.h"
 #include "base/logging.h"
 
 namespace util {
@@ -17,6 +20,76 @@ inline Status ZstdStatus(size_t res) {
   return Status(StatusCode::IO_ERROR, ZSTD_getErrorName(res));
 }
 
+namespace {
+
+constexpr uint32_t kSeekTableMagic = 0x184D2A5E;  // Skippable frame magic.
+constexpr uint32_t kSeekableMagic = 0x8F92EAB1;   // Footer magic.
+constexpr uint8_t kChecksumFlag = 0x80;
+constexpr uint8_t kReservedBits = 0x7C;
+
+}  // namespace
+
+size_t ZStdSeekTable::TableSize(const strings::ByteRange& footer) {
+  if (footer.size() != FOOTER_SIZE || coding::DecodeFixed32(footer.data() + 5) != kSeekableMagic)
+    return 0;
+
+  uint8_t descriptor = footer[4];
+  if (descriptor & kReservedBits)
+    return 0;
+
+  uint64_t entry_size = (descriptor & kChecksumFlag) ? 12 : 8;
+  return 8 + entry_size * coding::DecodeFixed32(footer.data()) + FOOTER_SIZE;
+}
+
+Status ZStdSeekTable::Parse(const strings::ByteRange& table) {
+  const size_t sz = table.size();
+  if (sz < 8 + FOOTER_SIZE || TableSize(table.subpiece(sz - FOOTER_SIZE)) != sz ||
+      coding::DecodeFixed32(table.data()) != kSeekTableMagic ||
+      coding::DecodeFixed32(table.data() + 4) != sz - 8) {
+    return Status(StatusCode::PARSE_ERROR, "Invalid zstd seek table");
+  }
+
+  const uint8_t* next = table.data() + 8;
+  uint32_t num_frames = coding::DecodeFixed32(table.data() + sz - FOOTER_SIZE);
+  unsigned entry_size = (table[sz - 5] & kChecksumFlag) ? 12 : 8;
+
+  frames_.resize(num_frames);
+  uint64_t offset = 0, raw_offset = 0;
+  for (Frame& frame : frames_) {
+    frame.offset = offset;
+    frame.raw_offset = raw_offset;
+    frame.size = coding::DecodeFixed32(next);
+    frame.raw_size = coding::DecodeFixed32(next + 4);
+    offset += frame.size;
+    raw_offset += frame.raw_size;
+    next += entry_size;
+  }
+
+  return Status::OK;
+}
+
+void ZStdSeekTable::Serialize(const std::vector<std::pair<uint32_t, uint32_t>>& sizes,
+                              std::string* dest) {
+  coding::AppendFixed32(kSeekTableMagic, dest);
+  coding::AppendFixed32(sizes.size() * 8 + FOOTER_SIZE, dest);
+  for (const auto& sz : sizes) {
+    coding::AppendFixed32(sz.first, dest);
+    coding::AppendFixed32(sz.second, dest);
+  }
+  coding::AppendFixed32(sizes.size(), dest);
+  dest->push_back(0);  // Descriptor: no checksums.
+  coding::AppendFixed32(kSeekableMagic, dest);
+}
+
+unsigned ZStdSeekTable::FindFrame(uint64_t raw_offset) const {
+  auto it = std::upper_bound(frames_.begin(), frames_.end(), raw_offset,
+                             [](uint64_t val, const Frame& f) { return val < f.raw_offset; });
+  if (it == frames_.begin())
+    return frames_.size();
+  --it;
+  return raw_offset < it->raw_offset + it->raw_size ? it - frames_.begin() : frames_.size();
+}
+
 
 size_t ZStdSink::CompressBound(size_t src_size) {
   return ZSTD_compressBound(src_size);
@@ -37,7 +110,11 @@ ZStdSink::~ZStdSink() {
 }
 
 
-Status ZStdSink::Init(int level) {
+Status ZStdSink::Init(int level, size_t max_frame_size) {
+  // Seek table stores 32 bit sizes.
+  CHECK_LT(max_frame_size, 1U << 30);
+  max_frame_size_ = max_frame_size;
+
   size_t const res = ZSTD_initCStream_srcSize(HANDLE, level, 0);
   if (ZSTD_isError(res)) {
     return ZstdStatus(res);
@@ -47,28 +124,74 @@ Status ZStdSink::Init(int level) {
 }
 
 Status ZStdSink::Append(const strings::ByteRange& slice) {
-  ZSTD_inBuffer input = { slice.data(), slice.size(), 0 };
-  while (input.pos < input.size) {
-    ZSTD_outBuffer out_buf{ buf_.get(), buf_sz_, 0};
-    size_t res = ZSTD_compressStream(HANDLE, &out_buf , &input);
+  return AppendV(absl::MakeConstSpan(&slice, 1));
+}
+
+Status ZStdSink::AppendV(absl::Span<const strings::ByteRange> slices) {
+  ZSTD_outBuffer out_buf{buf_.get(), buf_sz_, 0};
+  for (const auto& slice : slices) {
+    ZSTD_inBuffer input = {slice.data(), slice.size(), 0};
+    while (input.pos < input.size) {
+      if (out_buf.pos == out_buf.size) {
+        frame_size_ += out_buf.pos;
+        RETURN_IF_ERROR(upstream_->Append(strings::ByteRange(buf_.get(), out_buf.pos)));
+        out_buf.pos = 0;
+      }
+      size_t res = ZSTD_compressStream(HANDLE, &out_buf, &input);
+      if (ZSTD_isError(res)) {
+        return ZstdStatus(res);
+      }
+    }
+    frame_raw_ += slice.size();
+  }
+
+  if (out_buf.pos) {
+    frame_size_ += out_buf.pos;
+    RETURN_IF_ERROR(upstream_->Append(strings::ByteRange(buf_.get(), out_buf.pos)));
+  }
+
+  if (max_frame_size_ && frame_raw_ >= max_frame_size_) {
+    return EndFrame();
+  }
+  return Status::OK;
+}
+
+// The next compression call starts a new frame with the same parameters.
+Status ZStdSink::EndFrame() {
+  size_t res;
+  do {
+    ZSTD_outBuffer out_buf{buf_.get(), buf_sz_, 0};
+    res = ZSTD_endStream(HANDLE, &out_buf);
     if (ZSTD_isError(res)) {
       return ZstdStatus(res);
     }
-    RETURN_IF_ERROR(upstream_->Append(strings::ByteRange(buf_.get(), out_buf.pos)));
+    frame_size_ += out_buf.pos;
+    if (out_buf.pos) {
+      RETURN_IF_ERROR(upstream_->Append(strings::ByteRange(buf_.get(), out_buf.pos)));
+    }
+  } while (res > 0);
+
+  if (max_frame_size_) {
+    CHECK_LE(frame_size_, kuint32max);
+    CHECK_LE(frame_raw_, kuint32max);
+    seek_sizes_.emplace_back(frame_size_, frame_raw_);
   }
+  frame_size_ = frame_raw_ = 0;
+
   return Status::OK;
 }
 
 Status ZStdSink::Flush() {
-  ZSTD_outBuffer out_buf{buf_.get(), buf_sz_, 0};
-
-  size_t res = ZSTD_endStream(HANDLE, &out_buf);
-  if (ZSTD_isError(res)) {
-    return ZstdStatus(res);
+  // Seekable output does not need an empty frame unless it has no frames at all.
+  if (!max_frame_size_ || frame_raw_ || seek_sizes_.empty()) {
+    RETURN_IF_ERROR(EndFrame());
   }
-  CHECK_EQ(0, res);
-  if (out_buf.pos) {
-    RETURN_IF_ERROR(upstream_->Append(strings::ByteRange(buf_.get(), out_buf.pos)));
+
+  if (max_frame_size_) {
+    std::string table;
+    ZStdSeekTable::Serialize(seek_sizes_, &table);
+    seek_sizes_.clear();
+    RETURN_IF_ERROR(upstream_->Append(strings::ToByteRange(table)));
   }
   return upstream_->Flush();
 }
@@ -122,11 +245,9 @@ StatusObject<size_t> ZStdSource::ReadInternal(const strings::MutableByteRange& r
       return ZstdStatus(to_read);
     }
 
+    // The decoder stops at the end of each frame even if there is more input,
+    // so we just continue with the next frame.
     buf_range_.advance(input.pos);
-    if (input.pos < input.size) {
-      CHECK_EQ(output.pos, output.size);
-      break;
-    }
   } while (output.pos < output.size);
   return output.pos;
 }
@@ -4,28 +4,83 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+
 #include "util/sinksource.h"
 
 namespace util {
 
+// Seek table of zstd seekable format: a skippable frame at the end of the file that lists
+// the sizes of its independent frames. See
+// https://github.com/facebook/zstd/blob/dev/contrib/seekable_format/zstd_seekable_compression_format.md
+// Stock zstd decoders skip the table, therefore seekable files are regular zstd files.
+class ZStdSeekTable {
+ public:
+  struct Frame {
+    uint64_t offset;      // in the compressed file.
+    uint64_t raw_offset;  // in the decompressed stream.
+    uint32_t size, raw_size;
+  };
+
+  enum { FOOTER_SIZE = 9 };
+
+  // Given the last FOOTER_SIZE bytes of the file returns the size of the seek table frame
+  // including the footer or 0 if the file is not seekable.
+  static size_t TableSize(const strings::ByteRange& footer);
+
+  // Parses the seek table frame of TableSize() bytes.
+  Status Parse(const strings::ByteRange& table);
+
+  // Appends the seek table frame of frames with the specified (compressed, raw) sizes.
+  static void Serialize(const std::vector<std::pair<uint32_t, uint32_t>>& sizes,
+                        std::string* dest);
+
+  const std::vector<Frame>& frames() const { return frames_; }
+
+  // Returns the index of the frame that contains raw_offset or frames().size() if raw_offset
+  // is past the end.
+  unsigned FindFrame(uint64_t raw_offset) const;
+
+ private:
+  std::vector<Frame> frames_;
+};
+
 class ZStdSink : public Sink {
  public:
   // Takes ownership over upstream.
   ZStdSink(Sink* upstream);
   ~ZStdSink();
 
-  Status Init(int level);
+  // If max_frame_size is 0, writes a single zstd frame. Otherwise writes zstd seekable format:
+  // a frame is closed at the end of Append/AppendV call once it has at least max_frame_size
+  // uncompressed bytes. Therefore frames start at record boundaries if each call
+  // passes whole records. Flush() writes the seek table.
+  Status Init(int level, size_t max_frame_size = 0);
   Status Append(const strings::ByteRange& slice) override;
+
+  // Compresses all the slices before passing the output upstream, so that the output of
+  // a batch of small records is appended to upstream once.
+  Status AppendV(absl::Span<const strings::ByteRange> slices) override;
+
+  // Finalizes the compressed output.
   Status Flush() override;
   static size_t CompressBound(size_t src_size);
 
  private:
+  Status EndFrame();
+
   size_t buf_sz_;
   std::unique_ptr<uint8_t[]> buf_;
   std::unique_ptr<Sink> upstream_;
   void* zstd_handle_;
+
+  size_t max_frame_size_ = 0;
+  uint64_t frame_raw_ = 0, frame_size_ = 0;
+  std::vector<std::pair<uint32_t, uint32_t>> seek_sizes_;
 };
 
+// Decodes a sequence of zstd frames, skippable frames are ignored.
+// Can start at any frame of a seekable file, see file::Source::Uncompressed.
 class ZStdSource : public Source {
  public:
   explicit ZStdSource(Source* upstream);